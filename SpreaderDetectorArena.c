@@ -0,0 +1,261 @@
+/**
+* @file SpreaderDetectorArena.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the arena and of the tracked allocation functions
+* @section DESCRIPTION
+* The counters are atomic, because the loading threads may allocate at the same time. Under a
+* limit, the bytes of an allocation are added to the bytes in use before it is made, and taken
+* back if they go over the limit (or the allocation failed), so threads that allocate at the same
+* time can not pass the limit together.
+*/
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "SpreaderDetectorArena.h"
+
+/**
+ * @def ARENA_ALIGNMENT
+ * @brief Every allocation from the arena is aligned for any type
+ */
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+/**
+ * @def ALIGN_UP(size)
+ * @brief Rounds size up to a multiple of ARENA_ALIGNMENT
+ */
+#define ALIGN_UP(size) (((size) + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT)
+
+/**
+ * @def SLAB_HEADER_SIZE
+ * @brief The memory of a slab starts after its (aligned) header
+ */
+#define SLAB_HEADER_SIZE ALIGN_UP(sizeof(ArenaSlab))
+
+/**
+ * @def MIN_SLAB_SIZE (1 << 16)
+ * @brief The size of the first slab of an arena (64KB)
+ */
+#define MIN_SLAB_SIZE (1 << 16)
+
+/**
+ * @def MAX_SLAB_SIZE (1 << 26)
+ * @brief The slabs double in size until they are 64MB, and from there they stay 64MB
+ */
+#define MAX_SLAB_SIZE (1 << 26)
+
+/**
+ * @def SLAB_GROWTH_FACTOR 2
+ * @brief Every new slab is twice the size of the previous one (until MAX_SLAB_SIZE)
+ */
+#define SLAB_GROWTH_FACTOR 2
+
+/**
+ * The counters of the tracked allocations
+ */
+static atomic_size_t numOfAllocations;
+static atomic_size_t numOfFrees;
+static atomic_size_t bytesInUse;
+static atomic_size_t peakBytesInUse;
+static atomic_size_t numOfSlabs;
+
+/**
+ * The limit of the bytes in use (NO_HEAP_LIMIT when there is none), and whether an allocation
+ * failed because of it since it was set
+ */
+static atomic_size_t heapLimit = NO_HEAP_LIMIT;
+static atomic_int heapLimitReached;
+
+/**
+ * Adds size bytes to the bytes in use, before they are allocated, unless they go over the limit
+ * @param size The number of bytes
+ * @return 1 if they were added, 0 if they go over the limit (nothing was added)
+ */
+static int reserveBytes(size_t size)
+{
+	size_t inUse = atomic_fetch_add(&bytesInUse, size) + size;
+	if (inUse < size || inUse > atomic_load(&heapLimit))
+	{
+		atomic_fetch_sub(&bytesInUse, size);
+		atomic_store(&heapLimitReached, 1);
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Counts an allocation whose bytes were reserved, and updates the peak
+ */
+static void countAllocation(void)
+{
+	atomic_fetch_add(&numOfAllocations, 1);
+	size_t inUse = atomic_load(&bytesInUse);
+	size_t peak = atomic_load(&peakBytesInUse);
+	while (inUse > peak && !atomic_compare_exchange_weak(&peakBytesInUse, &peak, inUse))
+	{
+		// peak was updated by the failed exchange, try again
+	}
+}
+
+/**
+ * Counts a release of size bytes
+ * @param size The number of bytes
+ */
+static void countFree(size_t size)
+{
+	atomic_fetch_add(&numOfFrees, 1);
+	atomic_fetch_sub(&bytesInUse, size);
+}
+
+void *arenaAlloc(Arena *arena, size_t size)
+{
+	size = ALIGN_UP(size);
+	ArenaSlab *slab = arena->slabs;
+	if (slab == NULL || slab->size - slab->used < size)
+	{
+		size_t slabSize = arena->nextSlabSize ? arena->nextSlabSize : MIN_SLAB_SIZE;
+		int ownSlab = size > slabSize; // a large request gets a slab of exactly its size
+		if (ownSlab)
+		{
+			slabSize = size;
+		}
+		ArenaSlab *newSlab = (ArenaSlab *) trackedMalloc(SLAB_HEADER_SIZE + slabSize);
+		if (newSlab == NULL)
+		{
+			return NULL;
+		}
+		newSlab->size = slabSize;
+		newSlab->used = 0;
+		if (ownSlab && slab != NULL) // keep allocating from the current slab after this one
+		{
+			newSlab->next = slab->next;
+			slab->next = newSlab;
+		}
+		else
+		{
+			newSlab->next = slab;
+			arena->slabs = newSlab;
+			size_t nextSize = slabSize * SLAB_GROWTH_FACTOR;
+			arena->nextSlabSize = nextSize < MAX_SLAB_SIZE ? nextSize : MAX_SLAB_SIZE;
+		}
+		arena->numOfSlabs++;
+		atomic_fetch_add(&numOfSlabs, 1);
+		slab = newSlab;
+	}
+	void *memory = (char *) slab + SLAB_HEADER_SIZE + slab->used;
+	slab->used += size;
+	return memory;
+}
+
+void arenaDestroy(Arena *arena)
+{
+	ArenaSlab *slab = arena->slabs;
+	while (slab != NULL)
+	{
+		ArenaSlab *next = slab->next;
+		trackedFree(slab, SLAB_HEADER_SIZE + slab->size);
+		slab = next;
+	}
+	arena->slabs = NULL;
+	arena->numOfSlabs = 0;
+	arena->nextSlabSize = 0;
+}
+
+void *trackedMalloc(size_t size)
+{
+	if (!reserveBytes(size))
+	{
+		return NULL;
+	}
+	void *ptr = malloc(size);
+	if (ptr == NULL)
+	{
+		atomic_fetch_sub(&bytesInUse, size);
+		return NULL;
+	}
+	countAllocation();
+	return ptr;
+}
+
+void *trackedCalloc(size_t num, size_t size)
+{
+	if (size != 0 && num > SIZE_MAX / size)
+	{
+		return NULL;
+	}
+	if (!reserveBytes(num * size))
+	{
+		return NULL;
+	}
+	void *ptr = calloc(num, size);
+	if (ptr == NULL)
+	{
+		atomic_fetch_sub(&bytesInUse, num * size);
+		return NULL;
+	}
+	countAllocation();
+	return ptr;
+}
+
+void *trackedRealloc(void *ptr, size_t oldSize, size_t newSize)
+{
+	// the old bytes are still in use until realloc returns (it may copy them)
+	if (!reserveBytes(newSize))
+	{
+		return NULL;
+	}
+	void *newPtr = realloc(ptr, newSize);
+	if (newPtr == NULL)
+	{
+		atomic_fetch_sub(&bytesInUse, newSize);
+		return NULL;
+	}
+	if (ptr != NULL)
+	{
+		countFree(oldSize);
+	}
+	countAllocation();
+	return newPtr;
+}
+
+void trackedFree(void *ptr, size_t size)
+{
+	if (ptr != NULL)
+	{
+		countFree(size);
+	}
+	free(ptr);
+}
+
+void setTrackedHeapLimit(size_t limit)
+{
+	atomic_store(&heapLimit, limit);
+	atomic_store(&heapLimitReached, 0);
+}
+
+size_t getTrackedHeapRoom(void)
+{
+	size_t limit = atomic_load(&heapLimit);
+	size_t inUse = atomic_load(&bytesInUse);
+	if (limit == NO_HEAP_LIMIT)
+	{
+		return NO_HEAP_LIMIT;
+	}
+	return inUse < limit ? limit - inUse : 0;
+}
+
+int isTrackedHeapLimitReached(void)
+{
+	return atomic_load(&heapLimitReached);
+}
+
+void getAllocationStats(AllocationStats *stats)
+{
+	stats->numOfAllocations = atomic_load(&numOfAllocations);
+	stats->numOfFrees = atomic_load(&numOfFrees);
+	stats->bytesInUse = atomic_load(&bytesInUse);
+	stats->peakBytesInUse = atomic_load(&peakBytesInUse);
+	stats->numOfSlabs = atomic_load(&numOfSlabs);
+}
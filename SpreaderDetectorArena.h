@@ -0,0 +1,136 @@
+/**
+* @file SpreaderDetectorArena.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The memory of the detector: a bump (arena) allocator for many small objects that live
+* until the end of the run, and counted wrappers of the standard allocation functions
+* @section DESCRIPTION
+* An arena hands out memory from large slabs by moving a pointer forward. Nothing is released one
+* by one: arenaDestroy releases the whole arena in O(number of slabs).
+* Every allocation of the detector (including the slabs) goes through the tracked functions, so
+* at the end of the run we know how many allocations were made and what was the peak of the heap.
+* A limit can be set on the bytes in use: a tracked allocation that would go over it fails like an
+* allocation with no memory (the streaming mode keeps its whole heap under its budget this way).
+*/
+
+#ifndef EXAM_SPREADERDETECTORARENA_H
+#define EXAM_SPREADERDETECTORARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @def NO_HEAP_LIMIT SIZE_MAX
+ * @brief The limit of the tracked heap when there is none
+ */
+#define NO_HEAP_LIMIT SIZE_MAX
+
+/**
+ * @struct ArenaSlab
+ * @brief One slab of an arena. The memory we hand out comes right after this header
+ */
+typedef struct ArenaSlab
+{
+	struct ArenaSlab *next;
+	size_t size;
+	size_t used;
+} ArenaSlab;
+
+/**
+ * @struct Arena
+ * @brief A bump allocator. slabs is the current slab (the one we allocate from), and the rest of
+ * the slabs are linked after it. An arena initialized to {0} is an empty arena
+ */
+typedef struct Arena
+{
+	ArenaSlab *slabs;
+	size_t numOfSlabs;
+	size_t nextSlabSize;
+} Arena;
+
+/**
+ * @struct AllocationStats
+ * @brief Counters of all the tracked allocations since the beginning of the run
+ */
+typedef struct AllocationStats
+{
+	size_t numOfAllocations;
+	size_t numOfFrees;
+	size_t bytesInUse;
+	size_t peakBytesInUse;
+	size_t numOfSlabs;
+} AllocationStats;
+
+/**
+ * Allocates memory from the arena (aligned for any type). A new slab is added when the current
+ * one is full. The slabs grow geometrically, so n allocations need O(log n) slabs at most (and a
+ * large request gets a slab of its own)
+ * @param arena the arena
+ * @param size The number of bytes
+ * @return pointer to the memory, or NULL if a new slab could not be allocated
+ */
+void *arenaAlloc(Arena *arena, size_t size);
+
+/**
+ * Releases all the slabs of the arena (O(number of slabs)) and turns it into an empty arena
+ * @param arena the arena (can be empty)
+ */
+void arenaDestroy(Arena *arena);
+
+/**
+ * malloc that is counted in the allocation stats
+ * @param size The number of bytes
+ * @return Like malloc
+ */
+void *trackedMalloc(size_t size);
+
+/**
+ * calloc that is counted in the allocation stats
+ * @param num The number of elements
+ * @param size The size of one element
+ * @return Like calloc
+ */
+void *trackedCalloc(size_t num, size_t size);
+
+/**
+ * realloc that is counted in the allocation stats
+ * @param ptr Like realloc
+ * @param oldSize The number of bytes ptr points to (0 if ptr is NULL)
+ * @param newSize The new number of bytes
+ * @return Like realloc (if it fails ptr is still valid and still counted)
+ */
+void *trackedRealloc(void *ptr, size_t oldSize, size_t newSize);
+
+/**
+ * free that is counted in the allocation stats
+ * @param ptr Like free
+ * @param size The number of bytes ptr points to
+ */
+void trackedFree(void *ptr, size_t size);
+
+/**
+ * Sets the limit of the bytes in use of the tracked allocations (and forgets that the previous
+ * limit was reached). The allocations that are already made are not changed
+ * @param limit The limit, or NO_HEAP_LIMIT
+ */
+void setTrackedHeapLimit(size_t limit);
+
+/**
+ * Returns how many more bytes can be allocated under the limit
+ * @return The bytes, or NO_HEAP_LIMIT when there is no limit
+ */
+size_t getTrackedHeapRoom(void);
+
+/**
+ * Returns whether a tracked allocation failed because of the limit since it was set
+ * @return 1 if one did, 0 otherwise
+ */
+int isTrackedHeapLimitReached(void);
+
+/**
+ * Returns the counters of the tracked allocations (safe to call while other threads allocate)
+ * @param stats Will contain the counters
+ */
+void getAllocationStats(AllocationStats *stats);
+
+#endif //EXAM_SPREADERDETECTORARENA_H
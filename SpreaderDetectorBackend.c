@@ -12,561 +12,610 @@
 * distance between the two people calculates the person's chance of infection
 * Output : A output file containing a list of all the people as well as further instructions
 * (isolation, hospitalization, etc.) according to the chance of them being infected.
+* This file only reads the arguments and reports errors: the modes themselves are functions of the
+* library (see SpreaderDetectorModes.h).
 */
 
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
 #include "SpreaderDetectorParams.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorGraph.h"
+#include "SpreaderDetectorModel.h"
+#include "SpreaderDetectorModes.h"
+#include "SpreaderDetectorOrder.h"
+#include "SpreaderDetectorPipeline.h"
+#include "SpreaderDetectorPolicy.h"
+#include "SpreaderDetectorScan.h"
+#include "SpreaderDetectorShard.h"
+#include "SpreaderDetectorStats.h"
+#include "SpreaderDetectorStreaming.h"
+#include "SpreaderDetectorTable.h"
 
 /**
  * @def VALID_ARG 3
  * @brief The number of arguments required to run the program (The name of the program, the
- * people file and the meeting file)
+ * people file and the meeting file). Options (see OPTION_PREFIX) are not counted
  */
 #define VALID_ARG 3
 
 /**
  * @def PLACE_OF_PEOPLES_FILE 1
- * @brief the place of peoples file in argv[]
+ * @brief the place of peoples file in argv[] (not counting the options)
  */
 #define PLACE_OF_PEOPLS_FILE 1
 
 /**
  * @def PLACE_OF_MEETINGS_FILE 2
- * @brief the place of meetings file in argv[]
+ * @brief the place of meetings file in argv[] (not counting the options)
  */
 #define PLACE_OF_MEETINGS_FILE 2
 
 /**
- * @def TYPE_ARG_ERROR 0
- * @brief In case not enough arguments were received the error will be represented by 0
+ * @def OPTION_PREFIX "--"
+ * @brief An argument that starts with "--" is an option and not a path. The options can be given
+ * anywhere in argv[]
  */
-#define TYPE_ARG_ERROR 0
+#define OPTION_PREFIX "--"
 
 /**
- * @def ARGS_ERR_MSG "Usage: ./SpreaderDetectorBackend <Path to People.in> <Path to Meetings.in>\n"
- * @brief This message should be printed to stderr when a invalid error occurs.
+ * @def THREADS_OPTION "--threads="
+ * @brief "--threads=N" sets the number of threads that load the people file. By default we use
+ * all the online cores. The output does not depend on the number of threads
  */
-#define ARGS_ERR_MSG "Usage: ./SpreaderDetectorBackend <Path to People.in> <Path to Meetings.in>\n"
+#define THREADS_OPTION "--threads="
 
 /**
- * @def TYPE_OPEN_INFILE_ERROR 1
- * @brief In case the program fails to open a file (input!) the error will be represented
- * by 1
+ * @def MEMORY_STATS_OPTION "--memory-stats"
+ * @brief "--memory-stats" prints to stderr (at the end of the run) how many allocations were made,
+ * the peak of the heap and the peak RSS of the process
  */
-#define TYPE_OPEN_INFILE_ERROR 1
+#define MEMORY_STATS_OPTION "--memory-stats"
 
 /**
- * @def OPEN_IN_FILE_ERR_MSG "Error in input files.\n"
- * @brief This message should be printed to stderr when a open file error occurs (in input file).
+ * @def STATS_OPTION "--stats"
+ * @brief "--stats" prints to stderr (at the end of the run) a JSON report of the phases of the run:
+ * their time and hardware counters, the allocations and the bytes read and written (see
+ * SpreaderDetectorStats.h). Not an option when building with SPREADER_NO_PHASE_STATS
  */
-#define OPEN_IN_FILE_ERR_MSG "Error in input files.\n"
+#define STATS_OPTION "--stats"
 
 /**
- * @def TYPE_LIBRARY_ERROR 2
- * @brief In case there is a directory error for example: The operating system failed to allocate
- * memory, the error will be represented by 2
+ * @def TIMING_OPTION "--timing"
+ * @brief "--timing" prints to stderr how long the output phase (formatting and writing the output
+ * file) took
  */
-#define TYPE_LIBRARY_ERROR 2
+#define TIMING_OPTION "--timing"
 
 /**
- * @def TYPE_OPEN_OUTFILE_ERROR 3
- * @brief In case the program fails to open a file (output!) the error will be represented
- * by 1
+ * @def COMBINE_OPTION "--combine="
+ * @brief "--combine=max" (the default) or "--combine=noisy-or" sets how the exposures of a person
+ * who was met by several infectors are combined (see SpreaderDetectorGraph.h)
  */
-#define TYPE_OPEN_OUTFILE_ERROR 3
+#define COMBINE_OPTION "--combine="
 
 /**
- * @def OPEN_OUT_FILE_ERR_MSG "Error in output file.\n"
- * @brief This message should be printed to stderr when a open file error occurs (in output file).
+ * @def COMBINE_MAX_NAME "max"
+ * @brief The value of "--combine=" for COMBINE_MAX
  */
-#define OPEN_OUT_FILE_ERR_MSG "Error in output file.\n"
+#define COMBINE_MAX_NAME "max"
 
 /**
- * @def MAX_LINE_SIZE 1025
- * @brief It can be assumed that the maximum line length (in the input file or in the output file)
- * is 1024 but since we capture each line as a string we will need 1025 space in memory because '\0'
+ * @def COMBINE_NOISY_OR_NAME "noisy-or"
+ * @brief The value of "--combine=" for COMBINE_NOISY_OR
  */
-#define MAX_LINE_SIZE 1025
+#define COMBINE_NOISY_OR_NAME "noisy-or"
 
 /**
- * @def INIT_PROB 0.0f
- * @brief For each person absorbed from the people file we will initialize the probability that he
- * is sick to be 0, then if he is also in the meeting file (he will not necessarily be there)
- * we will change the probability accordingly)
+ * @def MEMORY_BUDGET_OPTION "--memory-budget="
+ * @brief "--memory-budget=N" (N in bytes, or with the suffix K, M or G) runs the streaming mode:
+ * the people are never kept in memory as a whole, and everything the mode allocates (the meetings,
+ * the people who appear in them and the people that are sorted at once) is kept under N bytes, or
+ * it fails with MEMORY_BUDGET_ERR_MSG (see SpreaderDetectorStreaming.h). N must be at least
+ * MIN_MEMORY_BUDGET (64K). The output is exactly the output of the regular mode
  */
-#define INIT_PROB 0.0f
+#define MEMORY_BUDGET_OPTION "--memory-budget="
 
 /**
- * @def IRRELEVANT_LEN 0
- * @brief The function that handles errors should have the array that contains the people and its
- * length. (To release resources before exiting) but sometimes the length of the list is irrelevant
- * (for example: before we even allocated memory) so 0 is given in the parameter of "list length"
+ * @def DELTAS_OPTION "--deltas="
+ * @brief "--deltas=PATH" keeps the people and the graph of the meetings in memory after the output
+ * file was written, and reads batches of new meetings from PATH (a file or a named pipe, so the
+ * batches can come over time). A batch is lines of meetings (the same format as the meeting file)
+ * that ends with an empty line or with the end of PATH
  */
-#define IRRELEVANT_LEN 0
+#define DELTAS_OPTION "--deltas="
 
 /**
- * @def INIT_COUNTER 0
- * @brief init counter
+ * @def WRITE_SNAPSHOT_OPTION "--write-snapshot="
+ * @brief "--write-snapshot=PREFIX" converts the two input files into binary snapshots (see
+ * SpreaderDetectorSnapshot.h) instead of writing the output file: PREFIX.people.snap and
+ * PREFIX.meetings.snap. The snapshots can then be given instead of the input files
  */
-#define INIT_COUNTER 0
+#define WRITE_SNAPSHOT_OPTION "--write-snapshot="
 
 /**
- * @def READING_MODE "r"
- * @brief Will indicate to the function "fopen" that we want to read only from the file (Of the two
- * input files we only read)
+ * @def PIPELINE_OPTION "--pipeline="
+ * @brief "--pipeline=N" reads the text meeting file through a pipeline of threads (see
+ * SpreaderDetectorPipeline.h): a reader, N parsers and the main thread, which finds the people and
+ * adds the meetings in the order of the file. With "--timing" the counters of every stage and of
+ * the rings between them are printed to stderr. The output does not depend on N
  */
-#define READING_MODE "r"
+#define PIPELINE_OPTION "--pipeline="
 
 /**
- * @def WRITING_MODE "w"
- * @brief Will indicate to the function "fopen" that we will just write into the file (In the
- * case of the output file)
+ * @def TOP_OPTION "--top="
+ * @brief "--top=K" writes only the first K people of the output file (the K with the highest
+ * probability). They are selected with a heap of K keys, so the other people are not sorted
  */
-#define WRITING_MODE "w"
+#define TOP_OPTION "--top="
 
 /**
- * @def NUM_OF_FILDS_PEOPLE_FILE 3
- * @brief The number of fields in each row in the people file should be 3: name, ID number and age
+ * @def MIN_PROB_OPTION "--min-prob="
+ * @brief "--min-prob=X" writes only the people whose probability is at least X (in the order of
+ * the output file). They are filtered in one pass, and only they are sorted. X is a number, or
+ * the name of a class (MIN_PROB_QUARANTINE_NAME or MIN_PROB_HOSPITALIZATION_NAME) for the people
+ * of that class or a more risky one by the policy (the thresholds of their age bands). A name
+ * always writes the first lines of the output file. A number does too with the default policy,
+ * but with a policy whose classes are not in the order of the probabilities (an old person can be
+ * in a more risky class with a smaller probability) the people at least X are not only the first
+ * lines. It can be given with "--top="
  */
-#define NUM_OF_FILDS_PEOPLE_FILE 3
+#define MIN_PROB_OPTION "--min-prob="
 
 /**
- * @def FORMAT_LINE_IN_PEOPLES_FILE "%s %d %f"
- * @brief Each line in the people file is as follows: <Person Name> <Person ID> <Person age>\n
- * Therefore we will read from it in the following format - "%s %d %f" - Into the variables
+ * @def MIN_PROB_QUARANTINE_NAME "quarantine"
+ * @brief "--min-prob=quarantine" keeps the people of QUARANTINE_CLASS and HOSPITALIZATION_CLASS
  */
-#define FORMAT_LINE_IN_PEOPLES_FILE "%s %lu %f"
+#define MIN_PROB_QUARANTINE_NAME "quarantine"
 
 /**
- * @def NUM_OF_FILDS_FIRST_LINE_MEETING_FILE 1
- * @brief The number of fields in first line in the meetings file should be 1: id of spreader
- * infector-id, infected-id, distance, time
+ * @def MIN_PROB_HOSPITALIZATION_NAME "hospitalization"
+ * @brief "--min-prob=hospitalization" keeps the people of HOSPITALIZATION_CLASS
  */
-#define NUM_OF_FILDS_FIRST_LINE_MEETING_FILE 1
-
+#define MIN_PROB_HOSPITALIZATION_NAME "hospitalization"
 
 /**
- * @def FORMAT_FIRST_LINE_IN_MEETINGS_FILE "%d"
- * @brief the first line in the meeting file is as follows: <spreader_id>\n
- * Therefore we will read from it in the following format - "%d" - Into the variable
+ * @def POLICY_OPTION "--policy="
+ * @brief "--policy=PATH" loads the age bands and the thresholds of the classes from PATH (see
+ * SpreaderDetectorPolicy.h) instead of the default policy
  */
-#define FORMAT_FIRST_LINE_IN_MEETINGS_FILE "%lu"
+#define POLICY_OPTION "--policy="
 
 /**
- * @def NUM_OF_FILDS_MEETING_FILE 4
- * @brief The number of fields in each row (except first line) in the meetings file should be 4:
- * infector-id, infected-id, distance, time
+ * @def SHARDS_OPTION "--shards="
+ * @brief "--shards=N" splits the people between N worker processes by a hash of their ID (see
+ * SpreaderDetectorShard.h), and merges their outputs into the output file
  */
-#define NUM_OF_FILDS_MEETING_FILE 4
+#define SHARDS_OPTION "--shards="
 
 /**
- * @def FORMAT_LINE_IN_MEETINGS_FILE "%d %d %f %f"
- * @brief Each line in the meeting file is as follows: <infector_id> <infected_id> <distance> <time>
- * Therefore we will read from it in the following format - "%d %d %f %f" - Into the variables
+ * @def SERVE_OPTION "--serve="
+ * @brief "--serve=PATH" loads the two files into an engine and answers queries on the Unix domain
+ * socket PATH (see SpreaderDetectorServer.h) until a client shuts it down, instead of writing the
+ * output file
  */
-#define FORMAT_LINE_IN_MEETINGS_FILE "%lu %lu %f %f"
+#define SERVE_OPTION "--serve="
 
 /**
- * @def LEFT_BEFOR_RIGHT -1
- * @brief In the comparison functions to be passed to q-sort -1 will indicate that the left value
- * should be according to the right value
+ * @def MODEL_OPTION "--model="
+ * @brief "--model=NAME" computes the probability of every meeting by the risk model NAME (see
+ * SpreaderDetectorModel.h) instead of the crna
  */
-#define LEFT_BEFOR_RIGHT -1
+#define MODEL_OPTION "--model="
 
 /**
- * @def PROBABILITY_IS_ONE 1
- * @brief The first person received in the file is sick for sure
+ * @def VALIDATE_OPTION "--validate"
+ * @brief "--validate" only checks the two text files (see SpreaderDetectorValidate.h): every
+ * problem is written to stdout with its line, then a summary, and the program ends with
+ * EXIT_FAILURE if there was any problem. No output file is written
  */
-#define PROBABILITY_IS_ONE 1
+#define VALIDATE_OPTION "--validate"
 
 /**
- * @def ELEMENT_NOT_FOUND -1
- * @brief If no element is found in the binary search, -1 will be returned. Let us note that in this
- * program if we look for someone in the array of people he will inevitably be there.
- * (It can be assumed that all the people in the meeting file are in the people file)
+ * @def KILO_SHIFT 10
+ * @brief The suffixes of the memory budget: K is 2^10, M is 2^20 and G is 2^30
  */
-#define ELEMENT_NOT_FOUND -1
+#define KILO_SHIFT 10
 
 /**
- * @def NO_PEOPLE_IN_FIRST_FILE 0
- * @brief Indicates that the people file is empty
+ * @def TYPE_ARG_ERROR 0
+ * @brief In case not enough arguments were received the error will be represented by 0
  */
-#define NO_PEOPLE_IN_FIRST_FILE 0
-
+#define TYPE_ARG_ERROR 0
 
 /**
- * @struct PersonDetailsNode
- * @brief Represents a person received in the first input file
+ * @def ARGS_ERR_MSG "Usage: ./SpreaderDetectorBackend <Path to People.in> <Path to Meetings.in>\n"
+ * @brief This message should be printed to stderr when a invalid error occurs.
  */
-typedef struct PersonDetailsNode
-{
-	size_t id;
-	float age;
-	char name[MAX_LINE_SIZE];
-	float probInfected;
-} PersonDetailsNode;
+#define ARGS_ERR_MSG "Usage: ./SpreaderDetectorBackend <Path to People.in> <Path to Meetings.in>\n"
 
 /**
- * @struct MeetingInfo
- * @brief Represents a meeting between two people received in the second input file
+ * @def TYPE_OPEN_INFILE_ERROR 1
+ * @brief In case the program fails to open a file (input!) the error will be represented
+ * by 1
  */
-typedef struct MeetingInfo
-{
-	size_t infectorId;
-	size_t infectedId;
-	float distance;
-	float time;
-} MeetingInfo;
+#define TYPE_OPEN_INFILE_ERROR 1
 
+/**
+ * @def OPEN_IN_FILE_ERR_MSG "Error in input files.\n"
+ * @brief This message should be printed to stderr when a open file error occurs (in input file).
+ */
+#define OPEN_IN_FILE_ERR_MSG "Error in input files.\n"
 
 /**
- * Creates an array that contains all the people from the first file
- * @param path Path to the file of the people
- * @param numOfPeople Pointer to counter of people. So that at the end of the run the variable will
- * be updated. (And it also represented the length of the array)
- * @return pointer to Array of pointers to "PersonDetailsNode". That is, an array that contains all
- * the people
+ * @def TYPE_LIBRARY_ERROR 2
+ * @brief In case there is a directory error for example: The operating system failed to allocate
+ * memory, the error will be represented by 2
  */
-PersonDetailsNode **createArrayOfPeopleFromFirstFile(const char *path, size_t * numOfPeople);
+#define TYPE_LIBRARY_ERROR 2
 
 /**
- * creates one "PersonDetailsNode" from one line in the people file
- * @param line line from the people file
- * @param arrayPeople pointer to pointer to array of people (We want a pointer, because if there
- * is a directory error within the function we can free up resources and change (!) the pointer to
- * an array to be a NULL)
- * @param lenOfArray num of peoples
- * @return pointer to "PersonDetailsNode" that Represents people
+ * @def TYPE_OPEN_OUTFILE_ERROR 3
+ * @brief In case the program fails to open a file (output!) the error will be represented
+ * by 1
  */
-PersonDetailsNode *createPersonDetailsNodeFromLine(const char *line, PersonDetailsNode
-                                                   ***arrayPeople, size_t lenOfArray);
+#define TYPE_OPEN_OUTFILE_ERROR 3
 
 /**
- * Reads the meeting file and updates the probability of each person who is there accordingly
- * @param path Path to the meeting file
- * @param arrayPeople pointer to pointer to array of people (We want a pointer, because if there
- * is a directory error within the function we can free up resources and change (!) the pointer to
- * an array to be a NULL)
- * @param lenOfArray num of peoples
+ * @def OPEN_OUT_FILE_ERR_MSG "Error in output file.\n"
+ * @brief This message should be printed to stderr when a open file error occurs (in output file).
  */
-void readMeetingsFile(const char *path, PersonDetailsNode ***arrayPeople, size_t lenOfArray);
+#define OPEN_OUT_FILE_ERR_MSG "Error in output file.\n"
 
 /**
- * Given a line in the meeting file (starting with the second line) we will create a "MeetingInfo"
- * that represents a one meeting
- * @param line line from meeting file
- * @param arrayPeople pointer to pointer to array of people (We want a pointer, because if there
- * is a directory error within the function we can free up resources and change (!) the pointer to
- * an array to be a NULL)
- * @param lenOfArray num of peoples
- * @return "MeetingInfo" that represents a one meeting
+ * @def TYPE_MEMORY_BUDGET_ERROR 4
+ * @brief In case the streaming mode needs more memory than "--memory-budget=" the error will be
+ * represented by 4
  */
-MeetingInfo createMeetingInfoFromLine(const char *line, PersonDetailsNode ***arrayPeople, size_t
-                                      lenOfArray);
+#define TYPE_MEMORY_BUDGET_ERROR 4
 
 /**
- * Standard binary search (O(logn)).
- * After creating the array of people - the progrem sort them by ID number. So when two people
- * meet and we want to update the probability that they are infected we can do so quickly
- * by binary search.
- * @param arr array of people
- * @param left The beginning of the array we are looking for
- * @param right The end of the array we are looking for
- * @param The ID number of the person we are looking for in the array
- * @return The location in the array where the person is
+ * @def MEMORY_BUDGET_ERR_MSG "Error in memory budget.\n"
+ * @brief This message should be printed to stderr when the input files do not fit in the memory
+ * budget.
  */
-size_t standardBinarySearch(PersonDetailsNode **arr, size_t left, size_t right, size_t id);
+#define MEMORY_BUDGET_ERR_MSG "Error in memory budget.\n"
+
 
 /**
- * Given infector and infected, As well as the meeting time and the distance between them. We will
- * update the probability that the second is infected according to the "crna" function and the
- * probability that the first is sick
- * @param distance The distance between the two people during the meeting
- * @param time How long did the meeting take
- * @param first the infector
- * @param sec the infected
+ * Reads the paths and the options from argv[]. In case of invalid arguments exits with
+ * TYPE_ARG_ERROR
+ * @param argc argc of main
+ * @param argv argv of main
+ * @param options Will contain the paths and the options
  */
-void updateProbAccordingCrnaAndProbOfInfector(float distance, float time, const PersonDetailsNode
-                                              *first, PersonDetailsNode *sec);
+void parseArguments(int argc, char *argv[], DetectorOptions *options);
 
 /**
- * After processing the data and updating the probabilities of all the people.
- * We will print to the output file all the people and instructions regarding isolation or
- * hospitalization, etc. according to the probability in which they were infected.
- * @param arrayPeople pointer to pointer to array of people (We want a pointer, because if there
- * is a directory error within the function we can free up resources and change (!) the pointer to
- * an array to be a NULL)
- * @param lenOfArray num of peoples
+ * Reads the value of "--memory-budget=". In case it is not a number (with an optional suffix K, M
+ * or G) of at least MIN_MEMORY_BUDGET bytes exits with TYPE_ARG_ERROR
+ * @param value The text after the '='
+ * @return The budget in bytes
  */
-void printToOutputFile(PersonDetailsNode ***peopleArray, size_t lenOfArray);
+size_t parseMemoryBudget(const char *value);
 
 /**
- * Given one person. The function will decide what to print to the output file.
- * (Is hospitalization, isolation needed or is it clean)
- * @param fdOutputFile  the output file
- * @param spreader the cur person
+ * Parses the value of "--min-prob=" (exits with the usage on an invalid value)
+ * @param value A number, MIN_PROB_QUARANTINE_NAME or MIN_PROB_HOSPITALIZATION_NAME
+ * @param options Will contain the threshold (a number) or the last class that is kept (a name)
  */
-void manageToOutputFile(FILE *fdOutputFile, const PersonDetailsNode *spreader);
+void parseMinProb(const char *value, DetectorOptions *options);
 
 /**
- * Handles any case of program error. (arguments. Error opening files, directory errors, etc.)
- * Releases resources and exits the program with exit code 1
- * @param typeError Error type
- * @param arrayPeople pointer to pointer to array of people (We want a pointer, because we
- * want change (!) the pointer to an array to be a NULL)
- * attention!! In errors that occurred before assignment we will pass null instead of the pointer
- * And 0 as the length of the array
- * @param lenOfArray num of peoples
+ * Returns whether only some of the people are written ("--top=" or "--min-prob=")
+ * @param options The options
+ * @return 1 if they are, 0 if everyone is written
  */
-void errorCase(int typeError, PersonDetailsNode ***arrayPeople, size_t lenOfArray);
+int isSelectingPeople(const DetectorOptions *options);
 
 /**
- * Releases the allocated resources. And turns the pointers we released to a NULL
- * @param arrayPeople pointer to pointer to array of people (We want a pointer, because we
- * want change (!) the pointer to an array to be a NULL)
- * @param lenOfArray num of peoples
+ * Returns the error type of a mode that failed (see SpreaderDetectorModes.h)
+ * @param status The MODE_ code the mode returned (not MODE_SUCCESS)
+ * @return The error type
  */
-void freeResources(PersonDetailsNode ***arrayPeople, size_t lenOfArray);
+int typeOfModeError(int status);
 
 /**
- * A comparison function to q-sort that decides which value is greater than the other according to
- * the ID number. This way we can sort the array by ID (the array will be sorted from the smallest to
- * the largest)
- * @param first
- * @param sec
- * @return -1 if less. 1 if grater and 0 if equal
+ * Handles any case of program error. (arguments. Error opening files, directory errors, etc.)
+ * Prints its message and exits the program with exit code 1 (the modes release their resources
+ * before they return an error)
+ * @param typeError Error type
  */
-int cmpFuncId(const void *first, const void *sec);
+void errorCase(int typeError);
 
 /**
- *  A comparison function to q-sort that decides which value is greater than the other according to
- * the The probability of infection. This way we can sort the array of people by probability of
- * infection (Note!: the array will be sorted from the largest to the smallest)
- * @param first
- * @param sec
- * @return -1 if grater. 1 if less and 0 if equal
+ * Prints to stderr the allocation stats (see SpreaderDetectorArena.h) and the peak RSS of the
+ * process
  */
-int cmpFuncProb(const void *first, const void *sec);
+void printMemoryStats(void);
 
 
 int main(int argc, char *argv[])
 {
-	if (argc != VALID_ARG)
+	DetectorOptions options;
+	parseArguments(argc, argv, &options);
+	if (options.printStats)
 	{
-		errorCase(TYPE_ARG_ERROR, NULL, IRRELEVANT_LEN); // len of array not relevant
+		STATS_ENABLE();
 	}
-	char *pathToPeopleFile = argv[PLACE_OF_PEOPLS_FILE];
-	char *pathToMeetings = argv[PLACE_OF_MEETINGS_FILE];
-	size_t numOfPeople = INIT_COUNTER; // len of array!!
-	PersonDetailsNode **ArrayOfPeople = createArrayOfPeopleFromFirstFile(pathToPeopleFile,
-																		 &numOfPeople);
-	if (numOfPeople ==
-		NO_PEOPLE_IN_FIRST_FILE) // The people file is empty so surely (by assumptions)
-		// the meeting file is empty. So we will print a empty file,(We will first check the
-		// correctness of the second file, because it may not open at all and then this is an error.
-		// If it opens it is guaranteed to be empty) free resources And we'll get
-		// out of the program
+	int status = runDetector(&options);
+	// The problems the validation found were already written, so there is no message
+	if (status != MODE_SUCCESS && status != MODE_INVALID_FILES)
 	{
-		readMeetingsFile(pathToMeetings, &ArrayOfPeople, numOfPeople);
-		printToOutputFile(&ArrayOfPeople, numOfPeople);
-		freeResources(&ArrayOfPeople, numOfPeople);
-		return EXIT_SUCCESS;
+		errorCase(typeOfModeError(status));
 	}
-	qsort(ArrayOfPeople, numOfPeople, sizeof(PersonDetailsNode *), cmpFuncId); //Sort the array
-	// by ID
-	readMeetingsFile(pathToMeetings, &ArrayOfPeople, numOfPeople);
-	qsort(ArrayOfPeople, numOfPeople, sizeof(PersonDetailsNode *), cmpFuncProb); //Sort the array
-	// according to the probability of infection
-	printToOutputFile(&ArrayOfPeople, numOfPeople);
-	freeResources(&ArrayOfPeople, numOfPeople);
-	return EXIT_SUCCESS;
-}
-
-PersonDetailsNode **createArrayOfPeopleFromFirstFile(const char *path, size_t * numOfPeople)
-{
-	FILE *inputFile = fopen(path, READING_MODE);
-	if (inputFile == NULL)
+	if (options.printMemoryStats)
 	{
-		errorCase(TYPE_OPEN_INFILE_ERROR, NULL, IRRELEVANT_LEN);
+		printMemoryStats();
 	}
-	PersonDetailsNode **arrayOfPeople = (PersonDetailsNode **) malloc(
-			sizeof(PersonDetailsNode *));
-	if (arrayOfPeople == NULL)
+	if (options.printStats)
 	{
-		errorCase(TYPE_LIBRARY_ERROR, NULL, IRRELEVANT_LEN);
+		WRITE_STATS_REPORT(stderr);
 	}
-	char currentRow[MAX_LINE_SIZE];
-	while (fgets(currentRow, sizeof(currentRow), inputFile))
+	return status == MODE_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void parseArguments(int argc, char *argv[], DetectorOptions *options)
+{
+	const char *paths[VALID_ARG] = {argv[0]};
+	size_t numOfPaths = 1; // argv[0]
+	long onlineCores = sysconf(_SC_NPROCESSORS_ONLN);
+	options->numOfThreads = onlineCores > 0 ? (size_t) onlineCores : 1;
+	options->printMemoryStats = 0;
+	options->printStats = 0;
+	options->printTiming = 0;
+	options->combineRule = COMBINE_MAX;
+	options->memoryBudget = NO_MEMORY_BUDGET;
+	options->pathToDeltas = NULL;
+	options->snapshotPrefix = NULL;
+	options->numOfParsers = NO_PIPELINE;
+	options->top = NO_TOP;
+	options->minProb = NO_MIN_PROB;
+	options->maxClass = NO_MAX_CLASS;
+	options->numOfShards = NO_SHARDS;
+	options->socketPath = NULL;
+	options->riskModel = MODEL_CRNA;
+	options->isValidation = 0;
+	options->log = stderr;
+	initDefaultPolicy(&options->policy);
+	const char *pathToPolicy = NULL;
+	for (int i = 1; i < argc; ++i)
 	{
-		size_t placeNeeded = ((*numOfPeople) + 1) * sizeof(PersonDetailsNode *);
-		PersonDetailsNode **tmpArrayOfPeople = (PersonDetailsNode **) realloc(arrayOfPeople,
-																			  placeNeeded);
-		if (tmpArrayOfPeople == NULL)
+		if (strncmp(argv[i], OPTION_PREFIX, strlen(OPTION_PREFIX)) != 0)
+		{
+			if (numOfPaths == VALID_ARG)
+			{
+				errorCase(TYPE_ARG_ERROR);
+			}
+			paths[numOfPaths++] = argv[i];
+		}
+		else if (strncmp(argv[i], THREADS_OPTION, strlen(THREADS_OPTION)) == 0)
+		{
+			char *numberEnd;
+			long numOfThreads = strtol(argv[i] + strlen(THREADS_OPTION), &numberEnd, DECIMAL_BASE);
+			if (*numberEnd != '\0' || numOfThreads < 1)
+			{
+				errorCase(TYPE_ARG_ERROR);
+			}
+			options->numOfThreads = (size_t) numOfThreads;
+		}
+		else if (strcmp(argv[i], MEMORY_STATS_OPTION) == 0)
+		{
+			options->printMemoryStats = 1;
+		}
+#ifndef NO_PHASE_STATS
+		else if (strcmp(argv[i], STATS_OPTION) == 0)
+		{
+			options->printStats = 1;
+		}
+#endif
+		else if (strcmp(argv[i], TIMING_OPTION) == 0)
+		{
+			options->printTiming = 1;
+		}
+		else if (strcmp(argv[i], COMBINE_OPTION COMBINE_MAX_NAME) == 0)
+		{
+			options->combineRule = COMBINE_MAX;
+		}
+		else if (strcmp(argv[i], COMBINE_OPTION COMBINE_NOISY_OR_NAME) == 0)
+		{
+			options->combineRule = COMBINE_NOISY_OR;
+		}
+		else if (strncmp(argv[i], MEMORY_BUDGET_OPTION, strlen(MEMORY_BUDGET_OPTION)) == 0)
 		{
-			errorCase(TYPE_LIBRARY_ERROR, &arrayOfPeople, *numOfPeople);
+			options->memoryBudget = parseMemoryBudget(argv[i] + strlen(MEMORY_BUDGET_OPTION));
+		}
+		else if (strncmp(argv[i], DELTAS_OPTION, strlen(DELTAS_OPTION)) == 0 &&
+		         argv[i][strlen(DELTAS_OPTION)] != '\0')
+		{
+			options->pathToDeltas = argv[i] + strlen(DELTAS_OPTION);
+		}
+		else if (strncmp(argv[i], WRITE_SNAPSHOT_OPTION, strlen(WRITE_SNAPSHOT_OPTION)) == 0 &&
+		         argv[i][strlen(WRITE_SNAPSHOT_OPTION)] != '\0')
+		{
+			options->snapshotPrefix = argv[i] + strlen(WRITE_SNAPSHOT_OPTION);
+		}
+		else if (strncmp(argv[i], PIPELINE_OPTION, strlen(PIPELINE_OPTION)) == 0)
+		{
+			char *numberEnd;
+			long numOfParsers = strtol(argv[i] + strlen(PIPELINE_OPTION), &numberEnd, DECIMAL_BASE);
+			if (*numberEnd != '\0' || numOfParsers < 1 || numOfParsers > MAX_PARSERS)
+			{
+				errorCase(TYPE_ARG_ERROR);
+			}
+			options->numOfParsers = (size_t) numOfParsers;
+		}
+		else if (strncmp(argv[i], TOP_OPTION, strlen(TOP_OPTION)) == 0)
+		{
+			char *numberEnd;
+			long long top = strtoll(argv[i] + strlen(TOP_OPTION), &numberEnd, DECIMAL_BASE);
+			if (*numberEnd != '\0' || top < 1)
+			{
+				errorCase(TYPE_ARG_ERROR);
+			}
+			options->top = (size_t) top;
+		}
+		else if (strncmp(argv[i], MIN_PROB_OPTION, strlen(MIN_PROB_OPTION)) == 0)
+		{
+			parseMinProb(argv[i] + strlen(MIN_PROB_OPTION), options);
+		}
+		else if (strncmp(argv[i], SHARDS_OPTION, strlen(SHARDS_OPTION)) == 0)
+		{
+			char *numberEnd;
+			long numOfShards = strtol(argv[i] + strlen(SHARDS_OPTION), &numberEnd, DECIMAL_BASE);
+			if (*numberEnd != '\0' || numOfShards < 1 || numOfShards > MAX_SHARDS)
+			{
+				errorCase(TYPE_ARG_ERROR);
+			}
+			options->numOfShards = (size_t) numOfShards;
+		}
+		else if (strncmp(argv[i], SERVE_OPTION, strlen(SERVE_OPTION)) == 0 &&
+		         argv[i][strlen(SERVE_OPTION)] != '\0')
+		{
+			options->socketPath = argv[i] + strlen(SERVE_OPTION);
+		}
+		else if (strcmp(argv[i], VALIDATE_OPTION) == 0)
+		{
+			options->isValidation = 1;
+		}
+		else if (strncmp(argv[i], MODEL_OPTION, strlen(MODEL_OPTION)) == 0)
+		{
+			options->riskModel = findRiskModel(argv[i] + strlen(MODEL_OPTION));
+			if (options->riskModel == NO_RISK_MODEL)
+			{
+				errorCase(TYPE_ARG_ERROR);
+			}
+		}
+		else if (strncmp(argv[i], POLICY_OPTION, strlen(POLICY_OPTION)) == 0 &&
+		         argv[i][strlen(POLICY_OPTION)] != '\0')
+		{
+			pathToPolicy = argv[i] + strlen(POLICY_OPTION);
+		}
+		else // unknown option
+		{
+			errorCase(TYPE_ARG_ERROR);
 		}
-		arrayOfPeople = tmpArrayOfPeople;
-		arrayOfPeople[*numOfPeople] = createPersonDetailsNodeFromLine(currentRow,
-																	  &arrayOfPeople,
-																	  *numOfPeople);
-		(*numOfPeople)++;
 	}
-	fclose(inputFile);
-	return arrayOfPeople;
-
-}
-
-PersonDetailsNode *
-createPersonDetailsNodeFromLine(const char *line, PersonDetailsNode ***arrayPeople, size_t
-                                lenOfArray)
-{
-	PersonDetailsNode *curPerson = (PersonDetailsNode *) malloc(sizeof(PersonDetailsNode));
-	if (curPerson == NULL)
+	if (numOfPaths != VALID_ARG || (options->pathToDeltas != NULL &&
+	                                options->memoryBudget != NO_MEMORY_BUDGET) || // no graph to keep
+		(options->snapshotPrefix != NULL && (options->pathToDeltas != NULL ||
+		                                     options->memoryBudget != NO_MEMORY_BUDGET)) ||
+		(options->numOfParsers != NO_PIPELINE && (options->snapshotPrefix != NULL ||
+		                                          options->memoryBudget != NO_MEMORY_BUDGET)) ||
+		(isSelectingPeople(options) && // no table to select from
+		 (options->snapshotPrefix != NULL || options->memoryBudget != NO_MEMORY_BUDGET)) ||
+		(options->numOfShards != NO_SHARDS && // the shards have their own loaders and output
+		 (options->snapshotPrefix != NULL || options->memoryBudget != NO_MEMORY_BUDGET ||
+		  options->pathToDeltas != NULL || options->numOfParsers != NO_PIPELINE ||
+		  isSelectingPeople(options))) ||
+		(options->socketPath != NULL && // the engine has its own loaders and no output file
+		 (options->snapshotPrefix != NULL || options->memoryBudget != NO_MEMORY_BUDGET ||
+		  options->pathToDeltas != NULL || options->numOfParsers != NO_PIPELINE ||
+		  isSelectingPeople(options) ||
+		  options->numOfShards != NO_SHARDS)) ||
+		(options->isValidation && // nothing is computed and no file is written
+		 (options->snapshotPrefix != NULL || options->memoryBudget != NO_MEMORY_BUDGET ||
+		  options->pathToDeltas != NULL || options->numOfParsers != NO_PIPELINE ||
+		  isSelectingPeople(options) ||
+		  options->numOfShards != NO_SHARDS || options->socketPath != NULL)))
 	{
-		errorCase(TYPE_LIBRARY_ERROR, arrayPeople, lenOfArray);
+		errorCase(TYPE_ARG_ERROR);
 	}
-	size_t id;
-	float age;
-	char name[MAX_LINE_SIZE];
-	if (sscanf(line, FORMAT_LINE_IN_PEOPLES_FILE, name, &id, &age) != NUM_OF_FILDS_PEOPLE_FILE)
+	options->pathToPeopleFile = paths[PLACE_OF_PEOPLS_FILE];
+	options->pathToMeetings = paths[PLACE_OF_MEETINGS_FILE];
+	int policyStatus = pathToPolicy == NULL ? POLICY_SUCCESS :
+	                   loadRiskPolicy(pathToPolicy, &options->policy);
+	if (policyStatus != POLICY_SUCCESS)
 	{
-		errorCase(TYPE_LIBRARY_ERROR, arrayPeople, lenOfArray);
+		errorCase(policyStatus == POLICY_OPEN_FAILED ? TYPE_OPEN_INFILE_ERROR : TYPE_LIBRARY_ERROR);
 	}
-	strcpy(curPerson->name, name); // we need chack?? (ERROR LIBRARY..)
-	curPerson->id = id;
-	curPerson->age = age;
-	curPerson->probInfected = INIT_PROB; // We initialize the probability to 0
-	// ("The person is innocent until proven otherwise")
-	return curPerson;
 }
 
-void readMeetingsFile(const char *path, PersonDetailsNode ***arrayPeople, size_t lenOfArray)
+void parseMinProb(const char *value, DetectorOptions *options)
 {
-	FILE *inputFile = fopen(path, READING_MODE);
-	if (inputFile == NULL)
+	// A name is a class of the policy (which may be loaded only by a later option), so the
+	// people are selected by their classes and not by one threshold. The last value counts
+	options->minProb = NO_MIN_PROB;
+	options->maxClass = NO_MAX_CLASS;
+	if (strcmp(value, MIN_PROB_QUARANTINE_NAME) == 0)
 	{
-		errorCase(TYPE_OPEN_INFILE_ERROR, arrayPeople, lenOfArray);
-	}
-	else if (lenOfArray == NO_PEOPLE_IN_FIRST_FILE) // The first file may be empty
-	{
-		fclose(inputFile);
+		options->maxClass = QUARANTINE_CLASS;
 		return;
 	}
-	char currentRow[MAX_LINE_SIZE];
-	//first line. get the id of the first infector. (The first line is different from the rest!)
-	size_t idOfFirstInfector;
-	if (fgets(currentRow, sizeof(currentRow), inputFile) == NULL)
+	if (strcmp(value, MIN_PROB_HOSPITALIZATION_NAME) == 0)
 	{
-		fclose(inputFile);
+		options->maxClass = HOSPITALIZATION_CLASS;
 		return;
 	}
-	if (sscanf(currentRow, FORMAT_FIRST_LINE_IN_MEETINGS_FILE, &idOfFirstInfector) !=
-		NUM_OF_FILDS_FIRST_LINE_MEETING_FILE)
+	char *numberEnd;
+	float minProb = strtof(value, &numberEnd);
+	if (numberEnd == value || *numberEnd != '\0' || isnan(minProb))
 	{
-		errorCase(TYPE_LIBRARY_ERROR, arrayPeople, lenOfArray);
+		errorCase(TYPE_ARG_ERROR);
 	}
-	size_t idxOfFirstInfectorInArray = standardBinarySearch(*arrayPeople, 0, lenOfArray - 1,
-															idOfFirstInfector);
-	PersonDetailsNode *firstInfector = (*arrayPeople)[idxOfFirstInfectorInArray];
-	firstInfector->probInfected = PROBABILITY_IS_ONE; //he sick for sure!!
-
-	// we get the rest of lines. Each line represents a meeting We will look for the people in the
-	// array (O(logn)!!) and update the probability of the infected according to the probability
-	// of the infector and the function "crna"
-	while (fgets(currentRow, sizeof(currentRow), inputFile))
-	{
-		MeetingInfo curMeeting = createMeetingInfoFromLine(currentRow, arrayPeople, lenOfArray);
-		size_t idxInfectorInArray = standardBinarySearch(*arrayPeople, 0, lenOfArray - 1,
-														 curMeeting.infectorId);
-		size_t idxInfectedInArray = standardBinarySearch(*arrayPeople, 0, lenOfArray - 1,
-														 curMeeting.infectedId);
-		updateProbAccordingCrnaAndProbOfInfector(curMeeting.distance, curMeeting.time,
-												 (*arrayPeople)[idxInfectorInArray],
-												 (*arrayPeople)[idxInfectedInArray]);
-	}
-	fclose(inputFile);
+	options->minProb = minProb;
 }
 
-MeetingInfo
-createMeetingInfoFromLine(const char *line, PersonDetailsNode ***arrayPeople, size_t lenOfArray)
+int isSelectingPeople(const DetectorOptions *options)
 {
-	size_t firstId, secondId;
-	float distance, time;
-	if (sscanf(line, FORMAT_LINE_IN_MEETINGS_FILE, &firstId, &secondId, &distance, &time) !=
-		NUM_OF_FILDS_MEETING_FILE)
-	{
-		errorCase(TYPE_LIBRARY_ERROR, arrayPeople, lenOfArray);
-
-	}
-	MeetingInfo curMeeting;
-	curMeeting.infectorId = firstId;
-	curMeeting.infectedId = secondId;
-	curMeeting.distance = distance;
-	curMeeting.time = time;
-	return curMeeting;
+	return options->top != NO_TOP || options->minProb != NO_MIN_PROB ||
+	       options->maxClass != NO_MAX_CLASS;
 }
 
-size_t standardBinarySearch(PersonDetailsNode **arr, size_t l, size_t r, size_t id)
+size_t parseMemoryBudget(const char *value)
 {
-	if (r >= l)
+	char *numberEnd;
+	long long budget = strtoll(value, &numberEnd, DECIMAL_BASE);
+	unsigned int shift = 0;
+	if (*numberEnd == 'K' || *numberEnd == 'k')
 	{
-		size_t mid = l + (r - l) / 2;
-		if (arr[mid]->id == id)
-		{
-			return mid;
-		}
-		else if (arr[mid]->id > id)
-		{
-			return standardBinarySearch(arr, l, mid - 1, id);
-		}
-		// else: arr[mid]->id < id
-		return standardBinarySearch(arr, mid + 1, r, id);
+		shift = KILO_SHIFT;
 	}
-	return ELEMENT_NOT_FOUND;
-}
-
-void updateProbAccordingCrnaAndProbOfInfector(float distance, float time, const PersonDetailsNode
-                                              *first, PersonDetailsNode *sec) // need to be void!!
-{
-	float calCrna = (time * MIN_DISTANCE) / (distance * MAX_TIME);
-	sec->probInfected = first->probInfected * calCrna;
-}
-
-void printToOutputFile(PersonDetailsNode ***peopleArray, size_t lenOfArray) // need to be void!!!
-{
-	FILE *outputFile = fopen(OUTPUT_FILE, WRITING_MODE);
-	if (outputFile == NULL)
+	else if (*numberEnd == 'M' || *numberEnd == 'm')
 	{
-		errorCase(TYPE_OPEN_OUTFILE_ERROR, peopleArray, lenOfArray);
+		shift = 2 * KILO_SHIFT;
 	}
-
-	for (size_t i = 0; i < lenOfArray; ++i)
+	else if (*numberEnd == 'G' || *numberEnd == 'g')
 	{
-		manageToOutputFile(outputFile, (*peopleArray)[i]);
+		shift = 3 * KILO_SHIFT;
 	}
-	fclose(outputFile);
+	if (shift != 0)
+	{
+		numberEnd++;
+	}
+	if (numberEnd == value || *numberEnd != '\0' || budget < 1 ||
+		(unsigned long long) budget > (SIZE_MAX >> shift) ||
+		(size_t) budget << shift < MIN_MEMORY_BUDGET)
+	{
+		errorCase(TYPE_ARG_ERROR);
+	}
+	return (size_t) budget << shift;
 }
 
-void manageToOutputFile(FILE *fdOutputFile, const PersonDetailsNode *spreader)
+int typeOfModeError(int status)
 {
-	if (spreader->probInfected >= MEDICAL_SUPERVISION_THRESHOLD)
+	if (status == MODE_INPUT_FAILED)
 	{
-		fprintf(fdOutputFile, MEDICAL_SUPERVISION_THRESHOLD_MSG, spreader->name, spreader->id);
+		return TYPE_OPEN_INFILE_ERROR;
 	}
-	else if (spreader->probInfected >= REGULAR_QUARANTINE_THRESHOLD)
+	if (status == MODE_OUTPUT_FAILED)
 	{
-		fprintf(fdOutputFile, REGULAR_QUARANTINE_MSG, spreader->name, spreader->id);
+		return TYPE_OPEN_OUTFILE_ERROR;
 	}
-	else // if (spreader->probInfected < REGULAR_QUARANTINE_THRESHOLD)
+	if (status == MODE_OVER_BUDGET)
 	{
-		fprintf(fdOutputFile, CLEAN_MSG, spreader->name,
-				spreader->id);
+		return TYPE_MEMORY_BUDGET_ERROR;
 	}
+	// A mode that reads only text files got a snapshot (or a pipe): the arguments are invalid
+	return status == MODE_NOT_TEXT ? TYPE_ARG_ERROR : TYPE_LIBRARY_ERROR;
 }
 
-void errorCase(int typeError, PersonDetailsNode ***arrayPeople, size_t lenOfArray)
+void errorCase(int typeError)
 {
 	if (typeError == TYPE_ARG_ERROR)
 	{
@@ -584,43 +633,22 @@ void errorCase(int typeError, PersonDetailsNode ***arrayPeople, size_t lenOfArra
 	{
 		fprintf(stderr, OPEN_OUT_FILE_ERR_MSG);
 	}
-	freeResources(arrayPeople, lenOfArray);
-	exit(EXIT_FAILURE);
-}
-
-void freeResources(PersonDetailsNode ***arrayPeople, size_t lenOfArray)
-{
-	for (size_t i = 0; i < lenOfArray; i++)
+	else if (typeError == TYPE_MEMORY_BUDGET_ERROR)
 	{
-		free((*arrayPeople)[i]);
-		(*arrayPeople)[i] = NULL;
-	}
-	if (arrayPeople)
-	{
-		free(*arrayPeople);
-		*arrayPeople = NULL;
+		fprintf(stderr, MEMORY_BUDGET_ERR_MSG);
 	}
+	exit(EXIT_FAILURE);
 }
 
-int cmpFuncId(const void *first, const void *sec)
+void printMemoryStats(void)
 {
-	size_t left = (*((PersonDetailsNode **) first))->id;
-	size_t right = (*((PersonDetailsNode **) sec))->id;
-	if (left < right)
-	{
-		return LEFT_BEFOR_RIGHT;
-	}
-	return left > right;
+	AllocationStats stats;
+	getAllocationStats(&stats);
+	struct rusage usage;
+	long peakRssKb = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+	fprintf(stderr, "allocations: %zu\n", stats.numOfAllocations);
+	fprintf(stderr, "frees: %zu\n", stats.numOfFrees);
+	fprintf(stderr, "arena slabs: %zu\n", stats.numOfSlabs);
+	fprintf(stderr, "peak heap bytes: %zu\n", stats.peakBytesInUse);
+	fprintf(stderr, "peak rss kb: %ld\n", peakRssKb);
 }
-
-int cmpFuncProb(const void *first, const void *sec)
-{
-	float left = (*((PersonDetailsNode **) first))->probInfected;
-	float right = (*((PersonDetailsNode **) sec))->probInfected;
-	if (left > right) // We want to sort from big to small because the first on the list will have
-		// the highest chance and so the order goes down to the end!
-	{
-		return LEFT_BEFOR_RIGHT;
-	}
-	return left < right;
-}
\ No newline at end of file
@@ -0,0 +1,672 @@
+#!/usr/bin/env python3
+"""
+@file SpreaderDetectorBench.py
+@author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+@brief Runs the detector over a grid of generated workloads, checks its output and compares the
+times to a stored baseline
+@section DESCRIPTION
+Usage: SpreaderDetectorBench.py --exam PATH --gen PATH [--examples DIR] [--baseline PATH]
+       [--update-baseline] [--scales 1000,10000,100000] [--work-dir DIR] [--tolerance 1.25]
+       [--reference-limit 100000] [--fail-on-regression]
+Every case of the grid (topology, kind of IDs and length of names, at every scale) is generated by
+workload_gen and run with "--stats". For every case we record the seconds, the people per second,
+the peak RSS of the process and the seconds and the peak RSS of every phase.
+The output is checked in three ways:
+- the examples (in-out-example/*) must give exactly their *_sol.out;
+- a case of at most --reference-limit people must give exactly the output of a reference written
+  here (the same float arithmetic, the same order and the same messages);
+- every case must give the same output with "--pipeline=2";
+- every case must give the same output with a budget of memory_budget(people) (alone and with
+  "--threads=4"), and the peak of its heap must be under the budget, and with a budget of
+  too_small_budget(people) (less than its meetings need) it must fail with BUDGET_ERROR;
+- the cyclic case (its meetings have cycles, which the detector breaks at the smallest IDs that
+  are left) must give the same output with "--threads=4", "--shards=2" and "--pipeline=2", and
+  when its last meetings come as batches of "--deltas" the changes of the classes must be exactly
+  the ones of the reference;
+- the meetings of NOISY_OR_MEETINGS, whose crnas are above 1, must give exactly the output of the
+  reference with "--combine=noisy-or", in every mode of NOISY_OR_MODES (with the smallest budget
+  MIN_MEMORY_BUDGET too);
+- "--shards=2" must fail with ARGS_ERROR when the people file is a pipe or the meetings file is a
+  named pipe (every worker would read the pipe from its start);
+- the examples with the age bands of POLICY_BANDS ("--policy"), alone and with "--min-prob" and
+  "--top", must give exactly the output of the reference with the same bands and selection;
+- the people of POLICY_MIN_PROB_PEOPLE with POLICY_BANDS and "--min-prob=" POLICY_MIN_PROB (a
+  number) must give the lines of the full output of the people at least POLICY_MIN_PROB, which are
+  not its first lines.
+The seconds of every case are compared to the baseline, and a case that is more than --tolerance
+times slower (and slower than NOISE_SECONDS) is reported as a regression. A case that is not in
+the baseline is a failure: the baseline is recorded again (--update-baseline) whenever GRID is
+changed.
+The reference runs in a process of its own ("--reference PEOPLE MEETINGS" prints the digest of its
+output, "--reference-option=OPTION" gives it an option of the detector) and the outputs are
+compared by their digests, so this process stays small: on Linux a
+child starts with the peak RSS of the process that forked it.
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import struct
+import subprocess
+import sys
+import time
+from collections import deque
+
+OUTPUT_FILE = "SpreaderDetectorAnalysis.out"
+DEFAULT_SCALES = "1000,10000,100000"
+DEFAULT_TOLERANCE = 1.25
+DEFAULT_REFERENCE_LIMIT = 100000
+DIGEST_CHUNK_SIZE = 1 << 20
+NOISE_SECONDS = 0.05
+OTHER_MODES = [["--pipeline=2"]]
+CYCLIC_MODES = [["--threads=4"], ["--shards=2"], ["--pipeline=2"]]
+# the budget of the streaming mode: the buffer of the output file and some more, and the meetings
+# with the people who appear in them (about 130 bytes a person in the generated workloads)
+BUDGET_BASE_BYTES = 2 << 20
+BUDGET_BYTES_PER_PERSON = 256
+BUDGET_MODES = [[], ["--threads=4"]]
+# the map of the people who appear in the meetings alone takes more than this (see
+# SpreaderDetectorStreaming.h)
+TOO_SMALL_BYTES_PER_PERSON = 48
+MIN_MEMORY_BUDGET = 64 << 10
+BUDGET_ERROR = "Error in memory budget.\n"
+PEAK_HEAP_PREFIX = "peak heap bytes: "
+DELTA_OUTPUT_FILE = "SpreaderDetectorAnalysis.delta.out"
+# the cyclic case starts from half of its meetings, and the rest come in this number of batches
+NUM_OF_DELTA_BATCHES = 4
+POLICY_FILE = "SpreaderDetectorBench.policy"
+# lower thresholds from RISK_AGE: an old person can be in a class of a younger one with a larger
+# probability, so the classes are not in the order of the probabilities
+POLICY_BANDS = "0 0.1 0.3\n65 0.05 0.1\n"
+POLICY_CASES = [[], ["--min-prob=hospitalization"], ["--min-prob=quarantine"],
+                ["--min-prob=0.2"], ["--min-prob=quarantine", "--top=3"],
+                ["--min-prob=0.2", "--min-prob=hospitalization"], ["--memory-budget=64K"],
+                ["--shards=2"]]
+# Bob (70) is in the class of hospitalization with 0.15 and Carl (30) in the class of quarantine
+# with 0.25, so "--min-prob=0.2" keeps Alice and Carl, and not Bob who is between them
+POLICY_MIN_PROB_PEOPLE = "Alice 1 30\nBob 2 70\nCarl 3 30\nDana 4 30\n"
+POLICY_MIN_PROB_MEETINGS = "1\n1 2 2 9\n1 3 1 7.5\n"
+POLICY_MIN_PROB_LINES = [0, 2]
+POLICY_MIN_PROB = "0.2"
+POLICY_MIN_PROB_PEOPLE_FILE = "SpreaderDetectorBench.min-prob.people.in"
+POLICY_MIN_PROB_MEETINGS_FILE = "SpreaderDetectorBench.min-prob.meetings.in"
+NOISY_OR_PEOPLE_FILE = "SpreaderDetectorBench.noisy-or.people.in"
+NOISY_OR_MEETINGS_FILE = "SpreaderDetectorBench.noisy-or.meetings.in"
+# crnas above 1 (a distance below MIN_DISTANCE): Carl's exposures are 4 and 2, Dana's are 0.01, 4
+# and 0.1, and Eve's are 2 and 2
+NOISY_OR_PEOPLE = "Alice 1 30\nBob 2 40\nCarl 3 50\nDana 4 70\nEve 5 20\nFrank 6 60\n"
+NOISY_OR_MEETINGS = ("1\n1 2 0.5 30\n2 3 0.5 30\n1 3 0.5 30\n1 4 10 3\n2 4 0.5 30\n3 4 5 15\n"
+                     "1 5 0.5 30\n1 5 0.5 30\n5 6 2 6\n")
+NOISY_OR_MODES = [["--threads=4"], ["--shards=2"], ["--pipeline=2"],
+                  ["--memory-budget=%d" % MIN_MEMORY_BUDGET]]
+SHARDS_FIFO_FILE = "SpreaderDetectorBench.meetings.fifo"
+ARGS_ERROR = "Usage: ./SpreaderDetectorBackend <Path to People.in> <Path to Meetings.in>\n"
+# a detector that opens the named pipe waits for a writer that never comes
+PIPE_TIMEOUT_SECONDS = 10
+
+# (topology, ids, length of names)
+GRID = [("chain", "sequential", 8),
+        ("star", "sequential", 8),
+        ("tree", "sequential", 8),
+        ("multi-seed", "sequential", 8),
+        ("tree", "random", 8),
+        ("tree", "strided", 8),
+        ("tree", "clustered", 8),
+        ("tree", "random", 200),
+        ("cyclic", "random", 8)]
+
+# SpreaderDetectorParams.h
+RISK_AGE = 65.0
+MIN_DISTANCE = 1.0
+MAX_TIME = 30.0
+MEDICAL_SUPERVISION_THRESHOLD = 0.3
+REGULAR_QUARANTINE_THRESHOLD = 0.1
+MEDICAL_SUPERVISION_THRESHOLD_MSG = "Hospitalization Required: %s %d.\n"
+REGULAR_QUARANTINE_MSG = "14-days-Quarantine Required: %s %d.\n"
+CLEAN_MSG = "No serious chance for infection: %s %d.\n"
+
+
+def f32(value):
+    """Rounds a number to the nearest float (every float operation of the detector is rounded)"""
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+
+def reference_policy(options):
+    """The age bands of "--policy=" in the options (minimal age and two thresholds each)"""
+    bands = [(0.0, f32(REGULAR_QUARANTINE_THRESHOLD), f32(MEDICAL_SUPERVISION_THRESHOLD)),
+             (f32(RISK_AGE), f32(REGULAR_QUARANTINE_THRESHOLD), f32(MEDICAL_SUPERVISION_THRESHOLD))]
+    for option in options:
+        if option.startswith("--policy="):
+            bands = []
+            with open(option[len("--policy="):]) as policy_file:
+                for line in policy_file:
+                    if line.strip() and not line.startswith("#"):
+                        bands.append(tuple(f32(float(field)) for field in line.split()))
+    return bands
+
+
+def reference_class(bands, age, prob):
+    """The class of a person (0 hospitalization, 1 quarantine, 2 clean) by the band of his age"""
+    _, quarantine, hospitalization = bands[0]
+    for min_age, band_quarantine, band_hospitalization in bands[1:]:
+        if age >= min_age:
+            quarantine, hospitalization = band_quarantine, band_hospitalization
+    return 2 - (prob >= quarantine) - (prob >= hospitalization)
+
+
+def reference_meetings(lines):
+    """The meetings of lines of a meeting file: (infector, infected, the crna in float)"""
+    meetings = []
+    for line in lines:
+        fields = line.split()
+        if fields:
+            crna = f32(f32(f32(float(fields[3])) * f32(MIN_DISTANCE)) /
+                       f32(f32(float(fields[2])) * f32(MAX_TIME)))
+            meetings.append((int(fields[0]), int(fields[1]), crna))
+    return meetings
+
+
+def reference_clamp(exposure):
+    """An exposure clamped to [0, 1] (a crna can be above 1)"""
+    return min(max(exposure, 0.0), 1.0)
+
+
+def reference_combine(combine, prob_so_far, exposure):
+    """
+    Combines a new exposure of a person with what he had so far, like the rules of
+    SpreaderDetectorGraph.h: the first exposure is taken as is, and then the largest of them
+    ("max") or 1 - (1 - p1) * .. * (1 - pk) of the clamped exposures ("noisy-or")
+    """
+    if prob_so_far == 0.0:
+        return exposure
+    if combine == "max":
+        return max(prob_so_far, exposure)
+    return f32(1.0 - f32(f32(1.0 - reference_clamp(prob_so_far)) *
+                         f32(1.0 - reference_clamp(exposure))))
+
+
+def reference_probs(person_ids, seeds, meetings, combine="max"):
+    """
+    The probability of every person: Kahn's order, so the probability of an infector is final
+    before his meetings are used, and his exposures are combined in the order of the meetings.
+    When only cycles are left, the person with the smallest ID that is left is made final with the
+    meetings of his infectors that are already final
+    """
+    infectors = {}
+    infecteds = {}
+    for infector, infected, crna in meetings:
+        infectors.setdefault(infected, []).append((infector, crna))
+        infecteds.setdefault(infector, []).append(infected)
+    waiting = {person_id: len(infectors.get(person_id, [])) for person_id in person_ids}
+    probs = {person_id: 0.0 for person_id in person_ids}
+    final = set()
+    ready = deque(person_id for person_id in person_ids if waiting[person_id] == 0)
+    by_id = sorted(person_ids)
+    next_by_id = 0
+    while len(final) < len(person_ids):
+        if not ready:  # only cycles are left
+            while by_id[next_by_id] in final:
+                next_by_id += 1
+            ready.append(by_id[next_by_id])
+        person_id = ready.popleft()
+        prob = 1.0 if person_id in seeds else 0.0
+        for infector, crna in infectors.get(person_id, []):
+            if infector in final:
+                prob = reference_combine(combine, prob, f32(probs[infector] * crna))
+        probs[person_id] = prob
+        final.add(person_id)
+        for infected in infecteds.get(person_id, []):
+            waiting[infected] -= 1
+            if waiting[infected] == 0 and infected not in final:
+                ready.append(infected)
+    return probs
+
+
+def reference_messages(people, probs, classes, selected_ids):
+    """The lines of the output of the selected people: sorted by class, then by probability (from
+    big to small) and then by ID"""
+    selected = sorted((person for person in people if person[1] in selected_ids),
+                      key=lambda person: (classes[person[1]], -probs[person[1]], person[1]))
+    messages = [MEDICAL_SUPERVISION_THRESHOLD_MSG, REGULAR_QUARANTINE_MSG, CLEAN_MSG]
+    return "".join(messages[classes[person_id]] % (name, person_id)
+                   for name, person_id, _ in selected)
+
+
+def reference_deltas(people, bands, seeds, meetings, deltas_path, combine):
+    """The output of "--deltas": after every batch, the people whose class was changed and an
+    empty line"""
+    person_ids = [person_id for _, person_id, _ in people]
+    ages = {person_id: age for _, person_id, age in people}
+    probs = reference_probs(person_ids, seeds, meetings, combine)
+    classes = {person_id: reference_class(bands, ages[person_id], probs[person_id])
+               for person_id in person_ids}
+    output = []
+    with open(deltas_path) as deltas_file:
+        batches = deltas_file.read().split("\n\n")
+    for batch in batches:
+        batch_meetings = reference_meetings(batch.splitlines())
+        if not batch_meetings:
+            continue
+        meetings = meetings + batch_meetings
+        probs = reference_probs(person_ids, seeds, meetings, combine)
+        new_classes = {person_id: reference_class(bands, ages[person_id], probs[person_id])
+                       for person_id in person_ids}
+        changed = {person_id for person_id in person_ids
+                   if new_classes[person_id] != classes[person_id]}
+        output.append(reference_messages(people, probs, new_classes, changed) + "\n")
+        classes = new_classes
+    return "".join(output)
+
+
+def reference_output(people_path, meetings_path, options=()):
+    """
+    The output the detector must give: the crna of every meeting and the exposures in float, the
+    exposures of every person combined by "--combine=" (the largest of them by default), and the
+    people sorted by class, then by probability (from big to small) and then by ID. The options
+    "--policy=", "--min-prob=" and "--top=" are applied like in the detector (the others do not
+    change the output). With "--deltas=" it is the output of the batches instead
+    """
+    people = []
+    with open(people_path) as people_file:
+        for line in people_file:
+            fields = line.split()
+            if fields:
+                people.append((fields[0], int(fields[1]), f32(float(fields[2]))))
+    with open(meetings_path) as meetings_file:
+        seeds = {int(field) for field in meetings_file.readline().split()}
+        meetings = reference_meetings(meetings_file)
+    bands = reference_policy(options)
+    combine = "max"
+    for option in options:
+        if option.startswith("--combine="):
+            combine = option[len("--combine="):]
+    for option in options:
+        if option.startswith("--deltas="):
+            return reference_deltas(people, bands, seeds, meetings, option[len("--deltas="):],
+                                    combine)
+    probs = reference_probs([person_id for _, person_id, _ in people], seeds, meetings, combine)
+    classes = {person_id: reference_class(bands, age, probs[person_id])
+               for _, person_id, age in people}
+    min_prob, max_class, top = None, 2, None
+    for option in options:
+        if option.startswith("--min-prob="):
+            value = option[len("--min-prob="):]
+            min_prob, max_class = None, 2  # the last one counts
+            if value in ("hospitalization", "quarantine"):
+                max_class = 0 if value == "hospitalization" else 1
+            else:
+                min_prob = f32(float(value))
+        elif option.startswith("--top="):
+            top = int(option[len("--top="):])
+    selected = [person for person in people if classes[person[1]] <= max_class and
+                (min_prob is None or probs[person[1]] >= min_prob)]
+    selected.sort(key=lambda person: (classes[person[1]], -probs[person[1]], person[1]))
+    return reference_messages(people, probs, classes,
+                              {person_id for _, person_id, _ in selected[:top]})
+
+
+def file_digest(path):
+    """The SHA-256 of a file, read in chunks"""
+    digest = hashlib.sha256()
+    with open(path, "rb") as digested_file:
+        for chunk in iter(lambda: digested_file.read(DIGEST_CHUNK_SIZE), b""):
+            digest.update(chunk)
+    return digest.hexdigest()
+
+
+def reference_digest(people_path, meetings_path, options=()):
+    """The SHA-256 of the reference output (with the options of the detector), computed by another
+    process"""
+    completed = subprocess.run([sys.executable, os.path.abspath(__file__), "--reference",
+                                people_path, meetings_path] +
+                               ["--reference-option=" + option for option in options],
+                               stdout=subprocess.PIPE, check=True)
+    return completed.stdout.decode().strip()
+
+
+def run_detector(exam, people_path, meetings_path, options, work_dir, output_file=OUTPUT_FILE):
+    """
+    Runs the detector in work_dir
+    @return (exit code, the SHA-256 of the output (output_file), wall seconds, peak RSS in KB, the
+    JSON report of --stats or None)
+    """
+    begin = time.monotonic()
+    process = subprocess.Popen([exam, people_path, meetings_path] + options, cwd=work_dir,
+                               stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    stderr = process.stderr.read()
+    _, status, usage = os.wait4(process.pid, 0)
+    process.returncode = os.waitstatus_to_exitcode(status)
+    seconds = time.monotonic() - begin
+    report = None
+    for line in stderr.decode(errors="replace").splitlines():
+        if line.startswith("{"):
+            report = json.loads(line)
+    output_path = os.path.join(work_dir, output_file)
+    output = None
+    if process.returncode == 0 and os.path.exists(output_path):
+        output = file_digest(output_path)
+    return process.returncode, output, seconds, usage.ru_maxrss, report
+
+
+def check_examples(exam, examples_dir, work_dir):
+    """Runs the examples and compares them to their *_sol.out (and to the reference)"""
+    failures = []
+    names = sorted(name[:-len("_sol.out")] for name in os.listdir(examples_dir)
+                   if name.endswith("_sol.out"))
+    for name in names:
+        people_path = os.path.join(examples_dir, name + "_people.in")
+        meetings_path = os.path.join(examples_dir, name + "_meeting.in")
+        solution = file_digest(os.path.join(examples_dir, name + "_sol.out"))
+        code, output, _, _, _ = run_detector(exam, people_path, meetings_path, [], work_dir)
+        if code != 0 or output != solution:
+            failures.append("example %s: the output is not %s_sol.out" % (name, name))
+        if reference_digest(people_path, meetings_path) != solution:
+            failures.append("example %s: the reference is not %s_sol.out" % (name, name))
+    print("examples: %d checked" % len(names))
+    return failures
+
+
+def check_policy_examples(exam, examples_dir, work_dir):
+    """Runs the examples with the bands of POLICY_BANDS and every case of POLICY_CASES, and compares
+    them to the reference with the same options"""
+    failures = []
+    policy_path = os.path.abspath(os.path.join(work_dir, POLICY_FILE))
+    with open(policy_path, "w") as policy_file:
+        policy_file.write(POLICY_BANDS)
+    names = sorted(name[:-len("_sol.out")] for name in os.listdir(examples_dir)
+                   if name.endswith("_sol.out"))
+    for name in names:
+        people_path = os.path.join(examples_dir, name + "_people.in")
+        meetings_path = os.path.join(examples_dir, name + "_meeting.in")
+        for case in POLICY_CASES:
+            options = ["--policy=" + policy_path] + case
+            code, output, _, _, _ = run_detector(exam, people_path, meetings_path, options,
+                                                 work_dir)
+            if code != 0 or output != reference_digest(people_path, meetings_path, options):
+                failures.append("example %s: %s is not the reference output" %
+                                (name, " ".join(["--policy"] + case)))
+    os.remove(policy_path)
+    print("examples with a policy: %d checked" % (len(names) * len(POLICY_CASES)))
+    return failures
+
+
+def check_policy_min_prob(exam, work_dir):
+    """Runs the people of POLICY_MIN_PROB_PEOPLE with POLICY_BANDS, alone and with "--min-prob="
+    POLICY_MIN_PROB, and checks that the selection is the lines POLICY_MIN_PROB_LINES of the full
+    output (and the reference output)"""
+    people_path = os.path.abspath(os.path.join(work_dir, POLICY_MIN_PROB_PEOPLE_FILE))
+    meetings_path = os.path.abspath(os.path.join(work_dir, POLICY_MIN_PROB_MEETINGS_FILE))
+    policy_path = os.path.abspath(os.path.join(work_dir, POLICY_FILE))
+    for path, text in ((people_path, POLICY_MIN_PROB_PEOPLE),
+                       (meetings_path, POLICY_MIN_PROB_MEETINGS), (policy_path, POLICY_BANDS)):
+        with open(path, "w") as written_file:
+            written_file.write(text)
+    output_path = os.path.join(work_dir, OUTPUT_FILE)
+    options = ["--policy=" + policy_path]
+    failures = []
+    code, _, _, _, _ = run_detector(exam, people_path, meetings_path, options, work_dir)
+    with open(output_path) as output_file:
+        full = output_file.readlines()
+    options.append("--min-prob=" + POLICY_MIN_PROB)
+    code_selected, output, _, _, _ = run_detector(exam, people_path, meetings_path, options,
+                                                  work_dir)
+    with open(output_path) as output_file:
+        selected = output_file.readlines()
+    if code != 0 or code_selected != 0 or \
+            selected != [full[line] for line in POLICY_MIN_PROB_LINES] or \
+            output != reference_digest(people_path, meetings_path, options):
+        failures.append("--policy with --min-prob=%s: not the lines %s of the full output" %
+                        (POLICY_MIN_PROB, POLICY_MIN_PROB_LINES))
+    os.remove(people_path)
+    os.remove(meetings_path)
+    os.remove(policy_path)
+    print("--policy with a numeric --min-prob: 1 checked")
+    return failures
+
+
+def check_noisy_or(exam, work_dir):
+    """Runs the meetings of NOISY_OR_MEETINGS (whose crnas are above 1) with "--combine=noisy-or",
+    alone and with every mode of NOISY_OR_MODES, and compares them to the reference"""
+    people_path = os.path.abspath(os.path.join(work_dir, NOISY_OR_PEOPLE_FILE))
+    meetings_path = os.path.abspath(os.path.join(work_dir, NOISY_OR_MEETINGS_FILE))
+    with open(people_path, "w") as people_file:
+        people_file.write(NOISY_OR_PEOPLE)
+    with open(meetings_path, "w") as meetings_file:
+        meetings_file.write(NOISY_OR_MEETINGS)
+    options = ["--combine=noisy-or"]
+    reference = reference_digest(people_path, meetings_path, options)
+    failures = []
+    for mode in [[]] + NOISY_OR_MODES:
+        code, output, _, _, _ = run_detector(exam, people_path, meetings_path, options + mode,
+                                             work_dir)
+        if code != 0 or output != reference:
+            failures.append("noisy-or: %s is not the reference output" %
+                            " ".join(options + mode))
+    os.remove(people_path)
+    os.remove(meetings_path)
+    print("noisy-or with crnas above 1: %d checked" % (1 + len(NOISY_OR_MODES)))
+    return failures
+
+
+def check_shards_pipes(exam, work_dir):
+    """Runs "--shards=2" with an anonymous pipe as the people file and with a named pipe as the
+    meetings file, and checks that both fail with ARGS_ERROR"""
+    people_path = os.path.abspath(os.path.join(work_dir, NOISY_OR_PEOPLE_FILE))
+    meetings_path = os.path.abspath(os.path.join(work_dir, NOISY_OR_MEETINGS_FILE))
+    fifo_path = os.path.abspath(os.path.join(work_dir, SHARDS_FIFO_FILE))
+    with open(people_path, "w") as people_file:
+        people_file.write(NOISY_OR_PEOPLE)
+    with open(meetings_path, "w") as meetings_file:
+        meetings_file.write(NOISY_OR_MEETINGS)
+    os.mkfifo(fifo_path)
+    read_fd, write_fd = os.pipe()
+    os.write(write_fd, NOISY_OR_PEOPLE.encode())
+    os.close(write_fd)
+    failures = []
+    for name, paths in (("a pipe of people", ["/dev/fd/%d" % read_fd, meetings_path]),
+                        ("a named pipe of meetings", [people_path, fifo_path])):
+        try:
+            completed = subprocess.run([exam] + paths + ["--shards=2"], cwd=work_dir,
+                                       stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+                                       pass_fds=(read_fd,), timeout=PIPE_TIMEOUT_SECONDS)
+        except subprocess.TimeoutExpired:
+            failures.append("--shards=2 with %s does not exit" % name)
+            continue
+        if completed.returncode == 0 or completed.stderr.decode(errors="replace") != ARGS_ERROR:
+            failures.append("--shards=2 with %s does not fail with %r" % (name, ARGS_ERROR))
+    os.close(read_fd)
+    os.remove(people_path)
+    os.remove(meetings_path)
+    os.remove(fifo_path)
+    print("--shards with pipes: 2 checked")
+    return failures
+
+
+def check_cyclic_deltas(args, case, people_path, meetings_path):
+    """Runs the first half of the meetings of a case, and the rest of them as batches of
+    "--deltas", and compares the changes of the classes to the reference"""
+    first_path = os.path.join(args.work_dir, case + ".first.in")
+    deltas_path = os.path.join(args.work_dir, case + ".deltas.in")
+    with open(meetings_path) as meetings_file:
+        seeds_line = meetings_file.readline()
+        lines = meetings_file.readlines()
+    half = len(lines) // 2
+    with open(first_path, "w") as first_file:
+        first_file.write(seeds_line)
+        first_file.writelines(lines[:half])
+    with open(deltas_path, "w") as deltas_file:
+        batch_len = -(-(len(lines) - half) // NUM_OF_DELTA_BATCHES)
+        for begin in range(half, len(lines), batch_len):
+            deltas_file.writelines(lines[begin:begin + batch_len])
+            deltas_file.write("\n")
+    options = ["--deltas=" + os.path.abspath(deltas_path)]
+    code, output, _, _, _ = run_detector(args.exam, people_path, first_path, options,
+                                         args.work_dir, DELTA_OUTPUT_FILE)
+    failures = []
+    if code != 0 or output != reference_digest(people_path, first_path, options):
+        failures.append("%s: the batches of --deltas do not give the reference output" % case)
+    os.remove(first_path)
+    os.remove(deltas_path)
+    return failures
+
+
+def memory_budget(people):
+    """The budget of the streaming mode in the cases of people people, in bytes"""
+    return BUDGET_BASE_BYTES + people * BUDGET_BYTES_PER_PERSON
+
+
+def too_small_budget(people):
+    """A budget of the streaming mode that the meetings of the cases of people people do not fit
+    in, in bytes (at least MIN_MEMORY_BUDGET, the smallest budget the detector accepts)"""
+    return max(MIN_MEMORY_BUDGET, people * TOO_SMALL_BYTES_PER_PERSON)
+
+
+def check_memory_budget(args, case, people_path, meetings_path, scale, output):
+    """Runs a case in the streaming mode with the budget of its scale (in every mode of
+    BUDGET_MODES) and with too_small_budget, and checks the output, the peak of the heap and the
+    error"""
+    failures = []
+    budget = memory_budget(scale)
+    for mode in BUDGET_MODES:
+        options = ["--memory-budget=%d" % budget, "--memory-stats"] + mode
+        completed = subprocess.run([args.exam, people_path, meetings_path] + options,
+                                   cwd=args.work_dir, stdout=subprocess.DEVNULL,
+                                   stderr=subprocess.PIPE)
+        output_path = os.path.join(args.work_dir, OUTPUT_FILE)
+        if completed.returncode != 0 or file_digest(output_path) != output:
+            failures.append("%s: %s gives another output" % (case, " ".join(options)))
+            continue
+        for line in completed.stderr.decode(errors="replace").splitlines():
+            if line.startswith(PEAK_HEAP_PREFIX) and int(line[len(PEAK_HEAP_PREFIX):]) > budget:
+                failures.append("%s: %s peaks at %s heap bytes" %
+                                (case, " ".join(options), line[len(PEAK_HEAP_PREFIX):]))
+    too_small = "--memory-budget=%d" % too_small_budget(scale)
+    completed = subprocess.run([args.exam, people_path, meetings_path, too_small],
+                               cwd=args.work_dir, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    if completed.returncode == 0 or completed.stderr.decode(errors="replace") != BUDGET_ERROR:
+        failures.append("%s: %s does not fail with %r" % (case, too_small, BUDGET_ERROR))
+    return failures
+
+
+def run_case(args, topology, ids, name_len, scale, stats_flag):
+    """Generates one case, runs it, checks it and returns (its result, its failures)"""
+    case = "%s-%s-name%d-%d" % (topology, ids, name_len, scale)
+    people_path = os.path.join(args.work_dir, case + ".people.in")
+    meetings_path = os.path.join(args.work_dir, case + ".meetings.in")
+    subprocess.run([args.gen, people_path, meetings_path, "--people=%d" % scale,
+                    "--topology=" + topology, "--ids=" + ids, "--name-len=%d" % name_len],
+                   check=True)
+    code, output, seconds, rss_kb, report = run_detector(args.exam, people_path, meetings_path,
+                                                         stats_flag, args.work_dir)
+    failures = []
+    if code != 0:
+        failures.append("%s: exit code %d" % (case, code))
+    elif scale <= args.reference_limit and \
+            output != reference_digest(people_path, meetings_path):
+        failures.append("%s: the output is not the reference output" % case)
+    for mode in CYCLIC_MODES if topology == "cyclic" else OTHER_MODES:
+        mode_code, mode_output, _, _, _ = run_detector(args.exam, people_path, meetings_path,
+                                                       mode, args.work_dir)
+        if code == 0 and (mode_code != 0 or mode_output != output):
+            failures.append("%s: %s gives another output" % (case, " ".join(mode)))
+    if code == 0:
+        failures += check_memory_budget(args, case, people_path, meetings_path, scale, output)
+    if topology == "cyclic" and scale <= args.reference_limit:
+        failures += check_cyclic_deltas(args, case, people_path, meetings_path)
+    os.remove(people_path)
+    os.remove(meetings_path)
+    result = {"people": scale, "seconds": round(seconds, 6),
+              "people_per_second": round(scale / seconds) if seconds > 0 else None,
+              "peak_rss_kb": rss_kb}
+    if report is not None:
+        result["phases"] = {phase["name"]: {"seconds": phase["seconds"],
+                                            "peak_rss_kb": phase["peak_rss_kb"]}
+                            for phase in report["phases"] if phase["runs"] > 0}
+    print("%-40s %9.4f s %12s people/s %9d KB %s" %
+          (case, seconds, result["people_per_second"], rss_kb, "FAILED" if failures else "ok"))
+    return case, result, failures
+
+
+def compare_to_baseline(results, baseline, tolerance):
+    """Prints the ratio of every case to the baseline and returns (the regressions, the failures):
+    a case that is not in the baseline is a failure, since it would never be compared"""
+    regressions = []
+    failures = []
+    for case, result in results.items():
+        if case not in baseline:
+            failures.append("%s: not in the baseline (record it with --update-baseline)" % case)
+            continue
+        before = baseline[case]["seconds"]
+        ratio = result["seconds"] / before if before > 0 else float("inf")
+        print("%-40s %9.4f s -> %9.4f s (x%.2f)" % (case, before, result["seconds"], ratio))
+        if ratio > tolerance and result["seconds"] - before > NOISE_SECONDS:
+            regressions.append("%s: x%.2f slower than the baseline" % (case, ratio))
+    return regressions, failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark of the spreader detector")
+    parser.add_argument("--exam")
+    parser.add_argument("--gen")
+    parser.add_argument("--reference", nargs=2, metavar=("PEOPLE", "MEETINGS"))
+    parser.add_argument("--reference-option", action="append", default=[])
+    parser.add_argument("--examples")
+    parser.add_argument("--baseline")
+    parser.add_argument("--update-baseline", action="store_true")
+    parser.add_argument("--scales", default=DEFAULT_SCALES)
+    parser.add_argument("--work-dir", default=".")
+    parser.add_argument("--tolerance", type=float, default=DEFAULT_TOLERANCE)
+    parser.add_argument("--reference-limit", type=int, default=DEFAULT_REFERENCE_LIMIT)
+    parser.add_argument("--fail-on-regression", action="store_true")
+    args = parser.parse_args()
+    if args.reference:
+        people_path, meetings_path = args.reference
+        output = reference_output(people_path, meetings_path, args.reference_option).encode()
+        print(hashlib.sha256(output).hexdigest())
+        return 0
+    if not args.exam or not args.gen:
+        parser.error("--exam and --gen are required")
+    args.exam = os.path.abspath(args.exam)
+    args.gen = os.path.abspath(args.gen)
+    if args.examples:
+        args.examples = os.path.abspath(args.examples)  # the detector runs in the work directory
+    args.work_dir = os.path.abspath(args.work_dir)  # and so do the paths of the cases
+    os.makedirs(args.work_dir, exist_ok=True)
+    failures = []
+    if args.examples:
+        failures += check_examples(args.exam, args.examples, args.work_dir)
+        failures += check_policy_examples(args.exam, args.examples, args.work_dir)
+    failures += check_policy_min_prob(args.exam, args.work_dir)
+    failures += check_noisy_or(args.exam, args.work_dir)
+    failures += check_shards_pipes(args.exam, args.work_dir)
+    # a build without the measurements of the phases does not know "--stats"
+    code, _, _, _, _ = run_detector(args.exam, os.devnull, os.devnull, ["--stats"], args.work_dir)
+    stats_flag = ["--stats"] if code == 0 else []
+    results = {}
+    for scale in (int(scale) for scale in args.scales.split(",")):
+        for topology, ids, name_len in GRID:
+            case, result, case_failures = run_case(args, topology, ids, name_len, scale,
+                                                   stats_flag)
+            results[case] = result
+            failures += case_failures
+    regressions = []
+    if args.baseline and os.path.exists(args.baseline) and not args.update_baseline:
+        with open(args.baseline) as baseline_file:
+            regressions, baseline_failures = compare_to_baseline(results, json.load(baseline_file),
+                                                                 args.tolerance)
+        failures += baseline_failures
+    if args.baseline and args.update_baseline:
+        with open(args.baseline, "w") as baseline_file:
+            json.dump(results, baseline_file, indent=1, sort_keys=True)
+            baseline_file.write("\n")
+        print("baseline written to %s" % args.baseline)
+    for message in failures + regressions:
+        print(message)
+    if failures or (regressions and args.fail_on_regression):
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
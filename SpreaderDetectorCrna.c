@@ -0,0 +1,154 @@
+/**
+* @file SpreaderDetectorCrna.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the crna of a batch of meetings (scalar, AVX2 and AVX-512)
+* @section DESCRIPTION
+* The vector versions are compiled for their instruction set only (a target attribute), so the
+* rest of the program does not need them, and they are called only after the CPU was asked if it
+* supports them. The last meetings of a batch (less than a full vector) are done by the scalar
+* version with AVX2, and by a masked load and store with AVX-512.
+*/
+
+#include "SpreaderDetectorCrna.h"
+#include "SpreaderDetectorParams.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/**
+ * @def CRNA_X86
+ * @brief The vector versions exist (the program is built for x86)
+ */
+#define CRNA_X86
+#endif
+
+/**
+ * @def AVX2_WIDTH 8
+ * @brief The number of floats in an AVX2 vector
+ */
+#define AVX2_WIDTH 8
+
+/**
+ * @def AVX512_WIDTH 16
+ * @brief The number of floats in an AVX-512 vector
+ */
+#define AVX512_WIDTH 16
+
+/**
+ * The crna of every meeting, one by one (the formula of the meeting file)
+ * @param distances The distances of the meetings
+ * @param times The times of the meetings
+ * @param crnas Will contain the crna of every meeting
+ * @param len The number of meetings
+ */
+static void computeCrnasScalar(const float *distances, const float *times, float *crnas,
+                               size_t len)
+{
+	for (size_t i = 0; i < len; ++i)
+	{
+		crnas[i] = (times[i] * MIN_DISTANCE) / (distances[i] * MAX_TIME);
+	}
+}
+
+#ifdef CRNA_X86
+
+/**
+ * The crna of 8 meetings per instruction
+ * @param distances The distances of the meetings
+ * @param times The times of the meetings
+ * @param crnas Will contain the crna of every meeting
+ * @param len The number of meetings
+ */
+__attribute__((target("avx2")))
+static void computeCrnasAvx2(const float *distances, const float *times, float *crnas, size_t len)
+{
+	const __m256 minDistance = _mm256_set1_ps(MIN_DISTANCE);
+	const __m256 maxTime = _mm256_set1_ps(MAX_TIME);
+	size_t i = 0;
+	for (; i + AVX2_WIDTH <= len; i += AVX2_WIDTH)
+	{
+		__m256 time = _mm256_loadu_ps(times + i);
+		__m256 distance = _mm256_loadu_ps(distances + i);
+		_mm256_storeu_ps(crnas + i, _mm256_div_ps(_mm256_mul_ps(time, minDistance),
+		                                          _mm256_mul_ps(distance, maxTime)));
+	}
+	computeCrnasScalar(distances + i, times + i, crnas + i, len - i);
+}
+
+/**
+ * The crna of 16 meetings per instruction. The last meetings are masked
+ * @param distances The distances of the meetings
+ * @param times The times of the meetings
+ * @param crnas Will contain the crna of every meeting
+ * @param len The number of meetings
+ */
+__attribute__((target("avx512f")))
+static void computeCrnasAvx512(const float *distances, const float *times, float *crnas,
+                               size_t len)
+{
+	const __m512 minDistance = _mm512_set1_ps(MIN_DISTANCE);
+	const __m512 maxTime = _mm512_set1_ps(MAX_TIME);
+	const __m512 one = _mm512_set1_ps(1.0f); // the distance of the masked lanes (no division by 0)
+	for (size_t i = 0; i < len; i += AVX512_WIDTH)
+	{
+		size_t left = len - i;
+		__mmask16 mask = left >= AVX512_WIDTH ? (__mmask16) 0xFFFF :
+		                 (__mmask16) ((1u << left) - 1);
+		__m512 time = _mm512_maskz_loadu_ps(mask, times + i);
+		__m512 distance = _mm512_mask_loadu_ps(one, mask, distances + i);
+		_mm512_mask_storeu_ps(crnas + i, mask, _mm512_div_ps(_mm512_mul_ps(time, minDistance),
+		                                                     _mm512_mul_ps(distance, maxTime)));
+	}
+}
+
+#endif
+
+void computeCrnas(const float *distances, const float *times, float *crnas, size_t len)
+{
+	computeCrnasWithIsa(bestCrnaIsa(), distances, times, crnas, len);
+}
+
+void computeCrnasWithIsa(int isa, const float *distances, const float *times, float *crnas,
+                         size_t len)
+{
+#ifdef CRNA_X86
+	if (isa == CRNA_ISA_AVX512)
+	{
+		computeCrnasAvx512(distances, times, crnas, len);
+		return;
+	}
+	else if (isa == CRNA_ISA_AVX2)
+	{
+		computeCrnasAvx2(distances, times, crnas, len);
+		return;
+	}
+#else
+	(void) isa;
+#endif
+	computeCrnasScalar(distances, times, crnas, len);
+}
+
+int bestCrnaIsa(void)
+{
+#ifdef CRNA_X86
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return CRNA_ISA_AVX512;
+	}
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return CRNA_ISA_AVX2;
+	}
+#endif
+	return CRNA_ISA_SCALAR;
+}
+
+const char *nameOfCrnaIsa(int isa)
+{
+	if (isa == CRNA_ISA_AVX512)
+	{
+		return "avx512";
+	}
+	return isa == CRNA_ISA_AVX2 ? "avx2" : "scalar";
+}
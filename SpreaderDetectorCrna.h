@@ -0,0 +1,98 @@
+/**
+* @file SpreaderDetectorCrna.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The crna of the meetings, computed for a whole batch of meetings at once
+* @section DESCRIPTION
+* The meetings are collected into batches as structure of arrays (the infectors, the infecteds,
+* the distances and the times, every one contiguous). The crna of a whole batch is computed with
+* the widest vector instructions the CPU has: 16 meetings per instruction with AVX-512, 8 with AVX2
+* or one by one otherwise. The instruction set is chosen at run time, so the same program runs on
+* any CPU. Every meeting gets exactly the crna of the scalar formula (the same multiplications and
+* the same division, in the same order), so the output does not depend on the instruction set.
+*/
+
+#ifndef EXAM_SPREADERDETECTORCRNA_H
+#define EXAM_SPREADERDETECTORCRNA_H
+
+#include <stddef.h>
+
+/**
+ * @def CRNA_BATCH_SIZE 1024
+ * @brief The number of meetings in a full batch
+ */
+#define CRNA_BATCH_SIZE 1024
+
+/**
+ * @def CRNA_ISA_SCALAR 0
+ * @brief One meeting at a time (any CPU)
+ */
+#define CRNA_ISA_SCALAR 0
+
+/**
+ * @def CRNA_ISA_AVX2 1
+ * @brief 8 meetings per instruction
+ */
+#define CRNA_ISA_AVX2 1
+
+/**
+ * @def CRNA_ISA_AVX512 2
+ * @brief 16 meetings per instruction
+ */
+#define CRNA_ISA_AVX512 2
+
+/**
+ * @def NUM_OF_CRNA_ISAS 3
+ * @brief The number of instruction sets
+ */
+#define NUM_OF_CRNA_ISAS 3
+
+/**
+ * @struct MeetingBatch
+ * @brief A batch of meetings that were read and not added to the graph yet, as structure of
+ * arrays. infectors and infecteds are the vertices of the two people. A batch initialized to {0}
+ * is empty
+ */
+typedef struct MeetingBatch
+{
+	size_t infectors[CRNA_BATCH_SIZE];
+	size_t infecteds[CRNA_BATCH_SIZE];
+	float distances[CRNA_BATCH_SIZE];
+	float times[CRNA_BATCH_SIZE];
+	size_t len;
+} MeetingBatch;
+
+/**
+ * Computes the crna of every meeting, with the widest instruction set the CPU supports
+ * @param distances The distances of the meetings
+ * @param times The times of the meetings
+ * @param crnas Will contain the crna of every meeting
+ * @param len The number of meetings
+ */
+void computeCrnas(const float *distances, const float *times, float *crnas, size_t len);
+
+/**
+ * Like computeCrnas, with a given instruction set (for the benchmark)
+ * @param isa CRNA_ISA_SCALAR, CRNA_ISA_AVX2 or CRNA_ISA_AVX512 (supported by the CPU)
+ * @param distances The distances of the meetings
+ * @param times The times of the meetings
+ * @param crnas Will contain the crna of every meeting
+ * @param len The number of meetings
+ */
+void computeCrnasWithIsa(int isa, const float *distances, const float *times, float *crnas,
+                         size_t len);
+
+/**
+ * Returns the widest instruction set the CPU supports (and the program was built for)
+ * @return CRNA_ISA_SCALAR, CRNA_ISA_AVX2 or CRNA_ISA_AVX512
+ */
+int bestCrnaIsa(void);
+
+/**
+ * Returns the name of an instruction set
+ * @param isa The instruction set
+ * @return "scalar", "avx2" or "avx512"
+ */
+const char *nameOfCrnaIsa(int isa);
+
+#endif //EXAM_SPREADERDETECTORCRNA_H
@@ -0,0 +1,241 @@
+/**
+* @file SpreaderDetectorCrnaBench.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief A micro benchmark of the crna of batches of meetings, for every instruction set, and of
+* the risk models
+* @section DESCRIPTION
+* Usage: crna_bench [number of meetings] [number of rounds]
+* Random meetings (distance and time in the ranges of the meeting file) are computed in batches of
+* CRNA_BATCH_SIZE, like the detector does, with every instruction set the CPU supports. For every
+* one of them the best round is printed (nanoseconds and millions of meetings per second), and the
+* crnas are compared to the scalar ones (they must be exactly the same).
+* Then the kernel that DEFINE_RISK_KERNEL makes from crnaRisk is compared to the hand-written
+* scalar loop (the same crnas, at the same speed), and to a loop that chooses the model of every
+* meeting (riskOfMeeting). Last, every model of the registry is computed in batches like the
+* detector does (computeRisks), and compared to its formula computed meeting by meeting.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SpreaderDetectorCrna.h"
+#include "SpreaderDetectorModel.h"
+#include "SpreaderDetectorParams.h"
+#include "SpreaderDetectorStats.h"
+
+/**
+ * @def DEFAULT_NUM_OF_MEETINGS (1 << 20)
+ * @brief The number of meetings when it is not given
+ */
+#define DEFAULT_NUM_OF_MEETINGS (1 << 20)
+
+/**
+ * @def DEFAULT_NUM_OF_ROUNDS 20
+ * @brief The number of rounds when it is not given (the best one is printed)
+ */
+#define DEFAULT_NUM_OF_ROUNDS 20
+
+/**
+ * @def RANDOM_SEED 12345
+ * @brief The seed of the random meetings (the same meetings in every run)
+ */
+#define RANDOM_SEED 12345
+
+/**
+ * Returns a random float in [low, high]
+ * @param low The lowest value
+ * @param high The highest value
+ * @return The float
+ */
+static float randomIn(float low, float high)
+{
+	return low + (high - low) * ((float) rand() / (float) RAND_MAX);
+}
+
+DEFINE_RISK_KERNEL(computeCrnaRisks, crnaRisk)
+
+/**
+ * Computes the crnas of all the meetings in batches of CRNA_BATCH_SIZE
+ * @param isa The instruction set
+ * @param distances The distances
+ * @param times The times
+ * @param crnas The crnas
+ * @param len The number of meetings
+ */
+static void computeInBatches(int isa, const float *distances, const float *times, float *crnas,
+                             size_t len)
+{
+	for (size_t i = 0; i < len; i += CRNA_BATCH_SIZE)
+	{
+		size_t batchLen = len - i < CRNA_BATCH_SIZE ? len - i : CRNA_BATCH_SIZE;
+		computeCrnasWithIsa(isa, distances + i, times + i, crnas + i, batchLen);
+	}
+}
+
+/**
+ * Computes the crnas of all the meetings in batches of CRNA_BATCH_SIZE, with the kernel of
+ * crnaRisk (has the signature of computeInBatches)
+ * @param unused Not used
+ * @param distances The distances
+ * @param times The times
+ * @param crnas The crnas
+ * @param len The number of meetings
+ */
+static void computeKernelInBatches(int unused, const float *distances, const float *times,
+                                   float *crnas, size_t len)
+{
+	(void) unused;
+	for (size_t i = 0; i < len; i += CRNA_BATCH_SIZE)
+	{
+		size_t batchLen = len - i < CRNA_BATCH_SIZE ? len - i : CRNA_BATCH_SIZE;
+		computeCrnaRisks(distances + i, times + i, crnas + i, batchLen);
+	}
+}
+
+/**
+ * Computes the risks of all the meetings by a model in batches of CRNA_BATCH_SIZE, like the
+ * detector does
+ * @param model The model
+ * @param distances The distances
+ * @param times The times
+ * @param risks The risks
+ * @param len The number of meetings
+ */
+static void computeModelInBatches(int model, const float *distances, const float *times,
+                                  float *risks, size_t len)
+{
+	for (size_t i = 0; i < len; i += CRNA_BATCH_SIZE)
+	{
+		size_t batchLen = len - i < CRNA_BATCH_SIZE ? len - i : CRNA_BATCH_SIZE;
+		computeRisks(model, distances + i, times + i, risks + i, batchLen);
+	}
+}
+
+/**
+ * Computes the risks of all the meetings by a model, choosing the model of every meeting
+ * @param model The model
+ * @param distances The distances
+ * @param times The times
+ * @param risks The risks
+ * @param len The number of meetings
+ */
+static void computeModelPerMeeting(int model, const float *distances, const float *times,
+                                   float *risks, size_t len)
+{
+	for (size_t i = 0; i < len; ++i)
+	{
+		risks[i] = riskOfMeeting(model, distances[i], times[i]);
+	}
+}
+
+/**
+ * Runs a computation of all the meetings for some rounds
+ * @param compute The computation
+ * @param arg The first argument of the computation (the instruction set or the model)
+ * @param distances The distances
+ * @param times The times
+ * @param results The results
+ * @param len The number of meetings
+ * @param numOfRounds The number of rounds
+ * @return The seconds of the best round
+ */
+static double bestRound(void (*compute)(int, const float *, const float *, float *, size_t),
+                        int arg, const float *distances, const float *times, float *results,
+                        size_t len, size_t numOfRounds)
+{
+	double best = 0;
+	for (size_t round = 0; round < numOfRounds; ++round)
+	{
+		double begin = currentSeconds();
+		compute(arg, distances, times, results, len);
+		double seconds = currentSeconds() - begin;
+		best = round == 0 || seconds < best ? seconds : best;
+	}
+	return best;
+}
+
+/**
+ * Prints a line of the benchmark
+ * @param name The name of the computation
+ * @param seconds The seconds of the best round
+ * @param numOfMeetings The number of meetings
+ * @param isExact Whether the results are the expected ones
+ */
+static void printResult(const char *name, double seconds, size_t numOfMeetings, int isExact)
+{
+	printf("%-22s %7.3f ns/meeting %9.1f M meetings/s %s\n", name,
+	       seconds * NANOS_IN_SECOND / (double) numOfMeetings,
+	       (double) numOfMeetings / seconds / 1e6, isExact ? "exact" : "MISMATCH");
+}
+
+int main(int argc, char *argv[])
+{
+	size_t numOfMeetings = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_NUM_OF_MEETINGS;
+	size_t numOfRounds = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_NUM_OF_ROUNDS;
+	if (numOfMeetings == 0 || numOfRounds == 0)
+	{
+		fprintf(stderr, "Usage: crna_bench [number of meetings] [number of rounds]\n");
+		return EXIT_FAILURE;
+	}
+	float *distances = (float *) malloc(numOfMeetings * sizeof(float));
+	float *times = (float *) malloc(numOfMeetings * sizeof(float));
+	float *expected = (float *) malloc(numOfMeetings * sizeof(float));
+	float *crnas = (float *) malloc(numOfMeetings * sizeof(float));
+	if (distances == NULL || times == NULL || expected == NULL || crnas == NULL)
+	{
+		fprintf(stderr, STANDARD_LIB_ERR_MSG);
+		free(distances);
+		free(times);
+		free(expected);
+		free(crnas);
+		return EXIT_FAILURE;
+	}
+	srand(RANDOM_SEED);
+	for (size_t i = 0; i < numOfMeetings; ++i)
+	{
+		distances[i] = randomIn(MIN_DISTANCE, 10 * MIN_DISTANCE);
+		times[i] = randomIn(1.0f, MAX_TIME);
+	}
+	computeInBatches(CRNA_ISA_SCALAR, distances, times, expected, numOfMeetings);
+	int status = EXIT_SUCCESS;
+	printf("meetings: %zu, rounds: %zu, widest isa: %s\n", numOfMeetings, numOfRounds,
+	       nameOfCrnaIsa(bestCrnaIsa()));
+	for (int isa = CRNA_ISA_SCALAR; isa <= bestCrnaIsa(); ++isa)
+	{
+		double best = bestRound(computeInBatches, isa, distances, times, crnas, numOfMeetings,
+		                        numOfRounds);
+		int isExact = memcmp(crnas, expected, numOfMeetings * sizeof(float)) == 0;
+		printResult(nameOfCrnaIsa(isa), best, numOfMeetings, isExact);
+		status = isExact ? status : EXIT_FAILURE;
+	}
+	printf("crna as a model:\n");
+	double best = bestRound(computeInBatches, CRNA_ISA_SCALAR, distances, times, crnas,
+	                        numOfMeetings, numOfRounds);
+	printResult("hand-written loop", best, numOfMeetings, 1);
+	best = bestRound(computeKernelInBatches, MODEL_CRNA, distances, times, crnas, numOfMeetings,
+	                 numOfRounds);
+	int isExact = memcmp(crnas, expected, numOfMeetings * sizeof(float)) == 0;
+	printResult("kernel of crnaRisk", best, numOfMeetings, isExact);
+	status = isExact ? status : EXIT_FAILURE;
+	best = bestRound(computeModelPerMeeting, MODEL_CRNA, distances, times, crnas, numOfMeetings,
+	                 numOfRounds);
+	isExact = memcmp(crnas, expected, numOfMeetings * sizeof(float)) == 0;
+	printResult("model of every meeting", best, numOfMeetings, isExact);
+	status = isExact ? status : EXIT_FAILURE;
+	printf("models (batches, compared to meeting by meeting):\n");
+	for (int model = 0; model < NUM_OF_RISK_MODELS; ++model)
+	{
+		computeModelPerMeeting(model, distances, times, expected, numOfMeetings);
+		best = bestRound(computeModelInBatches, model, distances, times, crnas, numOfMeetings,
+		                 numOfRounds);
+		isExact = memcmp(crnas, expected, numOfMeetings * sizeof(float)) == 0;
+		printResult(nameOfRiskModel(model), best, numOfMeetings, isExact);
+		status = isExact ? status : EXIT_FAILURE;
+	}
+	free(distances);
+	free(times);
+	free(expected);
+	free(crnas);
+	return status;
+}
@@ -0,0 +1,706 @@
+/**
+* @file SpreaderDetectorEngine.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the engine
+* @section DESCRIPTION
+* The engine keeps its people in the table of the command line tool (SpreaderDetectorTable.h), and
+* loads, propagates, sorts and writes them by the same functions, so the two can not drift apart.
+* The engine goes through three stages. While people are added the columns grow. The first seed,
+* meeting or query freezes the people: the ID index is built. The meetings are collected into the
+* batch of the table and added to the contact graph. The first query propagates the risk over the
+* whole graph, and moves the graph into an incremental graph; from then on new meetings are added
+* to the incremental graph and propagated as one batch by the next query.
+* A windowed engine never propagates over the whole graph: its meetings go from the batch (with
+* their timestamps beside it) into the graph of the window, and every query refreshes only what was
+* changed since the previous one.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SpreaderDetectorEngine.h"
+#include "SpreaderDetectorGraph.h"
+#include "SpreaderDetectorIncremental.h"
+#include "SpreaderDetectorModel.h"
+#include "SpreaderDetectorPolicy.h"
+#include "SpreaderDetectorScan.h"
+#include "SpreaderDetectorStats.h"
+#include "SpreaderDetectorTable.h"
+#include "SpreaderDetectorWindow.h"
+
+/**
+ * @def STAGE_PEOPLE 0
+ * @brief People can be added
+ */
+#define STAGE_PEOPLE 0
+
+/**
+ * @def STAGE_MEETINGS 1
+ * @brief The people are frozen, the seeds and the meetings go into the contact graph
+ */
+#define STAGE_MEETINGS 1
+
+/**
+ * @def STAGE_PROPAGATED 2
+ * @brief The risk was propagated, new meetings go into the incremental graph
+ */
+#define STAGE_PROPAGATED 2
+
+struct SpreaderEngine
+{
+	int combineRule;
+	size_t numOfThreads;
+	int stage;
+	PeopleTable people;
+	int hasNewMeetings;
+	ProbSortKey *order;
+	size_t numOfOrderKeys;
+	int isOrderValid;
+	size_t classCounts[NUM_OF_CLASSES];
+	int areCountsValid;
+	RiskPolicy policy;
+	int isWindowed;
+	size_t windowLength;
+	size_t halfLife;
+	size_t windowEnd;
+	size_t *batchTimestamps;
+	WindowGraph window;
+	size_t numOfRefreshes;
+};
+
+/**
+ * @struct EngineSeeds
+ * @brief The context of the seeds of a meeting file of a windowed engine: the engine, and the
+ * status of the first seed that could not be added
+ */
+typedef struct EngineSeeds
+{
+	SpreaderEngine *engine;
+	int status;
+} EngineSeeds;
+
+/**
+ * The messages of the ENGINE_ codes (by their values)
+ */
+static const char *const statusMessages[] = {"success", "a file could not be opened",
+                                             "an invalid line in an input file",
+                                             "no person with this ID", "out of memory",
+                                             "not allowed at this stage", "writing failed",
+                                             "no more people",
+                                             "older than the end of the window"};
+
+/**
+ * Converts a TABLE_ code (see SpreaderDetectorTable.h) to the ENGINE_ code of the same error
+ * @param status The TABLE_ code
+ * @return The ENGINE_ code
+ */
+static int engineStatusOf(int status)
+{
+	switch (status)
+	{
+		case TABLE_SUCCESS:
+			return ENGINE_SUCCESS;
+		case TABLE_OPEN_FAILED:
+			return ENGINE_OPEN_FAILED;
+		case TABLE_INVALID_INPUT:
+			return ENGINE_INVALID_INPUT;
+		case TABLE_UNKNOWN_PERSON:
+			return ENGINE_UNKNOWN_PERSON;
+		case TABLE_WRITE_FAILED:
+			return ENGINE_WRITE_FAILED;
+		default:
+			return ENGINE_NO_MEMORY;
+	}
+}
+
+/**
+ * Releases what freezePeople allocated, so the engine is back in the stage of the people
+ * @param engine The engine
+ */
+static void unfreezePeople(SpreaderEngine *engine)
+{
+	trackedFree(engine->batchTimestamps, CRNA_BATCH_SIZE * sizeof(size_t));
+	engine->batchTimestamps = NULL;
+	freeWindowGraph(&engine->window);
+	freeIdIndex(&engine->people.idIndex);
+}
+
+/**
+ * Freezes the people (only the first time): builds the ID index of the table, and the graph of
+ * the window in a windowed engine
+ * @param engine The engine
+ * @return ENGINE_SUCCESS or ENGINE_NO_MEMORY (the people are not frozen)
+ */
+static int freezePeople(SpreaderEngine *engine)
+{
+	if (engine->stage != STAGE_PEOPLE)
+	{
+		return ENGINE_SUCCESS;
+	}
+	if (engine->isWindowed)
+	{
+		engine->batchTimestamps = (size_t *) trackedMalloc(CRNA_BATCH_SIZE * sizeof(size_t));
+	}
+	if (indexPeopleTable(&engine->people) != TABLE_SUCCESS ||
+	    (engine->isWindowed &&
+	     (engine->batchTimestamps == NULL ||
+	      initWindowGraph(&engine->window, engine->people.len, engine->people.ids,
+	                      engine->combineRule, engine->windowLength, engine->halfLife,
+	                      engine->people.probsInfected) == WINDOW_FAILED)))
+	{
+		unfreezePeople(engine);
+		return ENGINE_NO_MEMORY;
+	}
+	engine->stage = STAGE_MEETINGS;
+	return ENGINE_SUCCESS;
+}
+
+/**
+ * Adds the meetings of the batch of the table to the graph of the window, and empties the batch
+ * (the other engines flush the batch by flushTableBatch)
+ * @param engine The engine (windowed)
+ * @return ENGINE_SUCCESS or ENGINE_NO_MEMORY (the meetings that were not added stay in the batch)
+ */
+static int flushWindowBatch(SpreaderEngine *engine)
+{
+	MeetingBatch *batch = &engine->people.meetingBatch;
+	if (batch->len == 0)
+	{
+		return ENGINE_SUCCESS;
+	}
+	float crnas[CRNA_BATCH_SIZE];
+	computeRisks(engine->people.contacts.riskModel, batch->distances, batch->times, crnas,
+	             batch->len);
+	size_t numOfAdded = 0;
+	// the timestamps were checked when the meetings were added
+	while (numOfAdded < batch->len &&
+	       addWindowContact(&engine->window, batch->infectors[numOfAdded],
+	                        batch->infecteds[numOfAdded], crnas[numOfAdded],
+	                        engine->batchTimestamps[numOfAdded]) == WINDOW_SUCCESS)
+	{
+		numOfAdded++;
+	}
+	if (numOfAdded < batch->len) // keep the meetings that were not added for the next flush
+	{
+		size_t numOfLeft = batch->len - numOfAdded;
+		memmove(batch->infectors, batch->infectors + numOfAdded, numOfLeft * sizeof(size_t));
+		memmove(batch->infecteds, batch->infecteds + numOfAdded, numOfLeft * sizeof(size_t));
+		memmove(batch->distances, batch->distances + numOfAdded, numOfLeft * sizeof(float));
+		memmove(batch->times, batch->times + numOfAdded, numOfLeft * sizeof(float));
+		memmove(engine->batchTimestamps, engine->batchTimestamps + numOfAdded,
+		        numOfLeft * sizeof(size_t));
+		batch->len = numOfLeft;
+		return ENGINE_NO_MEMORY;
+	}
+	batch->len = 0;
+	return ENGINE_SUCCESS;
+}
+
+/**
+ * Empties the batch of the table into the graph of the engine
+ * @param engine The engine (frozen)
+ * @return ENGINE_SUCCESS or ENGINE_NO_MEMORY
+ */
+static int flushEngineBatch(SpreaderEngine *engine)
+{
+	if (engine->isWindowed)
+	{
+		return flushWindowBatch(engine);
+	}
+	return flushTableBatch(&engine->people) == TABLE_SUCCESS ? ENGINE_SUCCESS : ENGINE_NO_MEMORY;
+}
+
+/**
+ * Brings the probabilities up to date with all the meetings that were added: the full
+ * propagation the first time, an incremental batch after that (a refresh of the window in a
+ * windowed engine)
+ * @param engine The engine
+ * @return ENGINE_SUCCESS or ENGINE_NO_MEMORY
+ */
+static int updateRisk(SpreaderEngine *engine)
+{
+	if (freezePeople(engine) != ENGINE_SUCCESS || flushEngineBatch(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	if (engine->isWindowed)
+	{
+		if (engine->window.order.numOfDirty > 0)
+		{
+			engine->numOfRefreshes++;
+			if (refreshWindow(&engine->window) > 0)
+			{
+				engine->isOrderValid = 0;
+				engine->areCountsValid = 0;
+			}
+		}
+	}
+	else if (engine->stage == STAGE_MEETINGS)
+	{
+		if (propagatePeopleTable(&engine->people, engine->combineRule, engine->numOfThreads) !=
+		    TABLE_SUCCESS ||
+		    beginTableUpdates(&engine->people, engine->combineRule) != TABLE_SUCCESS)
+		{
+			return ENGINE_NO_MEMORY;
+		}
+		engine->stage = STAGE_PROPAGATED;
+		engine->isOrderValid = 0;
+		engine->areCountsValid = 0;
+	}
+	else if (engine->hasNewMeetings)
+	{
+		propagateBatch(&engine->people.incremental);
+		engine->hasNewMeetings = 0;
+		engine->isOrderValid = 0;
+		engine->areCountsValid = 0;
+	}
+	return ENGINE_SUCCESS;
+}
+
+/**
+ * Fills the result of one row
+ * @param engine The engine (propagated)
+ * @param row The row
+ * @param result Will contain the person
+ */
+static void fillResult(const SpreaderEngine *engine, size_t row, EngineResult *result)
+{
+	const PeopleTable *people = &engine->people;
+	result->name = people->names[row];
+	result->nameLen = people->nameLengths[row];
+	result->id = people->ids[row];
+	result->age = people->ages[row];
+	result->probInfected = people->probsInfected[row];
+	result->riskClass = classOfPerson(&engine->policy, people->ages[row],
+	                                  people->probsInfected[row]);
+}
+
+/**
+ * Brings the probabilities up to date and sorts the people into the order of the output file (if
+ * they were changed since the last sort)
+ * @param engine The engine
+ * @return ENGINE_SUCCESS or ENGINE_NO_MEMORY
+ */
+static int updateOrder(SpreaderEngine *engine)
+{
+	if (updateRisk(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	if (engine->isOrderValid)
+	{
+		return ENGINE_SUCCESS;
+	}
+	trackedFree(engine->order, engine->numOfOrderKeys * sizeof(ProbSortKey));
+	engine->order = NULL;
+	engine->numOfOrderKeys = 0;
+	if (orderPeopleTable(&engine->people, &engine->policy, NO_TOP, NO_MIN_PROB, NO_MAX_CLASS,
+	                     engine->numOfThreads, &engine->order, &engine->numOfOrderKeys) !=
+	    TABLE_SUCCESS)
+	{
+		engine->numOfOrderKeys = 0;
+		return ENGINE_NO_MEMORY;
+	}
+	engine->isOrderValid = 1;
+	return ENGINE_SUCCESS;
+}
+
+/**
+ * A SeedConsumer that adds the seed to the engine
+ * @param id The ID of the seed
+ * @param context The EngineSeeds
+ * @return SCAN_SUCCESS or SCAN_FAILED (the status is in the EngineSeeds)
+ */
+static int addEngineSeed(size_t id, void *context)
+{
+	EngineSeeds *seeds = (EngineSeeds *) context;
+	seeds->status = engineAddSeed(seeds->engine, id);
+	return seeds->status == ENGINE_SUCCESS ? SCAN_SUCCESS : SCAN_FAILED;
+}
+
+/**
+ * Reads the first line of a meeting file of a windowed engine: the IDs of the seeds (one or more)
+ * @param engine The engine
+ * @param line The beginning of the line
+ * @param lineEnd The end of the line
+ * @return ENGINE_SUCCESS, ENGINE_INVALID_INPUT, ENGINE_UNKNOWN_PERSON, ENGINE_WRONG_STATE or
+ * ENGINE_NO_MEMORY
+ */
+static int addSeedsFromEngineLine(SpreaderEngine *engine, const char *line, const char *lineEnd)
+{
+	EngineSeeds seeds = {engine, ENGINE_SUCCESS};
+	if (parseSeedsFromBytes(line, lineEnd, addEngineSeed, &seeds) == SCAN_FAILED)
+	{
+		return seeds.status != ENGINE_SUCCESS ? seeds.status : ENGINE_INVALID_INPUT;
+	}
+	return ENGINE_SUCCESS;
+}
+
+/**
+ * Reads a meeting file of a windowed engine line by line (every meeting line ends with its
+ * timestamp, so it is not a file of the table)
+ * @param engine The engine (windowed)
+ * @param path The path of the file
+ * @return ENGINE_SUCCESS, ENGINE_OPEN_FAILED, ENGINE_INVALID_INPUT, ENGINE_UNKNOWN_PERSON,
+ * ENGINE_OUT_OF_ORDER or ENGINE_NO_MEMORY
+ */
+static int loadTimedMeetings(SpreaderEngine *engine, const char *path)
+{
+	FILE *inputFile = fopen(path, READING_MODE);
+	if (inputFile == NULL)
+	{
+		return ENGINE_OPEN_FAILED;
+	}
+	char currentRow[MAX_LINE_SIZE];
+	int status = ENGINE_SUCCESS;
+	//first line. get the ids of the seeds. (The first line is different from the rest!)
+	if (fgets(currentRow, sizeof(currentRow), inputFile))
+	{
+		size_t rowLen = strlen(currentRow);
+		COUNT_BYTES_READ(rowLen);
+		status = addSeedsFromEngineLine(engine, currentRow,
+		                                findLineEnd(currentRow, currentRow + rowLen));
+	}
+	while (status == ENGINE_SUCCESS && fgets(currentRow, sizeof(currentRow), inputFile))
+	{
+		size_t rowLen = strlen(currentRow);
+		COUNT_BYTES_READ(rowLen);
+		const char *lineEnd = findLineEnd(currentRow, currentRow + rowLen);
+		MeetingInfo meeting;
+		size_t timestamp;
+		status = scanTimedMeetingFromBytes(currentRow, lineEnd, &meeting, &timestamp) ==
+		         SCAN_FAILED ? ENGINE_INVALID_INPUT :
+		         engineAddTimedMeeting(engine, meeting.infectorId, meeting.infectedId,
+		                               meeting.distance, meeting.time, timestamp);
+	}
+	fclose(inputFile);
+	return status;
+}
+
+int createEngine(SpreaderEngine **engine, int combineRule, size_t numOfThreads)
+{
+	*engine = (SpreaderEngine *) trackedCalloc(1, sizeof(SpreaderEngine));
+	if (*engine == NULL)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	(*engine)->combineRule = combineRule;
+	(*engine)->numOfThreads = numOfThreads;
+	(*engine)->stage = STAGE_PEOPLE;
+	initDefaultPolicy(&(*engine)->policy);
+	return ENGINE_SUCCESS;
+}
+
+int createWindowedEngine(SpreaderEngine **engine, int combineRule, size_t windowLength,
+                         size_t halfLife)
+{
+	*engine = NULL;
+	if (windowLength == 0)
+	{
+		return ENGINE_INVALID_INPUT;
+	}
+	int status = createEngine(engine, combineRule, 1); // the window is refreshed by one thread
+	if (status == ENGINE_SUCCESS)
+	{
+		(*engine)->isWindowed = 1;
+		(*engine)->windowLength = windowLength;
+		(*engine)->halfLife = halfLife;
+	}
+	return status;
+}
+
+int engineSetPolicy(SpreaderEngine *engine, const RiskPolicy *policy)
+{
+	if (policy->numOfBands == 0 || policy->numOfBands > MAX_AGE_BANDS)
+	{
+		return ENGINE_INVALID_INPUT;
+	}
+	engine->policy = *policy;
+	engine->isOrderValid = 0; // the people are ordered by their classes first
+	engine->areCountsValid = 0;
+	return ENGINE_SUCCESS;
+}
+
+int engineSetRiskModel(SpreaderEngine *engine, int model)
+{
+	if (model < 0 || model >= NUM_OF_RISK_MODELS)
+	{
+		return ENGINE_INVALID_INPUT;
+	}
+	if (engine->stage != STAGE_PEOPLE)
+	{
+		return ENGINE_WRONG_STATE;
+	}
+	// also the model of the meetings after the propagation
+	engine->people.contacts.riskModel = model;
+	return ENGINE_SUCCESS;
+}
+
+int engineAddPerson(SpreaderEngine *engine, const char *name, size_t id, float age)
+{
+	if (engine->stage != STAGE_PEOPLE)
+	{
+		return ENGINE_WRONG_STATE;
+	}
+	return engineStatusOf(addTablePerson(&engine->people, name, strlen(name), id, age));
+}
+
+int engineLoadPeople(SpreaderEngine *engine, const char *path)
+{
+	if (engine->stage != STAGE_PEOPLE)
+	{
+		return ENGINE_WRONG_STATE;
+	}
+	return engineStatusOf(loadPeopleTable(&engine->people, path, engine->numOfThreads));
+}
+
+int engineAddSeed(SpreaderEngine *engine, size_t id)
+{
+	if (engine->stage == STAGE_PROPAGATED)
+	{
+		return ENGINE_WRONG_STATE;
+	}
+	if (freezePeople(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	if (engine->isWindowed)
+	{
+		size_t row;
+		if (findTableRow(&engine->people, id, &row) != TABLE_SUCCESS)
+		{
+			return ENGINE_UNKNOWN_PERSON;
+		}
+		addWindowSeed(&engine->window, row);
+		return ENGINE_SUCCESS;
+	}
+	return engineStatusOf(addTableSeed(&engine->people, id));
+}
+
+int engineAddMeeting(SpreaderEngine *engine, size_t infectorId, size_t infectedId, float distance,
+                     float time)
+{
+	if (engine->isWindowed)
+	{
+		return ENGINE_WRONG_STATE;
+	}
+	if (freezePeople(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	MeetingInfo meeting = {infectorId, infectedId, distance, time};
+	int status = engineStatusOf(addTableMeeting(&engine->people, &meeting));
+	if (status == ENGINE_SUCCESS && engine->stage == STAGE_PROPAGATED)
+	{
+		engine->hasNewMeetings = 1;
+	}
+	return status;
+}
+
+int engineAddTimedMeeting(SpreaderEngine *engine, size_t infectorId, size_t infectedId,
+                          float distance, float time, size_t timestamp)
+{
+	if (!engine->isWindowed)
+	{
+		return ENGINE_WRONG_STATE;
+	}
+	if (freezePeople(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	if (timestamp < engine->windowEnd)
+	{
+		return ENGINE_OUT_OF_ORDER;
+	}
+	size_t infectorRow, infectedRow;
+	if (findTableRow(&engine->people, infectorId, &infectorRow) != TABLE_SUCCESS ||
+	    findTableRow(&engine->people, infectedId, &infectedRow) != TABLE_SUCCESS)
+	{
+		return ENGINE_UNKNOWN_PERSON;
+	}
+	MeetingBatch *batch = &engine->people.meetingBatch;
+	if (batch->len == CRNA_BATCH_SIZE && flushWindowBatch(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	batch->infectors[batch->len] = infectorRow;
+	batch->infecteds[batch->len] = infectedRow;
+	batch->distances[batch->len] = distance;
+	batch->times[batch->len] = time;
+	engine->batchTimestamps[batch->len] = timestamp;
+	batch->len++;
+	engine->windowEnd = timestamp;
+	return ENGINE_SUCCESS;
+}
+
+int engineAdvanceWindow(SpreaderEngine *engine, size_t now)
+{
+	if (!engine->isWindowed)
+	{
+		return ENGINE_WRONG_STATE;
+	}
+	if (freezePeople(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	if (now < engine->windowEnd)
+	{
+		return ENGINE_OUT_OF_ORDER;
+	}
+	if (flushWindowBatch(engine) != ENGINE_SUCCESS) // the meetings before the new end
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	advanceWindow(&engine->window, now);
+	engine->windowEnd = now;
+	return ENGINE_SUCCESS;
+}
+
+int engineWindowStats(const SpreaderEngine *engine, EngineWindowStats *stats)
+{
+	if (!engine->isWindowed)
+	{
+		return ENGINE_WRONG_STATE;
+	}
+	const WindowGraph *window = &engine->window;
+	stats->windowEnd = engine->windowEnd;
+	stats->numOfLiveMeetings = window->numOfEdges;
+	stats->numOfAdded = window->numOfAdded;
+	stats->numOfExpired = window->numOfExpired;
+	stats->numOfRefreshes = engine->numOfRefreshes;
+	stats->numOfVisited = window->numOfVisited;
+	stats->numOfChanged = window->numOfChanged;
+	return ENGINE_SUCCESS;
+}
+
+int engineLoadMeetings(SpreaderEngine *engine, const char *path)
+{
+	if (engine->isWindowed)
+	{
+		return loadTimedMeetings(engine, path);
+	}
+	if (engine->stage == STAGE_PROPAGATED) // the first line of the file is seeds
+	{
+		return ENGINE_WRONG_STATE;
+	}
+	if (freezePeople(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	PipelineStats stats;
+	return engineStatusOf(loadTableMeetings(&engine->people, path, NO_PIPELINE, &stats));
+}
+
+int engineQueryRisk(SpreaderEngine *engine, size_t id, EngineResult *result)
+{
+	if (updateRisk(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	size_t row;
+	if (findTableRow(&engine->people, id, &row) != TABLE_SUCCESS)
+	{
+		return ENGINE_UNKNOWN_PERSON;
+	}
+	fillResult(engine, row, result);
+	return ENGINE_SUCCESS;
+}
+
+int engineQueryInfector(SpreaderEngine *engine, size_t id, EngineResult *infector)
+{
+	if (updateRisk(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	size_t row;
+	if (findTableRow(&engine->people, id, &row) != TABLE_SUCCESS)
+	{
+		return ENGINE_UNKNOWN_PERSON;
+	}
+	size_t infectorRow = engine->isWindowed ? strongestWindowInfector(&engine->window, row) :
+	                     strongestInfector(&engine->people.incremental, row);
+	if (infectorRow == NO_INFECTOR || infectorRow == NO_WINDOW_INFECTOR)
+	{
+		return ENGINE_END;
+	}
+	fillResult(engine, infectorRow, infector);
+	return ENGINE_SUCCESS;
+}
+
+int engineCountClasses(SpreaderEngine *engine, size_t *counts)
+{
+	if (updateRisk(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	if (!engine->areCountsValid)
+	{
+		const PeopleTable *people = &engine->people;
+		unsigned char *classes = (unsigned char *) trackedMalloc(people->len ? people->len : 1);
+		if (classes == NULL)
+		{
+			return ENGINE_NO_MEMORY;
+		}
+		classifyPeople(&engine->policy, people->ages, people->probsInfected, people->len, classes);
+		memset(engine->classCounts, 0, sizeof(engine->classCounts));
+		for (size_t row = 0; row < people->len; ++row)
+		{
+			engine->classCounts[classes[row]]++;
+		}
+		trackedFree(classes, people->len ? people->len : 1);
+		engine->areCountsValid = 1;
+	}
+	memcpy(counts, engine->classCounts, sizeof(engine->classCounts));
+	return ENGINE_SUCCESS;
+}
+
+size_t engineNumOfPeople(const SpreaderEngine *engine)
+{
+	return engine->people.len;
+}
+
+int engineResultAt(SpreaderEngine *engine, size_t rank, EngineResult *result)
+{
+	if (updateOrder(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	if (rank >= engine->numOfOrderKeys)
+	{
+		return ENGINE_END;
+	}
+	fillResult(engine, engine->order[rank].row, result);
+	return ENGINE_SUCCESS;
+}
+
+int engineWriteOutput(SpreaderEngine *engine, const char *path)
+{
+	if (updateOrder(engine) != ENGINE_SUCCESS)
+	{
+		return ENGINE_NO_MEMORY;
+	}
+	return engineStatusOf(writePeopleTable(&engine->people, engine->order, engine->numOfOrderKeys,
+	                                       path));
+}
+
+const char *engineStatusMessage(int status)
+{
+	if (status < ENGINE_SUCCESS || status > ENGINE_OUT_OF_ORDER)
+	{
+		return "unknown status";
+	}
+	return statusMessages[status];
+}
+
+void destroyEngine(SpreaderEngine *engine)
+{
+	if (engine == NULL)
+	{
+		return;
+	}
+	unfreezePeople(engine);
+	trackedFree(engine->order, engine->numOfOrderKeys * sizeof(ProbSortKey));
+	freePeopleTable(&engine->people); // the index, the graphs and the columns
+	trackedFree(engine, sizeof(SpreaderEngine));
+}
@@ -0,0 +1,319 @@
+/**
+* @file SpreaderDetectorEngine.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The detector as a library: an engine that is loaded once and then answers many queries
+* @section DESCRIPTION
+* The engine keeps the people, the meetings and the probabilities in memory for as long as it
+* lives. The people are added first (one by one or from a people file), then the seeds and the
+* meetings (one by one or from a meeting file), and then the risk of any person can be asked for,
+* or all the people can be visited in the order of the output file. Meetings may still be added
+* after the first query: they are propagated incrementally (see SpreaderDetectorIncremental.h)
+* before the next query, and the probabilities are exactly the ones of a full run.
+* A windowed engine (createWindowedEngine) is for continuous feeds: every meeting has a timestamp,
+* only the meetings of a sliding time window count and their exposures decay with their age (see
+* SpreaderDetectorWindow.h). Seeds may be added at any time, and after the window slides only the
+* people it changed are computed again.
+* No function of the engine exits or prints: every error is returned as one of the ENGINE_ codes,
+* and the engine stays valid (and can be destroyed) after any error.
+*/
+
+#ifndef EXAM_SPREADERDETECTORENGINE_H
+#define EXAM_SPREADERDETECTORENGINE_H
+
+#include <stddef.h>
+#include "SpreaderDetectorPolicy.h"
+
+/**
+ * @def ENGINE_SUCCESS 0
+ * @brief Returned by the functions of the engine when they succeeded
+ */
+#define ENGINE_SUCCESS 0
+
+/**
+ * @def ENGINE_OPEN_FAILED 1
+ * @brief An input file (or the output file) could not be opened
+ */
+#define ENGINE_OPEN_FAILED 1
+
+/**
+ * @def ENGINE_INVALID_INPUT 2
+ * @brief A line of an input file is not in the format of its file (the lines before it were
+ * added)
+ */
+#define ENGINE_INVALID_INPUT 2
+
+/**
+ * @def ENGINE_UNKNOWN_PERSON 3
+ * @brief There is no person with this ID (a seed, a meeting or a query)
+ */
+#define ENGINE_UNKNOWN_PERSON 3
+
+/**
+ * @def ENGINE_NO_MEMORY 4
+ * @brief An allocation failed
+ */
+#define ENGINE_NO_MEMORY 4
+
+/**
+ * @def ENGINE_WRONG_STATE 5
+ * @brief People can not be added after the first seed, meeting or query, and seeds can not be
+ * added after the first query (except in a windowed engine). Meetings with and without timestamps
+ * are only for windowed engines and for the other engines respectively
+ */
+#define ENGINE_WRONG_STATE 5
+
+/**
+ * @def ENGINE_WRITE_FAILED 6
+ * @brief Writing the output file failed
+ */
+#define ENGINE_WRITE_FAILED 6
+
+/**
+ * @def ENGINE_END 7
+ * @brief Returned by engineResultAt after the last person
+ */
+#define ENGINE_END 7
+
+/**
+ * @def ENGINE_OUT_OF_ORDER 8
+ * @brief A meeting (or a new end of the window) is older than the end of the window of a windowed
+ * engine
+ */
+#define ENGINE_OUT_OF_ORDER 8
+
+/**
+ * @struct SpreaderEngine
+ * @brief The engine. Opaque: it is created by createEngine and released by destroyEngine
+ */
+typedef struct SpreaderEngine SpreaderEngine;
+
+/**
+ * @struct EngineResult
+ * @brief What the engine knows about one person. The name is not '\0' terminated, and it is valid
+ * as long as the engine lives
+ */
+typedef struct EngineResult
+{
+	const char *name;
+	size_t nameLen;
+	size_t id;
+	float age;
+	float probInfected;
+	unsigned int riskClass;
+} EngineResult;
+
+/**
+ * @struct EngineWindowStats
+ * @brief The counters of a windowed engine: the meetings in the window now, and since it was
+ * created the meetings that were added and that left the window, the refreshes (queries after a
+ * change), the people they visited and the people whose probability they changed
+ */
+typedef struct EngineWindowStats
+{
+	size_t windowEnd;
+	size_t numOfLiveMeetings;
+	size_t numOfAdded;
+	size_t numOfExpired;
+	size_t numOfRefreshes;
+	size_t numOfVisited;
+	size_t numOfChanged;
+} EngineWindowStats;
+
+/**
+ * Creates an empty engine
+ * @param engine Will point to the engine
+ * @param combineRule COMBINE_MAX or COMBINE_NOISY_OR (see SpreaderDetectorGraph.h)
+ * @param numOfThreads The maximal number of threads of the full propagation
+ * @return ENGINE_SUCCESS or ENGINE_NO_MEMORY
+ */
+int createEngine(SpreaderEngine **engine, int combineRule, size_t numOfThreads);
+
+/**
+ * Creates an empty windowed engine. Its meetings are added with engineAddTimedMeeting (or from a
+ * meeting file whose lines end with a timestamp)
+ * @param engine Will point to the engine
+ * @param combineRule COMBINE_MAX or COMBINE_NOISY_OR (see SpreaderDetectorGraph.h)
+ * @param windowLength The length of the window, in the unit of the timestamps (positive)
+ * @param halfLife After every full half-life of its age the exposure of a meeting is halved (0 for
+ * no decay)
+ * @return ENGINE_SUCCESS, ENGINE_INVALID_INPUT (an empty window) or ENGINE_NO_MEMORY
+ */
+int createWindowedEngine(SpreaderEngine **engine, int combineRule, size_t windowLength,
+                         size_t halfLife);
+
+/**
+ * Replaces the policy of the classes (the default one is the policy of the command line tool
+ * without a policy file). It only changes the riskClass of the results and the order of the output
+ * file (the classes come first), so it is allowed at any stage
+ * @param engine The engine
+ * @param policy The policy (it is copied)
+ * @return ENGINE_SUCCESS or ENGINE_INVALID_INPUT (no bands)
+ */
+int engineSetPolicy(SpreaderEngine *engine, const RiskPolicy *policy);
+
+/**
+ * Sets the risk model of the meetings (see SpreaderDetectorModel.h), MODEL_CRNA by default
+ * @param engine The engine
+ * @param model The model
+ * @return ENGINE_SUCCESS, ENGINE_INVALID_INPUT (not a model) or ENGINE_WRONG_STATE (after the first
+ * seed, meeting or query)
+ */
+int engineSetRiskModel(SpreaderEngine *engine, int model);
+
+/**
+ * Adds one person
+ * @param engine The engine
+ * @param name The name ('\0' terminated, it is copied)
+ * @param id The ID
+ * @param age The age
+ * @return ENGINE_SUCCESS, ENGINE_WRONG_STATE or ENGINE_NO_MEMORY
+ */
+int engineAddPerson(SpreaderEngine *engine, const char *name, size_t id, float age);
+
+/**
+ * Adds all the people of a people file (in the format of the command line tool)
+ * @param engine The engine
+ * @param path The path of the file
+ * @return ENGINE_SUCCESS, ENGINE_OPEN_FAILED, ENGINE_INVALID_INPUT, ENGINE_WRONG_STATE or
+ * ENGINE_NO_MEMORY
+ */
+int engineLoadPeople(SpreaderEngine *engine, const char *path);
+
+/**
+ * Adds a seed (a person who is sick for sure). A windowed engine takes seeds at any time
+ * @param engine The engine
+ * @param id The ID of the person
+ * @return ENGINE_SUCCESS, ENGINE_UNKNOWN_PERSON, ENGINE_WRONG_STATE or ENGINE_NO_MEMORY
+ */
+int engineAddSeed(SpreaderEngine *engine, size_t id);
+
+/**
+ * Adds a meeting. Its effect is computed by the next query
+ * @param engine The engine
+ * @param infectorId The ID of the infector
+ * @param infectedId The ID of the infected
+ * @param distance The distance between the two people during the meeting
+ * @param time How long did the meeting take
+ * @return ENGINE_SUCCESS, ENGINE_UNKNOWN_PERSON, ENGINE_WRONG_STATE (a windowed engine needs the
+ * timestamps) or ENGINE_NO_MEMORY
+ */
+int engineAddMeeting(SpreaderEngine *engine, size_t infectorId, size_t infectedId, float distance,
+                     float time);
+
+/**
+ * Adds a meeting of a continuous feed to a windowed engine. The meetings come in the order of
+ * their timestamps, and the window slides to the timestamp of every meeting
+ * @param engine The engine
+ * @param infectorId The ID of the infector
+ * @param infectedId The ID of the infected
+ * @param distance The distance between the two people during the meeting
+ * @param time How long did the meeting take
+ * @param timestamp When did the meeting happen
+ * @return ENGINE_SUCCESS, ENGINE_UNKNOWN_PERSON, ENGINE_OUT_OF_ORDER, ENGINE_WRONG_STATE (not a
+ * windowed engine) or ENGINE_NO_MEMORY
+ */
+int engineAddTimedMeeting(SpreaderEngine *engine, size_t infectorId, size_t infectedId,
+                          float distance, float time, size_t timestamp);
+
+/**
+ * Slides the end of the window of a windowed engine to a later time, without a meeting (the
+ * meetings that are too old leave the window, and the others decay)
+ * @param engine The engine
+ * @param now The new end of the window
+ * @return ENGINE_SUCCESS, ENGINE_OUT_OF_ORDER, ENGINE_WRONG_STATE (not a windowed engine) or
+ * ENGINE_NO_MEMORY
+ */
+int engineAdvanceWindow(SpreaderEngine *engine, size_t now);
+
+/**
+ * Returns the counters of a windowed engine
+ * @param engine The engine
+ * @param stats Will contain the counters
+ * @return ENGINE_SUCCESS or ENGINE_WRONG_STATE (not a windowed engine)
+ */
+int engineWindowStats(const SpreaderEngine *engine, EngineWindowStats *stats);
+
+/**
+ * Adds the seeds (the first line) and all the meetings of a meeting file (in the format of the
+ * command line tool; in a windowed engine every meeting line ends with its timestamp)
+ * @param engine The engine
+ * @param path The path of the file
+ * @return ENGINE_SUCCESS, ENGINE_OPEN_FAILED, ENGINE_INVALID_INPUT, ENGINE_UNKNOWN_PERSON,
+ * ENGINE_WRONG_STATE or ENGINE_NO_MEMORY
+ */
+int engineLoadMeetings(SpreaderEngine *engine, const char *path);
+
+/**
+ * Returns what the engine knows about one person (the meetings added so far are propagated first)
+ * @param engine The engine
+ * @param id The ID of the person
+ * @param result Will contain the person
+ * @return ENGINE_SUCCESS, ENGINE_UNKNOWN_PERSON or ENGINE_NO_MEMORY
+ */
+int engineQueryRisk(SpreaderEngine *engine, size_t id, EngineResult *result);
+
+/**
+ * Returns the person who most likely infected a person: the infector of the meeting that gave him
+ * his largest exposure (with COMBINE_MAX, the one his probability came from). Asking again about
+ * the infector walks the path of the infection back to a seed
+ * @param engine The engine
+ * @param id The ID of the person
+ * @param infector Will contain the infector
+ * @return ENGINE_SUCCESS, ENGINE_END (a seed, or nobody exposed the person), ENGINE_UNKNOWN_PERSON
+ * or ENGINE_NO_MEMORY
+ */
+int engineQueryInfector(SpreaderEngine *engine, size_t id, EngineResult *infector);
+
+/**
+ * Counts the people of every class. The counts are kept until the probabilities (or the policy)
+ * are changed, so asking again costs nothing
+ * @param engine The engine
+ * @param counts Will contain the number of people of every class (NUM_OF_CLASSES counts, by the
+ * classes of SpreaderDetectorOrder.h)
+ * @return ENGINE_SUCCESS or ENGINE_NO_MEMORY
+ */
+int engineCountClasses(SpreaderEngine *engine, size_t *counts);
+
+/**
+ * Returns the number of people in the engine
+ * @param engine The engine
+ * @return The number of people
+ */
+size_t engineNumOfPeople(const SpreaderEngine *engine);
+
+/**
+ * Returns a person by his place in the order of the output file (by class, then the largest
+ * probability first, people with the same probability by ID). Visiting rank 0, 1, .. until
+ * ENGINE_END visits everyone in risk order; the order is sorted once and sorted again only after
+ * new meetings or a new policy
+ * @param engine The engine
+ * @param rank The place of the person in the order
+ * @param result Will contain the person
+ * @return ENGINE_SUCCESS, ENGINE_END (rank is not smaller than the number of people) or
+ * ENGINE_NO_MEMORY
+ */
+int engineResultAt(SpreaderEngine *engine, size_t rank, EngineResult *result);
+
+/**
+ * Writes all the people to an output file, exactly as the command line tool does
+ * @param engine The engine
+ * @param path The path of the output file
+ * @return ENGINE_SUCCESS, ENGINE_OPEN_FAILED, ENGINE_WRITE_FAILED or ENGINE_NO_MEMORY
+ */
+int engineWriteOutput(SpreaderEngine *engine, const char *path);
+
+/**
+ * Returns a message that describes an ENGINE_ code
+ * @param status The code
+ * @return The message (a constant string)
+ */
+const char *engineStatusMessage(int status);
+
+/**
+ * Releases the engine and everything in it
+ * @param engine The engine (NULL is ignored)
+ */
+void destroyEngine(SpreaderEngine *engine);
+
+#endif //EXAM_SPREADERDETECTORENGINE_H
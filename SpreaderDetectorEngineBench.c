@@ -0,0 +1,290 @@
+/**
+* @file SpreaderDetectorEngineBench.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Compares a query to an engine that is already loaded with a run of the command line tool
+* @section DESCRIPTION
+* Usage: engine_bench <Path to exam> <Path to People.in> <Path to Meetings.in> [number of queries]
+* [number of runs]
+* The engine (see SpreaderDetectorEngine.h) loads the two files once, and then answers queries on
+* random people; the command line tool has to load and compute everything for every answer. The
+* load, the first query (the full propagation), the average query and a query after a small batch
+* of new meetings are timed, and then the tool is run (fork and exec, in a temporary directory) the
+* given number of times. The output file of the engine is compared to the one of the tool (they
+* must be exactly the same).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "SpreaderDetectorEngine.h"
+#include "SpreaderDetectorGraph.h"
+#include "SpreaderDetectorParams.h"
+#include "SpreaderDetectorStats.h"
+
+/**
+ * @def DEFAULT_NUM_OF_QUERIES 1000000
+ * @brief The number of queries when it is not given
+ */
+#define DEFAULT_NUM_OF_QUERIES 1000000
+
+/**
+ * @def DEFAULT_NUM_OF_RUNS 10
+ * @brief The number of runs of the command line tool when it is not given
+ */
+#define DEFAULT_NUM_OF_RUNS 10
+
+/**
+ * @def NUM_OF_NEW_MEETINGS 16
+ * @brief The number of new meetings added before the incremental query
+ */
+#define NUM_OF_NEW_MEETINGS 16
+
+/**
+ * @def RANDOM_SEED 12345
+ * @brief The seed of the random queries (the same queries in every run)
+ */
+#define RANDOM_SEED 12345
+
+/**
+ * @def WORK_DIR_TEMPLATE "/tmp/engine_benchXXXXXX"
+ * @brief The temporary directory the command line tool runs in (it writes its output file there)
+ */
+#define WORK_DIR_TEMPLATE "/tmp/engine_benchXXXXXX"
+
+/**
+ * @def ENGINE_OUTPUT_NAME "engine.out"
+ * @brief The output file of the engine, in the temporary directory
+ */
+#define ENGINE_OUTPUT_NAME "engine.out"
+
+/**
+ * @def COMPARE_BUFFER_SIZE 65536
+ * @brief The size of the buffers the two output files are compared with
+ */
+#define COMPARE_BUFFER_SIZE 65536
+
+/**
+ * Returns a random index in [0, len)
+ * @param len The number of indexes (positive)
+ * @return The index
+ */
+static size_t randomIndex(size_t len)
+{
+	return (((size_t) rand() << 16) ^ (size_t) rand()) % len;
+}
+
+/**
+ * Runs the command line tool once in the work directory and waits for it
+ * @param exam The path to the tool
+ * @param people The (absolute) path to the people file
+ * @param meetings The (absolute) path to the meeting file
+ * @param workDir The directory the tool runs in
+ * @return 1 if the tool exited with success, 0 otherwise
+ */
+static int runTool(const char *exam, const char *people, const char *meetings, const char *workDir)
+{
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		return 0;
+	}
+	if (pid == 0)
+	{
+		if (chdir(workDir) == 0)
+		{
+			execl(exam, exam, people, meetings, (char *) NULL);
+		}
+		_exit(EXIT_FAILURE);
+	}
+	int status;
+	return waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+	       WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+/**
+ * Compares two files byte by byte
+ * @param firstPath The first file
+ * @param secPath The second file
+ * @return 1 if they are the same, 0 otherwise (or if one of them can not be read)
+ */
+static int isSameFile(const char *firstPath, const char *secPath)
+{
+	FILE *first = fopen(firstPath, "rb");
+	FILE *sec = fopen(secPath, "rb");
+	int isSame = first != NULL && sec != NULL;
+	static char firstBuffer[COMPARE_BUFFER_SIZE];
+	static char secBuffer[COMPARE_BUFFER_SIZE];
+	while (isSame)
+	{
+		size_t firstLen = fread(firstBuffer, 1, sizeof(firstBuffer), first);
+		size_t secLen = fread(secBuffer, 1, sizeof(secBuffer), sec);
+		isSame = firstLen == secLen && memcmp(firstBuffer, secBuffer, firstLen) == 0;
+		if (firstLen == 0)
+		{
+			break;
+		}
+	}
+	if (first != NULL)
+	{
+		fclose(first);
+	}
+	if (sec != NULL)
+	{
+		fclose(sec);
+	}
+	return isSame;
+}
+
+/**
+ * Loads the two files into a new engine
+ * @param people The path to the people file
+ * @param meetings The path to the meeting file
+ * @return The engine, or NULL (the error was printed)
+ */
+static SpreaderEngine *loadEngine(const char *people, const char *meetings)
+{
+	SpreaderEngine *engine;
+	long onlineCores = sysconf(_SC_NPROCESSORS_ONLN);
+	int status = createEngine(&engine, COMBINE_MAX, onlineCores > 0 ? (size_t) onlineCores : 1);
+	if (status != ENGINE_SUCCESS)
+	{
+		fprintf(stderr, "engine: %s\n", engineStatusMessage(status));
+		return NULL;
+	}
+	status = engineLoadPeople(engine, people);
+	if (status == ENGINE_SUCCESS)
+	{
+		status = engineLoadMeetings(engine, meetings);
+	}
+	if (status != ENGINE_SUCCESS)
+	{
+		fprintf(stderr, "engine: %s\n", engineStatusMessage(status));
+		destroyEngine(engine);
+		return NULL;
+	}
+	return engine;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "Usage: engine_bench <Path to exam> <Path to People.in> "
+		                "<Path to Meetings.in> [number of queries] [number of runs]\n");
+		return EXIT_FAILURE;
+	}
+	size_t numOfQueries = argc > 4 ? strtoul(argv[4], NULL, 10) : DEFAULT_NUM_OF_QUERIES;
+	size_t numOfRuns = argc > 5 ? strtoul(argv[5], NULL, 10) : DEFAULT_NUM_OF_RUNS;
+	char *exam = realpath(argv[1], NULL);
+	char *people = realpath(argv[2], NULL);
+	char *meetings = realpath(argv[3], NULL);
+	char workDir[] = WORK_DIR_TEMPLATE;
+	if (exam == NULL || people == NULL || meetings == NULL || mkdtemp(workDir) == NULL)
+	{
+		fprintf(stderr, "engine_bench: the paths can not be used\n");
+		free(exam);
+		free(people);
+		free(meetings);
+		return EXIT_FAILURE;
+	}
+	double begin = currentSeconds();
+	SpreaderEngine *engine = loadEngine(people, meetings);
+	if (engine == NULL)
+	{
+		free(exam);
+		free(people);
+		free(meetings);
+		rmdir(workDir);
+		return EXIT_FAILURE;
+	}
+	double loadSeconds = currentSeconds() - begin;
+	size_t numOfPeople = engineNumOfPeople(engine);
+	size_t *ids = (size_t *) malloc((numOfPeople ? numOfPeople : 1) * sizeof(size_t));
+	EngineResult result;
+	begin = currentSeconds();
+	int status = engineResultAt(engine, 0, &result); // the full propagation
+	double firstSeconds = currentSeconds() - begin;
+	for (size_t rank = 0; ids != NULL && rank < numOfPeople; ++rank)
+	{
+		engineResultAt(engine, rank, &result);
+		ids[rank] = result.id;
+	}
+	int exitStatus = EXIT_SUCCESS;
+	if (ids == NULL || numOfPeople == 0 || (status != ENGINE_SUCCESS && status != ENGINE_END))
+	{
+		fprintf(stderr, "engine: no people to query\n");
+		exitStatus = EXIT_FAILURE;
+	}
+	double querySeconds = 0, updateSeconds = 0;
+	float checksum = 0;
+	int isSame = 0;
+	if (exitStatus == EXIT_SUCCESS)
+	{
+		srand(RANDOM_SEED);
+		begin = currentSeconds();
+		for (size_t i = 0; i < numOfQueries; ++i)
+		{
+			engineQueryRisk(engine, ids[randomIndex(numOfPeople)], &result);
+			checksum += result.probInfected; // so the queries are not optimized away
+		}
+		querySeconds = currentSeconds() - begin;
+		// The output of the tool must be the output of the engine before the new meetings
+		char enginePath[sizeof(workDir) + sizeof(ENGINE_OUTPUT_NAME) + 1];
+		char toolPath[sizeof(workDir) + sizeof(OUTPUT_FILE) + 1];
+		snprintf(enginePath, sizeof(enginePath), "%s/%s", workDir, ENGINE_OUTPUT_NAME);
+		snprintf(toolPath, sizeof(toolPath), "%s/%s", workDir, OUTPUT_FILE);
+		isSame = engineWriteOutput(engine, enginePath) == ENGINE_SUCCESS &&
+		         runTool(exam, people, meetings, workDir) && isSameFile(enginePath, toolPath);
+		remove(enginePath);
+		for (size_t i = 0; i < NUM_OF_NEW_MEETINGS; ++i)
+		{
+			engineAddMeeting(engine, ids[randomIndex(numOfPeople)], ids[randomIndex(numOfPeople)],
+			                 2 * MIN_DISTANCE, MAX_TIME / 2);
+		}
+		begin = currentSeconds();
+		engineQueryRisk(engine, ids[0], &result);
+		updateSeconds = currentSeconds() - begin;
+	}
+	destroyEngine(engine);
+	free(ids);
+	if (exitStatus == EXIT_SUCCESS)
+	{
+		double toolSeconds = 0;
+		size_t numOfFailed = 0;
+		for (size_t run = 0; run < numOfRuns; ++run)
+		{
+			begin = currentSeconds();
+			numOfFailed += !runTool(exam, people, meetings, workDir);
+			toolSeconds += currentSeconds() - begin;
+		}
+		double nanosPerQuery = numOfQueries ? querySeconds * NANOS_IN_SECOND /
+		                                      (double) numOfQueries : 0;
+		double nanosPerRun = numOfRuns ? toolSeconds * NANOS_IN_SECOND / (double) numOfRuns : 0;
+		printf("people: %zu, queries: %zu, runs: %zu (checksum %g)\n", numOfPeople, numOfQueries,
+		       numOfRuns, (double) checksum);
+		printf("engine load          %12.3f ms\n", loadSeconds * 1e3);
+		printf("engine first query   %12.3f ms (full propagation and sort)\n", firstSeconds * 1e3);
+		printf("engine query         %12.1f ns/query\n", nanosPerQuery);
+		printf("engine query after %d new meetings %9.3f ms\n", NUM_OF_NEW_MEETINGS,
+		       updateSeconds * 1e3);
+		printf("tool run             %12.3f ms/query%s\n", nanosPerRun / 1e6,
+		       numOfFailed ? " (FAILED RUNS)" : "");
+		if (nanosPerQuery > 0)
+		{
+			printf("speedup              %12.0fx\n", nanosPerRun / nanosPerQuery);
+		}
+		printf("output %s\n", isSame ? "exact" : "MISMATCH");
+		exitStatus = isSame && numOfFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	char toolPath[sizeof(workDir) + sizeof(OUTPUT_FILE) + 1];
+	snprintf(toolPath, sizeof(toolPath), "%s/%s", workDir, OUTPUT_FILE);
+	remove(toolPath);
+	rmdir(workDir);
+	free(exam);
+	free(people);
+	free(meetings);
+	return exitStatus;
+}
@@ -0,0 +1,864 @@
+/**
+* @file SpreaderDetectorGraph.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the graph of the meetings (CSR and level by level topological order)
+* @section DESCRIPTION
+* Level 0 is the people no meeting infects. Level i + 1 is the people whose last infector is in
+* level i. Every vertex is in exactly one level: when the in-degree of a vertex drops to 0 (an
+* atomic decrement, done by exactly one thread) his probability is computed from all his infectors,
+* which are already final, and he is added to the next level.
+* A large level is split into blocks of FRONTIER_BLOCK_SIZE vertices. Every worker has a range of
+* blocks: the owner takes blocks from its beginning and the other workers steal from its end when
+* their own range is empty. A range is one 64-bit atomic (begin and end), so taking a block is one
+* compare-and-swap. The workers meet at a barrier before and after every level; small levels are
+* run by the calling thread alone, without waking them.
+* When the levels stop before all the vertices are final, the vertices that are left (on cycles or
+* after them) are sorted once by their keys, and from then on every stop makes the next of them
+* that is still left final, and the propagation continues from him.
+* The functions of a level take the combine rule, and are inlined into a wrapper for every rule
+* (see SpreaderDetectorGraph.h). The workers and the calling thread run the wrappers of the rule of
+* the propagation.
+*/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include "SpreaderDetectorGraph.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorModel.h"
+#include "SpreaderDetectorTable.h"
+
+/**
+ * @def ON_CYCLE SIZE_MAX
+ * @brief The in-degree of a vertex on a cycle that was made final (far from every real in-degree,
+ * so the meetings that are still left can not drop it to 0)
+ */
+#define ON_CYCLE SIZE_MAX
+
+/**
+ * @def NO_CYCLE_VERTEX SIZE_MAX
+ * @brief Returned when there is no memory for the order of the vertices that are left
+ */
+#define NO_CYCLE_VERTEX SIZE_MAX
+
+/**
+ * @def FRONTIER_BLOCK_SIZE 256
+ * @brief The number of vertices of the frontier in one block (the unit of work stealing)
+ */
+#define FRONTIER_BLOCK_SIZE 256
+
+/**
+ * @def FRONTIER_BUFFER_SIZE 256
+ * @brief Every worker collects the vertices of the next level in a small buffer, and adds them to
+ * the next frontier together (one atomic add per buffer)
+ */
+#define FRONTIER_BUFFER_SIZE 256
+
+/**
+ * @def MIN_PARALLEL_FRONTIER 4096
+ * @brief A level with fewer vertices is run by the calling thread alone (waking the workers would
+ * cost more than the level)
+ */
+#define MIN_PARALLEL_FRONTIER 4096
+
+/**
+ * @def RANGE_BITS 32
+ * @brief A range of blocks is packed into 64 bits: the beginning in the low 32 bits and the end in
+ * the high 32 bits
+ */
+#define RANGE_BITS 32
+
+/**
+ * @def PACK_RANGE(begin, end)
+ * @brief Packs a range of blocks
+ */
+#define PACK_RANGE(begin, end) ((uint_least64_t) (begin) | ((uint_least64_t) (end) << RANGE_BITS))
+
+/**
+ * @def RANGE_BEGIN(packed)
+ * @brief The first block of a packed range
+ */
+#define RANGE_BEGIN(packed) ((size_t) ((packed) & 0xFFFFFFFFu))
+
+/**
+ * @def RANGE_END(packed)
+ * @brief The end (one after the last block) of a packed range
+ */
+#define RANGE_END(packed) ((size_t) ((packed) >> RANGE_BITS))
+
+/**
+ * @struct Propagation
+ * @brief Everything the workers of one propagation share: the two CSRs of the edges (the second
+ * one only for the people with several infectors), the in-degrees that are left, the
+ * probabilities, the frontier of the current level (and the one of the next level), the ranges of
+ * blocks of the workers and the barriers of the levels. cycleOrder is the vertices that were left
+ * when the levels first stopped, by their keys (NULL until then)
+ */
+typedef struct Propagation
+{
+	size_t numOfNodes;
+	size_t numOfEdges;
+	const size_t *keys;
+	size_t *cycleOrder;
+	size_t cycleOrderLen;
+	size_t *outOffsets;
+	size_t *targets;
+	float *outWeights;
+	size_t *inOffsets;
+	size_t *sources;
+	float *inWeights;
+	atomic_size_t *inDegrees;
+	float *probs;
+	int combineRule;
+	size_t *frontier;
+	size_t frontierLen;
+	size_t *next;
+	atomic_size_t nextLen;
+	atomic_uint_least64_t *ranges;
+	size_t numOfWorkers;
+	pthread_barrier_t levelBegin;
+	pthread_barrier_t levelEnd;
+	pthread_mutex_t gateLock;
+	pthread_cond_t gateOpened;
+	int gateOpen;
+	int finished;
+} Propagation;
+
+/**
+ * @struct PropagationWorker
+ * @brief The argument of a worker thread
+ */
+typedef struct PropagationWorker
+{
+	Propagation *propagation;
+	size_t id;
+} PropagationWorker;
+
+/**
+ * Tells whether a vertex comes before another one in the order of sortNodesByKey
+ * @param first The first vertex
+ * @param sec The second vertex
+ * @param keys The keys (or NULL)
+ * @return 1 if the first vertex comes first, 0 otherwise
+ */
+static int isBeforeByKey(size_t first, size_t sec, const size_t *keys)
+{
+	if (keys != NULL && keys[first] != keys[sec])
+	{
+		return keys[first] < keys[sec];
+	}
+	return first < sec;
+}
+
+/**
+ * Moves a vertex down a max-heap (by the order of sortNodesByKey) to his place
+ * @param nodes The heap
+ * @param len The number of vertices in the heap
+ * @param place The place of the vertex
+ * @param keys The keys (or NULL)
+ */
+static void siftDownByKey(size_t *nodes, size_t len, size_t place, const size_t *keys)
+{
+	size_t node = nodes[place];
+	while (2 * place + 1 < len)
+	{
+		size_t child = 2 * place + 1;
+		if (child + 1 < len && isBeforeByKey(nodes[child], nodes[child + 1], keys))
+		{
+			child++;
+		}
+		if (!isBeforeByKey(node, nodes[child], keys))
+		{
+			break;
+		}
+		nodes[place] = nodes[child];
+		place = child;
+	}
+	nodes[place] = node;
+}
+
+void sortNodesByKey(size_t *nodes, size_t len, const size_t *keys)
+{
+	// a heap sort: in place, so breaking a cycle never needs memory of its own
+	for (size_t place = len / 2; place > 0; --place)
+	{
+		siftDownByKey(nodes, len, place - 1, keys);
+	}
+	for (size_t end = len; end > 1; --end)
+	{
+		size_t largest = nodes[0];
+		nodes[0] = nodes[end - 1];
+		nodes[end - 1] = largest;
+		siftDownByKey(nodes, end - 1, 0, keys);
+	}
+}
+
+int addSeed(ContactGraph *graph, size_t node)
+{
+	if (ensureArrayCapacity((void **) &graph->seeds, &graph->seedsCapacity, graph->numOfSeeds,
+	                        sizeof(size_t)) == GROW_FAILED)
+	{
+		return GRAPH_FAILED;
+	}
+	graph->seeds[graph->numOfSeeds++] = node;
+	return GRAPH_SUCCESS;
+}
+
+/**
+ * Makes sure that the arrays of the edges have room for more edges. If they are full their
+ * capacity is multiplied by GROWTH_FACTOR (until there is room)
+ * @param graph The graph
+ * @param numOfNewEdges The number of edges that will be added
+ * @return GRAPH_SUCCESS or GRAPH_FAILED
+ */
+static int reserveEdges(ContactGraph *graph, size_t numOfNewEdges)
+{
+	if (graph->numOfEdges + numOfNewEdges > graph->edgesCapacity)
+	{
+		size_t capacity = graph->edgesCapacity;
+		size_t newCapacity = capacity ? capacity * GROWTH_FACTOR : INIT_CAPACITY;
+		while (newCapacity < graph->numOfEdges + numOfNewEdges)
+		{
+			newCapacity *= GROWTH_FACTOR;
+		}
+		if (resizeArray((void **) &graph->infectors, capacity, newCapacity, sizeof(size_t)) ==
+		    GROW_FAILED ||
+			resizeArray((void **) &graph->infecteds, capacity, newCapacity, sizeof(size_t)) ==
+			GROW_FAILED ||
+			resizeArray((void **) &graph->crnas, capacity, newCapacity, sizeof(float)) == GROW_FAILED)
+		{
+			return GRAPH_FAILED; // the arrays that did grow are released with the graph
+		}
+		graph->edgesCapacity = newCapacity;
+	}
+	return GRAPH_SUCCESS;
+}
+
+int addContact(ContactGraph *graph, size_t infector, size_t infected, float crna)
+{
+	if (reserveEdges(graph, 1) == GRAPH_FAILED)
+	{
+		return GRAPH_FAILED;
+	}
+	graph->infectors[graph->numOfEdges] = infector;
+	graph->infecteds[graph->numOfEdges] = infected;
+	graph->crnas[graph->numOfEdges] = crna;
+	graph->numOfEdges++;
+	return GRAPH_SUCCESS;
+}
+
+int addContactBatch(ContactGraph *graph, MeetingBatch *batch)
+{
+	if (batch->len == 0)
+	{
+		return GRAPH_SUCCESS;
+	}
+	if (reserveEdges(graph, batch->len) == GRAPH_FAILED)
+	{
+		return GRAPH_FAILED;
+	}
+	size_t first = graph->numOfEdges;
+	memcpy(graph->infectors + first, batch->infectors, batch->len * sizeof(size_t));
+	memcpy(graph->infecteds + first, batch->infecteds, batch->len * sizeof(size_t));
+	// the crnas are written straight into the edges of the batch
+	computeRisks(graph->riskModel, batch->distances, batch->times, graph->crnas + first,
+	             batch->len);
+	graph->numOfEdges += batch->len;
+	batch->len = 0;
+	return GRAPH_SUCCESS;
+}
+
+/**
+ * Takes the next block of a range of blocks: the owner takes from the beginning
+ * @param range The range
+ * @param block Will contain the block
+ * @return 1 if a block was taken, 0 if the range is empty
+ */
+static int popBlock(atomic_uint_least64_t *range, size_t *block)
+{
+	uint_least64_t packed = atomic_load(range);
+	while (RANGE_BEGIN(packed) < RANGE_END(packed))
+	{
+		if (atomic_compare_exchange_weak(range, &packed, packed + 1)) // begin + 1
+		{
+			*block = RANGE_BEGIN(packed);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Steals a block of a range of blocks: a thief takes from the end
+ * @param range The range (of another worker)
+ * @param block Will contain the block
+ * @return 1 if a block was taken, 0 if the range is empty
+ */
+static int stealBlock(atomic_uint_least64_t *range, size_t *block)
+{
+	uint_least64_t packed = atomic_load(range);
+	while (RANGE_BEGIN(packed) < RANGE_END(packed))
+	{
+		if (atomic_compare_exchange_weak(range, &packed, packed - ((uint_least64_t) 1 << RANGE_BITS)))
+		{
+			*block = RANGE_END(packed) - 1;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Adds the vertices in a buffer of a worker to the next frontier (one atomic add for all of them)
+ * @param propagation The propagation
+ * @param buffer The vertices
+ * @param len The number of vertices
+ */
+static void flushToNextFrontier(Propagation *propagation, const size_t *buffer, size_t len)
+{
+	size_t place = atomic_fetch_add(&propagation->nextLen, len);
+	memcpy(propagation->next + place, buffer, len * sizeof(size_t));
+}
+
+/**
+ * Tells whether a vertex is final: his in-degree dropped to 0, or he was made final on a cycle
+ * @param propagation The propagation
+ * @param node The vertex
+ * @return 1 if he is final, 0 otherwise
+ */
+static int isFinal(Propagation *propagation, size_t node)
+{
+	size_t inDegree = atomic_load(&propagation->inDegrees[node]);
+	return inDegree == 0 || inDegree > propagation->numOfEdges;
+}
+
+/**
+ * Computes the final probability of a person with several infectors, when they are all final: his
+ * own probability (1 for a seed, NOT_EXPOSED otherwise) combined with the exposure of every
+ * meeting that infects him, in the order the meetings were read
+ * @param propagation The propagation
+ * @param node The vertex of the person
+ * @param combineRule The combine rule (a constant of the caller)
+ */
+static ALWAYS_INLINE void pullExposures(Propagation *propagation, size_t node, int combineRule)
+{
+	float prob = propagation->probs[node];
+	for (size_t e = propagation->inOffsets[node]; e < propagation->inOffsets[node + 1]; ++e)
+	{
+		prob = combineExposure(combineRule, prob, propagation->probs[propagation->sources[e]] *
+		                                          propagation->inWeights[e]);
+	}
+	propagation->probs[node] = prob;
+}
+
+/**
+ * Makes an infected final, after the last meeting that infects him was done. If this is his only
+ * infector the exposure is taken from this meeting, otherwise it is pulled from all of them
+ * @param propagation The propagation
+ * @param infector The vertex of the infector of the meeting
+ * @param edge The place of the meeting in the CSR of the infectors
+ * @param combineRule The combine rule (a constant of the caller)
+ */
+static ALWAYS_INLINE void makeFinal(Propagation *propagation, size_t infector, size_t edge,
+                                    int combineRule)
+{
+	size_t node = propagation->targets[edge];
+	if (propagation->inOffsets[node] == propagation->inOffsets[node + 1]) // one infector
+	{
+		propagation->probs[node] = combineExposure(combineRule, propagation->probs[node],
+		                                           propagation->probs[infector] *
+		                                           propagation->outWeights[edge]);
+	}
+	else
+	{
+		pullExposures(propagation, node, combineRule);
+	}
+}
+
+/**
+ * One worker's part of a level: takes blocks of the frontier (its own, then stolen ones) until all
+ * the ranges are empty. For every vertex of the frontier, every meeting he is the infector in is
+ * done: the last one to be done for an infected makes the infected final, and he is in the next
+ * frontier
+ * @param propagation The propagation
+ * @param worker The worker
+ * @param combineRule The combine rule (a constant of the caller)
+ */
+static ALWAYS_INLINE void runLevel(Propagation *propagation, size_t worker, int combineRule)
+{
+	size_t buffer[FRONTIER_BUFFER_SIZE];
+	size_t bufferLen = 0;
+	size_t block;
+	while (1)
+	{
+		if (!popBlock(&propagation->ranges[worker], &block))
+		{
+			int stole = 0;
+			for (size_t i = 1; i < propagation->numOfWorkers && !stole; ++i)
+			{
+				size_t victim = (worker + i) % propagation->numOfWorkers;
+				stole = stealBlock(&propagation->ranges[victim], &block);
+			}
+			if (!stole) // all the ranges are empty, and no block is added during a level
+			{
+				break;
+			}
+		}
+		size_t begin = block * FRONTIER_BLOCK_SIZE;
+		size_t end = begin + FRONTIER_BLOCK_SIZE < propagation->frontierLen ?
+		             begin + FRONTIER_BLOCK_SIZE : propagation->frontierLen;
+		for (size_t i = begin; i < end; ++i)
+		{
+			size_t node = propagation->frontier[i];
+			for (size_t e = propagation->outOffsets[node];
+			     e < propagation->outOffsets[node + 1]; ++e)
+			{
+				size_t target = propagation->targets[e];
+				if (atomic_fetch_sub_explicit(&propagation->inDegrees[target], 1,
+				                              memory_order_relaxed) == 1) // the last one
+				{
+					makeFinal(propagation, node, e, combineRule);
+					buffer[bufferLen++] = target;
+					if (bufferLen == FRONTIER_BUFFER_SIZE)
+					{
+						flushToNextFrontier(propagation, buffer, bufferLen);
+						bufferLen = 0;
+					}
+				}
+			}
+		}
+	}
+	flushToNextFrontier(propagation, buffer, bufferLen);
+}
+
+/**
+ * A level that is run by the calling thread alone: the same as runLevel, without the ranges and
+ * without atomic read-modify-write (no other thread runs)
+ * @param propagation The propagation
+ * @param combineRule The combine rule (a constant of the caller)
+ */
+static ALWAYS_INLINE void runLevelAlone(Propagation *propagation, int combineRule)
+{
+	size_t nextLen = 0;
+	for (size_t i = 0; i < propagation->frontierLen; ++i)
+	{
+		size_t node = propagation->frontier[i];
+		for (size_t e = propagation->outOffsets[node]; e < propagation->outOffsets[node + 1]; ++e)
+		{
+			size_t target = propagation->targets[e];
+			size_t inDegree = atomic_load_explicit(&propagation->inDegrees[target],
+			                                       memory_order_relaxed) - 1;
+			atomic_store_explicit(&propagation->inDegrees[target], inDegree, memory_order_relaxed);
+			if (inDegree == 0) // the last one
+			{
+				makeFinal(propagation, node, e, combineRule);
+				propagation->next[nextLen++] = target;
+			}
+		}
+	}
+	atomic_store(&propagation->nextLen, nextLen);
+}
+
+/**
+ * Makes a vertex on a cycle final, with the exposures of his infectors that are already final (not
+ * himself, for a meeting of a person with himself)
+ * @param propagation The propagation
+ * @param node The vertex
+ * @param combineRule The combine rule (a constant of the caller)
+ */
+static ALWAYS_INLINE void breakCycle(Propagation *propagation, size_t node, int combineRule)
+{
+	float prob = propagation->probs[node];
+	for (size_t e = propagation->inOffsets[node]; e < propagation->inOffsets[node + 1]; ++e)
+	{
+		if (propagation->sources[e] != node && isFinal(propagation, propagation->sources[e]))
+		{
+			prob = combineExposure(combineRule, prob, propagation->probs[propagation->sources[e]] *
+			                                          propagation->inWeights[e]);
+		}
+	}
+	propagation->probs[node] = prob;
+	atomic_store(&propagation->inDegrees[node], ON_CYCLE);
+}
+
+/**
+ * runLevel with COMBINE_MAX
+ * @param propagation The propagation
+ * @param worker The worker
+ */
+static void runLevelMax(Propagation *propagation, size_t worker)
+{
+	runLevel(propagation, worker, COMBINE_MAX);
+}
+
+/**
+ * runLevelAlone with COMBINE_MAX
+ * @param propagation The propagation
+ */
+static void runLevelAloneMax(Propagation *propagation)
+{
+	runLevelAlone(propagation, COMBINE_MAX);
+}
+
+/**
+ * breakCycle with COMBINE_MAX
+ * @param propagation The propagation
+ * @param node The vertex
+ */
+static void breakCycleMax(Propagation *propagation, size_t node)
+{
+	breakCycle(propagation, node, COMBINE_MAX);
+}
+
+/**
+ * runLevel with COMBINE_NOISY_OR
+ * @param propagation The propagation
+ * @param worker The worker
+ */
+static void runLevelNoisyOr(Propagation *propagation, size_t worker)
+{
+	runLevel(propagation, worker, COMBINE_NOISY_OR);
+}
+
+/**
+ * runLevelAlone with COMBINE_NOISY_OR
+ * @param propagation The propagation
+ */
+static void runLevelAloneNoisyOr(Propagation *propagation)
+{
+	runLevelAlone(propagation, COMBINE_NOISY_OR);
+}
+
+/**
+ * breakCycle with COMBINE_NOISY_OR
+ * @param propagation The propagation
+ * @param node The vertex
+ */
+static void breakCycleNoisyOr(Propagation *propagation, size_t node)
+{
+	breakCycle(propagation, node, COMBINE_NOISY_OR);
+}
+
+/**
+ * @struct LevelRunners
+ * @brief The loops of the propagation of one combine rule (its wrappers)
+ */
+typedef struct LevelRunners
+{
+	void (*runLevel)(Propagation *propagation, size_t worker);
+	void (*runLevelAlone)(Propagation *propagation);
+	void (*breakCycle)(Propagation *propagation, size_t node);
+} LevelRunners;
+
+/**
+ * The loops of the propagation (by combine rule)
+ */
+static const LevelRunners levelRunners[NUM_OF_COMBINE_RULES] = {
+		{runLevelMax,     runLevelAloneMax,     breakCycleMax},
+		{runLevelNoisyOr, runLevelAloneNoisyOr, breakCycleNoisyOr}};
+
+/**
+ * Finds the vertex that is made final when the levels stopped: the one with the smallest key of
+ * the vertices that are left. The first time, the vertices that are left are sorted by their keys
+ * (no vertex is left again after he was made final, so they are sorted only once)
+ * @param propagation The propagation
+ * @param nextOnCycle pointer to the place in cycleOrder of the last vertex that was found
+ * @return The vertex, or NO_CYCLE_VERTEX (no memory)
+ */
+static size_t nextCycleVertex(Propagation *propagation, size_t *nextOnCycle)
+{
+	if (propagation->cycleOrder == NULL)
+	{
+		size_t numOfLeft = 0;
+		for (size_t node = 0; node < propagation->numOfNodes; ++node)
+		{
+			numOfLeft += !isFinal(propagation, node);
+		}
+		propagation->cycleOrder = (size_t *) trackedMalloc(numOfLeft * sizeof(size_t));
+		if (propagation->cycleOrder == NULL)
+		{
+			return NO_CYCLE_VERTEX;
+		}
+		propagation->cycleOrderLen = numOfLeft;
+		numOfLeft = 0;
+		for (size_t node = 0; node < propagation->numOfNodes; ++node)
+		{
+			if (!isFinal(propagation, node))
+			{
+				propagation->cycleOrder[numOfLeft++] = node;
+			}
+		}
+		sortNodesByKey(propagation->cycleOrder, numOfLeft, propagation->keys);
+	}
+	while (isFinal(propagation, propagation->cycleOrder[*nextOnCycle]))
+	{
+		(*nextOnCycle)++;
+	}
+	return propagation->cycleOrder[*nextOnCycle];
+}
+
+/**
+ * Splits the blocks of the frontier evenly between the ranges of the workers
+ * @param propagation The propagation
+ * @param numOfWorkers The number of workers that take part in the level
+ */
+static void splitFrontier(Propagation *propagation, size_t numOfWorkers)
+{
+	size_t numOfBlocks = (propagation->frontierLen + FRONTIER_BLOCK_SIZE - 1) / FRONTIER_BLOCK_SIZE;
+	for (size_t worker = 0; worker < propagation->numOfWorkers; ++worker)
+	{
+		size_t begin = worker < numOfWorkers ? numOfBlocks * worker / numOfWorkers : 0;
+		size_t end = worker < numOfWorkers ? numOfBlocks * (worker + 1) / numOfWorkers : 0;
+		atomic_store(&propagation->ranges[worker], PACK_RANGE(begin, end));
+	}
+}
+
+/**
+ * The function of a worker thread: waits for a level, does its part, and waits for the others
+ * @param arg pointer to "PropagationWorker"
+ * @return NULL
+ */
+static void *propagationWorker(void *arg)
+{
+	PropagationWorker *worker = (PropagationWorker *) arg;
+	Propagation *propagation = worker->propagation;
+	pthread_mutex_lock(&propagation->gateLock); // wait until all the workers were created
+	while (!propagation->gateOpen)
+	{
+		pthread_cond_wait(&propagation->gateOpened, &propagation->gateLock);
+	}
+	pthread_mutex_unlock(&propagation->gateLock);
+	while (1)
+	{
+		pthread_barrier_wait(&propagation->levelBegin);
+		if (propagation->finished)
+		{
+			return NULL;
+		}
+		levelRunners[propagation->combineRule].runLevel(propagation, worker->id);
+		pthread_barrier_wait(&propagation->levelEnd);
+	}
+}
+
+/**
+ * Builds the CSR of the edges by the infector (targets and their weights), and the CSR of the
+ * edges by the infected (sources and their weights) only for the people with more than one
+ * infector (one infector is taken straight from the meeting). The edges of every vertex keep the
+ * order they were read in
+ * @param graph The graph
+ * @param propagation The propagation (its arrays are allocated)
+ */
+static void buildCsr(const ContactGraph *graph, Propagation *propagation)
+{
+	size_t numOfNodes = propagation->numOfNodes;
+	size_t *outOffsets = propagation->outOffsets;
+	size_t *inOffsets = propagation->inOffsets;
+	for (size_t e = 0; e < graph->numOfEdges; ++e)
+	{
+		outOffsets[graph->infectors[e] + 1]++;
+		inOffsets[graph->infecteds[e] + 1]++;
+	}
+	for (size_t node = 0; node < numOfNodes; ++node)
+	{
+		size_t inDegree = inOffsets[node + 1];
+		atomic_init(&propagation->inDegrees[node], inDegree);
+		outOffsets[node + 1] += outOffsets[node];
+		inOffsets[node + 1] = inOffsets[node] + (inDegree > 1 ? inDegree : 0);
+	}
+	for (size_t e = 0; e < graph->numOfEdges; ++e)
+	{
+		size_t infected = graph->infecteds[e];
+		size_t outPlace = outOffsets[graph->infectors[e]]++; // moves to the next place
+		propagation->targets[outPlace] = infected;
+		propagation->outWeights[outPlace] = graph->crnas[e];
+		if (atomic_load_explicit(&propagation->inDegrees[infected], memory_order_relaxed) > 1)
+		{
+			size_t inPlace = inOffsets[infected]++;
+			propagation->sources[inPlace] = graph->infectors[e];
+			propagation->inWeights[inPlace] = graph->crnas[e];
+		}
+	}
+	for (size_t node = numOfNodes; node > 0; --node) // back to the first place of every vertex
+	{
+		outOffsets[node] = outOffsets[node - 1];
+		inOffsets[node] = inOffsets[node - 1];
+	}
+	outOffsets[0] = 0;
+	inOffsets[0] = 0;
+}
+
+/**
+ * Propagates level by level. The calling thread is worker 0: it prepares every level, runs small
+ * levels alone, and runs large levels together with the other workers
+ * @param propagation The propagation (the CSR is built, and the workers wait at the gate)
+ * @return GRAPH_SUCCESS or GRAPH_FAILED (no memory for the order of the cycles)
+ */
+static int runLevels(Propagation *propagation)
+{
+	const LevelRunners *runners = &levelRunners[propagation->combineRule];
+	size_t numOfNodes = propagation->numOfNodes;
+	size_t numOfDone = 0;
+	size_t nextOnCycle = 0;
+	propagation->frontierLen = 0;
+	for (size_t node = 0; node < numOfNodes; ++node)
+	{
+		if (atomic_load(&propagation->inDegrees[node]) == 0) // no meeting infects him
+		{
+			propagation->frontier[propagation->frontierLen++] = node;
+		}
+	}
+	while (1)
+	{
+		numOfDone += propagation->frontierLen;
+		if (propagation->frontierLen == 0)
+		{
+			if (numOfDone == numOfNodes)
+			{
+				break;
+			}
+			// only cycles are left: the vertex with the smallest key that is left is final with what
+			// he has now
+			size_t node = nextCycleVertex(propagation, &nextOnCycle);
+			if (node == NO_CYCLE_VERTEX)
+			{
+				return GRAPH_FAILED;
+			}
+			runners->breakCycle(propagation, node);
+			propagation->frontier[propagation->frontierLen++] = node;
+			numOfDone++;
+		}
+		if (propagation->numOfWorkers > 1 && propagation->frontierLen >= MIN_PARALLEL_FRONTIER)
+		{
+			atomic_store(&propagation->nextLen, 0);
+			splitFrontier(propagation, propagation->numOfWorkers);
+			pthread_barrier_wait(&propagation->levelBegin);
+			runners->runLevel(propagation, 0);
+			pthread_barrier_wait(&propagation->levelEnd);
+		}
+		else
+		{
+			runners->runLevelAlone(propagation);
+		}
+		size_t *done = propagation->frontier;
+		propagation->frontier = propagation->next;
+		propagation->next = done;
+		propagation->frontierLen = atomic_load(&propagation->nextLen);
+	}
+	return GRAPH_SUCCESS;
+}
+
+int propagateRisk(const ContactGraph *graph, size_t numOfNodes, const size_t *keys,
+                  int combineRule, size_t numOfThreads, float *probs)
+{
+	Propagation propagation = {0};
+	propagation.numOfNodes = numOfNodes;
+	propagation.numOfEdges = graph->numOfEdges;
+	propagation.keys = keys;
+	propagation.probs = probs;
+	propagation.combineRule = combineRule;
+	size_t numOfEdges = graph->numOfEdges;
+	numOfThreads = numOfThreads > 0 ? numOfThreads : 1;
+	propagation.outOffsets = (size_t *) trackedCalloc(numOfNodes + 1, sizeof(size_t));
+	propagation.inOffsets = (size_t *) trackedCalloc(numOfNodes + 1, sizeof(size_t));
+	propagation.targets = (size_t *) trackedMalloc(numOfEdges * sizeof(size_t));
+	propagation.outWeights = (float *) trackedMalloc(numOfEdges * sizeof(float));
+	propagation.sources = (size_t *) trackedMalloc(numOfEdges * sizeof(size_t));
+	propagation.inWeights = (float *) trackedMalloc(numOfEdges * sizeof(float));
+	propagation.inDegrees = (atomic_size_t *) trackedMalloc(numOfNodes * sizeof(atomic_size_t));
+	propagation.frontier = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	propagation.next = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	propagation.ranges = (atomic_uint_least64_t *) trackedMalloc(
+			numOfThreads * sizeof(atomic_uint_least64_t));
+	PropagationWorker *workers = (PropagationWorker *) trackedCalloc(numOfThreads,
+	                                                                 sizeof(PropagationWorker));
+	pthread_t *threads = (pthread_t *) trackedCalloc(numOfThreads, sizeof(pthread_t));
+	int status = GRAPH_SUCCESS;
+	if (propagation.outOffsets == NULL || propagation.inOffsets == NULL ||
+		(numOfEdges > 0 && (propagation.targets == NULL || propagation.outWeights == NULL ||
+		                    propagation.sources == NULL || propagation.inWeights == NULL)) ||
+		propagation.inDegrees == NULL ||
+		propagation.frontier == NULL || propagation.next == NULL || propagation.ranges == NULL ||
+		workers == NULL || threads == NULL)
+	{
+		status = GRAPH_FAILED;
+	}
+	else
+	{
+		buildCsr(graph, &propagation);
+		for (size_t node = 0; node < numOfNodes; ++node)
+		{
+			probs[node] = NOT_EXPOSED;
+		}
+		for (size_t i = 0; i < graph->numOfSeeds; ++i)
+		{
+			probs[graph->seeds[i]] = SURE_INFECTED; //he sick for sure!!
+		}
+		// The workers wait at the gate until we know how many of them were created
+		pthread_mutex_init(&propagation.gateLock, NULL);
+		pthread_cond_init(&propagation.gateOpened, NULL);
+		size_t numOfWorkers = 1; // this thread
+		for (size_t i = 1; i < numOfThreads; ++i)
+		{
+			workers[numOfWorkers].propagation = &propagation;
+			workers[numOfWorkers].id = numOfWorkers;
+			if (pthread_create(&threads[numOfWorkers], NULL, propagationWorker,
+			                   &workers[numOfWorkers]) == 0)
+			{
+				numOfWorkers++;
+			}
+		}
+		propagation.numOfWorkers = numOfWorkers;
+		pthread_barrier_init(&propagation.levelBegin, NULL, (unsigned int) numOfWorkers);
+		pthread_barrier_init(&propagation.levelEnd, NULL, (unsigned int) numOfWorkers);
+		pthread_mutex_lock(&propagation.gateLock);
+		propagation.gateOpen = 1;
+		pthread_cond_broadcast(&propagation.gateOpened);
+		pthread_mutex_unlock(&propagation.gateLock);
+		status = runLevels(&propagation);
+		propagation.finished = 1;
+		if (numOfWorkers > 1)
+		{
+			pthread_barrier_wait(&propagation.levelBegin); // the workers see finished and return
+		}
+		for (size_t i = 1; i < numOfWorkers; ++i)
+		{
+			pthread_join(threads[i], NULL);
+		}
+		pthread_barrier_destroy(&propagation.levelBegin);
+		pthread_barrier_destroy(&propagation.levelEnd);
+		pthread_cond_destroy(&propagation.gateOpened);
+		pthread_mutex_destroy(&propagation.gateLock);
+	}
+	trackedFree(propagation.outOffsets, (numOfNodes + 1) * sizeof(size_t));
+	trackedFree(propagation.inOffsets, (numOfNodes + 1) * sizeof(size_t));
+	trackedFree(propagation.targets, numOfEdges * sizeof(size_t));
+	trackedFree(propagation.outWeights, numOfEdges * sizeof(float));
+	trackedFree(propagation.sources, numOfEdges * sizeof(size_t));
+	trackedFree(propagation.inWeights, numOfEdges * sizeof(float));
+	trackedFree(propagation.inDegrees, numOfNodes * sizeof(atomic_size_t));
+	trackedFree(propagation.frontier, numOfNodes * sizeof(size_t));
+	trackedFree(propagation.next, numOfNodes * sizeof(size_t));
+	trackedFree(propagation.ranges, numOfThreads * sizeof(atomic_uint_least64_t));
+	trackedFree(propagation.cycleOrder, propagation.cycleOrderLen * sizeof(size_t));
+	trackedFree(workers, numOfThreads * sizeof(PropagationWorker));
+	trackedFree(threads, numOfThreads * sizeof(pthread_t));
+	return status;
+}
+
+void freeContactGraph(ContactGraph *graph)
+{
+	trackedFree(graph->infectors, graph->edgesCapacity * sizeof(size_t));
+	trackedFree(graph->infecteds, graph->edgesCapacity * sizeof(size_t));
+	trackedFree(graph->crnas, graph->edgesCapacity * sizeof(float));
+	trackedFree(graph->seeds, graph->seedsCapacity * sizeof(size_t));
+	graph->infectors = NULL;
+	graph->infecteds = NULL;
+	graph->crnas = NULL;
+	graph->seeds = NULL;
+	graph->numOfEdges = 0;
+	graph->edgesCapacity = 0;
+	graph->numOfSeeds = 0;
+	graph->seedsCapacity = 0;
+}
@@ -0,0 +1,227 @@
+/**
+* @file SpreaderDetectorGraph.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The graph of the meetings, and the propagation of the risk over it
+* @section DESCRIPTION
+* The people are the vertices (numbered 0 .. numOfNodes - 1 by the caller) and every meeting is an
+* edge from the infector to the infected, whose weight is the crna of the meeting. The infectors of
+* the first line of the meeting file (there may be several) are the seeds, with probability 1.
+* The meetings may come in any order: after all of them were read, the edges are arranged in CSR
+* form (the edges of every vertex are contiguous) and the probabilities are propagated in
+* topological order, level by level, so the probability of a person is computed only when all his
+* infectors are final. A person who was exposed in several meetings gets the combination of all of
+* them (see COMBINE_MAX and COMBINE_NOISY_OR), always in the order the meetings were read, so the
+* result does not depend on the number of threads. The propagation is O(people + meetings), and
+* the vertices of a large level are divided between the threads (work stealing).
+* If only cycles are left (which should not happen), the person with the smallest key (his ID) of
+* all the people that are left is made final with the exposures of his infectors that are already
+* final, and the propagation continues from him. The key does not depend on how the vertices were
+* numbered, so every mode of the detector (which numbers them in its own order) breaks the cycles
+* at the same people.
+* The combine rule is the only formula the propagation evaluates for every meeting (the risk of a
+* meeting is computed once, by the model, when it is added, see SpreaderDetectorModel.h). Every
+* rule is a static inline function here. Every propagation (the levels here, the ranks of
+* SpreaderDetectorRankOrder.h and the shards of SpreaderDetectorShard.h) writes its loops once, as
+* ALWAYS_INLINE functions that take the rule, and has a thin wrapper for every rule that calls them
+* with the rule as a constant, so the compiler makes a copy of the loops for every rule with the
+* rule inlined. The wrapper is chosen once per propagation, so the loops over the meetings have no
+* branch and no call for the rule.
+*/
+
+#ifndef EXAM_SPREADERDETECTORGRAPH_H
+#define EXAM_SPREADERDETECTORGRAPH_H
+
+#include <stddef.h>
+#include "SpreaderDetectorCrna.h"
+
+/**
+ * @def GRAPH_SUCCESS 1
+ * @brief Returned by the functions of the graph when they succeeded
+ */
+#define GRAPH_SUCCESS 1
+
+/**
+ * @def GRAPH_FAILED 0
+ * @brief Returned by the functions of the graph when an allocation failed
+ */
+#define GRAPH_FAILED 0
+
+/**
+ * @def COMBINE_MAX 0
+ * @brief A person exposed in several meetings gets the largest of their probabilities
+ */
+#define COMBINE_MAX 0
+
+/**
+ * @def COMBINE_NOISY_OR 1
+ * @brief A person exposed in several meetings (with probabilities p1 .. pk) gets the probability
+ * that at least one of them infected him, if they are independent: 1 - (1 - p1) * .. * (1 - pk).
+ * The crna of a meeting is above 1 when the distance is below MIN_DISTANCE or the time is above
+ * MAX_TIME, so every exposure is clamped to [NOT_EXPOSED, SURE_INFECTED] before it is combined
+ * (otherwise 1 - p would be negative, and another meeting could lower the probability). A person
+ * exposed in one meeting still gets its exposure as is, exactly like with COMBINE_MAX
+ */
+#define COMBINE_NOISY_OR 1
+
+/**
+ * @def NUM_OF_COMBINE_RULES 2
+ * @brief The number of combine rules (the instances of every propagation, by rule)
+ */
+#define NUM_OF_COMBINE_RULES 2
+
+/**
+ * @def ALWAYS_INLINE
+ * @brief A function that is inlined in every call, even a long one (the loops of a propagation,
+ * which are specialized by the constant combine rule of their caller)
+ */
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+/**
+ * @def NOT_EXPOSED 0.0f
+ * @brief The probability of a person before any meeting reached him (INIT_PROB)
+ */
+#define NOT_EXPOSED 0.0f
+
+/**
+ * @def SURE_INFECTED 1.0f
+ * @brief The probability of a seed
+ */
+#define SURE_INFECTED 1.0f
+
+/**
+ * Combines a new exposure of a person with what he had so far by COMBINE_MAX
+ * @param probSoFar The probability of the person so far (NOT_EXPOSED if this is his first)
+ * @param exposure The probability of the new exposure
+ * @return The new probability of the person
+ */
+static inline float combineMaxExposure(float probSoFar, float exposure)
+{
+	if (probSoFar == NOT_EXPOSED) // the first exposure is taken as is (exactly like one meeting)
+	{
+		return exposure;
+	}
+	return exposure > probSoFar ? exposure : probSoFar;
+}
+
+/**
+ * Clamps an exposure to a probability (see COMBINE_NOISY_OR)
+ * @param exposure The exposure
+ * @return The exposure, if it is in [NOT_EXPOSED, SURE_INFECTED], otherwise the nearest of them
+ */
+static inline float clampExposure(float exposure)
+{
+	if (exposure < NOT_EXPOSED)
+	{
+		return NOT_EXPOSED;
+	}
+	return exposure > SURE_INFECTED ? SURE_INFECTED : exposure;
+}
+
+/**
+ * Combines a new exposure of a person with what he had so far by COMBINE_NOISY_OR
+ * @param probSoFar The probability of the person so far (NOT_EXPOSED if this is his first)
+ * @param exposure The probability of the new exposure
+ * @return The new probability of the person
+ */
+static inline float combineNoisyOrExposure(float probSoFar, float exposure)
+{
+	if (probSoFar == NOT_EXPOSED) // the first exposure is taken as is (exactly like one meeting)
+	{
+		return exposure;
+	}
+	return SURE_INFECTED - (SURE_INFECTED - clampExposure(probSoFar)) *
+	                       (SURE_INFECTED - clampExposure(exposure));
+}
+
+/**
+ * Combines a new exposure of a person with what he had so far by a combine rule. The loops of the
+ * propagations call it with a constant rule, so only the formula of the rule is left
+ * @param combineRule COMBINE_MAX or COMBINE_NOISY_OR
+ * @param probSoFar The probability of the person so far (NOT_EXPOSED if this is his first)
+ * @param exposure The probability of the new exposure
+ * @return The new probability of the person
+ */
+static ALWAYS_INLINE float combineExposure(int combineRule, float probSoFar, float exposure)
+{
+	return combineRule == COMBINE_NOISY_OR ? combineNoisyOrExposure(probSoFar, exposure) :
+	       combineMaxExposure(probSoFar, exposure);
+}
+
+/**
+ * @struct ContactGraph
+ * @brief The meetings and the seeds as they were read (the edges are arranged only when the risk
+ * is propagated). riskModel is the model of the crnas of the batches (see
+ * SpreaderDetectorModel.h). A graph initialized to {0} is empty, with MODEL_CRNA
+ */
+typedef struct ContactGraph
+{
+	size_t *infectors;
+	size_t *infecteds;
+	float *crnas;
+	size_t numOfEdges;
+	size_t edgesCapacity;
+	size_t *seeds;
+	size_t numOfSeeds;
+	size_t seedsCapacity;
+	int riskModel;
+} ContactGraph;
+
+/**
+ * Adds a seed (a person who is sick for sure)
+ * @param graph The graph
+ * @param node The vertex of the person
+ * @return GRAPH_SUCCESS or GRAPH_FAILED
+ */
+int addSeed(ContactGraph *graph, size_t node);
+
+/**
+ * Adds a meeting
+ * @param graph The graph
+ * @param infector The vertex of the infector
+ * @param infected The vertex of the infected
+ * @param crna The crna of the meeting (the probability of the infected is the probability of the
+ * infector times the crna)
+ * @return GRAPH_SUCCESS or GRAPH_FAILED
+ */
+int addContact(ContactGraph *graph, size_t infector, size_t infected, float crna);
+
+/**
+ * Adds all the meetings of a batch (their crnas are computed here by the model of the graph, for
+ * the whole batch at once, see SpreaderDetectorModel.h), in their order. The batch is left empty
+ * @param graph The graph
+ * @param batch The batch
+ * @return GRAPH_SUCCESS or GRAPH_FAILED (nothing was added)
+ */
+int addContactBatch(ContactGraph *graph, MeetingBatch *batch);
+
+/**
+ * Propagates the risk from the seeds over all the meetings
+ * @param graph The graph
+ * @param numOfNodes The number of vertices (every vertex in the graph is smaller)
+ * @param keys The key of every vertex (the ID of the person), to break the cycles by. NULL when
+ * every vertex is its own key
+ * @param combineRule COMBINE_MAX or COMBINE_NOISY_OR
+ * @param numOfThreads The maximal number of threads (the probabilities are the same for any number)
+ * @param probs Will contain the probability of every vertex (0 for a vertex with no meetings)
+ * @return GRAPH_SUCCESS or GRAPH_FAILED (no memory)
+ */
+int propagateRisk(const ContactGraph *graph, size_t numOfNodes, const size_t *keys,
+                  int combineRule, size_t numOfThreads, float *probs);
+
+/**
+ * Sorts vertices by their keys (and equal keys by the vertices), in place: the order in which the
+ * vertices that are left on cycles are made final
+ * @param nodes The vertices
+ * @param len The number of vertices
+ * @param keys The key of every vertex (NULL when every vertex is its own key)
+ */
+void sortNodesByKey(size_t *nodes, size_t len, const size_t *keys);
+
+/**
+ * Releases the graph. And turns it into an empty graph
+ * @param graph The graph
+ */
+void freeContactGraph(ContactGraph *graph);
+
+#endif //EXAM_SPREADERDETECTORGRAPH_H
@@ -0,0 +1,153 @@
+/**
+* @file SpreaderDetectorIdIndex.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the index of IDs (hash index or sorted index, see the header)
+* @section DESCRIPTION
+* The hash index uses linear probing over a power of two number of slots, with a load factor of
+* at most 1/2, so a lookup rarely looks at more than one or two (adjacent) slots.
+*/
+
+#include <stdint.h>
+#include "SpreaderDetectorIdIndex.h"
+#include "SpreaderDetectorArena.h"
+
+/**
+ * @def EMPTY_SLOT
+ * @brief The row of an empty slot of the hash index
+ */
+#define EMPTY_SLOT SIZE_MAX
+
+/**
+ * @def SLOTS_PER_PERSON 2
+ * @brief The hash index has at least 2 slots per person (load factor of at most 1/2)
+ */
+#define SLOTS_PER_PERSON 2
+
+/**
+ * @def MIN_SLOTS_BITS 4
+ * @brief The minimal number of slots of the hash index is 2^4 = 16
+ */
+#define MIN_SLOTS_BITS 4
+
+/**
+ * @def FIBONACCI_MULTIPLIER 0x9E3779B97F4A7C15
+ * @brief 2^64 / golden ratio. Multiplying by it mixes all the bits of the ID into the high bits,
+ * so the IDs spread evenly over the slots even if they are not random (Fibonacci hashing)
+ */
+#define FIBONACCI_MULTIPLIER 0x9E3779B97F4A7C15ull
+
+/**
+ * @def BITS_IN_HASH 64
+ * @brief The number of bits of the hash (we take its high bits as the slot)
+ */
+#define BITS_IN_HASH 64
+
+#ifdef SORTED_ID_INDEX
+
+int buildIdIndex(IdIndex *index, const size_t *ids, size_t len)
+{
+	index->ids = ids;
+	index->len = len;
+	return INDEX_BUILD_SUCCESS;
+}
+
+size_t findRowById(const IdIndex *index, size_t id)
+{
+	return standardBinarySearch(index->ids, index->len, id);
+}
+
+#else
+
+/**
+ * Returns the first slot to look at for an ID
+ * @param index The hash index
+ * @param id The ID
+ * @return The slot
+ */
+static size_t slotOfId(const IdIndex *index, size_t id)
+{
+	return (size_t) (((uint64_t) id * FIBONACCI_MULTIPLIER) >> index->shift);
+}
+
+int buildIdIndex(IdIndex *index, const size_t *ids, size_t len)
+{
+	unsigned int bits = MIN_SLOTS_BITS;
+	size_t numOfSlots = (size_t) 1 << bits;
+	while (numOfSlots < len * SLOTS_PER_PERSON)
+	{
+		numOfSlots *= 2;
+		bits++;
+	}
+	IdSlot *slots = (IdSlot *) trackedMalloc(numOfSlots * sizeof(IdSlot));
+	if (slots == NULL)
+	{
+		return INDEX_BUILD_FAILED;
+	}
+	for (size_t i = 0; i < numOfSlots; ++i)
+	{
+		slots[i].row = EMPTY_SLOT;
+	}
+	index->ids = ids;
+	index->len = len;
+	index->slots = slots;
+	index->numOfSlots = numOfSlots;
+	index->shift = BITS_IN_HASH - bits;
+	size_t mask = numOfSlots - 1;
+	for (size_t row = 0; row < len; ++row)
+	{
+		size_t slot = slotOfId(index, ids[row]);
+		while (slots[slot].row != EMPTY_SLOT)
+		{
+			slot = (slot + 1) & mask;
+		}
+		slots[slot].id = ids[row];
+		slots[slot].row = row;
+	}
+	return INDEX_BUILD_SUCCESS;
+}
+
+size_t findRowById(const IdIndex *index, size_t id)
+{
+	size_t mask = index->numOfSlots - 1;
+	size_t slot = slotOfId(index, id);
+	while (index->slots[slot].row != EMPTY_SLOT)
+	{
+		if (index->slots[slot].id == id)
+		{
+			return index->slots[slot].row;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return ELEMENT_NOT_FOUND;
+}
+
+#endif
+
+size_t standardBinarySearch(const size_t *ids, size_t len, size_t id)
+{
+	size_t l = 0;
+	size_t r = len; // the range we are looking in is [l, r)
+	while (l < r) // the first place whose ID is not smaller than id
+	{
+		size_t mid = l + (r - l) / 2;
+		if (ids[mid] < id)
+		{
+			l = mid + 1;
+		}
+		else // ids[mid] >= id
+		{
+			r = mid;
+		}
+	}
+	return l < len && ids[l] == id ? l : (size_t) ELEMENT_NOT_FOUND;
+}
+
+void freeIdIndex(IdIndex *index)
+{
+	trackedFree(index->slots, index->numOfSlots * sizeof(IdSlot));
+	index->slots = NULL;
+	index->numOfSlots = 0;
+	index->ids = NULL;
+	index->len = 0;
+}
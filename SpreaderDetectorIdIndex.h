@@ -0,0 +1,101 @@
+/**
+* @file SpreaderDetectorIdIndex.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Finds the row of a person in the table of people by his ID
+* @section DESCRIPTION
+* Two implementations, chosen when building (the CMake option SPREADER_SORTED_ID_INDEX):
+* - hash index (the default): a flat open-addressing hash table of (ID, row) pairs, sized from the
+*   number of people. Built in O(n) and every lookup is O(1) expected (usually one cache miss).
+*   The table of people does not have to be sorted by ID at all.
+* - sorted index (SORTED_ID_INDEX): the table of people is sorted by ID, and every lookup is a
+*   binary search over the ids column (O(logn)).
+*/
+
+#ifndef EXAM_SPREADERDETECTORIDINDEX_H
+#define EXAM_SPREADERDETECTORIDINDEX_H
+
+#include <stddef.h>
+
+/**
+ * @def ELEMENT_NOT_FOUND -1
+ * @brief If no element is found in the index, -1 will be returned. Let us note that in this
+ * program if we look for someone in the table of people he will inevitably be there.
+ * (It can be assumed that all the people in the meeting file are in the people file)
+ */
+#define ELEMENT_NOT_FOUND -1
+
+/**
+ * @def INDEX_BUILD_FAILED 0
+ * @brief Returned by buildIdIndex when the allocation failed
+ */
+#define INDEX_BUILD_FAILED 0
+
+/**
+ * @def INDEX_BUILD_SUCCESS 1
+ * @brief Returned by buildIdIndex when the index is ready
+ */
+#define INDEX_BUILD_SUCCESS 1
+
+/**
+ * @struct IdSlot
+ * @brief One slot of the hash index. The ID is kept next to the row, so a lookup does not need
+ * to go to the ids column to compare
+ */
+typedef struct IdSlot
+{
+	size_t id;
+	size_t row;
+} IdSlot;
+
+/**
+ * @struct IdIndex
+ * @brief The index. An index initialized to {0} is empty (and can be freed)
+ */
+typedef struct IdIndex
+{
+	const size_t *ids;
+	size_t len;
+	IdSlot *slots;
+	size_t numOfSlots;
+	unsigned int shift;
+} IdIndex;
+
+/**
+ * Builds the index over the ids column
+ * @param index The index to build (empty)
+ * @param ids The ids column. (For the sorted index it must be sorted, and it must stay valid as
+ * long as the index is used)
+ * @param len num of peoples
+ * @return INDEX_BUILD_SUCCESS or INDEX_BUILD_FAILED
+ */
+int buildIdIndex(IdIndex *index, const size_t *ids, size_t len);
+
+/**
+ * Finds the row of a person by his ID
+ * @param index The index
+ * @param id The ID number of the person we are looking for
+ * @return The row of the person, or ELEMENT_NOT_FOUND (as size_t)
+ */
+size_t findRowById(const IdIndex *index, size_t id);
+
+/**
+ * Standard binary search (O(logn)), without recursion.
+ * After creating the table of people - the progrem sort it by ID number (sorted index). So when
+ * two people meet and we want to update the probability that they are infected we can do so
+ * quickly by binary search over the ids column.
+ * @param ids The ids column (sorted)
+ * @param len The length of the column
+ * @param id The ID number of the person we are looking for in the array
+ * @return The first location in the array where the ID is (so when two people have the same ID
+ * the first of them is found, like in the hash index), or ELEMENT_NOT_FOUND (as size_t)
+ */
+size_t standardBinarySearch(const size_t *ids, size_t len, size_t id);
+
+/**
+ * Releases the index. And turns it into an empty index
+ * @param index The index
+ */
+void freeIdIndex(IdIndex *index);
+
+#endif //EXAM_SPREADERDETECTORIDINDEX_H
@@ -0,0 +1,135 @@
+/**
+* @file SpreaderDetectorIncremental.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the incremental graph of the meetings
+* @section DESCRIPTION
+* Every person has a rank, and the ranks are a topological order (the infector of every meeting has
+* a smaller rank than the infected). Every new meeting marks its infected, and the batch is
+* propagated over the ranks by SpreaderDetectorRankOrder.c: a heap by rank while the new meetings
+* keep the order, Kahn's order over the affected people otherwise. The meetings are linked with
+* their crnas as the weights.
+*/
+
+#include <stdint.h>
+#include "SpreaderDetectorIncremental.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorTable.h"
+
+/**
+ * Returns the meetings of the graph and their lists, with the crnas as the weights
+ * @param graph The graph
+ * @return The meetings (valid until the arrays grow)
+ */
+static RankEdges edgesOf(const IncrementalGraph *graph)
+{
+	RankEdges edges = {graph->infectors, graph->infecteds, graph->crnas, graph->nextIn,
+	                   graph->nextOut, NULL, graph->inHeads, graph->inTails, graph->outHeads};
+	return edges;
+}
+
+int initIncrementalGraph(IncrementalGraph *graph, ContactGraph *contacts, size_t numOfNodes,
+                         const size_t *keys, int combineRule, float *probs)
+{
+	graph->infectors = contacts->infectors; // the edges are moved from the contact graph
+	graph->infecteds = contacts->infecteds;
+	graph->crnas = contacts->crnas;
+	graph->numOfEdges = contacts->numOfEdges;
+	graph->edgesCapacity = contacts->edgesCapacity;
+	contacts->infectors = NULL;
+	contacts->infecteds = NULL;
+	contacts->crnas = NULL;
+	contacts->numOfEdges = 0;
+	contacts->edgesCapacity = 0;
+	int status = initRankOrder(&graph->order, numOfNodes, keys, combineRule, probs, 1);
+	graph->nextOut = (size_t *) trackedMalloc(graph->edgesCapacity * sizeof(size_t));
+	graph->nextIn = (size_t *) trackedMalloc(graph->edgesCapacity * sizeof(size_t));
+	graph->outHeads = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	graph->inHeads = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	graph->inTails = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	if (status == RANK_FAILED ||
+		(graph->edgesCapacity > 0 && (graph->nextOut == NULL || graph->nextIn == NULL)) ||
+		(numOfNodes > 0 &&
+		 (graph->outHeads == NULL || graph->inHeads == NULL || graph->inTails == NULL)))
+	{
+		return INCREMENTAL_FAILED; // everything that was allocated is released with the graph
+	}
+	for (size_t i = 0; i < contacts->numOfSeeds; ++i)
+	{
+		graph->order.isSeed[contacts->seeds[i]] = 1;
+	}
+	for (size_t node = 0; node < numOfNodes; ++node)
+	{
+		graph->outHeads[node] = NO_EDGE;
+		graph->inHeads[node] = NO_EDGE;
+		graph->inTails[node] = NO_EDGE;
+	}
+	RankEdges edges = edgesOf(graph);
+	for (size_t e = 0; e < graph->numOfEdges; ++e)
+	{
+		linkRankEdge(&edges, e);
+	}
+	rankAllNodes(&graph->order, &edges); // the first ranks
+	freeContactGraph(contacts); // only the seeds are left there
+	return INCREMENTAL_SUCCESS;
+}
+
+int addBatchContact(IncrementalGraph *graph, size_t infector, size_t infected, float crna)
+{
+	if (graph->numOfEdges == graph->edgesCapacity)
+	{
+		size_t capacity = graph->edgesCapacity;
+		size_t newCapacity = capacity ? capacity * GROWTH_FACTOR : INIT_CAPACITY;
+		if (resizeArray((void **) &graph->infectors, capacity, newCapacity, sizeof(size_t)) ==
+		    GROW_FAILED ||
+			resizeArray((void **) &graph->infecteds, capacity, newCapacity, sizeof(size_t)) ==
+			GROW_FAILED ||
+			resizeArray((void **) &graph->crnas, capacity, newCapacity, sizeof(float)) ==
+			GROW_FAILED ||
+			resizeArray((void **) &graph->nextOut, capacity, newCapacity, sizeof(size_t)) ==
+			GROW_FAILED ||
+			resizeArray((void **) &graph->nextIn, capacity, newCapacity, sizeof(size_t)) ==
+			GROW_FAILED)
+		{
+			return INCREMENTAL_FAILED; // the arrays that did grow are released with the graph
+		}
+		graph->edgesCapacity = newCapacity;
+	}
+	graph->infectors[graph->numOfEdges] = infector;
+	graph->infecteds[graph->numOfEdges] = infected;
+	graph->crnas[graph->numOfEdges] = crna;
+	RankEdges edges = edgesOf(graph);
+	linkRankEdge(&edges, graph->numOfEdges);
+	addRankEdge(&graph->order, infector, infected);
+	graph->numOfEdges++;
+	return INCREMENTAL_SUCCESS;
+}
+
+size_t propagateBatch(IncrementalGraph *graph)
+{
+	RankEdges edges = edgesOf(graph);
+	return propagateRankOrder(&graph->order, &edges);
+}
+
+size_t strongestInfector(const IncrementalGraph *graph, size_t node)
+{
+	RankEdges edges = edgesOf(graph);
+	return strongestRankInfector(&graph->order, &edges, node);
+}
+
+void freeIncrementalGraph(IncrementalGraph *graph)
+{
+	size_t numOfNodes = graph->order.numOfNodes;
+	size_t capacity = graph->edgesCapacity;
+	freeRankOrder(&graph->order);
+	trackedFree(graph->infectors, capacity * sizeof(size_t));
+	trackedFree(graph->infecteds, capacity * sizeof(size_t));
+	trackedFree(graph->crnas, capacity * sizeof(float));
+	trackedFree(graph->nextOut, capacity * sizeof(size_t));
+	trackedFree(graph->nextIn, capacity * sizeof(size_t));
+	trackedFree(graph->outHeads, numOfNodes * sizeof(size_t));
+	trackedFree(graph->inHeads, numOfNodes * sizeof(size_t));
+	trackedFree(graph->inTails, numOfNodes * sizeof(size_t));
+	IncrementalGraph empty = {0};
+	*graph = empty;
+}
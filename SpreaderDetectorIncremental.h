@@ -0,0 +1,122 @@
+/**
+* @file SpreaderDetectorIncremental.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The graph of the meetings kept in memory after the first run, so new meetings can be added
+* without computing everything again
+* @section DESCRIPTION
+* After the full propagation (see SpreaderDetectorGraph.h) the edges are moved into a graph that
+* can grow: every vertex has a list of the meetings he is the infector in and a list of the
+* meetings that infect him (in the order they were read), as linked lists inside the arrays of the
+* edges. New meetings are added in batches. After a batch the people are visited in topological
+* order, starting from the infecteds of the new meetings, and a person is computed again (from all
+* his infectors, like in the full propagation) only if one of his meetings is new or one of his
+* infectors was changed. Usually only the changed people (and the people they infect) are visited;
+* a new meeting against the topological order makes the batch visit everyone that can be reached
+* from the new meetings. The batch is propagated by SpreaderDetectorRankOrder.h, like the refresh
+* of the window. The probabilities are exactly the ones a full run over all the meetings would
+* compute.
+*/
+
+#ifndef EXAM_SPREADERDETECTORINCREMENTAL_H
+#define EXAM_SPREADERDETECTORINCREMENTAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SpreaderDetectorGraph.h"
+#include "SpreaderDetectorRankOrder.h"
+
+/**
+ * @def INCREMENTAL_SUCCESS 1
+ * @brief Returned by the functions of the incremental graph when they succeeded
+ */
+#define INCREMENTAL_SUCCESS 1
+
+/**
+ * @def INCREMENTAL_FAILED 0
+ * @brief Returned by the functions of the incremental graph when an allocation failed
+ */
+#define INCREMENTAL_FAILED 0
+
+/**
+ * @def NO_INFECTOR NO_RANK_INFECTOR
+ * @brief Returned by strongestInfector for a person that nobody infected (a seed, or a person
+ * whose meetings all have no risk)
+ */
+#define NO_INFECTOR NO_RANK_INFECTOR
+
+/**
+ * @struct IncrementalGraph
+ * @brief The graph that stays in memory. The edges are infectors, infecteds and crnas; nextOut
+ * and nextIn link the edges of every vertex (outHeads, inHeads and inTails are the ends of the
+ * lists of every vertex). order holds the probabilities, the seeds and the ranks of the vertices
+ * and the scratch of a batch (see SpreaderDetectorRankOrder.h); after a batch order.changed (with
+ * order.oldProbs) are the people whose probability was changed by it. A graph initialized to {0}
+ * is empty
+ */
+typedef struct IncrementalGraph
+{
+	RankOrder order;
+	size_t *infectors;
+	size_t *infecteds;
+	float *crnas;
+	size_t *nextOut;
+	size_t *nextIn;
+	size_t numOfEdges;
+	size_t edgesCapacity;
+	size_t *outHeads;
+	size_t *inHeads;
+	size_t *inTails;
+} IncrementalGraph;
+
+/**
+ * Builds the incremental graph from the graph of the full propagation. The edges are moved (not
+ * copied), and the contact graph is left empty
+ * @param graph The incremental graph (empty)
+ * @param contacts The graph of the meetings, after propagateRisk
+ * @param numOfNodes The number of vertices
+ * @param keys The keys propagateRisk broke the cycles by (the IDs of the people, kept as long as
+ * the graph is used)
+ * @param combineRule The rule propagateRisk used
+ * @param probs The probabilities propagateRisk computed. They are updated by every batch (and must
+ * stay valid as long as the graph is used)
+ * @return INCREMENTAL_SUCCESS or INCREMENTAL_FAILED (no memory)
+ */
+int initIncrementalGraph(IncrementalGraph *graph, ContactGraph *contacts, size_t numOfNodes,
+                         const size_t *keys, int combineRule, float *probs);
+
+/**
+ * Adds a new meeting to the current batch (its effect is computed by propagateBatch)
+ * @param graph The graph
+ * @param infector The vertex of the infector
+ * @param infected The vertex of the infected
+ * @param crna The crna of the meeting
+ * @return INCREMENTAL_SUCCESS or INCREMENTAL_FAILED (no memory)
+ */
+int addBatchContact(IncrementalGraph *graph, size_t infector, size_t infected, float crna);
+
+/**
+ * Propagates the meetings of the current batch through the affected part of the graph. After it
+ * graph->order.changed holds the people whose probability was changed (and graph->order.oldProbs
+ * their probabilities before the batch)
+ * @param graph The graph
+ * @return The number of people that were visited
+ */
+size_t propagateBatch(IncrementalGraph *graph);
+
+/**
+ * Finds the infector of the meeting that gave a person his largest exposure (with COMBINE_MAX the
+ * one his probability came from). The first of equal exposures, in the order the meetings were read
+ * @param graph The graph (after the last batch was propagated)
+ * @param node The vertex of the person
+ * @return The vertex of the infector, or NO_INFECTOR
+ */
+size_t strongestInfector(const IncrementalGraph *graph, size_t node);
+
+/**
+ * Releases the graph. And turns it into an empty graph
+ * @param graph The graph
+ */
+void freeIncrementalGraph(IncrementalGraph *graph);
+
+#endif //EXAM_SPREADERDETECTORINCREMENTAL_H
@@ -0,0 +1,64 @@
+/**
+* @file SpreaderDetectorModel.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the registry of the risk models
+* @section DESCRIPTION
+* Every model has an entry in the registry: its name, the kernel of a batch (an instance of
+* DEFINE_RISK_KERNEL, or the vector kernels of the crna) and the formula of one meeting.
+*/
+
+#include <string.h>
+#include "SpreaderDetectorModel.h"
+#include "SpreaderDetectorCrna.h"
+
+/**
+ * @struct RiskModel
+ * @brief An entry of the registry
+ */
+typedef struct RiskModel
+{
+	const char *name;
+	void (*kernel)(const float *distances, const float *times, float *risks, size_t len);
+	float (*riskOfOneMeeting)(float distance, float time);
+} RiskModel;
+
+DEFINE_RISK_KERNEL(computeExpDistanceRisks, expDistanceRisk)
+
+DEFINE_RISK_KERNEL(computeCappedDurationRisks, cappedDurationRisk)
+
+/**
+ * The registry (by model)
+ */
+static const RiskModel riskModels[NUM_OF_RISK_MODELS] = {
+		{"crna",            computeCrnas,               crnaRisk},
+		{"exp-distance",    computeExpDistanceRisks,    expDistanceRisk},
+		{"capped-duration", computeCappedDurationRisks, cappedDurationRisk}};
+
+int findRiskModel(const char *name)
+{
+	for (int model = 0; model < NUM_OF_RISK_MODELS; ++model)
+	{
+		if (strcmp(name, riskModels[model].name) == 0)
+		{
+			return model;
+		}
+	}
+	return NO_RISK_MODEL;
+}
+
+const char *nameOfRiskModel(int model)
+{
+	return riskModels[model].name;
+}
+
+void computeRisks(int model, const float *distances, const float *times, float *risks,
+                  size_t len)
+{
+	riskModels[model].kernel(distances, times, risks, len);
+}
+
+float riskOfMeeting(int model, float distance, float time)
+{
+	return riskModels[model].riskOfOneMeeting(distance, time);
+}
@@ -0,0 +1,149 @@
+/**
+* @file SpreaderDetectorModel.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The risk models: how the distance and the time of a meeting become the probability that
+* the infector infected the infected (the crna of the default model)
+* @section DESCRIPTION
+* A model is a formula of one meeting with constant coefficients (a static inline function here),
+* and DEFINE_RISK_KERNEL makes from it a loop over a batch of meetings in which the formula is
+* inlined. A model is chosen by its name at startup ("--model="), and its kernel is called once
+* for every batch of meetings that is read, so the risk of every meeting is computed once, when
+* it is added to the graph. The propagation only reads these risks (its own loops are instantiated
+* for every combine rule, see SpreaderDetectorGraph.h). The default model (MODEL_CRNA) is the
+* formula of the meeting file, computed with the vector kernels of SpreaderDetectorCrna.h.
+* The models are:
+* - "crna": time * MIN_DISTANCE / (distance * MAX_TIME).
+* - "exp-distance": the risk falls exponentially with the distance, by e every
+*   EXP_DISTANCE_SCALE beyond MIN_DISTANCE, and grows with the time like the crna.
+* - "capped-duration": the crna, with the time capped at MAX_TIME and the distance at least
+*   MIN_DISTANCE, so the risk of a meeting is never above 1.
+*/
+
+#ifndef EXAM_SPREADERDETECTORMODEL_H
+#define EXAM_SPREADERDETECTORMODEL_H
+
+#include <math.h>
+#include <stddef.h>
+#include "SpreaderDetectorParams.h"
+
+/**
+ * @def MODEL_CRNA 0
+ * @brief The crna of the meeting file (the default)
+ */
+#define MODEL_CRNA 0
+
+/**
+ * @def MODEL_EXP_DISTANCE 1
+ * @brief The risk falls exponentially with the distance
+ */
+#define MODEL_EXP_DISTANCE 1
+
+/**
+ * @def MODEL_CAPPED_DURATION 2
+ * @brief The crna with a capped time and a minimal distance
+ */
+#define MODEL_CAPPED_DURATION 2
+
+/**
+ * @def NUM_OF_RISK_MODELS 3
+ * @brief The number of models
+ */
+#define NUM_OF_RISK_MODELS 3
+
+/**
+ * @def NO_RISK_MODEL (-1)
+ * @brief Returned by findRiskModel for a name that is not a model
+ */
+#define NO_RISK_MODEL (-1)
+
+/**
+ * @def EXP_DISTANCE_SCALE 2.0f
+ * @brief The distance over which the risk of "exp-distance" falls by e
+ */
+#define EXP_DISTANCE_SCALE 2.0f
+
+/**
+ * @def DEFINE_RISK_KERNEL(kernelName, riskOfOneMeeting)
+ * @brief Defines a static function kernelName(distances, times, risks, len) that computes
+ * riskOfOneMeeting(distance, time) of every meeting of a batch
+ */
+#define DEFINE_RISK_KERNEL(kernelName, riskOfOneMeeting)                                        \
+static void kernelName(const float *distances, const float *times, float *risks, size_t len)   \
+{                                                                                               \
+	for (size_t i = 0; i < len; ++i)                                                            \
+	{                                                                                           \
+		risks[i] = riskOfOneMeeting(distances[i], times[i]);                                    \
+	}                                                                                           \
+}
+
+/**
+ * The crna of one meeting (MODEL_CRNA)
+ * @param distance The distance between the two people during the meeting
+ * @param time How long did the meeting take
+ * @return The risk
+ */
+static inline float crnaRisk(float distance, float time)
+{
+	return (time * MIN_DISTANCE) / (distance * MAX_TIME);
+}
+
+/**
+ * The risk of one meeting by MODEL_EXP_DISTANCE
+ * @param distance The distance between the two people during the meeting
+ * @param time How long did the meeting take
+ * @return The risk
+ */
+static inline float expDistanceRisk(float distance, float time)
+{
+	return (time / MAX_TIME) * expf((MIN_DISTANCE - distance) / EXP_DISTANCE_SCALE);
+}
+
+/**
+ * The risk of one meeting by MODEL_CAPPED_DURATION
+ * @param distance The distance between the two people during the meeting
+ * @param time How long did the meeting take
+ * @return The risk
+ */
+static inline float cappedDurationRisk(float distance, float time)
+{
+	float cappedTime = time < MAX_TIME ? time : MAX_TIME;
+	float cappedDistance = distance > MIN_DISTANCE ? distance : MIN_DISTANCE;
+	return (cappedTime * MIN_DISTANCE) / (cappedDistance * MAX_TIME);
+}
+
+/**
+ * Finds a model by its name
+ * @param name The name ("crna", "exp-distance" or "capped-duration")
+ * @return The model, or NO_RISK_MODEL
+ */
+int findRiskModel(const char *name);
+
+/**
+ * Returns the name of a model
+ * @param model The model
+ * @return The name
+ */
+const char *nameOfRiskModel(int model);
+
+/**
+ * Computes the risk of every meeting of a batch by a model
+ * @param model The model
+ * @param distances The distances of the meetings
+ * @param times The times of the meetings
+ * @param risks Will contain the risk of every meeting
+ * @param len The number of meetings
+ */
+void computeRisks(int model, const float *distances, const float *times, float *risks,
+                  size_t len);
+
+/**
+ * Computes the risk of one meeting by a model (for the modes that add the meetings one by one)
+ * @param model The model
+ * @param distance The distance between the two people during the meeting
+ * @param time How long did the meeting take
+ * @return The risk
+ */
+float riskOfMeeting(int model, float distance, float time);
+
+#endif //EXAM_SPREADERDETECTORMODEL_H
@@ -0,0 +1,1620 @@
+/**
+* @file SpreaderDetectorModes.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the modes of the command line tool
+* @section DESCRIPTION
+* Every mode keeps what it holds in one place (a table, a StreamingState, a ShardWorker or a
+* MeetingList), so it can release all of it before it returns an error. The errors are found in
+* the order of the table mode: the people file, then the meeting file, and only then the output
+* file, so the same invalid input ends every mode with the same code.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "SpreaderDetectorModes.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorEngine.h"
+#include "SpreaderDetectorGraph.h"
+#include "SpreaderDetectorModel.h"
+#include "SpreaderDetectorOrder.h"
+#include "SpreaderDetectorParams.h"
+#include "SpreaderDetectorPipeline.h"
+#include "SpreaderDetectorScan.h"
+#include "SpreaderDetectorServer.h"
+#include "SpreaderDetectorShard.h"
+#include "SpreaderDetectorSnapshot.h"
+#include "SpreaderDetectorStats.h"
+#include "SpreaderDetectorStreaming.h"
+#include "SpreaderDetectorTable.h"
+#include "SpreaderDetectorValidate.h"
+#include "SpreaderDetectorWriter.h"
+
+/**
+ * @def SHARD_READY 'R'
+ * @brief The first byte a shard writes to its pipe, after the propagation succeeded. The records
+ * of the shard come after it
+ */
+#define SHARD_READY 'R'
+
+/**
+ * @def RUNS_RESERVE_DIVISOR 16
+ * @brief The buffer of the records of the streaming mode gets the room that is left in its budget
+ * after the meetings, except for the buffer of the output file and 1/16 of the room (for the list
+ * of the runs, which grows while the buffer is full)
+ */
+#define RUNS_RESERVE_DIVISOR 16
+
+/**
+ * @def OUTPUT_BUFFER_DIVISOR 8
+ * @brief The buffer of the output file of the streaming mode gets 1/8 of the room that is left in
+ * its budget after the meetings (at least MIN_OUTPUT_BUFFER_SIZE and at most OUTPUT_BUFFER_SIZE)
+ */
+#define OUTPUT_BUFFER_DIVISOR 8
+
+/**
+ * @struct StreamingState
+ * @brief Everything the streaming mode holds, so it can be released in any case of error. An input
+ * file that is a snapshot is mapped (peopleSnapshot or meetingsSnapshot) instead of being opened
+ */
+typedef struct StreamingState
+{
+	ProbMap probs;
+	ContactGraph contacts;
+	MeetingBatch meetingBatch;
+	RunSpiller spiller;
+	FILE *peopleFile;
+	FILE *meetingsFile;
+	Snapshot peopleSnapshot;
+	Snapshot meetingsSnapshot;
+	OutputWriter output;
+	size_t outputBufferSize;
+	const RiskPolicy *policy;
+} StreamingState;
+
+/**
+ * @struct ShardWorker
+ * @brief Everything a worker of the sharded mode holds: the people of its shard (and the number of
+ * lines of the people file), the graph of the shard and the pipe of its records
+ */
+typedef struct ShardWorker
+{
+	size_t shard;
+	size_t numOfShards;
+	PeopleTable people;
+	size_t numOfLines;
+	ShardGraph graph;
+	FILE *inputFile;
+	FILE *records;
+	ProbSortKey *order;
+	unsigned char *classes;
+} ShardWorker;
+
+/**
+ * @struct MeetingList
+ * @brief The seeds and the meetings of the meeting file as they are read by the converter to
+ * snapshots, before the meetings snapshot is created in their size
+ */
+typedef struct MeetingList
+{
+	size_t *seeds;
+	size_t numOfSeeds;
+	size_t seedsCapacity;
+	MeetingInfo *meetings;
+	size_t numOfMeetings;
+	size_t meetingsCapacity;
+	FILE *meetingsFile;
+	Snapshot snapshot;
+} MeetingList;
+
+/**
+ * Converts a TABLE_ code of a function that reads the input files to the MODE_ code of the same
+ * error
+ * @param status The TABLE_ code
+ * @return The MODE_ code
+ */
+static int modeStatusOfTable(int status)
+{
+	if (status == TABLE_SUCCESS)
+	{
+		return MODE_SUCCESS;
+	}
+	return status == TABLE_OPEN_FAILED ? MODE_INPUT_FAILED : MODE_FAILED;
+}
+
+/**
+ * Converts the code of opening an output file (a WRITER_ or a SNAPSHOT_ code) to the MODE_ code
+ * of the same error
+ * @param status The code
+ * @param successStatus The code of success (WRITER_SUCCESS or SNAPSHOT_SUCCESS)
+ * @param openFailedStatus The code of a file that could not be opened
+ * @return The MODE_ code
+ */
+static int modeStatusOfOutput(int status, int successStatus, int openFailedStatus)
+{
+	if (status == successStatus)
+	{
+		return MODE_SUCCESS;
+	}
+	return status == openFailedStatus ? MODE_OUTPUT_FAILED : MODE_FAILED;
+}
+
+/**
+ * Prints the counters of the pipeline
+ * @param log Where they are written
+ * @param stats The counters
+ */
+static void printPipelineStats(FILE *log, const PipelineStats *stats)
+{
+	const char *stageNames[] = {"reader", "parsers", "applier"};
+	const char *itemNames[] = {"bytes", "meetings", "meetings"};
+	const StageStats *stages[] = {&stats->reader, &stats->parsers, &stats->applier};
+	fprintf(log, "pipeline seconds: %.6f (%zu parsers)\n", stats->seconds, stats->numOfParsers);
+	for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i)
+	{
+		fprintf(log, "%s: %zu batches, %zu %s, busy %.6f s, waited %.6f s\n", stageNames[i],
+		        stages[i]->numOfBatches, stages[i]->numOfItems, itemNames[i],
+		        stages[i]->busySeconds, stages[i]->waitSeconds);
+	}
+	const char *ringNames[] = {"raw rings", "parsed rings"};
+	const RingStats *rings[] = {&stats->rawRings, &stats->parsedRings};
+	for (size_t i = 0; i < sizeof(rings) / sizeof(rings[0]); ++i)
+	{
+		double occupancy = rings[i]->numOfPushes == 0 ? 0 :
+		                   (double) rings[i]->occupancySum / (double) rings[i]->numOfPushes;
+		fprintf(log, "%s: average occupancy %.2f of %zu, %zu full waits, %zu empty waits\n",
+		        ringNames[i], occupancy, rings[i]->capacity, rings[i]->numOfFullWaits,
+		        rings[i]->numOfEmptyWaits);
+	}
+}
+
+/**
+ * Reads the meeting file into the graph of the meetings (people->contacts, see loadTableMeetings),
+ * and then propagates the risk over the graph, which updates the probability of each person who is
+ * there accordingly. The graph is kept (for the batches of new meetings), it is released by
+ * freePeopleTable
+ * @param options The path to the meeting file, how the exposures of one person are combined, the
+ * maximal number of threads of the propagation and the number of parsers of the pipeline
+ * @param people The table of people
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED or MODE_FAILED
+ */
+static int readMeetingsFile(const DetectorOptions *options, PeopleTable *people)
+{
+	PHASE_BEGIN(PHASE_READ_MEETINGS);
+	PipelineStats pipelineStats;
+	int status = loadTableMeetings(people, options->pathToMeetings, options->numOfParsers,
+	                               &pipelineStats);
+	if (options->printTiming && pipelineStats.numOfParsers > 0) // the pipeline ran
+	{
+		printPipelineStats(options->log, &pipelineStats);
+	}
+	PHASE_END(PHASE_READ_MEETINGS);
+	if (status != TABLE_SUCCESS)
+	{
+		return modeStatusOfTable(status);
+	}
+	PHASE_BEGIN(PHASE_PROPAGATE);
+	status = propagatePeopleTable(people, options->combineRule, options->numOfThreads);
+	PHASE_END(PHASE_PROPAGATE);
+	return modeStatusOfTable(status);
+}
+
+/**
+ * Writes the people of an order to OUTPUT_FILE
+ * @param people The table of people
+ * @param order The rows of the table in the order they are written (NULL if there are none)
+ * @param numOfKeys The number of people to write (the length of order)
+ * @param options With printTiming, how long the output took is written to the log
+ * @return MODE_SUCCESS, MODE_OUTPUT_FAILED or MODE_FAILED
+ */
+static int writeOutputFile(const PeopleTable *people, const ProbSortKey *order, size_t numOfKeys,
+                           const DetectorOptions *options)
+{
+	PHASE_BEGIN(PHASE_OUTPUT);
+	double outputBegin = currentSeconds();
+	int status = writePeopleTable(people, order, numOfKeys, OUTPUT_FILE);
+	PHASE_END(PHASE_OUTPUT);
+	if (status != TABLE_SUCCESS)
+	{
+		return status == TABLE_OPEN_FAILED ? MODE_OUTPUT_FAILED : MODE_FAILED;
+	}
+	if (options->printTiming)
+	{
+		fprintf(options->log, "output seconds: %.6f\n", currentSeconds() - outputBegin);
+	}
+	return MODE_SUCCESS;
+}
+
+/**
+ * Reads one batch of new meetings (until an empty line or the end of the file) into the
+ * incremental graph
+ * @param deltasFile The file of the batches
+ * @param people The table of people (after beginTableUpdates)
+ * @param numOfMeetings Will contain the number of meetings in the batch
+ * @param isEndOfFile Will contain 1 if the file has ended, 0 otherwise
+ * @return MODE_SUCCESS or MODE_FAILED (an invalid line, an unknown person or no memory)
+ */
+static int readDeltaBatch(FILE *deltasFile, PeopleTable *people, size_t *numOfMeetings,
+                          int *isEndOfFile)
+{
+	char currentRow[MAX_LINE_SIZE];
+	int status = TABLE_SUCCESS;
+	*isEndOfFile = 1;
+	*numOfMeetings = 0;
+	while (status == TABLE_SUCCESS && fgets(currentRow, sizeof(currentRow), deltasFile))
+	{
+		size_t rowLen = strlen(currentRow);
+		COUNT_BYTES_READ(rowLen);
+		const char *lineEnd = findLineEnd(currentRow, currentRow + rowLen);
+		if (skipBlanks(currentRow, lineEnd) == lineEnd) // the batch ended
+		{
+			*isEndOfFile = 0;
+			break;
+		}
+		MeetingInfo curMeeting;
+		status = scanMeetingFromBytes(currentRow, lineEnd, &curMeeting) == SCAN_FAILED ?
+		         TABLE_INVALID_INPUT : addTableMeeting(people, &curMeeting);
+		(*numOfMeetings)++;
+	}
+	if (status != TABLE_SUCCESS || flushTableBatch(people) != TABLE_SUCCESS) // the last meetings
+	{
+		return MODE_FAILED;
+	}
+	return MODE_SUCCESS;
+}
+
+/**
+ * Writes the people whose class was changed by the last batch (in the order of the output file)
+ * @param writer The writer of DELTA_OUTPUT_FILE
+ * @param people The table of people
+ * @param policy The policy of the classes
+ * @param numOfWritten Will contain the number of people that were written
+ * @return MODE_SUCCESS or MODE_FAILED (no memory)
+ */
+static int writeChangedClasses(OutputWriter *writer, const PeopleTable *people,
+                               const RiskPolicy *policy, size_t *numOfWritten)
+{
+	const RankOrder *order = &people->incremental.order;
+	size_t numOfKeys = 0;
+	*numOfWritten = 0;
+	ProbSortKey *keys = (ProbSortKey *) trackedMalloc(order->numOfChanged * sizeof(ProbSortKey));
+	if (keys == NULL && order->numOfChanged > 0)
+	{
+		return MODE_FAILED;
+	}
+	for (size_t i = 0; i < order->numOfChanged; ++i)
+	{
+		size_t row = order->changed[i];
+		unsigned int riskClass = classOfPerson(policy, people->ages[row],
+		                                       people->probsInfected[row]);
+		if (classOfPerson(policy, people->ages[row], order->oldProbs[i]) != riskClass)
+		{
+			keys[numOfKeys].id = people->ids[row];
+			keys[numOfKeys].row = row;
+			keys[numOfKeys].probInfected = people->probsInfected[row];
+			keys[numOfKeys].riskClass = riskClass;
+			numOfKeys++;
+		}
+	}
+	int status = sortByProbability(keys, numOfKeys, 1) == ORDER_FAILED ? MODE_FAILED :
+	             MODE_SUCCESS; // a batch changes few people
+	for (size_t i = 0; i < numOfKeys && status == MODE_SUCCESS; ++i)
+	{
+		manageToOutputFile(writer, people, keys[i].row, keys[i].riskClass);
+	}
+	trackedFree(keys, order->numOfChanged * sizeof(ProbSortKey));
+	*numOfWritten = numOfKeys;
+	return status;
+}
+
+/**
+ * Moves the graph of the meetings (people->contacts, after the full propagation) into an
+ * incremental graph, and then reads the batches of new meetings from options->pathToDeltas until
+ * its end. After every batch the people whose class was changed are written to DELTA_OUTPUT_FILE
+ * @param people The table of people (with the probabilities of the full propagation)
+ * @param options The paths and the options
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED, MODE_OUTPUT_FAILED or MODE_FAILED
+ */
+static int applyDeltas(PeopleTable *people, const DetectorOptions *options)
+{
+	FILE *deltasFile = fopen(options->pathToDeltas, READING_MODE);
+	if (deltasFile == NULL)
+	{
+		return MODE_INPUT_FAILED;
+	}
+	OutputWriter writer = {0};
+	int status = modeStatusOfOutput(openOutputWriter(&writer, DELTA_OUTPUT_FILE), WRITER_SUCCESS,
+	                                WRITER_OPEN_FAILED);
+	if (status == MODE_SUCCESS && beginTableUpdates(people, options->combineRule) != TABLE_SUCCESS)
+	{
+		status = MODE_FAILED;
+	}
+	size_t numOfBatches = 0;
+	int isEndOfDeltas = 0;
+	while (status == MODE_SUCCESS && !isEndOfDeltas)
+	{
+		size_t numOfMeetings;
+		status = readDeltaBatch(deltasFile, people, &numOfMeetings, &isEndOfDeltas);
+		if (status != MODE_SUCCESS || numOfMeetings == 0) // an empty batch changes nothing
+		{
+			continue;
+		}
+		double updateBegin = currentSeconds();
+		size_t numOfAffected = propagateBatch(&people->incremental);
+		size_t numOfWritten;
+		status = writeChangedClasses(&writer, people, &options->policy, &numOfWritten);
+		if (status == MODE_SUCCESS && endOutputBatch(&writer) == WRITER_FAILED)
+		{
+			status = MODE_FAILED;
+		}
+		numOfBatches++;
+		if (status == MODE_SUCCESS && options->printTiming)
+		{
+			fprintf(options->log, "batch %zu: %zu meetings, %zu visited, %zu changed class, "
+			                      "update seconds: %.6f\n", numOfBatches, numOfMeetings,
+			        numOfAffected, numOfWritten, currentSeconds() - updateBegin);
+		}
+	}
+	fclose(deltasFile);
+	if (closeOutputWriter(&writer) == WRITER_FAILED && status == MODE_SUCCESS)
+	{
+		status = MODE_FAILED;
+	}
+	return status;
+}
+
+int runTableMode(const DetectorOptions *options)
+{
+	PeopleTable people = {0};
+	people.contacts.riskModel = options->riskModel;
+	PHASE_BEGIN(PHASE_LOAD_PEOPLE);
+	int status = modeStatusOfTable(loadPeopleTable(&people, options->pathToPeopleFile,
+	                                               options->numOfThreads));
+	PHASE_END(PHASE_LOAD_PEOPLE);
+	// If the people file is empty then surely (by assumptions) the meeting file is empty too, and
+	// the output file is empty. The meeting file is still opened, because it may not open at all
+	// and then this is an error
+	int hasPeople = people.len != NO_PEOPLE_IN_FIRST_FILE;
+	if (status == MODE_SUCCESS && hasPeople)
+	{
+		PHASE_BEGIN(PHASE_ID_INDEX);
+		status = modeStatusOfTable(indexPeopleTable(&people));
+		PHASE_END(PHASE_ID_INDEX);
+	}
+	if (status == MODE_SUCCESS)
+	{
+		status = readMeetingsFile(options, &people);
+	}
+	ProbSortKey *order = NULL;
+	size_t numOfKeys = 0;
+	if (status == MODE_SUCCESS && hasPeople)
+	{
+		if (options->pathToDeltas == NULL)
+		{
+			freeContactGraph(&people.contacts); // not needed anymore
+		}
+		PHASE_BEGIN(PHASE_SORT_BY_PROB);
+		status = modeStatusOfTable(orderPeopleTable(&people, &options->policy, options->top,
+		                                            options->minProb, options->maxClass,
+		                                            options->numOfThreads, &order, &numOfKeys));
+		PHASE_END(PHASE_SORT_BY_PROB);
+	}
+	if (status == MODE_SUCCESS)
+	{
+		status = writeOutputFile(&people, order, numOfKeys, options);
+	}
+	trackedFree(order, numOfKeys * sizeof(ProbSortKey));
+	if (status == MODE_SUCCESS && options->pathToDeltas != NULL)
+	{
+		PHASE_BEGIN(PHASE_INCREMENTAL);
+		status = applyDeltas(&people, options);
+		PHASE_END(PHASE_INCREMENTAL);
+	}
+	freePeopleTable(&people);
+	return status;
+}
+
+/**
+ * Returns the path of a snapshot: the prefix and then the suffix
+ * @param prefix The prefix (options->snapshotPrefix)
+ * @param suffix PEOPLE_SNAPSHOT_SUFFIX or MEETINGS_SNAPSHOT_SUFFIX
+ * @return The path (allocated, of strlen + 1 bytes), or NULL (no memory)
+ */
+static char *snapshotPath(const char *prefix, const char *suffix)
+{
+	size_t prefixLen = strlen(prefix);
+	size_t suffixLen = strlen(suffix);
+	char *path = (char *) trackedMalloc(prefixLen + suffixLen + 1);
+	if (path != NULL)
+	{
+		memcpy(path, prefix, prefixLen);
+		memcpy(path + prefixLen, suffix, suffixLen + 1); // with the '\0'
+	}
+	return path;
+}
+
+/**
+ * Creates a snapshot at the prefix and a suffix (see createSnapshot)
+ * @param prefix The prefix of the path
+ * @param suffix PEOPLE_SNAPSHOT_SUFFIX or MEETINGS_SNAPSHOT_SUFFIX
+ * @param kind SNAPSHOT_PEOPLE or SNAPSHOT_MEETINGS
+ * @param count The number of people (or of meetings)
+ * @param extraCount The number of bytes of all the names (or the number of seeds)
+ * @param snapshot The snapshot (empty)
+ * @return MODE_SUCCESS, MODE_OUTPUT_FAILED or MODE_FAILED
+ */
+static int createSnapshotAt(const char *prefix, const char *suffix, unsigned int kind, size_t count,
+                            size_t extraCount, Snapshot *snapshot)
+{
+	char *path = snapshotPath(prefix, suffix);
+	if (path == NULL)
+	{
+		return MODE_FAILED;
+	}
+	int status = modeStatusOfOutput(createSnapshot(path, kind, count, extraCount, snapshot),
+	                                SNAPSHOT_SUCCESS, SNAPSHOT_OPEN_FAILED);
+	trackedFree(path, strlen(path) + 1);
+	return status;
+}
+
+/**
+ * Writes the table of people (as it was read, before any sort) as a people snapshot
+ * @param people The table of people
+ * @param prefix The prefix of the path of the snapshot (PEOPLE_SNAPSHOT_SUFFIX is added)
+ * @return MODE_SUCCESS, MODE_OUTPUT_FAILED or MODE_FAILED
+ */
+static int writePeopleSnapshot(const PeopleTable *people, const char *prefix)
+{
+	size_t numOfNameBytes = 0;
+	for (size_t row = 0; row < people->len; ++row)
+	{
+		numOfNameBytes += people->nameLengths[row];
+	}
+	Snapshot snapshot = {0};
+	int status = createSnapshotAt(prefix, PEOPLE_SNAPSHOT_SUFFIX, SNAPSHOT_PEOPLE, people->len,
+	                              numOfNameBytes, &snapshot);
+	if (status != MODE_SUCCESS)
+	{
+		return status;
+	}
+	if (people->len != NO_PEOPLE_IN_FIRST_FILE)
+	{
+		memcpy(snapshot.ids, people->ids, people->len * sizeof(size_t));
+		memcpy(snapshot.ages, people->ages, people->len * sizeof(float));
+		memcpy(snapshot.probs, people->probsInfected, people->len * sizeof(float));
+		memcpy(snapshot.nameLengths, people->nameLengths, people->len * sizeof(unsigned int));
+	}
+	char *name = snapshot.names;
+	for (size_t row = 0; row < people->len; ++row)
+	{
+		memcpy(name, people->names[row], people->nameLengths[row]);
+		name += people->nameLengths[row];
+	}
+	return finishSnapshot(&snapshot) == SNAPSHOT_SUCCESS ? MODE_SUCCESS : MODE_FAILED;
+}
+
+/**
+ * A SeedConsumer that adds the seed to the meeting list
+ * @param id The ID of the seed
+ * @param context The MeetingList
+ * @return SCAN_SUCCESS or SCAN_FAILED (no memory)
+ */
+static int addListSeed(size_t id, void *context)
+{
+	MeetingList *list = (MeetingList *) context;
+	if (ensureArrayCapacity((void **) &list->seeds, &list->seedsCapacity, list->numOfSeeds,
+	                        sizeof(size_t)) == GROW_FAILED)
+	{
+		return SCAN_FAILED;
+	}
+	list->seeds[list->numOfSeeds++] = id;
+	return SCAN_SUCCESS;
+}
+
+/**
+ * Reads the seeds and the meetings of the open meeting file (list->meetingsFile) line by line
+ * into the list
+ * @param list The list
+ * @return MODE_SUCCESS or MODE_FAILED (an invalid line or no memory)
+ */
+static int readMeetingList(MeetingList *list)
+{
+	char currentRow[MAX_LINE_SIZE];
+	//first line. get the ids of the first infectors. (The first line is different from the rest!)
+	if (fgets(currentRow, sizeof(currentRow), list->meetingsFile) == NULL)
+	{
+		return MODE_SUCCESS;
+	}
+	size_t rowLen = strlen(currentRow);
+	COUNT_BYTES_READ(rowLen);
+	if (parseSeedsFromBytes(currentRow, findLineEnd(currentRow, currentRow + rowLen), addListSeed,
+	                        list) == SCAN_FAILED)
+	{
+		return MODE_FAILED;
+	}
+	while (fgets(currentRow, sizeof(currentRow), list->meetingsFile))
+	{
+		rowLen = strlen(currentRow);
+		COUNT_BYTES_READ(rowLen);
+		MeetingInfo meeting;
+		if (scanMeetingFromBytes(currentRow, findLineEnd(currentRow, currentRow + rowLen),
+		                         &meeting) == SCAN_FAILED ||
+		    ensureArrayCapacity((void **) &list->meetings, &list->meetingsCapacity,
+		                        list->numOfMeetings, sizeof(MeetingInfo)) == GROW_FAILED)
+		{
+			return MODE_FAILED;
+		}
+		list->meetings[list->numOfMeetings++] = meeting;
+	}
+	return MODE_SUCCESS;
+}
+
+/**
+ * Releases the list (and closes its file and its snapshot)
+ * @param list The list
+ */
+static void freeMeetingList(MeetingList *list)
+{
+	trackedFree(list->seeds, list->seedsCapacity * sizeof(size_t));
+	trackedFree(list->meetings, list->meetingsCapacity * sizeof(MeetingInfo));
+	if (list->meetingsFile != NULL)
+	{
+		fclose(list->meetingsFile);
+	}
+	closeSnapshot(&list->snapshot);
+	MeetingList empty = {0};
+	*list = empty;
+}
+
+/**
+ * Reads the meeting file (a text file) and writes it as a meetings snapshot
+ * @param pathToMeetings Path to the meeting file
+ * @param prefix The prefix of the path of the snapshot (MEETINGS_SNAPSHOT_SUFFIX is added)
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED, MODE_OUTPUT_FAILED or MODE_FAILED
+ */
+static int writeMeetingsSnapshot(const char *pathToMeetings, const char *prefix)
+{
+	MeetingList list = {0};
+	list.meetingsFile = fopen(pathToMeetings, READING_MODE);
+	int status = list.meetingsFile != NULL ? readMeetingList(&list) : MODE_INPUT_FAILED;
+	if (status == MODE_SUCCESS)
+	{
+		status = createSnapshotAt(prefix, MEETINGS_SNAPSHOT_SUFFIX, SNAPSHOT_MEETINGS,
+		                          list.numOfMeetings, list.numOfSeeds, &list.snapshot);
+	}
+	if (status == MODE_SUCCESS)
+	{
+		if (list.numOfSeeds > 0)
+		{
+			memcpy(list.snapshot.seeds, list.seeds, list.numOfSeeds * sizeof(size_t));
+		}
+		if (list.numOfMeetings > 0)
+		{
+			memcpy(list.snapshot.meetings, list.meetings,
+			       list.numOfMeetings * sizeof(MeetingInfo));
+		}
+		status = finishSnapshot(&list.snapshot) == SNAPSHOT_SUCCESS ? MODE_SUCCESS : MODE_FAILED;
+	}
+	freeMeetingList(&list);
+	return status;
+}
+
+int runSnapshotConverter(const DetectorOptions *options)
+{
+	PHASE_BEGIN(PHASE_WRITE_SNAPSHOTS);
+	PeopleTable people = {0};
+	int status = modeStatusOfTable(loadPeopleTable(&people, options->pathToPeopleFile,
+	                                               options->numOfThreads));
+	if (status == MODE_SUCCESS)
+	{
+		status = writePeopleSnapshot(&people, options->snapshotPrefix);
+	}
+	freePeopleTable(&people);
+	if (status == MODE_SUCCESS)
+	{
+		status = writeMeetingsSnapshot(options->pathToMeetings, options->snapshotPrefix);
+	}
+	PHASE_END(PHASE_WRITE_SNAPSHOTS);
+	return status;
+}
+
+/**
+ * Opens an input file of the streaming mode: a snapshot is mapped, and any other file is opened
+ * to be read line by line
+ * @param path The path of the file
+ * @param kind SNAPSHOT_PEOPLE or SNAPSHOT_MEETINGS
+ * @param snapshot Will contain the snapshot (empty)
+ * @param file Will point to the open file (NULL)
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED or MODE_FAILED (an invalid snapshot)
+ */
+static int openStreamingInput(const char *path, unsigned int kind, Snapshot *snapshot,
+                              FILE **file)
+{
+	int snapshotStatus = openSnapshot(path, kind, snapshot);
+	if (snapshotStatus == SNAPSHOT_NOT_SNAPSHOT)
+	{
+		*file = fopen(path, READING_MODE);
+	}
+	if (snapshotStatus == SNAPSHOT_OPEN_FAILED ||
+	    (snapshotStatus == SNAPSHOT_NOT_SNAPSHOT && *file == NULL))
+	{
+		return MODE_INPUT_FAILED;
+	}
+	if (snapshotStatus != SNAPSHOT_SUCCESS && snapshotStatus != SNAPSHOT_NOT_SNAPSHOT)
+	{
+		return MODE_FAILED;
+	}
+	return MODE_SUCCESS;
+}
+
+/**
+ * A SeedConsumer that adds one seed to the graph of the streaming mode (its vertex comes from the
+ * map)
+ * @param id The ID of the seed
+ * @param context The state of the streaming mode
+ * @return SCAN_SUCCESS or SCAN_FAILED (no memory)
+ */
+static int addMapSeed(size_t id, void *context)
+{
+	StreamingState *state = (StreamingState *) context;
+	size_t node = nodeOfId(&state->probs, id);
+	if (node == NODE_FAILED || addSeed(&state->contacts, node) == GRAPH_FAILED)
+	{
+		return SCAN_FAILED;
+	}
+	return SCAN_SUCCESS;
+}
+
+/**
+ * Adds one meeting to the batch of meetings of the streaming mode (the vertices come from the
+ * map). A full batch is added to the graph
+ * @param state The state of the streaming mode
+ * @param meeting The meeting
+ * @return MODE_SUCCESS or MODE_FAILED (no memory)
+ */
+static int addMapMeeting(StreamingState *state, const MeetingInfo *meeting)
+{
+	size_t infector = nodeOfId(&state->probs, meeting->infectorId);
+	size_t infected = nodeOfId(&state->probs, meeting->infectedId);
+	if (infector == NODE_FAILED || infected == NODE_FAILED)
+	{
+		return MODE_FAILED;
+	}
+	MeetingBatch *batch = &state->meetingBatch;
+	batch->infectors[batch->len] = infector;
+	batch->infecteds[batch->len] = infected;
+	batch->distances[batch->len] = meeting->distance;
+	batch->times[batch->len] = meeting->time;
+	if (++batch->len == CRNA_BATCH_SIZE &&
+	    addContactBatch(&state->contacts, batch) == GRAPH_FAILED)
+	{
+		return MODE_FAILED;
+	}
+	return MODE_SUCCESS;
+}
+
+/**
+ * Reads the meeting file line by line (or its snapshot) into the graph of the meetings, and
+ * propagates the risk over it. The map keeps the probabilities of the people who appear in it
+ * @param state The state of the streaming mode (with the open meeting file)
+ * @param combineRule How the exposures of one person are combined
+ * @param numOfThreads The maximal number of threads of the propagation
+ * @return MODE_SUCCESS or MODE_FAILED (an invalid line or no memory)
+ */
+static int readMeetingsIntoMap(StreamingState *state, int combineRule, size_t numOfThreads)
+{
+	const Snapshot *snapshot = &state->meetingsSnapshot;
+	int status = MODE_SUCCESS;
+	if (snapshot->data != NULL) // nothing to parse
+	{
+		if (snapshot->extraCount == 0) // like an empty meeting file
+		{
+			return MODE_SUCCESS;
+		}
+		for (size_t i = 0; i < snapshot->extraCount && status == MODE_SUCCESS; ++i)
+		{
+			status = addMapSeed(snapshot->seeds[i], state) == SCAN_SUCCESS ? MODE_SUCCESS :
+			         MODE_FAILED;
+		}
+		for (size_t i = 0; i < snapshot->count && status == MODE_SUCCESS; ++i)
+		{
+			status = addMapMeeting(state, &snapshot->meetings[i]);
+		}
+		closeSnapshot(&state->meetingsSnapshot); // not needed for the propagation
+	}
+	else
+	{
+		char currentRow[MAX_LINE_SIZE];
+		//first line. get the ids of the first infectors. (The first line is different from the
+		// rest!)
+		if (fgets(currentRow, sizeof(currentRow), state->meetingsFile) == NULL)
+		{
+			return MODE_SUCCESS;
+		}
+		size_t rowLen = strlen(currentRow);
+		COUNT_BYTES_READ(rowLen);
+		if (parseSeedsFromBytes(currentRow, findLineEnd(currentRow, currentRow + rowLen),
+		                        addMapSeed, state) == SCAN_FAILED)
+		{
+			return MODE_FAILED;
+		}
+		while (status == MODE_SUCCESS && fgets(currentRow, sizeof(currentRow), state->meetingsFile))
+		{
+			rowLen = strlen(currentRow);
+			COUNT_BYTES_READ(rowLen);
+			MeetingInfo meeting;
+			status = scanMeetingFromBytes(currentRow, findLineEnd(currentRow, currentRow + rowLen),
+			                              &meeting) == SCAN_FAILED ? MODE_FAILED :
+			         addMapMeeting(state, &meeting);
+		}
+	}
+	if (status != MODE_SUCCESS ||
+	    addContactBatch(&state->contacts, &state->meetingBatch) == GRAPH_FAILED) // the last batch
+	{
+		return MODE_FAILED;
+	}
+	float *probs = allocateNodeProbs(&state->probs);
+	if (probs == NULL ||
+	    propagateRisk(&state->contacts, state->probs.len, state->probs.ids, combineRule,
+	                  numOfThreads, probs) == GRAPH_FAILED)
+	{
+		return MODE_FAILED;
+	}
+	freeContactGraph(&state->contacts);
+	return MODE_SUCCESS;
+}
+
+/**
+ * Gives one person with his probability (see matchProb) and his class to the spiller
+ * @param state The state of the streaming mode
+ * @param record The person (without his probability and his class)
+ * @param age The age of the person
+ * @return MODE_SUCCESS or MODE_FAILED (no memory, or a temporary file failed)
+ */
+static int spillPerson(StreamingState *state, PersonRecord *record, float age)
+{
+	record->probInfected = matchProb(&state->probs, record->id);
+	record->riskClass = classOfPerson(state->policy, age, record->probInfected);
+	return addRecord(&state->spiller, record) == STREAM_SUCCESS ? MODE_SUCCESS : MODE_FAILED;
+}
+
+/**
+ * Reads the people file line by line, and gives every person to the spiller
+ * @param state The state of the streaming mode (with the open people file)
+ * @return MODE_SUCCESS or MODE_FAILED (an invalid line, no memory or a temporary file failed)
+ */
+static int spillPeopleFile(StreamingState *state)
+{
+	char currentRow[MAX_LINE_SIZE];
+	int status = MODE_SUCCESS;
+	while (status == MODE_SUCCESS && fgets(currentRow, sizeof(currentRow), state->peopleFile))
+	{
+		size_t rowLen = strlen(currentRow);
+		COUNT_BYTES_READ(rowLen);
+		const char *name;
+		size_t nameLen;
+		float age;
+		PersonRecord record;
+		if (scanPersonFromBytes(currentRow, findLineEnd(currentRow, currentRow + rowLen), &name,
+		                        &nameLen, &record.id, &age) == SCAN_FAILED)
+		{
+			return MODE_FAILED;
+		}
+		record.name = name;
+		record.nameLen = (unsigned int) nameLen;
+		status = spillPerson(state, &record, age);
+	}
+	return status;
+}
+
+/**
+ * Gives every person of the people snapshot to the spiller
+ * @param state The state of the streaming mode (with the people snapshot)
+ * @return MODE_SUCCESS or MODE_FAILED (an invalid snapshot, no memory or a temporary file failed)
+ */
+static int spillPeopleSnapshot(StreamingState *state)
+{
+	const Snapshot *snapshot = &state->peopleSnapshot;
+	const char *name = snapshot->names;
+	size_t numOfNameBytes = 0;
+	int status = MODE_SUCCESS;
+	for (size_t row = 0; row < snapshot->count && status == MODE_SUCCESS; ++row)
+	{
+		unsigned int nameLen = snapshot->nameLengths[row];
+		numOfNameBytes += nameLen;
+		if (numOfNameBytes > snapshot->extraCount) // the lengths do not match the names
+		{
+			return MODE_FAILED;
+		}
+		PersonRecord record;
+		record.id = snapshot->ids[row];
+		record.name = name;
+		record.nameLen = nameLen;
+		status = spillPerson(state, &record, snapshot->ages[row]);
+		name += nameLen;
+	}
+	return status;
+}
+
+/**
+ * Computes the probabilities of the streaming mode from the meeting file, and then gives every
+ * person of the people file to the spiller
+ * @param state The state of the streaming mode (with its open input files)
+ * @param options The options
+ * @return MODE_SUCCESS or MODE_FAILED
+ */
+static int spillStreamingPeople(StreamingState *state, const DetectorOptions *options)
+{
+	PHASE_BEGIN(PHASE_READ_MEETINGS);
+	int status = readMeetingsIntoMap(state, options->combineRule, options->numOfThreads);
+	PHASE_END(PHASE_READ_MEETINGS);
+	if (status != MODE_SUCCESS)
+	{
+		return status;
+	}
+	PHASE_BEGIN(PHASE_LOAD_PEOPLE);
+	// A room too small for any buffer gives the smallest one, which goes over the budget
+	size_t room = getTrackedHeapRoom();
+	state->outputBufferSize = room / OUTPUT_BUFFER_DIVISOR;
+	state->outputBufferSize = state->outputBufferSize < MIN_OUTPUT_BUFFER_SIZE ?
+	                          MIN_OUTPUT_BUFFER_SIZE : state->outputBufferSize;
+	state->outputBufferSize = state->outputBufferSize > OUTPUT_BUFFER_SIZE ? OUTPUT_BUFFER_SIZE :
+	                          state->outputBufferSize;
+	size_t reserve = state->outputBufferSize + room / RUNS_RESERVE_DIVISOR;
+	if (initSpiller(&state->spiller, room > reserve ? room - reserve : 0) == STREAM_FAILED)
+	{
+		status = MODE_FAILED;
+	}
+	else if (state->peopleFile != NULL)
+	{
+		status = spillPeopleFile(state);
+	}
+	else
+	{
+		status = spillPeopleSnapshot(state);
+	}
+	if (status == MODE_SUCCESS && !isEveryNodeMatched(&state->probs)) // an ID that is not a person
+	{
+		status = MODE_FAILED;
+	}
+	PHASE_END(PHASE_LOAD_PEOPLE);
+	freeProbMap(&state->probs); // not needed for the merge
+	return status;
+}
+
+/**
+ * A RecordConsumer that writes one person to the output file
+ * @param record The person
+ * @param context The writer of the output file
+ * @return STREAM_SUCCESS
+ */
+static int writeRecordToOutput(const PersonRecord *record, void *context)
+{
+	writePersonLine((OutputWriter *) context, record->name, record->nameLen, record->id,
+	                record->riskClass);
+	return STREAM_SUCCESS;
+}
+
+/**
+ * Releases everything the streaming mode holds (and closes its files)
+ * @param state The state of the streaming mode
+ */
+static void freeStreamingState(StreamingState *state)
+{
+	freeProbMap(&state->probs);
+	freeContactGraph(&state->contacts);
+	freeSpiller(&state->spiller);
+	if (state->peopleFile != NULL)
+	{
+		fclose(state->peopleFile);
+		state->peopleFile = NULL;
+	}
+	if (state->meetingsFile != NULL)
+	{
+		fclose(state->meetingsFile);
+		state->meetingsFile = NULL;
+	}
+	closeSnapshot(&state->peopleSnapshot);
+	closeSnapshot(&state->meetingsSnapshot);
+	closeOutputWriter(&state->output);
+}
+
+/**
+ * The streaming mode under the limit of the tracked heap (see runStreamingMode)
+ * @param options The paths and the options
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED, MODE_OUTPUT_FAILED or MODE_FAILED
+ */
+static int runStreamingUnderLimit(const DetectorOptions *options)
+{
+	StreamingState state = {0};
+	state.outputBufferSize = MIN_OUTPUT_BUFFER_SIZE; // without people nothing is written
+	state.policy = &options->policy;
+	state.contacts.riskModel = options->riskModel;
+	// The people file is opened first, so the errors are found in the same order as in the table
+	// mode. It stays open (and is read only once) so it can also be a pipe
+	int status = openStreamingInput(options->pathToPeopleFile, SNAPSHOT_PEOPLE,
+	                                &state.peopleSnapshot, &state.peopleFile);
+	int noPeople = state.peopleSnapshot.data != NULL && state.peopleSnapshot.count == 0;
+	if (state.peopleFile != NULL)
+	{
+		int firstChar = fgetc(state.peopleFile);
+		noPeople = firstChar == EOF;
+		ungetc(firstChar, state.peopleFile);
+	}
+	if (status == MODE_SUCCESS)
+	{
+		status = openStreamingInput(options->pathToMeetings, SNAPSHOT_MEETINGS,
+		                            &state.meetingsSnapshot, &state.meetingsFile);
+	}
+	if (status == MODE_SUCCESS && !noPeople) // If the people file is empty the meeting file is too
+	{
+		status = spillStreamingPeople(&state, options);
+	}
+	if (status != MODE_SUCCESS)
+	{
+		freeStreamingState(&state);
+		return status;
+	}
+	PHASE_BEGIN(PHASE_OUTPUT);
+	double outputBegin = currentSeconds();
+	status = modeStatusOfOutput(openSizedOutputWriter(&state.output, OUTPUT_FILE,
+	                                                  state.outputBufferSize),
+	                            WRITER_SUCCESS, WRITER_OPEN_FAILED);
+	if (status == MODE_SUCCESS && !noPeople &&
+	    mergeRuns(&state.spiller, writeRecordToOutput, &state.output) == STREAM_FAILED)
+	{
+		status = MODE_FAILED;
+	}
+	if (status == MODE_SUCCESS && closeOutputWriter(&state.output) == WRITER_FAILED)
+	{
+		status = MODE_FAILED;
+	}
+	PHASE_END(PHASE_OUTPUT);
+	if (status == MODE_SUCCESS && options->printTiming) // the merge and the output are one phase
+	{
+		fprintf(options->log, "output seconds: %.6f\n", currentSeconds() - outputBegin);
+	}
+	if (status == MODE_SUCCESS && options->printMemoryStats)
+	{
+		fprintf(options->log, "sorted runs: %zu\n", getNumOfRuns(&state.spiller));
+	}
+	freeStreamingState(&state);
+	return status;
+}
+
+int runStreamingMode(const DetectorOptions *options)
+{
+	AllocationStats stats;
+	getAllocationStats(&stats);
+	setTrackedHeapLimit(options->memoryBudget < NO_HEAP_LIMIT - stats.bytesInUse ?
+	                    stats.bytesInUse + options->memoryBudget : NO_HEAP_LIMIT);
+	int status = runStreamingUnderLimit(options);
+	if (status == MODE_FAILED && isTrackedHeapLimitReached()) // an allocation went over the budget
+	{
+		status = MODE_OVER_BUDGET;
+	}
+	setTrackedHeapLimit(NO_HEAP_LIMIT);
+	return status;
+}
+
+/**
+ * Reads the people file and keeps only the people of the shard of the worker
+ * @param worker The worker
+ * @param path Path to the people file
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED or MODE_FAILED (an invalid line or no memory)
+ */
+static int loadShardPeople(ShardWorker *worker, const char *path)
+{
+	PeopleTable *people = &worker->people;
+	worker->inputFile = fopen(path, READING_MODE);
+	if (worker->inputFile == NULL)
+	{
+		return MODE_INPUT_FAILED;
+	}
+	char currentRow[MAX_LINE_SIZE];
+	int status = MODE_SUCCESS;
+	while (status == MODE_SUCCESS && fgets(currentRow, sizeof(currentRow), worker->inputFile))
+	{
+		size_t rowLen = strlen(currentRow);
+		COUNT_BYTES_READ(rowLen);
+		size_t row = people->len;
+		if (ensurePeopleCapacity(people) == GROW_FAILED ||
+		    parsePersonFromBytes(currentRow, findLineEnd(currentRow, currentRow + rowLen), people,
+		                         row) == SCAN_FAILED)
+		{
+			status = MODE_FAILED;
+		}
+		// Everyone is parsed (an invalid line is an error in every shard), but only the people of
+		// the shard are kept: the next line simply overwrites the row of anyone else
+		else if (shardOfId(people->ids[row], worker->numOfShards) == worker->shard)
+		{
+			char *name = (char *) arenaAlloc(&people->namesArena, people->nameLengths[row]);
+			if (name == NULL)
+			{
+				status = MODE_FAILED;
+			}
+			else
+			{
+				memcpy(name, people->names[row], people->nameLengths[row]);
+				people->names[row] = name;
+				people->len++;
+			}
+		}
+		worker->numOfLines++;
+	}
+	fclose(worker->inputFile);
+	worker->inputFile = NULL;
+	return status;
+}
+
+/**
+ * Adds the meetings of the batch (worker->people.meetingBatch) to the graph of the shard, with
+ * their risks computed by the model for the whole batch at once, and empties the batch
+ * @param worker The worker
+ * @return MODE_SUCCESS or MODE_FAILED (no memory)
+ */
+static int flushShardBatch(ShardWorker *worker)
+{
+	MeetingBatch *batch = &worker->people.meetingBatch;
+	float risks[CRNA_BATCH_SIZE];
+	computeRisks(worker->people.contacts.riskModel, batch->distances, batch->times, risks,
+	             batch->len);
+	for (size_t i = 0; i < batch->len; ++i)
+	{
+		if (addShardContact(&worker->graph, batch->infectors[i], batch->infecteds[i], risks[i]) ==
+		    SHARD_FAILED)
+		{
+			return MODE_FAILED;
+		}
+	}
+	batch->len = 0;
+	return MODE_SUCCESS;
+}
+
+/**
+ * A SeedConsumer that adds a seed of the shard of the worker to the graph of the shard (the seeds
+ * of the other shards are skipped)
+ * @param id The ID of the seed
+ * @param context The worker
+ * @return SCAN_SUCCESS or SCAN_FAILED (the seed is not a person)
+ */
+static int addWorkerSeed(size_t id, void *context)
+{
+	ShardWorker *worker = (ShardWorker *) context;
+	size_t row;
+	if (shardOfId(id, worker->numOfShards) != worker->shard)
+	{
+		return SCAN_SUCCESS;
+	}
+	if (findTableRow(&worker->people, id, &row) != TABLE_SUCCESS)
+	{
+		return SCAN_FAILED;
+	}
+	addShardSeed(&worker->graph, row);
+	return SCAN_SUCCESS;
+}
+
+/**
+ * Adds a meeting to the shard of the worker: to the batch if its infected is in the shard, as a
+ * subscriber if only its infector is. A person of the shard who is not in the table is an invalid
+ * meeting file (like in the table mode, see findTableRow)
+ * @param worker The worker
+ * @param meeting The meeting
+ * @return MODE_SUCCESS or MODE_FAILED (an unknown person or no memory)
+ */
+static int addWorkerMeeting(ShardWorker *worker, const MeetingInfo *meeting)
+{
+	size_t infectorShard = shardOfId(meeting->infectorId, worker->numOfShards);
+	size_t infectedShard = shardOfId(meeting->infectedId, worker->numOfShards);
+	size_t infector;
+	size_t infected;
+	if (infectedShard == worker->shard)
+	{
+		if (findTableRow(&worker->people, meeting->infectedId, &infected) != TABLE_SUCCESS)
+		{
+			return MODE_FAILED;
+		}
+		if (infectorShard != worker->shard)
+		{
+			infector = remoteNodeOfId(&worker->graph, meeting->infectorId);
+		}
+		else if (findTableRow(&worker->people, meeting->infectorId, &infector) != TABLE_SUCCESS)
+		{
+			return MODE_FAILED;
+		}
+		if (infector == NODE_FAILED)
+		{
+			return MODE_FAILED;
+		}
+		MeetingBatch *batch = &worker->people.meetingBatch;
+		batch->infectors[batch->len] = infector;
+		batch->infecteds[batch->len] = infected;
+		batch->distances[batch->len] = meeting->distance;
+		batch->times[batch->len] = meeting->time;
+		return ++batch->len == CRNA_BATCH_SIZE ? flushShardBatch(worker) : MODE_SUCCESS;
+	}
+	if (infectorShard == worker->shard)
+	{
+		if (findTableRow(&worker->people, meeting->infectorId, &infector) != TABLE_SUCCESS)
+		{
+			return MODE_FAILED;
+		}
+		addShardSubscriber(&worker->graph, infector, infectedShard);
+	}
+	return MODE_SUCCESS;
+}
+
+/**
+ * Reads the meeting file and adds to the graph of the shard the seeds of the shard, the meetings
+ * whose infected is in the shard and the subscribers of the meetings whose infector is
+ * @param worker The worker
+ * @param path Path to the meeting file
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED or MODE_FAILED
+ */
+static int readShardMeetings(ShardWorker *worker, const char *path)
+{
+	worker->inputFile = fopen(path, READING_MODE);
+	if (worker->inputFile == NULL)
+	{
+		return MODE_INPUT_FAILED;
+	}
+	char currentRow[MAX_LINE_SIZE];
+	int status = MODE_SUCCESS;
+	// The first file may be empty, and then the meeting file is not read (like in the table mode)
+	if (worker->numOfLines != NO_PEOPLE_IN_FIRST_FILE &&
+	    fgets(currentRow, sizeof(currentRow), worker->inputFile) != NULL)
+	{
+		size_t rowLen = strlen(currentRow);
+		COUNT_BYTES_READ(rowLen);
+		if (parseSeedsFromBytes(currentRow, findLineEnd(currentRow, currentRow + rowLen),
+		                        addWorkerSeed, worker) == SCAN_FAILED)
+		{
+			status = MODE_FAILED;
+		}
+		while (status == MODE_SUCCESS && fgets(currentRow, sizeof(currentRow), worker->inputFile))
+		{
+			rowLen = strlen(currentRow);
+			COUNT_BYTES_READ(rowLen);
+			MeetingInfo meeting;
+			status = scanMeetingFromBytes(currentRow, findLineEnd(currentRow, currentRow + rowLen),
+			                              &meeting) == SCAN_FAILED ? MODE_FAILED :
+			         addWorkerMeeting(worker, &meeting);
+		}
+		if (status == MODE_SUCCESS)
+		{
+			status = flushShardBatch(worker); // the last batch
+		}
+	}
+	fclose(worker->inputFile);
+	worker->inputFile = NULL;
+	return status;
+}
+
+/**
+ * Writes the people of the shard to the pipe, as records sorted like the output file
+ * @param worker The worker
+ * @param policy The policy of the classes
+ * @return MODE_SUCCESS or MODE_FAILED (no memory, or the pipe was closed)
+ */
+static int writeShardRecords(ShardWorker *worker, const RiskPolicy *policy)
+{
+	PeopleTable *people = &worker->people;
+	if (people->len == NO_PEOPLE_IN_FIRST_FILE)
+	{
+		return MODE_SUCCESS;
+	}
+	worker->order = (ProbSortKey *) trackedMalloc(people->len * sizeof(ProbSortKey));
+	worker->classes = (unsigned char *) trackedMalloc(people->len);
+	if (worker->order == NULL || worker->classes == NULL)
+	{
+		return MODE_FAILED;
+	}
+	classifyPeople(policy, people->ages, people->probsInfected, people->len, worker->classes);
+	for (size_t row = 0; row < people->len; ++row)
+	{
+		worker->order[row].id = people->ids[row];
+		worker->order[row].row = row;
+		worker->order[row].probInfected = people->probsInfected[row];
+		worker->order[row].riskClass = worker->classes[row];
+	}
+	// One thread: every shard already has a process of its own
+	if (sortByProbability(worker->order, people->len, 1) == ORDER_FAILED)
+	{
+		return MODE_FAILED;
+	}
+	for (size_t i = 0; i < people->len; ++i)
+	{
+		size_t row = worker->order[i].row;
+		PersonRecord record;
+		record.probInfected = people->probsInfected[row];
+		record.id = people->ids[row];
+		record.name = people->names[row];
+		record.nameLen = people->nameLengths[row];
+		record.riskClass = worker->classes[row];
+		if (writeRecordToRun(&record, worker->records) == STREAM_FAILED)
+		{
+			return MODE_FAILED;
+		}
+	}
+	return MODE_SUCCESS;
+}
+
+/**
+ * Releases everything a worker of the sharded mode holds (and closes its files and sockets)
+ * @param worker The worker
+ */
+static void freeShardWorker(ShardWorker *worker)
+{
+	freeShardGraph(&worker->graph);
+	trackedFree(worker->order,
+	            worker->order != NULL ? worker->people.len * sizeof(ProbSortKey) : 0);
+	worker->order = NULL;
+	trackedFree(worker->classes, worker->classes != NULL ? worker->people.len : 0);
+	worker->classes = NULL;
+	freePeopleTable(&worker->people);
+	if (worker->inputFile != NULL)
+	{
+		fclose(worker->inputFile);
+		worker->inputFile = NULL;
+	}
+	if (worker->records != NULL)
+	{
+		fclose(worker->records);
+		worker->records = NULL;
+	}
+}
+
+/**
+ * The worker of one shard, in its own process: loads the people of the shard and its meetings,
+ * propagates together with the other workers and writes the records of its people, sorted, to the
+ * pipe. Never returns: the process exits with EXIT_FAILURE on any error, without a message (the
+ * main process reports it, once)
+ * @param options The paths and the options
+ * @param mesh The sockets between the shards
+ * @param shard The shard of the worker
+ * @param recordsFd The end of the pipe the records are written to
+ */
+static void runShardWorker(const DetectorOptions *options, ShardMesh *mesh, size_t shard,
+                           int recordsFd)
+{
+	double begin = currentSeconds();
+	ShardWorker worker = {0};
+	worker.shard = shard;
+	worker.numOfShards = options->numOfShards;
+	worker.people.contacts.riskModel = options->riskModel;
+	worker.records = fdopen(recordsFd, "wb"); // on an error the process ends and closes it
+	int status = worker.records != NULL ? loadShardPeople(&worker, options->pathToPeopleFile) :
+	             MODE_FAILED;
+	if (status == MODE_SUCCESS &&
+	    (indexPeopleTable(&worker.people) != TABLE_SUCCESS ||
+	     initShardGraph(&worker.graph, mesh, shard, worker.people.ids, worker.people.len) ==
+	     SHARD_FAILED))
+	{
+		status = MODE_FAILED;
+	}
+	if (status == MODE_SUCCESS)
+	{
+		status = readShardMeetings(&worker, options->pathToMeetings);
+	}
+	size_t numOfMeetings = worker.graph.numOfEdges;
+	size_t numOfRounds = 0;
+	if (status == MODE_SUCCESS &&
+	    (propagateShard(&worker.graph, options->combineRule, worker.people.probsInfected,
+	                    &numOfRounds) == SHARD_FAILED || fputc(SHARD_READY, worker.records) == EOF))
+	{
+		status = MODE_FAILED;
+	}
+	freeShardGraph(&worker.graph); // not needed for the records
+	if (status == MODE_SUCCESS)
+	{
+		status = writeShardRecords(&worker, &options->policy);
+	}
+	if (status == MODE_SUCCESS)
+	{
+		int closeStatus = fclose(worker.records);
+		worker.records = NULL;
+		status = closeStatus == 0 ? MODE_SUCCESS : MODE_FAILED;
+	}
+	if (status == MODE_SUCCESS && options->printTiming)
+	{
+		fprintf(options->log, "shard %zu: %zu people, %zu meetings, %zu rounds, seconds: %.6f\n",
+		        shard, worker.people.len, numOfMeetings, numOfRounds, currentSeconds() - begin);
+		fflush(options->log);
+	}
+	freeShardWorker(&worker);
+	_exit(status == MODE_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE); // the buffers and the handlers
+	// of the main process are not the worker's
+}
+
+/**
+ * Waits for all the workers of the sharded mode
+ * @param workers The process IDs of the workers
+ * @param numOfWorkers The number of workers
+ * @return MODE_SUCCESS if all of them exited with EXIT_SUCCESS, MODE_FAILED otherwise
+ */
+static int waitForShardWorkers(const pid_t *workers, size_t numOfWorkers)
+{
+	int result = MODE_SUCCESS;
+	for (size_t i = 0; i < numOfWorkers; ++i)
+	{
+		int status;
+		if (waitpid(workers[i], &status, 0) != workers[i] || !WIFEXITED(status) ||
+		    WEXITSTATUS(status) != EXIT_SUCCESS)
+		{
+			result = MODE_FAILED;
+		}
+	}
+	return result;
+}
+
+/**
+ * Checks that the input files can be opened and are regular text files (a mode that reads them
+ * again in other threads or processes can not read a pipe or a snapshot). A named pipe is found
+ * by stat, so it is not opened here, and nothing waits for its writer
+ * @param options The paths
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED, MODE_NOT_TEXT or MODE_FAILED (an invalid snapshot)
+ */
+static int checkTextInputs(const DetectorOptions *options)
+{
+	const char *paths[] = {options->pathToPeopleFile, options->pathToMeetings};
+	const unsigned int kinds[] = {SNAPSHOT_PEOPLE, SNAPSHOT_MEETINGS};
+	for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); ++i)
+	{
+		Snapshot snapshot = {0};
+		int snapshotStatus = openSnapshot(paths[i], kinds[i], &snapshot);
+		if (snapshotStatus == SNAPSHOT_OPEN_FAILED)
+		{
+			return MODE_INPUT_FAILED;
+		}
+		else if (snapshotStatus == SNAPSHOT_SUCCESS)
+		{
+			closeSnapshot(&snapshot);
+			return MODE_NOT_TEXT;
+		}
+		else if (snapshotStatus != SNAPSHOT_NOT_SNAPSHOT)
+		{
+			return MODE_FAILED;
+		}
+		struct stat fileStat;
+		if (stat(paths[i], &fileStat) != 0)
+		{
+			return MODE_INPUT_FAILED;
+		}
+		if (!S_ISREG(fileStat.st_mode)) // a pipe, that every worker would read from the start
+		{
+			return MODE_NOT_TEXT;
+		}
+	}
+	return MODE_SUCCESS;
+}
+
+int runShardedMode(const DetectorOptions *options)
+{
+	// The input files are checked here, so their errors are reported once and in the same order as
+	// in the table mode. Every worker opens them again, so they have to be regular text files
+	int status = checkTextInputs(options);
+	if (status != MODE_SUCCESS)
+	{
+		return status;
+	}
+	ShardMesh mesh = {0};
+	RunSpiller spiller = {0};
+	if (createShardMesh(&mesh, options->numOfShards) == SHARD_FAILED ||
+	    initSpiller(&spiller, MIN_MEMORY_BUDGET) == STREAM_FAILED)
+	{
+		closeShardMesh(&mesh);
+		freeSpiller(&spiller);
+		return MODE_FAILED;
+	}
+	fflush(stdout); // otherwise what is buffered would be written by every worker too
+	fflush(stderr);
+	fflush(options->log);
+	pid_t workers[MAX_SHARDS];
+	size_t numOfWorkers = 0;
+	int isFailed = 0;
+	for (size_t shard = 0; shard < options->numOfShards && !isFailed; ++shard)
+	{
+		int recordsPipe[2];
+		if (pipe(recordsPipe) != 0)
+		{
+			isFailed = 1;
+			break;
+		}
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			close(recordsPipe[0]);
+			freeSpiller(&spiller); // the pipes of the workers before this one
+			runShardWorker(options, &mesh, shard, recordsPipe[1]);
+		}
+		close(recordsPipe[1]);
+		if (pid < 0)
+		{
+			close(recordsPipe[0]);
+			isFailed = 1;
+			break;
+		}
+		workers[numOfWorkers++] = pid;
+		FILE *run = fdopen(recordsPipe[0], "rb");
+		if (run == NULL)
+		{
+			close(recordsPipe[0]);
+			isFailed = 1;
+		}
+		else if (addSortedRun(&spiller, run, MAX_LINE_SIZE) == STREAM_FAILED)
+		{
+			isFailed = 1;
+		}
+	}
+	// Only the workers use the sockets. If a worker is missing the others find their sockets to it
+	// closed, and fail instead of waiting for it
+	closeShardMesh(&mesh);
+	// A worker writes SHARD_READY only after the propagation, so an error in the input files is
+	// known before the output file is opened (like in the table mode)
+	for (size_t i = 0; i < getNumOfRuns(&spiller) && !isFailed; ++i)
+	{
+		isFailed = fgetc(spiller.runs[i]) != SHARD_READY;
+	}
+	if (isFailed)
+	{
+		freeSpiller(&spiller); // a worker that still writes gets a broken pipe
+		waitForShardWorkers(workers, numOfWorkers);
+		return MODE_FAILED;
+	}
+	PHASE_BEGIN(PHASE_OUTPUT);
+	double outputBegin = currentSeconds();
+	OutputWriter output = {0};
+	status = modeStatusOfOutput(openOutputWriter(&output, OUTPUT_FILE), WRITER_SUCCESS,
+	                            WRITER_OPEN_FAILED);
+	if (status == MODE_SUCCESS &&
+	    mergeRuns(&spiller, writeRecordToOutput, &output) == STREAM_FAILED)
+	{
+		status = MODE_FAILED;
+	}
+	if (closeOutputWriter(&output) == WRITER_FAILED && status == MODE_SUCCESS)
+	{
+		status = MODE_FAILED;
+	}
+	freeSpiller(&spiller);
+	if (waitForShardWorkers(workers, numOfWorkers) == MODE_FAILED && status == MODE_SUCCESS)
+	{
+		status = MODE_FAILED;
+	}
+	PHASE_END(PHASE_OUTPUT);
+	if (status == MODE_SUCCESS && options->printTiming) // one phase, like in the streaming mode
+	{
+		fprintf(options->log, "output seconds: %.6f\n", currentSeconds() - outputBegin);
+	}
+	return status;
+}
+
+int runServerMode(const DetectorOptions *options)
+{
+	SpreaderEngine *engine;
+	int status = createEngine(&engine, options->combineRule, options->numOfThreads);
+	if (status != ENGINE_SUCCESS)
+	{
+		return MODE_FAILED;
+	}
+	engineSetPolicy(engine, &options->policy); // it was validated when it was loaded
+	engineSetRiskModel(engine, options->riskModel); // it was found in the registry
+	status = engineLoadPeople(engine, options->pathToPeopleFile);
+	if (status == ENGINE_SUCCESS)
+	{
+		status = engineLoadMeetings(engine, options->pathToMeetings);
+	}
+	if (status == ENGINE_SUCCESS) // the first query propagates: do it before the first client
+	{
+		size_t counts[NUM_OF_CLASSES];
+		status = engineCountClasses(engine, counts);
+	}
+	if (status != ENGINE_SUCCESS)
+	{
+		destroyEngine(engine);
+		return status == ENGINE_OPEN_FAILED ? MODE_INPUT_FAILED : MODE_FAILED;
+	}
+	ServerStats stats;
+	status = runQueryServer(engine, options->socketPath, &stats);
+	destroyEngine(engine);
+	if (status != SERVER_SUCCESS)
+	{
+		return MODE_FAILED;
+	}
+	if (options->printTiming)
+	{
+		fprintf(options->log, "server: %zu connections, %zu requests in %zu batches\n",
+		        stats.numOfConnections, stats.numOfRequests, stats.numOfBatches);
+	}
+	return MODE_SUCCESS;
+}
+
+int runValidationMode(const DetectorOptions *options)
+{
+	const char *paths[] = {options->pathToPeopleFile, options->pathToMeetings};
+	const unsigned int kinds[] = {SNAPSHOT_PEOPLE, SNAPSHOT_MEETINGS};
+	MappedFile files[sizeof(kinds) / sizeof(kinds[0])] = {{0}};
+	for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); ++i)
+	{
+		Snapshot snapshot = {0};
+		int snapshotStatus = openSnapshot(paths[i], kinds[i], &snapshot);
+		int mapStatus = snapshotStatus == SNAPSHOT_NOT_SNAPSHOT ?
+		                mapInputFile(paths[i], &files[i]) : MAP_SUCCESS;
+		int status = MODE_SUCCESS;
+		if (snapshotStatus == SNAPSHOT_OPEN_FAILED || mapStatus == MAP_OPEN_FAILED)
+		{
+			status = MODE_INPUT_FAILED;
+		}
+		else if (snapshotStatus == SNAPSHOT_SUCCESS || mapStatus == MAP_NOT_MAPPABLE) // only text
+		{
+			closeSnapshot(&snapshot);
+			status = MODE_NOT_TEXT;
+		}
+		else if (snapshotStatus != SNAPSHOT_NOT_SNAPSHOT)
+		{
+			status = MODE_FAILED;
+		}
+		if (status != MODE_SUCCESS)
+		{
+			unmapInputFile(&files[0]);
+			return status;
+		}
+	}
+	PHASE_BEGIN(PHASE_VALIDATE);
+	double begin = currentSeconds();
+	ValidationStats stats;
+	int status = validateInputFiles(paths[0], files[0].data, files[0].len, paths[1], files[1].data,
+	                                files[1].len, options->numOfThreads, stdout, &stats);
+	double seconds = currentSeconds() - begin;
+	PHASE_END(PHASE_VALIDATE);
+	unmapInputFile(&files[0]);
+	unmapInputFile(&files[1]);
+	if (status == VALIDATION_FAILED)
+	{
+		return MODE_FAILED;
+	}
+	printf("%s: %zu lines, %zu malformed, %zu repeated IDs\n", paths[0], stats.numOfPeopleLines,
+	       stats.numOfIssues[ISSUE_MALFORMED_PERSON], stats.numOfIssues[ISSUE_DUPLICATE_ID]);
+	printf("%s: %zu lines, %zu malformed, %zu unknown IDs, %zu non-positive distances\n",
+	       paths[1], stats.numOfMeetingLines,
+	       stats.numOfIssues[ISSUE_MALFORMED_SEEDS] + stats.numOfIssues[ISSUE_MALFORMED_MEETING],
+	       stats.numOfIssues[ISSUE_UNKNOWN_PERSON], stats.numOfIssues[ISSUE_NON_POSITIVE_DISTANCE]);
+	size_t numOfIssues = totalIssues(&stats);
+	if (stats.numOfListed < numOfIssues)
+	{
+		printf("%zu problems were counted but not listed\n", numOfIssues - stats.numOfListed);
+	}
+	if (options->printTiming)
+	{
+		fprintf(options->log, "validation: %.3fs in %zu chunks\n", seconds, stats.numOfChunks);
+	}
+	return numOfIssues == 0 ? MODE_SUCCESS : MODE_INVALID_FILES;
+}
+
+int runDetector(const DetectorOptions *options)
+{
+	if (options->snapshotPrefix != NULL)
+	{
+		return runSnapshotConverter(options);
+	}
+	if (options->isValidation)
+	{
+		return runValidationMode(options);
+	}
+	if (options->socketPath != NULL)
+	{
+		return runServerMode(options);
+	}
+	if (options->numOfShards != NO_SHARDS)
+	{
+		return runShardedMode(options);
+	}
+	if (options->memoryBudget != NO_MEMORY_BUDGET)
+	{
+		return runStreamingMode(options);
+	}
+	return runTableMode(options);
+}
@@ -0,0 +1,203 @@
+/**
+* @file SpreaderDetectorModes.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The modes of the command line tool, as functions of the library
+* @section DESCRIPTION
+* The command line tool (SpreaderDetectorBackend.c) only reads its arguments into DetectorOptions,
+* runs the mode they ask for and reports how it ended. Every mode is a function of this file:
+* - runTableMode: the people in memory (see SpreaderDetectorTable.h), and after the output file the
+*   batches of new meetings of "--deltas=" (see SpreaderDetectorIncremental.h).
+* - runStreamingMode: "--memory-budget=", the whole heap of the mode under a budget (see
+*   SpreaderDetectorStreaming.h).
+* - runShardedMode: "--shards=", a worker process for every shard (see SpreaderDetectorShard.h),
+*   whose sorted records are merged into the output file.
+* - runSnapshotConverter: "--write-snapshot=", the input files as snapshots (see
+*   SpreaderDetectorSnapshot.h).
+* - runServerMode: "--serve=", the queries of the clients of an engine (see
+*   SpreaderDetectorServer.h).
+* - runValidationMode: "--validate", the problems of the input files (see
+*   SpreaderDetectorValidate.h).
+* runDetector runs the mode the options ask for. No mode exits or prints an error: every error is
+* returned as one of the MODE_ codes, after everything the mode held was released. What "--timing"
+* (and "--memory-stats") asks for is written to the log of the options.
+*/
+
+#ifndef EXAM_SPREADERDETECTORMODES_H
+#define EXAM_SPREADERDETECTORMODES_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "SpreaderDetectorPolicy.h"
+
+/**
+ * @def MODE_SUCCESS 0
+ * @brief Returned by the modes when they succeeded
+ */
+#define MODE_SUCCESS 0
+
+/**
+ * @def MODE_INPUT_FAILED 1
+ * @brief An input file could not be opened
+ */
+#define MODE_INPUT_FAILED 1
+
+/**
+ * @def MODE_OUTPUT_FAILED 2
+ * @brief An output file (or a snapshot) could not be opened
+ */
+#define MODE_OUTPUT_FAILED 2
+
+/**
+ * @def MODE_NOT_TEXT 3
+ * @brief The mode reads only text files, and an input file is a snapshot (or a pipe, that can not
+ * be mapped)
+ */
+#define MODE_NOT_TEXT 3
+
+/**
+ * @def MODE_FAILED 4
+ * @brief Any other error: an invalid line, a person who is not in the people file, no memory, a
+ * failed write or a worker that failed
+ */
+#define MODE_FAILED 4
+
+/**
+ * @def MODE_INVALID_FILES 5
+ * @brief The validation found problems in the input files (they were written)
+ */
+#define MODE_INVALID_FILES 5
+
+/**
+ * @def MODE_OVER_BUDGET 6
+ * @brief The streaming mode needs more memory than its budget ("--memory-budget=") for the input
+ * files
+ */
+#define MODE_OVER_BUDGET 6
+
+/**
+ * @def NO_MEMORY_BUDGET 0
+ * @brief The memory budget when "--memory-budget=" was not given (the people are kept in memory)
+ */
+#define NO_MEMORY_BUDGET 0
+
+/**
+ * @def NO_SHARDS 0
+ * @brief The people are not split between processes
+ */
+#define NO_SHARDS 0
+
+/**
+ * @def DELTA_OUTPUT_FILE "SpreaderDetectorAnalysis.delta.out"
+ * @brief After every batch of new meetings, the people whose class was changed by it are written
+ * to this file (in the order of the output file), and then an empty line
+ */
+#define DELTA_OUTPUT_FILE "SpreaderDetectorAnalysis.delta.out"
+
+/**
+ * @def PEOPLE_SNAPSHOT_SUFFIX ".people.snap"
+ * @brief Added to the prefix of the snapshots to get the path of the people snapshot
+ */
+#define PEOPLE_SNAPSHOT_SUFFIX ".people.snap"
+
+/**
+ * @def MEETINGS_SNAPSHOT_SUFFIX ".meetings.snap"
+ * @brief Added to the prefix of the snapshots to get the path of the meetings snapshot
+ */
+#define MEETINGS_SNAPSHOT_SUFFIX ".meetings.snap"
+
+/**
+ * @struct DetectorOptions
+ * @brief The paths and the options of a run (see the options of SpreaderDetectorBackend.c).
+ * pathToDeltas, snapshotPrefix and socketPath are NULL when they were not given, and log is where
+ * the timings are written (the tool gives stderr)
+ */
+typedef struct DetectorOptions
+{
+	const char *pathToPeopleFile;
+	const char *pathToMeetings;
+	size_t numOfThreads;
+	int printMemoryStats;
+	int printStats;
+	int printTiming;
+	int combineRule;
+	size_t memoryBudget;
+	const char *pathToDeltas;
+	const char *snapshotPrefix;
+	size_t numOfParsers;
+	size_t top;
+	float minProb;
+	unsigned int maxClass;
+	RiskPolicy policy;
+	size_t numOfShards;
+	const char *socketPath;
+	int riskModel;
+	int isValidation;
+	FILE *log;
+} DetectorOptions;
+
+/**
+ * Runs the mode the options ask for: the converter to snapshots, the validation, the server, the
+ * sharded mode, the streaming mode or (without any of them) the table mode
+ * @param options The paths and the options
+ * @return The code of the mode
+ */
+int runDetector(const DetectorOptions *options);
+
+/**
+ * The table mode: loads the people into a table and the meetings into its graph, propagates the
+ * risk, writes the (selected) people to OUTPUT_FILE, and with options->pathToDeltas then reads
+ * its batches of new meetings until its end. After every batch the people whose class was changed
+ * are written to DELTA_OUTPUT_FILE
+ * @param options The paths and the options
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED, MODE_OUTPUT_FAILED or MODE_FAILED
+ */
+int runTableMode(const DetectorOptions *options);
+
+/**
+ * The streaming mode: computes the probabilities from the meeting file, then reads the people file
+ * line by line into sorted runs and merges them into OUTPUT_FILE. Everything it allocates (the
+ * meetings, the map of the people who appear in them, the propagation, the buffer of the runs and
+ * the buffer of the output file, which are sized from the budget) is kept under
+ * options->memoryBudget bytes (at least MIN_MEMORY_BUDGET, see SpreaderDetectorStreaming.h)
+ * @param options The paths and the options
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED, MODE_OUTPUT_FAILED, MODE_OVER_BUDGET or MODE_FAILED
+ */
+int runStreamingMode(const DetectorOptions *options);
+
+/**
+ * The sharded mode: forks a worker for every shard, and merges the sorted records of the workers
+ * (one pipe from every worker) into OUTPUT_FILE. Every worker loads the people of its shard and
+ * its meetings from the text files, and propagates together with the other workers. The files
+ * must be regular text files: a snapshot or a pipe gives MODE_NOT_TEXT
+ * @param options The paths and the options
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED, MODE_OUTPUT_FAILED, MODE_NOT_TEXT or MODE_FAILED
+ */
+int runShardedMode(const DetectorOptions *options);
+
+/**
+ * The converter to snapshots: reads the people file and the meeting file and writes them as the
+ * snapshots options->snapshotPrefix PEOPLE_SNAPSHOT_SUFFIX and MEETINGS_SNAPSHOT_SUFFIX, without
+ * computing anything
+ * @param options The paths and the options
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED, MODE_OUTPUT_FAILED or MODE_FAILED
+ */
+int runSnapshotConverter(const DetectorOptions *options);
+
+/**
+ * The server mode: loads the two files into an engine and serves its queries on
+ * options->socketPath until a client shuts the server down
+ * @param options The paths and the options
+ * @return MODE_SUCCESS, MODE_INPUT_FAILED or MODE_FAILED
+ */
+int runServerMode(const DetectorOptions *options);
+
+/**
+ * The validation mode: maps the two text files, and writes their problems and a summary to stdout
+ * @param options The paths and the options
+ * @return MODE_SUCCESS (no problem), MODE_INVALID_FILES, MODE_INPUT_FAILED, MODE_NOT_TEXT or
+ * MODE_FAILED
+ */
+int runValidationMode(const DetectorOptions *options);
+
+#endif //EXAM_SPREADERDETECTORMODES_H
@@ -0,0 +1,634 @@
+/**
+* @file SpreaderDetectorOrder.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the order of the output (radix sort or q-sort, see the header)
+* @section DESCRIPTION
+* The radix sort needs the probabilities as unsigned numbers whose order is the order of the
+* output. A non negative IEEE-754 float keeps its order when its bits are read as an unsigned
+* number, and a negative one reverses it, so we flip the sign bit of the non negative floats and
+* all the bits of the negative ones (ascending order), and then all the bits again (descending).
+* The parallel sort runs the same passes, but every pass is split between the workers: every
+* worker counts the digits of its part of the keys, and then scatters its part to the places that
+* follow the parts of the workers before it (of the same digit), so the pass stays stable and the
+* order is exactly the one of the sort of one thread.
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SpreaderDetectorOrder.h"
+#include "SpreaderDetectorArena.h"
+
+/**
+ * @def LEFT_BEFOR_RIGHT -1
+ * @brief In the comparison functions -1 will indicate that the left key comes first
+ */
+#define LEFT_BEFOR_RIGHT -1
+
+/**
+ * @def RADIX_BITS 8
+ * @brief The radix sort sorts one byte per pass
+ */
+#define RADIX_BITS 8
+
+/**
+ * @def RADIX 256
+ * @brief The number of buckets of one pass (2^RADIX_BITS)
+ */
+#define RADIX 256
+
+/**
+ * @def ID_PASSES 8
+ * @brief The number of passes over the ID (the first passes, since it is the less significant key)
+ */
+#define ID_PASSES 8
+
+/**
+ * @def PROB_PASSES 4
+ * @brief The number of passes over the bits of the probability (the last passes)
+ */
+#define PROB_PASSES 4
+
+/**
+ * @def NUM_OF_PASSES 12
+ * @brief The number of passes of the radix sort
+ */
+#define NUM_OF_PASSES (ID_PASSES + PROB_PASSES)
+
+/**
+ * @def SIGN_BIT 0x80000000u
+ * @brief The sign bit of a float
+ */
+#define SIGN_BIT 0x80000000u
+
+/**
+ * @def CLASS_PASS NUM_OF_PASSES
+ * @brief The pass of the parallel sort that splits the keys into the classes of the output
+ */
+#define CLASS_PASS NUM_OF_PASSES
+
+/**
+ * @def COPY_PASS (NUM_OF_PASSES + 1)
+ * @brief The "pass" of the parallel sort that copies the keys back from the scratch
+ */
+#define COPY_PASS (NUM_OF_PASSES + 1)
+
+/**
+ * @def MIN_PARALLEL_SORT (1 << 16)
+ * @brief Fewer keys (in all, or in a class) are sorted by the calling thread alone (waking the
+ * workers would cost more than the sort)
+ */
+#define MIN_PARALLEL_SORT (1 << 16)
+
+#ifndef QSORT_PROB_ORDER
+
+/**
+ * @struct ParallelSort
+ * @brief Everything the workers of one sort share: the pass that runs now (its keys, where they go
+ * and how many there are), the counts of the digits of every worker and the barriers of the passes
+ */
+typedef struct ParallelSort
+{
+	const ProbSortKey *from;
+	ProbSortKey *to;
+	size_t len;
+	unsigned int pass;
+	size_t (*counts)[RADIX];
+	size_t numOfWorkers;
+	int isSkipped;
+	pthread_barrier_t passBegin;
+	pthread_barrier_t counted;
+	pthread_barrier_t passEnd;
+	pthread_mutex_t gateLock;
+	pthread_cond_t gateOpened;
+	int gateOpen;
+	int finished;
+} ParallelSort;
+
+/**
+ * @struct SortWorker
+ * @brief The argument of a worker thread
+ */
+typedef struct SortWorker
+{
+	ParallelSort *sort;
+	size_t id;
+} SortWorker;
+
+/**
+ * Returns the probability as an unsigned number, such that a larger probability is a smaller
+ * number (see the description of the file)
+ * @param probInfected The probability
+ * @return The number
+ */
+static uint32_t descendingProbBits(float probInfected)
+{
+	probInfected += 0.0f; // -0 is 0 for cmpFuncProb: -0 + 0 is +0
+	uint32_t bits;
+	memcpy(&bits, &probInfected, sizeof(bits));
+	bits = (bits & SIGN_BIT) ? ~bits : bits | SIGN_BIT;
+	return ~bits;
+}
+
+/**
+ * Returns the byte of the key that is sorted in a pass
+ * @param key The key
+ * @param pass The pass (the first ID_PASSES are the bytes of the ID, the rest are of the
+ * probability, from the least significant byte)
+ * @return The byte
+ */
+static unsigned int digitOf(const ProbSortKey *key, unsigned int pass)
+{
+	if (pass < ID_PASSES)
+	{
+		return (unsigned int) ((uint64_t) key->id >> (pass * RADIX_BITS)) & (RADIX - 1);
+	}
+	return (descendingProbBits(key->probInfected) >> ((pass - ID_PASSES) * RADIX_BITS)) &
+	       (RADIX - 1);
+}
+
+/**
+ * LSD radix sort of a range of keys. The buckets of all the passes are counted in one pass over
+ * the keys, and then every pass is one (stable) scatter between the keys and the scratch
+ * @param keys The keys
+ * @param scratch Room for len keys
+ * @param len The number of keys
+ */
+static void radixSortRange(ProbSortKey *keys, ProbSortKey *scratch, size_t len)
+{
+	if (len < 2)
+	{
+		return;
+	}
+	size_t counts[NUM_OF_PASSES][RADIX] = {{0}};
+	for (size_t i = 0; i < len; ++i)
+	{
+		for (unsigned int pass = 0; pass < NUM_OF_PASSES; ++pass)
+		{
+			counts[pass][digitOf(&keys[i], pass)]++;
+		}
+	}
+	ProbSortKey *from = keys;
+	ProbSortKey *to = scratch;
+	for (unsigned int pass = 0; pass < NUM_OF_PASSES; ++pass)
+	{
+		if (counts[pass][digitOf(&from[0], pass)] == len) // all the keys have the same byte
+		{
+			continue;
+		}
+		size_t offset = 0;
+		for (unsigned int digit = 0; digit < RADIX; ++digit)
+		{
+			size_t count = counts[pass][digit];
+			counts[pass][digit] = offset;
+			offset += count;
+		}
+		for (size_t i = 0; i < len; ++i)
+		{
+			to[counts[pass][digitOf(&from[i], pass)]++] = from[i];
+		}
+		ProbSortKey *tmp = from;
+		from = to;
+		to = tmp;
+	}
+	if (from != keys)
+	{
+		memcpy(keys, from, len * sizeof(ProbSortKey));
+	}
+}
+
+/**
+ * Sorts the keys by the calling thread alone
+ * @param keys The keys
+ * @param scratch Room for len keys
+ * @param len The number of keys
+ */
+static void sortAlone(ProbSortKey *keys, ProbSortKey *scratch, size_t len)
+{
+	// First split the keys into the classes of the output (stable), so every class is sorted on
+	// its own and its passes are more likely to be skipped
+	size_t classBegin[NUM_OF_CLASSES + 1] = {0};
+	for (size_t i = 0; i < len; ++i)
+	{
+		classBegin[keys[i].riskClass + 1]++;
+	}
+	for (unsigned int c = 1; c <= NUM_OF_CLASSES; ++c)
+	{
+		classBegin[c] += classBegin[c - 1];
+	}
+	size_t next[NUM_OF_CLASSES];
+	memcpy(next, classBegin, sizeof(next));
+	for (size_t i = 0; i < len; ++i)
+	{
+		scratch[next[keys[i].riskClass]++] = keys[i];
+	}
+	memcpy(keys, scratch, len * sizeof(ProbSortKey));
+	for (unsigned int c = 0; c < NUM_OF_CLASSES; ++c)
+	{
+		radixSortRange(keys + classBegin[c], scratch + classBegin[c],
+		               classBegin[c + 1] - classBegin[c]);
+	}
+}
+
+/**
+ * Runs the part of a worker in the current pass: counts the digits of its part of the keys, waits
+ * for the counts of the others, and scatters its part (the pass is skipped when all the keys have
+ * the same digit). The copy pass only copies the part
+ * @param sort The sort
+ * @param id The worker
+ */
+static void runPassPart(ParallelSort *sort, size_t id)
+{
+	size_t begin = sort->len * id / sort->numOfWorkers;
+	size_t end = sort->len * (id + 1) / sort->numOfWorkers;
+	const ProbSortKey *from = sort->from;
+	unsigned int pass = sort->pass;
+	size_t *counts = sort->counts[id];
+	if (pass == COPY_PASS)
+	{
+		memcpy(sort->to + begin, from + begin, (end - begin) * sizeof(ProbSortKey));
+		pthread_barrier_wait(&sort->counted);
+		return;
+	}
+	memset(counts, 0, RADIX * sizeof(size_t));
+	for (size_t i = begin; i < end; ++i)
+	{
+		counts[pass == CLASS_PASS ? from[i].riskClass : digitOf(&from[i], pass)]++;
+	}
+	pthread_barrier_wait(&sort->counted);
+	// The place of a digit of this worker: all the smaller digits, and this digit of the workers
+	// before it
+	size_t offsets[RADIX];
+	size_t offset = 0;
+	int isSkipped = 0;
+	for (unsigned int digit = 0; digit < RADIX; ++digit)
+	{
+		size_t digitBegin = offset;
+		for (size_t worker = 0; worker < id; ++worker)
+		{
+			offset += sort->counts[worker][digit];
+		}
+		offsets[digit] = offset;
+		for (size_t worker = id; worker < sort->numOfWorkers; ++worker)
+		{
+			offset += sort->counts[worker][digit];
+		}
+		isSkipped |= offset - digitBegin == sort->len;
+	}
+	if (id == 0)
+	{
+		sort->isSkipped = isSkipped;
+	}
+	if (isSkipped)
+	{
+		return;
+	}
+	ProbSortKey *to = sort->to;
+	for (size_t i = begin; i < end; ++i)
+	{
+		unsigned int digit = pass == CLASS_PASS ? from[i].riskClass : digitOf(&from[i], pass);
+		to[offsets[digit]++] = from[i];
+	}
+}
+
+/**
+ * The function of a worker thread: waits for a pass, does its part, and waits for the others
+ * @param arg pointer to "SortWorker"
+ * @return NULL
+ */
+static void *sortWorker(void *arg)
+{
+	SortWorker *worker = (SortWorker *) arg;
+	ParallelSort *sort = worker->sort;
+	pthread_mutex_lock(&sort->gateLock); // wait until all the workers were created
+	while (!sort->gateOpen)
+	{
+		pthread_cond_wait(&sort->gateOpened, &sort->gateLock);
+	}
+	pthread_mutex_unlock(&sort->gateLock);
+	while (1)
+	{
+		pthread_barrier_wait(&sort->passBegin);
+		if (sort->finished)
+		{
+			return NULL;
+		}
+		runPassPart(sort, worker->id);
+		pthread_barrier_wait(&sort->passEnd);
+	}
+}
+
+/**
+ * Runs a pass with all the workers. The calling thread is worker 0
+ * @param sort The sort
+ * @param pass The pass (of the radix sort, CLASS_PASS or COPY_PASS)
+ * @param from The keys
+ * @param to Room for len keys
+ * @param len The number of keys
+ * @return 1 if the keys were moved to "to", 0 if the pass was skipped
+ */
+static int runPass(ParallelSort *sort, unsigned int pass, const ProbSortKey *from,
+                   ProbSortKey *to, size_t len)
+{
+	sort->from = from;
+	sort->to = to;
+	sort->len = len;
+	sort->pass = pass;
+	sort->isSkipped = 0;
+	pthread_barrier_wait(&sort->passBegin);
+	runPassPart(sort, 0);
+	pthread_barrier_wait(&sort->passEnd);
+	return !sort->isSkipped;
+}
+
+/**
+ * Sorts the keys with the workers: the classes are split in one pass, and every class that is
+ * large enough is sorted by the passes of the radix sort (a small one by the calling thread alone)
+ * @param sort The sort (the workers wait at the gate)
+ * @param keys The keys
+ * @param scratch Room for len keys
+ * @param len The number of keys
+ */
+static void runPasses(ParallelSort *sort, ProbSortKey *keys, ProbSortKey *scratch, size_t len)
+{
+	size_t classBegin[NUM_OF_CLASSES + 1] = {0};
+	if (runPass(sort, CLASS_PASS, keys, scratch, len))
+	{
+		runPass(sort, COPY_PASS, scratch, keys, len); // keeps the counts of the split
+	}
+	for (unsigned int c = 0; c < NUM_OF_CLASSES; ++c)
+	{
+		classBegin[c + 1] = classBegin[c];
+		for (size_t worker = 0; worker < sort->numOfWorkers; ++worker)
+		{
+			classBegin[c + 1] += sort->counts[worker][c];
+		}
+	}
+	for (unsigned int c = 0; c < NUM_OF_CLASSES; ++c)
+	{
+		ProbSortKey *classKeys = keys + classBegin[c];
+		ProbSortKey *classScratch = scratch + classBegin[c];
+		size_t classLen = classBegin[c + 1] - classBegin[c];
+		if (classLen < MIN_PARALLEL_SORT)
+		{
+			radixSortRange(classKeys, classScratch, classLen);
+			continue;
+		}
+		ProbSortKey *from = classKeys;
+		ProbSortKey *to = classScratch;
+		for (unsigned int pass = 0; pass < NUM_OF_PASSES; ++pass)
+		{
+			if (runPass(sort, pass, from, to, classLen))
+			{
+				ProbSortKey *tmp = from;
+				from = to;
+				to = tmp;
+			}
+		}
+		if (from != classKeys)
+		{
+			runPass(sort, COPY_PASS, from, classKeys, classLen);
+		}
+	}
+}
+
+/**
+ * Sorts the keys with numOfThreads threads (the calling one too)
+ * @param keys The keys
+ * @param scratch Room for len keys
+ * @param len The number of keys
+ * @param numOfThreads The number of threads
+ * @return ORDER_SUCCESS or ORDER_FAILED (no memory, the keys are not changed)
+ */
+static int sortInParallel(ProbSortKey *keys, ProbSortKey *scratch, size_t len,
+                          size_t numOfThreads)
+{
+	ParallelSort sort = {0};
+	sort.counts = (size_t (*)[RADIX]) trackedMalloc(numOfThreads * RADIX * sizeof(size_t));
+	SortWorker *workers = (SortWorker *) trackedCalloc(numOfThreads, sizeof(SortWorker));
+	pthread_t *threads = (pthread_t *) trackedCalloc(numOfThreads, sizeof(pthread_t));
+	int status = ORDER_SUCCESS;
+	if (sort.counts == NULL || workers == NULL || threads == NULL)
+	{
+		status = ORDER_FAILED;
+	}
+	else
+	{
+		// The workers wait at the gate until we know how many of them were created
+		pthread_mutex_init(&sort.gateLock, NULL);
+		pthread_cond_init(&sort.gateOpened, NULL);
+		size_t numOfWorkers = 1; // this thread
+		for (size_t i = 1; i < numOfThreads; ++i)
+		{
+			workers[numOfWorkers].sort = &sort;
+			workers[numOfWorkers].id = numOfWorkers;
+			if (pthread_create(&threads[numOfWorkers], NULL, sortWorker, &workers[numOfWorkers]) ==
+			    0)
+			{
+				numOfWorkers++;
+			}
+		}
+		sort.numOfWorkers = numOfWorkers;
+		pthread_barrier_init(&sort.passBegin, NULL, (unsigned int) numOfWorkers);
+		pthread_barrier_init(&sort.counted, NULL, (unsigned int) numOfWorkers);
+		pthread_barrier_init(&sort.passEnd, NULL, (unsigned int) numOfWorkers);
+		pthread_mutex_lock(&sort.gateLock);
+		sort.gateOpen = 1;
+		pthread_cond_broadcast(&sort.gateOpened);
+		pthread_mutex_unlock(&sort.gateLock);
+		runPasses(&sort, keys, scratch, len);
+		sort.finished = 1;
+		if (numOfWorkers > 1)
+		{
+			pthread_barrier_wait(&sort.passBegin); // the workers see finished and return
+		}
+		for (size_t i = 1; i < numOfWorkers; ++i)
+		{
+			pthread_join(threads[i], NULL);
+		}
+		pthread_barrier_destroy(&sort.passBegin);
+		pthread_barrier_destroy(&sort.counted);
+		pthread_barrier_destroy(&sort.passEnd);
+		pthread_cond_destroy(&sort.gateOpened);
+		pthread_mutex_destroy(&sort.gateLock);
+	}
+	trackedFree(sort.counts, numOfThreads * RADIX * sizeof(size_t));
+	trackedFree(workers, numOfThreads * sizeof(SortWorker));
+	trackedFree(threads, numOfThreads * sizeof(pthread_t));
+	return status;
+}
+
+int sortByProbability(ProbSortKey *keys, size_t len, size_t numOfThreads)
+{
+	if (len < 2)
+	{
+		return ORDER_SUCCESS;
+	}
+	ProbSortKey *scratch = (ProbSortKey *) trackedMalloc(len * sizeof(ProbSortKey));
+	if (scratch == NULL)
+	{
+		return ORDER_FAILED;
+	}
+	int status = ORDER_SUCCESS;
+	if (numOfThreads > 1 && len >= MIN_PARALLEL_SORT)
+	{
+		status = sortInParallel(keys, scratch, len, numOfThreads);
+	}
+	else
+	{
+		sortAlone(keys, scratch, len);
+	}
+	trackedFree(scratch, len * sizeof(ProbSortKey));
+	return status;
+}
+
+#else
+
+int sortByProbability(ProbSortKey *keys, size_t len, size_t numOfThreads)
+{
+	(void) numOfThreads; // q-sort runs on the calling thread
+	qsort(keys, len, sizeof(ProbSortKey), cmpFuncProb);
+	return ORDER_SUCCESS;
+}
+
+#endif
+
+/**
+ * Does the first key come before the second one in the order of the output file (see cmpFuncProb)
+ * @param first The first key
+ * @param sec The second key
+ * @return 1 if it does, 0 otherwise
+ */
+static int comesBefore(const ProbSortKey *first, const ProbSortKey *sec)
+{
+	if (first->riskClass != sec->riskClass)
+	{
+		return first->riskClass < sec->riskClass;
+	}
+	return first->probInfected > sec->probInfected ||
+	       (first->probInfected == sec->probInfected && first->id < sec->id);
+}
+
+/**
+ * Moves the key at the top of the heap down into its place. The heap keeps the key that comes
+ * last in the order of the output at its top
+ * @param heap The heap
+ * @param len The number of keys in the heap
+ * @param i The place of the key to move down
+ */
+static void siftDown(ProbSortKey *heap, size_t len, size_t i)
+{
+	ProbSortKey key = heap[i];
+	for (size_t child = 2 * i + 1; child < len; child = 2 * i + 1)
+	{
+		if (child + 1 < len && comesBefore(&heap[child], &heap[child + 1]))
+		{
+			child++; // the one of the two that comes last
+		}
+		if (!comesBefore(&key, &heap[child]))
+		{
+			break;
+		}
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = key;
+}
+
+size_t countAtLeastProbability(const float *probs, const unsigned char *classes, size_t len,
+                               float minProb, unsigned int maxClass)
+{
+	size_t count = 0;
+	for (size_t row = 0; row < len; ++row)
+	{
+		count += probs[row] >= minProb && classes[row] <= maxClass;
+	}
+	return count;
+}
+
+size_t selectAtLeastProbability(const size_t *ids, const float *probs, const unsigned char *classes,
+                                size_t len, float minProb, unsigned int maxClass,
+                                ProbSortKey *keys)
+{
+	size_t numOfKeys = 0;
+	for (size_t row = 0; row < len; ++row)
+	{
+		if (probs[row] >= minProb && classes[row] <= maxClass)
+		{
+			keys[numOfKeys].id = ids[row];
+			keys[numOfKeys].row = row;
+			keys[numOfKeys].probInfected = probs[row];
+			keys[numOfKeys].riskClass = classes[row];
+			numOfKeys++;
+		}
+	}
+	return numOfKeys;
+}
+
+size_t selectTopByProbability(const size_t *ids, const float *probs, const unsigned char *classes,
+                              size_t len, float minProb, unsigned int maxClass, size_t k,
+                              ProbSortKey *keys)
+{
+	size_t numOfKeys = 0;
+	for (size_t row = 0; row < len; ++row)
+	{
+		if (!(probs[row] >= minProb && classes[row] <= maxClass))
+		{
+			continue;
+		}
+		ProbSortKey key = {ids[row], row, probs[row], classes[row]};
+		if (numOfKeys < k) // the heap is not full yet: push
+		{
+			size_t i = numOfKeys++;
+			while (i > 0 && comesBefore(&keys[(i - 1) / 2], &key))
+			{
+				keys[i] = keys[(i - 1) / 2];
+				i = (i - 1) / 2;
+			}
+			keys[i] = key;
+		}
+		else if (comesBefore(&key, &keys[0])) // replaces the last of the first k
+		{
+			keys[0] = key;
+			siftDown(keys, numOfKeys, 0);
+		}
+	}
+	// Heap sort: the top is the last, so it goes to the end
+	for (size_t end = numOfKeys; end > 1; --end)
+	{
+		ProbSortKey last = keys[0];
+		keys[0] = keys[end - 1];
+		keys[end - 1] = last;
+		siftDown(keys, end - 1, 0);
+	}
+	return numOfKeys;
+}
+
+int cmpFuncProb(const void *first, const void *sec)
+{
+	const ProbSortKey *leftKey = (const ProbSortKey *) first;
+	const ProbSortKey *rightKey = (const ProbSortKey *) sec;
+	if (leftKey->riskClass != rightKey->riskClass) // the more risky class first
+	{
+		return leftKey->riskClass < rightKey->riskClass ? LEFT_BEFOR_RIGHT : 1;
+	}
+	float left = leftKey->probInfected;
+	float right = rightKey->probInfected;
+	if (left > right) // We want to sort from big to small because the first on the list will have
+		// the highest chance and so the order goes down to the end!
+	{
+		return LEFT_BEFOR_RIGHT;
+	}
+	if (left < right)
+	{
+		return 1;
+	}
+	// Same probability: by ID (qsort is not stable, so we decide it ourselves)
+	if (leftKey->id < rightKey->id)
+	{
+		return LEFT_BEFOR_RIGHT;
+	}
+	return leftKey->id > rightKey->id;
+}
@@ -0,0 +1,157 @@
+/**
+* @file SpreaderDetectorOrder.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Sorts the people into the order of the output file
+* @section DESCRIPTION
+* The order of the output is by the class of the person (hospitalization, quarantine and clean, by
+* the policy, see SpreaderDetectorPolicy.h), then by the probability of infection from the largest
+* to the smallest, and people with the same probability are ordered by ID from the smallest to the
+* largest (exactly the order of cmpFuncProb). With the default policy the class follows the
+* probability, so this is the order by probability alone. Every key carries the class of its
+* person. Two implementations, chosen when building (the CMake option SPREADER_QSORT_PROB_ORDER):
+* - radix sort (the default): the keys are first split (stable) into the three classes of the
+*   output (hospitalization, quarantine and clean), and then every class is sorted by an LSD radix
+*   sort, one byte per pass, over the ID and over the bits of the probability. O(n) per pass, and a
+*   pass in which all the keys have the same byte is skipped.
+*   With several threads every pass is split between them (see sortByProbability), and the order
+*   is exactly the same.
+* - qsort (QSORT_PROB_ORDER): q-sort with cmpFuncProb, O(nlogn), on one thread.
+* When only the people at risk (above a threshold of probability, or in a class of at least some
+* risk) or only the first k are asked for, they are selected first (a linear filter or a heap of k
+* keys) and only they are sorted.
+*/
+
+#ifndef EXAM_SPREADERDETECTORORDER_H
+#define EXAM_SPREADERDETECTORORDER_H
+
+#include <stddef.h>
+
+/**
+ * @def ORDER_FAILED 0
+ * @brief Returned by sortByProbability when the allocation of the scratch keys failed
+ */
+#define ORDER_FAILED 0
+
+/**
+ * @def ORDER_SUCCESS 1
+ * @brief Returned by sortByProbability when the keys are sorted
+ */
+#define ORDER_SUCCESS 1
+
+/**
+ * @def NUM_OF_CLASSES 3
+ * @brief The classes of the output: hospitalization, quarantine and clean (in this order)
+ */
+#define NUM_OF_CLASSES 3
+
+/**
+ * @def HOSPITALIZATION_CLASS 0
+ * @brief The class of the people with probability of at least the hospitalization threshold of
+ * their age band
+ */
+#define HOSPITALIZATION_CLASS 0
+
+/**
+ * @def QUARANTINE_CLASS 1
+ * @brief The class of the people with probability of at least the quarantine threshold of their
+ * age band
+ */
+#define QUARANTINE_CLASS 1
+
+/**
+ * @def CLEAN_CLASS 2
+ * @brief The class of everyone else
+ */
+#define CLEAN_CLASS 2
+
+/**
+ * @struct ProbSortKey
+ * @brief The key we sort when we sort the people by the probability of infection: the class of
+ * the person (by the policy), the probability, the ID (people with the same probability are
+ * ordered by ID) and the row of the person in the table
+ */
+typedef struct ProbSortKey
+{
+	size_t id;
+	size_t row;
+	float probInfected;
+	unsigned int riskClass;
+} ProbSortKey;
+
+/**
+ * Sorts the keys into the order of the output file. With more than one thread and enough keys,
+ * the split into the classes and every pass of the radix sort over a large class are divided
+ * between the threads: each one counts the digits of its part of the keys and scatters it after
+ * the parts of the threads before it, so every pass is stable and the order (ties by ID) is the
+ * same for any number of threads
+ * @param keys The keys
+ * @param len The number of keys
+ * @param numOfThreads The maximal number of threads (the calling one too)
+ * @return ORDER_SUCCESS or ORDER_FAILED (no memory, the keys are not changed)
+ */
+int sortByProbability(ProbSortKey *keys, size_t len, size_t numOfThreads);
+
+/**
+ * Counts the people whose probability is at least a threshold and whose class is at least as
+ * risky as a given class
+ * @param probs The probabilities (by row)
+ * @param classes The classes (by row, see classifyPeople)
+ * @param len The number of people
+ * @param minProb The threshold
+ * @param maxClass The last class that is counted (CLEAN_CLASS counts every class)
+ * @return The number of people
+ */
+size_t countAtLeastProbability(const float *probs, const unsigned char *classes, size_t len,
+                               float minProb, unsigned int maxClass);
+
+/**
+ * Makes the keys of the people whose probability is at least a threshold and whose class is at
+ * least as risky as a given class (in the order of their rows, not sorted). A linear filter, so
+ * only the survivors have to be sorted
+ * @param ids The IDs (by row)
+ * @param probs The probabilities (by row)
+ * @param classes The classes (by row, see classifyPeople)
+ * @param len The number of people
+ * @param minProb The threshold
+ * @param maxClass The last class that is selected (CLEAN_CLASS selects every class)
+ * @param keys Will contain the keys (room for countAtLeastProbability keys)
+ * @return The number of keys
+ */
+size_t selectAtLeastProbability(const size_t *ids, const float *probs, const unsigned char *classes,
+                                size_t len, float minProb, unsigned int maxClass,
+                                ProbSortKey *keys);
+
+/**
+ * Makes the keys of the first k people in the order of the output file among the people whose
+ * probability is at least a threshold and whose class is at least as risky as a given class,
+ * sorted into that order. The candidates pass through a heap of k keys whose top is the last of
+ * them, so a person who does not make it costs one comparison: O(n + m*logk) for m people that
+ * enter the heap, and O(k) memory
+ * @param ids The IDs (by row)
+ * @param probs The probabilities (by row)
+ * @param classes The classes (by row, see classifyPeople)
+ * @param len The number of people
+ * @param minProb The threshold
+ * @param maxClass The last class that is selected (CLEAN_CLASS selects every class)
+ * @param k The number of people to keep (positive)
+ * @param keys Will contain the keys (room for k keys)
+ * @return The number of keys (k, or less if less people are selected)
+ */
+size_t selectTopByProbability(const size_t *ids, const float *probs, const unsigned char *classes,
+                              size_t len, float minProb, unsigned int maxClass, size_t k,
+                              ProbSortKey *keys);
+
+/**
+ *  A comparison function to q-sort that decides which value is greater than the other according to
+ * the class and then the The probability of infection. This way we can sort the keys by probability
+ * of infection (Note!: the keys will be sorted from the largest to the smallest) inside every
+ * class. People with the same class and probability are ordered by ID (from the smallest to the
+ * largest)
+ * @param first
+ * @param sec
+ * @return -1 if grater. 1 if less and 0 if equal
+ */
+int cmpFuncProb(const void *first, const void *sec);
+
+#endif //EXAM_SPREADERDETECTORORDER_H
@@ -0,0 +1,522 @@
+/**
+* @file SpreaderDetectorPipeline.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the pipeline of the meetings
+* @section DESCRIPTION
+* The producer of a ring fills the slot at tail and then publishes it by moving tail (release),
+* and the consumer uses the slot at head and then frees it by moving head (release), so every slot
+* is owned by one thread at a time. A ring is closed by its producer after its last slot. When
+* something fails the stop flag is raised: the reader stops reading, and the parsers and the
+* applier keep draining their rings (without working) until they are closed, so every thread can
+* end and be joined.
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+#include "SpreaderDetectorPipeline.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorStats.h"
+
+/**
+ * @def RING_CAPACITY 8
+ * @brief The number of slots of every ring (a power of two)
+ */
+#define RING_CAPACITY 8
+
+/**
+ * @def SPINS_BEFORE_YIELD 256
+ * @brief A stage that waits for a ring checks it this many times before it yields the CPU
+ */
+#define SPINS_BEFORE_YIELD 256
+
+/**
+ * @def CACHE_LINE 64
+ * @brief The counters of a ring are on different cache lines, so the producer and the consumer
+ * do not write to the same line
+ */
+#define CACHE_LINE 64
+
+/**
+ * @def MAX_PARSED_MEETINGS
+ * @brief The number of meetings a batch can hold (the most a block of RAW_BATCH_SIZE can have)
+ */
+#define MAX_PARSED_MEETINGS (RAW_BATCH_SIZE / MIN_MEETING_LINE_LEN + 1)
+
+/**
+ * @struct SpscRing
+ * @brief The counters of a single producer / single consumer ring (the slots are kept by the
+ * user). head and the empty waits are written only by the consumer, tail and the other counters
+ * only by the producer
+ */
+typedef struct SpscRing
+{
+	_Alignas(CACHE_LINE) atomic_size_t head;
+	size_t numOfEmptyWaits;
+	_Alignas(CACHE_LINE) atomic_size_t tail;
+	atomic_int isClosed;
+	size_t numOfPushes;
+	size_t occupancySum;
+	size_t numOfFullWaits;
+} SpscRing;
+
+/**
+ * @struct RawSlot
+ * @brief A block of whole lines read by the reader (status is PIPELINE_FAILED if reading failed)
+ */
+typedef struct RawSlot
+{
+	char *data;
+	size_t len;
+	int status;
+} RawSlot;
+
+/**
+ * @struct ParsedSlot
+ * @brief A batch of meetings parsed from one block (status is PIPELINE_FAILED if the block was
+ * invalid)
+ */
+typedef struct ParsedSlot
+{
+	MeetingInfo *meetings;
+	size_t numOfMeetings;
+	int status;
+} ParsedSlot;
+
+struct Pipeline;
+
+/**
+ * @struct ParserLane
+ * @brief One parser thread with its two rings (the blocks it gets and the batches it gives) and
+ * its counters
+ */
+typedef struct ParserLane
+{
+	SpscRing rawRing;
+	SpscRing parsedRing;
+	RawSlot raw[RING_CAPACITY];
+	ParsedSlot parsed[RING_CAPACITY];
+	StageStats stats;
+	struct Pipeline *pipeline;
+	pthread_t thread;
+} ParserLane;
+
+/**
+ * @struct Pipeline
+ * @brief Everything the threads of the pipeline share
+ */
+typedef struct Pipeline
+{
+	int fd;
+	size_t numOfParsers;
+	ParserLane *lanes;
+	MeetingParser parser;
+	StageStats readerStats;
+	atomic_int isStopped;
+} Pipeline;
+
+/**
+ * Waits a little: spins for the first checks, and then yields the CPU to the other stages
+ * @param numOfChecks pointer to the number of checks so far (counted here)
+ */
+static void waitBriefly(size_t *numOfChecks)
+{
+	if (++(*numOfChecks) >= SPINS_BEFORE_YIELD)
+	{
+		sched_yield();
+	}
+}
+
+/**
+ * The producer waits until the ring has a free slot
+ * @param ring The ring
+ * @param waitSeconds The time of the wait is added to it
+ * @return The free slot (to be filled and then published)
+ */
+static size_t waitForFreeSlot(SpscRing *ring, double *waitSeconds)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == RING_CAPACITY)
+	{
+		ring->numOfFullWaits++;
+		double waitBegin = currentSeconds();
+		size_t numOfChecks = 0;
+		while (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == RING_CAPACITY)
+		{
+			waitBriefly(&numOfChecks);
+		}
+		*waitSeconds += currentSeconds() - waitBegin;
+	}
+	return tail & (RING_CAPACITY - 1);
+}
+
+/**
+ * The producer publishes the slot it filled
+ * @param ring The ring
+ */
+static void publishSlot(SpscRing *ring)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed) + 1;
+	ring->numOfPushes++;
+	ring->occupancySum += tail - atomic_load_explicit(&ring->head, memory_order_relaxed);
+	atomic_store_explicit(&ring->tail, tail, memory_order_release);
+}
+
+/**
+ * The producer closes the ring (after its last slot)
+ * @param ring The ring
+ */
+static void closeRing(SpscRing *ring)
+{
+	atomic_store_explicit(&ring->isClosed, 1, memory_order_release);
+}
+
+/**
+ * The consumer waits until the ring has a filled slot, or until it is closed and empty
+ * @param ring The ring
+ * @param slot Will contain the filled slot (to be used and then freed)
+ * @param waitSeconds The time of the wait is added to it
+ * @return 1 if there is a slot, 0 if the ring is closed and empty
+ */
+static int waitForFilledSlot(SpscRing *ring, size_t *slot, double *waitSeconds)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	*slot = head & (RING_CAPACITY - 1);
+	if (atomic_load_explicit(&ring->tail, memory_order_acquire) != head)
+	{
+		return 1;
+	}
+	ring->numOfEmptyWaits++;
+	double waitBegin = currentSeconds();
+	size_t numOfChecks = 0;
+	int hasSlot = 0;
+	while (1)
+	{
+		// the producer publishes its last slot before it closes the ring, so after seeing it closed
+		// one more look at tail is enough
+		int isClosed = atomic_load_explicit(&ring->isClosed, memory_order_acquire);
+		if (atomic_load_explicit(&ring->tail, memory_order_acquire) != head)
+		{
+			hasSlot = 1;
+			break;
+		}
+		if (isClosed)
+		{
+			break;
+		}
+		waitBriefly(&numOfChecks);
+	}
+	*waitSeconds += currentSeconds() - waitBegin;
+	return hasSlot;
+}
+
+/**
+ * The consumer frees the slot it used
+ * @param ring The ring
+ */
+static void freeSlot(SpscRing *ring)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * Reads into a block until it is full or the file ended
+ * @param fd The file
+ * @param raw The block (raw->len bytes are already there)
+ * @param isEnd Will be 1 if the file ended
+ * @return PIPELINE_SUCCESS or PIPELINE_FAILED (read failed)
+ */
+static int fillBlock(int fd, RawSlot *raw, int *isEnd)
+{
+	while (raw->len < RAW_BATCH_SIZE)
+	{
+		ssize_t numOfBytes = read(fd, raw->data + raw->len, RAW_BATCH_SIZE - raw->len);
+		if (numOfBytes < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (numOfBytes < 0)
+		{
+			return PIPELINE_FAILED;
+		}
+		if (numOfBytes == 0)
+		{
+			*isEnd = 1;
+			break;
+		}
+		raw->len += (size_t) numOfBytes;
+		COUNT_BYTES_READ((size_t) numOfBytes);
+	}
+	return PIPELINE_SUCCESS;
+}
+
+/**
+ * The function of the reader thread: reads the file into blocks of whole lines, and gives them to
+ * the parsers in turns. The partial line at the end of a block is carried to the next block
+ * @param arg pointer to "Pipeline"
+ * @return NULL
+ */
+static void *readBlocks(void *arg)
+{
+	Pipeline *pipeline = (Pipeline *) arg;
+	StageStats *stats = &pipeline->readerStats;
+	char *carry = (char *) trackedMalloc(RAW_BATCH_SIZE);
+	size_t carryLen = 0;
+	int isEnd = carry == NULL;
+	if (carry == NULL)
+	{
+		atomic_store(&pipeline->isStopped, 1);
+	}
+	for (size_t block = 0; !isEnd && !atomic_load_explicit(&pipeline->isStopped,
+	                                                       memory_order_relaxed); ++block)
+	{
+		ParserLane *lane = &pipeline->lanes[block % pipeline->numOfParsers];
+		RawSlot *raw = &lane->raw[waitForFreeSlot(&lane->rawRing, &stats->waitSeconds)];
+		double busyBegin = currentSeconds();
+		memcpy(raw->data, carry, carryLen);
+		raw->len = carryLen;
+		carryLen = 0;
+		raw->status = fillBlock(pipeline->fd, raw, &isEnd);
+		if (raw->status == PIPELINE_FAILED)
+		{
+			isEnd = 1;
+		}
+		else if (!isEnd)
+		{
+			size_t blockLen = raw->len;
+			while (blockLen > 0 && raw->data[blockLen - 1] != '\n')
+			{
+				blockLen--;
+			}
+			if (blockLen > 0) // (a block without '\n' is a line that is too long)
+			{
+				carryLen = raw->len - blockLen;
+				memcpy(carry, raw->data + blockLen, carryLen);
+				raw->len = blockLen;
+			}
+		}
+		stats->numOfBatches++;
+		stats->numOfItems += raw->len;
+		stats->busySeconds += currentSeconds() - busyBegin;
+		publishSlot(&lane->rawRing);
+	}
+	trackedFree(carry, RAW_BATCH_SIZE);
+	for (size_t i = 0; i < pipeline->numOfParsers; ++i)
+	{
+		closeRing(&pipeline->lanes[i].rawRing);
+	}
+	return NULL;
+}
+
+/**
+ * The function of a parser thread: parses its blocks into batches of meetings, until its ring of
+ * blocks is closed
+ * @param arg pointer to "ParserLane"
+ * @return NULL
+ */
+static void *parseBlocks(void *arg)
+{
+	ParserLane *lane = (ParserLane *) arg;
+	Pipeline *pipeline = lane->pipeline;
+	size_t rawSlot;
+	while (waitForFilledSlot(&lane->rawRing, &rawSlot, &lane->stats.waitSeconds))
+	{
+		RawSlot *raw = &lane->raw[rawSlot];
+		ParsedSlot *parsed = &lane->parsed[waitForFreeSlot(&lane->parsedRing,
+		                                                   &lane->stats.waitSeconds)];
+		double busyBegin = currentSeconds();
+		parsed->numOfMeetings = 0;
+		parsed->status = raw->status;
+		if (parsed->status == PIPELINE_SUCCESS &&
+		    !atomic_load_explicit(&pipeline->isStopped, memory_order_relaxed))
+		{
+			parsed->status = pipeline->parser(raw->data, raw->data + raw->len, parsed->meetings,
+			                                  MAX_PARSED_MEETINGS, &parsed->numOfMeetings);
+		}
+		if (parsed->status == PIPELINE_FAILED)
+		{
+			atomic_store(&pipeline->isStopped, 1);
+		}
+		lane->stats.numOfBatches++;
+		lane->stats.numOfItems += parsed->numOfMeetings;
+		lane->stats.busySeconds += currentSeconds() - busyBegin;
+		freeSlot(&lane->rawRing);
+		publishSlot(&lane->parsedRing);
+	}
+	closeRing(&lane->parsedRing);
+	return NULL;
+}
+
+/**
+ * The applier: takes the batches from the parsers in turns (the order of the file) and applies
+ * them, until the ring of the next turn is closed
+ * @param pipeline The pipeline
+ * @param applier The applier
+ * @param context Given to the applier
+ * @param stats The counters of the applier
+ * @return PIPELINE_SUCCESS or PIPELINE_FAILED
+ */
+static int applyBatches(Pipeline *pipeline, MeetingApplier applier, void *context,
+                        StageStats *stats)
+{
+	int status = PIPELINE_SUCCESS;
+	for (size_t batch = 0;; ++batch)
+	{
+		ParserLane *lane = &pipeline->lanes[batch % pipeline->numOfParsers];
+		size_t parsedSlot;
+		if (!waitForFilledSlot(&lane->parsedRing, &parsedSlot, &stats->waitSeconds))
+		{
+			break;
+		}
+		ParsedSlot *parsed = &lane->parsed[parsedSlot];
+		double busyBegin = currentSeconds();
+		if (status == PIPELINE_SUCCESS) // after a failure the rings are only drained
+		{
+			status = parsed->status == PIPELINE_SUCCESS ?
+			         applier(parsed->meetings, parsed->numOfMeetings, context) : PIPELINE_FAILED;
+			if (status == PIPELINE_FAILED)
+			{
+				atomic_store(&pipeline->isStopped, 1);
+			}
+			stats->numOfItems += parsed->numOfMeetings;
+		}
+		stats->numOfBatches++;
+		stats->busySeconds += currentSeconds() - busyBegin;
+		freeSlot(&lane->parsedRing);
+	}
+	return status;
+}
+
+/**
+ * Allocates the slots of every lane
+ * @param pipeline The pipeline (with its lanes, zeroed)
+ * @return PIPELINE_SUCCESS or PIPELINE_FAILED (what was allocated is released by freeLanes)
+ */
+static int allocateLanes(Pipeline *pipeline)
+{
+	for (size_t i = 0; i < pipeline->numOfParsers; ++i)
+	{
+		ParserLane *lane = &pipeline->lanes[i];
+		lane->pipeline = pipeline;
+		for (size_t slot = 0; slot < RING_CAPACITY; ++slot)
+		{
+			lane->raw[slot].data = (char *) trackedMalloc(RAW_BATCH_SIZE);
+			lane->parsed[slot].meetings = (MeetingInfo *) trackedMalloc(
+					MAX_PARSED_MEETINGS * sizeof(MeetingInfo));
+			if (lane->raw[slot].data == NULL || lane->parsed[slot].meetings == NULL)
+			{
+				return PIPELINE_FAILED;
+			}
+		}
+	}
+	return PIPELINE_SUCCESS;
+}
+
+/**
+ * Releases the slots and the lanes
+ * @param pipeline The pipeline
+ */
+static void freeLanes(Pipeline *pipeline)
+{
+	for (size_t i = 0; i < pipeline->numOfParsers; ++i)
+	{
+		for (size_t slot = 0; slot < RING_CAPACITY; ++slot)
+		{
+			trackedFree(pipeline->lanes[i].raw[slot].data, RAW_BATCH_SIZE);
+			trackedFree(pipeline->lanes[i].parsed[slot].meetings,
+			            MAX_PARSED_MEETINGS * sizeof(MeetingInfo));
+		}
+	}
+	trackedFree(pipeline->lanes, pipeline->numOfParsers * sizeof(ParserLane));
+	pipeline->lanes = NULL;
+}
+
+/**
+ * Sums the counters of the threads into the stats
+ * @param pipeline The pipeline (after all its threads ended)
+ * @param stats The stats
+ */
+static void collectStats(const Pipeline *pipeline, PipelineStats *stats)
+{
+	stats->reader = pipeline->readerStats;
+	stats->rawRings.capacity = RING_CAPACITY;
+	stats->parsedRings.capacity = RING_CAPACITY;
+	for (size_t i = 0; i < pipeline->numOfParsers; ++i)
+	{
+		const ParserLane *lane = &pipeline->lanes[i];
+		stats->parsers.numOfBatches += lane->stats.numOfBatches;
+		stats->parsers.numOfItems += lane->stats.numOfItems;
+		stats->parsers.busySeconds += lane->stats.busySeconds;
+		stats->parsers.waitSeconds += lane->stats.waitSeconds;
+		const SpscRing *rings[] = {&lane->rawRing, &lane->parsedRing};
+		RingStats *ringStats[] = {&stats->rawRings, &stats->parsedRings};
+		for (size_t r = 0; r < 2; ++r)
+		{
+			ringStats[r]->numOfPushes += rings[r]->numOfPushes;
+			ringStats[r]->occupancySum += rings[r]->occupancySum;
+			ringStats[r]->numOfFullWaits += rings[r]->numOfFullWaits;
+			ringStats[r]->numOfEmptyWaits += rings[r]->numOfEmptyWaits;
+		}
+	}
+}
+
+int runMeetingPipeline(int fd, size_t numOfParsers, MeetingParser parser, MeetingApplier applier,
+                       void *context, PipelineStats *stats)
+{
+	PipelineStats empty = {0};
+	*stats = empty;
+	stats->numOfParsers = numOfParsers;
+	double begin = currentSeconds();
+	Pipeline pipeline;
+	pipeline.fd = fd;
+	pipeline.numOfParsers = numOfParsers;
+	pipeline.parser = parser;
+	pipeline.readerStats = empty.reader;
+	atomic_init(&pipeline.isStopped, 0);
+	pipeline.lanes = (ParserLane *) trackedCalloc(numOfParsers, sizeof(ParserLane));
+	if (pipeline.lanes == NULL)
+	{
+		return PIPELINE_FAILED;
+	}
+	if (allocateLanes(&pipeline) == PIPELINE_FAILED)
+	{
+		freeLanes(&pipeline);
+		return PIPELINE_FAILED;
+	}
+	size_t numOfStarted = 0;
+	while (numOfStarted < numOfParsers &&
+	       pthread_create(&pipeline.lanes[numOfStarted].thread, NULL, parseBlocks,
+	                      &pipeline.lanes[numOfStarted]) == 0)
+	{
+		numOfStarted++;
+	}
+	pthread_t reader;
+	int isReading = numOfStarted == numOfParsers &&
+	                pthread_create(&reader, NULL, readBlocks, &pipeline) == 0;
+	int status = PIPELINE_FAILED;
+	if (isReading)
+	{
+		status = applyBatches(&pipeline, applier, context, &stats->applier);
+		pthread_join(reader, NULL);
+	}
+	else // no reader: the parsers that did start see their rings closed and empty
+	{
+		for (size_t i = 0; i < numOfParsers; ++i)
+		{
+			closeRing(&pipeline.lanes[i].rawRing);
+		}
+	}
+	for (size_t i = 0; i < numOfStarted; ++i)
+	{
+		pthread_join(pipeline.lanes[i].thread, NULL);
+	}
+	collectStats(&pipeline, stats);
+	freeLanes(&pipeline);
+	stats->seconds = currentSeconds() - begin;
+	return status;
+}
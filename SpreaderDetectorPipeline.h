@@ -0,0 +1,138 @@
+/**
+* @file SpreaderDetectorPipeline.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Reading, parsing and applying the meetings as a pipeline of threads
+* @section DESCRIPTION
+* The lines of the meetings go through three stages that run at the same time:
+* - The reader thread reads the file into blocks of whole lines (RAW_BATCH_SIZE bytes at most).
+* - Every parser thread turns blocks into batches of MeetingInfo. The blocks are given to the
+*   parsers in turns (block k to parser k % numOfParsers).
+* - The applier (the calling thread) takes the batches in the same turns, so it gets them exactly
+*   in the order of the file, and applies them (finds the people and adds the meetings).
+* Every parser has two bounded single producer / single consumer rings: the blocks from the reader
+* and the batches to the applier. A ring is two counters (written only by its producer and only by
+* its consumer) over a fixed array of slots, so there are no locks at all: a stage that has nothing
+* to do spins for a while and then yields the CPU. Every stage counts what it did, how long it was
+* busy and how long it waited, and every ring counts how full it was, so the slowest stage can be
+* seen (the rings before it are full and the rings after it are empty).
+*/
+
+#ifndef EXAM_SPREADERDETECTORPIPELINE_H
+#define EXAM_SPREADERDETECTORPIPELINE_H
+
+#include <stddef.h>
+#include "SpreaderDetectorSnapshot.h"
+
+/**
+ * @def PIPELINE_SUCCESS 1
+ * @brief Returned by the pipeline (and by its callbacks) when they succeeded
+ */
+#define PIPELINE_SUCCESS 1
+
+/**
+ * @def PIPELINE_FAILED 0
+ * @brief Returned by the pipeline (and by its callbacks) when they failed. The pipeline is stopped
+ * and all its threads are joined before it returns
+ */
+#define PIPELINE_FAILED 0
+
+/**
+ * @def RAW_BATCH_SIZE (1 << 16)
+ * @brief The maximal number of bytes in one block of lines
+ */
+#define RAW_BATCH_SIZE (1 << 16)
+
+/**
+ * @def MIN_MEETING_LINE_LEN 8
+ * @brief A valid meeting line has at least 8 bytes (4 numbers, 3 spaces and the '\n'), so a block
+ * has at most RAW_BATCH_SIZE / 8 + 1 meetings (the last line may have no '\n')
+ */
+#define MIN_MEETING_LINE_LEN 8
+
+/**
+ * @def MAX_PARSERS 64
+ * @brief The maximal number of parser threads
+ */
+#define MAX_PARSERS 64
+
+/**
+ * Parses a block of whole lines of meetings
+ * @param begin The first byte of the block
+ * @param end The end of the block
+ * @param meetings Will contain the meetings
+ * @param capacity The number of meetings that meetings can hold
+ * @param numOfMeetings Will contain the number of meetings
+ * @return PIPELINE_SUCCESS, or PIPELINE_FAILED (an invalid line)
+ */
+typedef int (*MeetingParser)(const char *begin, const char *end, MeetingInfo *meetings,
+                             size_t capacity, size_t *numOfMeetings);
+
+/**
+ * Applies a batch of meetings (called only by the applier, in the order of the file)
+ * @param meetings The meetings
+ * @param numOfMeetings The number of meetings
+ * @param context The context given to runMeetingPipeline
+ * @return PIPELINE_SUCCESS, or PIPELINE_FAILED to stop the pipeline
+ */
+typedef int (*MeetingApplier)(const MeetingInfo *meetings, size_t numOfMeetings, void *context);
+
+/**
+ * @struct StageStats
+ * @brief What one stage (or all the parsers together) did: the number of batches, the number of
+ * items (bytes for the reader, meetings for the others), and the seconds it was busy and waited
+ * for a ring
+ */
+typedef struct StageStats
+{
+	size_t numOfBatches;
+	size_t numOfItems;
+	double busySeconds;
+	double waitSeconds;
+} StageStats;
+
+/**
+ * @struct RingStats
+ * @brief How full the rings of one kind were: the number of pushes, the sum of the number of full
+ * slots right after every push (so the average is occupancySum / numOfPushes, out of capacity),
+ * and the number of times the producer found the ring full or the consumer found it empty
+ */
+typedef struct RingStats
+{
+	size_t capacity;
+	size_t numOfPushes;
+	size_t occupancySum;
+	size_t numOfFullWaits;
+	size_t numOfEmptyWaits;
+} RingStats;
+
+/**
+ * @struct PipelineStats
+ * @brief The counters of the whole pipeline
+ */
+typedef struct PipelineStats
+{
+	size_t numOfParsers;
+	StageStats reader;
+	StageStats parsers;
+	StageStats applier;
+	RingStats rawRings;
+	RingStats parsedRings;
+	double seconds;
+} PipelineStats;
+
+/**
+ * Runs the pipeline over a file until its end
+ * @param fd The file (read from its current place until its end)
+ * @param numOfParsers The number of parser threads (1 .. MAX_PARSERS)
+ * @param parser Parses the blocks (called by the parser threads at the same time)
+ * @param applier Applies the batches
+ * @param context Given to the applier
+ * @param stats Will contain the counters
+ * @return PIPELINE_SUCCESS, or PIPELINE_FAILED (reading failed, a line is invalid, the applier
+ * failed, or no memory or threads)
+ */
+int runMeetingPipeline(int fd, size_t numOfParsers, MeetingParser parser, MeetingApplier applier,
+                       void *context, PipelineStats *stats);
+
+#endif //EXAM_SPREADERDETECTORPIPELINE_H
@@ -0,0 +1,188 @@
+/**
+* @file SpreaderDetectorPolicy.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the policy of the classes
+* @section DESCRIPTION
+* The class is computed without branches: the thresholds of the first band are replaced by the
+* thresholds of every band the age reaches, and then the class is CLEAN_CLASS minus one for every
+* threshold the probability reaches (the quarantine threshold is never above the hospitalization
+* threshold, so reaching the second means reaching the first). The AVX2 version does the same with
+* compares and blends, 8 people at a time.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "SpreaderDetectorPolicy.h"
+#include "SpreaderDetectorCrna.h"
+#include "SpreaderDetectorOrder.h"
+#include "SpreaderDetectorParams.h"
+#include "SpreaderDetectorScan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/**
+ * @def POLICY_X86
+ * @brief The vector version exists (the program is built for x86)
+ */
+#define POLICY_X86
+#endif
+
+/**
+ * @def AVX2_WIDTH 8
+ * @brief The number of floats in an AVX2 vector
+ */
+#define AVX2_WIDTH 8
+
+/**
+ * @def COMMENT_CHAR '#'
+ * @brief A line of the policy file that starts with it is skipped
+ */
+#define COMMENT_CHAR '#'
+
+/**
+ * The classes of the people one by one
+ * @param policy The policy
+ * @param ages The ages
+ * @param probs The probabilities
+ * @param len The number of people
+ * @param classes Will contain the classes
+ */
+static void classifyPeopleScalar(const RiskPolicy *policy, const float *ages, const float *probs,
+                                 size_t len, unsigned char *classes)
+{
+	for (size_t i = 0; i < len; ++i)
+	{
+		classes[i] = (unsigned char) classOfPerson(policy, ages[i], probs[i]);
+	}
+}
+
+#ifdef POLICY_X86
+
+/**
+ * The classes of 8 people per instruction
+ * @param policy The policy
+ * @param ages The ages
+ * @param probs The probabilities
+ * @param len The number of people
+ * @param classes Will contain the classes
+ */
+__attribute__((target("avx2")))
+static void classifyPeopleAvx2(const RiskPolicy *policy, const float *ages, const float *probs,
+                               size_t len, unsigned char *classes)
+{
+	const __m256i clean = _mm256_set1_epi32(CLEAN_CLASS);
+	size_t i = 0;
+	for (; i + AVX2_WIDTH <= len; i += AVX2_WIDTH)
+	{
+		__m256 age = _mm256_loadu_ps(ages + i);
+		__m256 prob = _mm256_loadu_ps(probs + i);
+		__m256 quarantine = _mm256_set1_ps(policy->bands[0].quarantineThreshold);
+		__m256 hospitalization = _mm256_set1_ps(policy->bands[0].hospitalizationThreshold);
+		for (size_t b = 1; b < policy->numOfBands; ++b)
+		{
+			const AgeBand *band = &policy->bands[b];
+			__m256 inBand = _mm256_cmp_ps(age, _mm256_set1_ps(band->minAge), _CMP_GE_OQ);
+			quarantine = _mm256_blendv_ps(quarantine, _mm256_set1_ps(band->quarantineThreshold),
+			                              inBand);
+			hospitalization = _mm256_blendv_ps(hospitalization,
+			                                   _mm256_set1_ps(band->hospitalizationThreshold),
+			                                   inBand);
+		}
+		// A reached threshold is a lane of -1, so adding it takes one class off
+		__m256i reachedQuarantine = _mm256_castps_si256(_mm256_cmp_ps(prob, quarantine,
+		                                                              _CMP_GE_OQ));
+		__m256i reachedHospitalization = _mm256_castps_si256(_mm256_cmp_ps(prob, hospitalization,
+		                                                                   _CMP_GE_OQ));
+		__m256i classOfLane = _mm256_add_epi32(_mm256_add_epi32(clean, reachedQuarantine),
+		                                       reachedHospitalization);
+		// 8 classes of 32 bits into 8 bytes: the packs work inside each half of the vector
+		__m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(classOfLane, classOfLane),
+		                                     _mm256_setzero_si256());
+		int low = _mm256_cvtsi256_si32(packed);
+		int high = _mm256_extract_epi32(packed, 4);
+		memcpy(classes + i, &low, sizeof(low));
+		memcpy(classes + i + sizeof(low), &high, sizeof(high));
+	}
+	classifyPeopleScalar(policy, ages + i, probs + i, len - i, classes + i);
+}
+
+#endif
+
+void initDefaultPolicy(RiskPolicy *policy)
+{
+	const AgeBand young = {0.0f, REGULAR_QUARANTINE_THRESHOLD, MEDICAL_SUPERVISION_THRESHOLD};
+	const AgeBand old = {RISK_AGE, REGULAR_QUARANTINE_THRESHOLD, MEDICAL_SUPERVISION_THRESHOLD};
+	policy->bands[0] = young;
+	policy->bands[1] = old;
+	policy->numOfBands = 2;
+}
+
+int loadRiskPolicy(const char *path, RiskPolicy *policy)
+{
+	FILE *policyFile = fopen(path, READING_MODE);
+	if (policyFile == NULL)
+	{
+		return POLICY_OPEN_FAILED;
+	}
+	RiskPolicy loaded;
+	loaded.numOfBands = 0;
+	int status = POLICY_SUCCESS;
+	char currentRow[MAX_LINE_SIZE];
+	while (status == POLICY_SUCCESS && fgets(currentRow, sizeof(currentRow), policyFile))
+	{
+		const char *lineEnd = findLineEnd(currentRow, currentRow + strlen(currentRow));
+		const char *cur = skipBlanks(currentRow, lineEnd);
+		if (cur == lineEnd || *cur == COMMENT_CHAR)
+		{
+			continue;
+		}
+		AgeBand band;
+		if (loaded.numOfBands == MAX_AGE_BANDS ||
+		    scanFloat(&cur, lineEnd, &band.minAge) == SCAN_FAILED ||
+		    scanFloat(&cur, lineEnd, &band.quarantineThreshold) == SCAN_FAILED ||
+		    scanFloat(&cur, lineEnd, &band.hospitalizationThreshold) == SCAN_FAILED ||
+		    skipBlanks(cur, lineEnd) != lineEnd ||
+		    !(band.quarantineThreshold <= band.hospitalizationThreshold) ||
+		    (loaded.numOfBands > 0 && !(band.minAge > loaded.bands[loaded.numOfBands - 1].minAge)))
+		{
+			status = POLICY_INVALID;
+			break;
+		}
+		loaded.bands[loaded.numOfBands++] = band;
+	}
+	fclose(policyFile);
+	if (status != POLICY_SUCCESS || loaded.numOfBands == 0)
+	{
+		return POLICY_INVALID;
+	}
+	*policy = loaded;
+	return POLICY_SUCCESS;
+}
+
+unsigned int classOfPerson(const RiskPolicy *policy, float age, float probInfected)
+{
+	float quarantine = policy->bands[0].quarantineThreshold;
+	float hospitalization = policy->bands[0].hospitalizationThreshold;
+	for (size_t b = 1; b < policy->numOfBands; ++b)
+	{
+		int inBand = age >= policy->bands[b].minAge;
+		quarantine = inBand ? policy->bands[b].quarantineThreshold : quarantine;
+		hospitalization = inBand ? policy->bands[b].hospitalizationThreshold : hospitalization;
+	}
+	return CLEAN_CLASS - (probInfected >= quarantine) - (probInfected >= hospitalization);
+}
+
+void classifyPeople(const RiskPolicy *policy, const float *ages, const float *probs, size_t len,
+                    unsigned char *classes)
+{
+#ifdef POLICY_X86
+	if (bestCrnaIsa() != CRNA_ISA_SCALAR)
+	{
+		classifyPeopleAvx2(policy, ages, probs, len, classes);
+		return;
+	}
+#endif
+	classifyPeopleScalar(policy, ages, probs, len, classes);
+}
@@ -0,0 +1,105 @@
+/**
+* @file SpreaderDetectorPolicy.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The classes of the output (hospitalization, quarantine or clean) by age and probability
+* @section DESCRIPTION
+* A policy is a list of age bands, every band with its own two thresholds. A person belongs to the
+* last band whose minimal age is at most his age (and the first band takes everyone younger than
+* all the bands). The default policy has two bands, below RISK_AGE and from RISK_AGE, both with
+* REGULAR_QUARANTINE_THRESHOLD and MEDICAL_SUPERVISION_THRESHOLD, so it gives exactly the classes
+* of the thresholds alone. A policy file replaces it at startup, without building again: one band
+* per line, "<minimal age> <quarantine threshold> <hospitalization threshold>", the minimal ages
+* increasing, and lines that are empty or start with '#' are skipped.
+* The classes of a whole table are computed in one pass over its ages and probabilities columns,
+* with AVX2 when the CPU has it (8 people per instruction, see SpreaderDetectorCrna.h for how the
+* instruction set is chosen), so the bands cost the output almost nothing.
+*/
+
+#ifndef EXAM_SPREADERDETECTORPOLICY_H
+#define EXAM_SPREADERDETECTORPOLICY_H
+
+#include <stddef.h>
+
+/**
+ * @def MAX_AGE_BANDS 16
+ * @brief The maximal number of bands in a policy
+ */
+#define MAX_AGE_BANDS 16
+
+/**
+ * @def POLICY_SUCCESS 0
+ * @brief Returned by loadRiskPolicy when the policy was loaded
+ */
+#define POLICY_SUCCESS 0
+
+/**
+ * @def POLICY_OPEN_FAILED 1
+ * @brief Returned by loadRiskPolicy when the file could not be opened
+ */
+#define POLICY_OPEN_FAILED 1
+
+/**
+ * @def POLICY_INVALID 2
+ * @brief Returned by loadRiskPolicy when the file is not a valid policy (an invalid line, no
+ * bands, too many bands, ages that do not increase or a quarantine threshold above the
+ * hospitalization threshold)
+ */
+#define POLICY_INVALID 2
+
+/**
+ * @struct AgeBand
+ * @brief The thresholds of the people from minAge (until the minAge of the next band)
+ */
+typedef struct AgeBand
+{
+	float minAge;
+	float quarantineThreshold;
+	float hospitalizationThreshold;
+} AgeBand;
+
+/**
+ * @struct RiskPolicy
+ * @brief The bands, by increasing minAge
+ */
+typedef struct RiskPolicy
+{
+	AgeBand bands[MAX_AGE_BANDS];
+	size_t numOfBands;
+} RiskPolicy;
+
+/**
+ * Makes the default policy (the thresholds of SpreaderDetectorParams.h, split at RISK_AGE)
+ * @param policy The policy
+ */
+void initDefaultPolicy(RiskPolicy *policy);
+
+/**
+ * Loads a policy file
+ * @param path The path of the file
+ * @param policy Will contain the policy (it is not changed if the file is not valid)
+ * @return POLICY_SUCCESS, POLICY_OPEN_FAILED or POLICY_INVALID
+ */
+int loadRiskPolicy(const char *path, RiskPolicy *policy);
+
+/**
+ * Returns the class of one person
+ * @param policy The policy
+ * @param age The age of the person
+ * @param probInfected The probability that the person is infected
+ * @return HOSPITALIZATION_CLASS, QUARANTINE_CLASS or CLEAN_CLASS (see SpreaderDetectorOrder.h)
+ */
+unsigned int classOfPerson(const RiskPolicy *policy, float age, float probInfected);
+
+/**
+ * Computes the class of every person of a table, in one pass over its columns
+ * @param policy The policy
+ * @param ages The ages (by row)
+ * @param probs The probabilities (by row)
+ * @param len The number of people
+ * @param classes Will contain the class of every person (by row)
+ */
+void classifyPeople(const RiskPolicy *policy, const float *ages, const float *probs, size_t len,
+                    unsigned char *classes);
+
+#endif //EXAM_SPREADERDETECTORPOLICY_H
@@ -0,0 +1,600 @@
+/**
+* @file SpreaderDetectorRankOrder.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the propagation over the ranks
+* @section DESCRIPTION
+* A batch whose new meetings keep the ranks is propagated with a heap by rank, only through the
+* people that were really changed. Otherwise the batch has four passes over the affected people:
+* finding them (from the dirty people, along the meetings), counting for every one of them the
+* meetings that infect him from other affected people, Kahn's topological order over them, and
+* giving them new ranks in this order (and computing the dirty ones). If Kahn's order stops at a
+* cycle, all the people are ordered again like in the full propagation. The scratch of every
+* visited person is cleared at the end, so the next batch starts from clean scratch without
+* touching the rest of the graph. The loops that compute the people again take the combine rule,
+* and are inlined into a wrapper for every rule (see SpreaderDetectorGraph.h); a propagation uses
+* the wrappers of its rule.
+*/
+
+#include "SpreaderDetectorRankOrder.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorGraph.h"
+
+/**
+ * @def AFFECTED_MARK 1
+ * @brief The person can be reached from the dirty people of the batch
+ */
+#define AFFECTED_MARK 1
+
+/**
+ * @def DIRTY_MARK 2
+ * @brief The person has to be computed again (one of his meetings was changed, or one of his
+ * infectors)
+ */
+#define DIRTY_MARK 2
+
+/**
+ * @def DONE_MARK 4
+ * @brief The person was already visited in the topological order of the batch
+ */
+#define DONE_MARK 4
+
+/**
+ * @def NO_RANK SIZE_MAX
+ * @brief The rank of an affected person until he gets his new one (larger than every rank, so
+ * his meetings are not used before)
+ */
+#define NO_RANK SIZE_MAX
+
+int initRankOrder(RankOrder *order, size_t numOfNodes, const size_t *keys, int combineRule,
+                  float *probs, int isKeepingChanged)
+{
+	order->numOfNodes = numOfNodes;
+	order->keys = keys;
+	order->combineRule = combineRule;
+	order->probs = probs;
+	order->isSeed = (unsigned char *) trackedCalloc(numOfNodes, sizeof(unsigned char));
+	order->marks = (unsigned char *) trackedCalloc(numOfNodes, sizeof(unsigned char));
+	order->dirty = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	order->pending = (size_t *) trackedCalloc(numOfNodes, sizeof(size_t));
+	order->affected = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	order->ready = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	order->ranks = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	order->byKey = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	if (isKeepingChanged)
+	{
+		order->changed = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+		order->oldProbs = (float *) trackedMalloc(numOfNodes * sizeof(float));
+	}
+	order->numOfDirty = 0;
+	order->numOfChanged = 0;
+	order->isInOrder = 1;
+	order->hasCycles = 0;
+	order->isByKeySorted = 0;
+	if (numOfNodes > 0 &&
+		(order->isSeed == NULL || order->marks == NULL || order->dirty == NULL ||
+		 order->pending == NULL || order->affected == NULL || order->ready == NULL ||
+		 order->ranks == NULL || order->byKey == NULL ||
+		 (isKeepingChanged && (order->changed == NULL || order->oldProbs == NULL))))
+	{
+		return RANK_FAILED;
+	}
+	for (size_t node = 0; node < numOfNodes; ++node) // no meetings, so any order is topological
+	{
+		order->ranks[node] = node;
+	}
+	order->nextRank = numOfNodes;
+	return RANK_SUCCESS;
+}
+
+void linkRankEdge(const RankEdges *edges, size_t edge)
+{
+	size_t infector = edges->infectors[edge];
+	size_t infected = edges->infecteds[edge];
+	if (edges->prevOut != NULL)
+	{
+		edges->prevOut[edge] = NO_EDGE;
+		if (edges->outHeads[infector] != NO_EDGE)
+		{
+			edges->prevOut[edges->outHeads[infector]] = edge;
+		}
+	}
+	edges->nextOut[edge] = edges->outHeads[infector];
+	edges->outHeads[infector] = edge;
+	edges->nextIn[edge] = NO_EDGE;
+	if (edges->inTails[infected] == NO_EDGE)
+	{
+		edges->inHeads[infected] = edge;
+	}
+	else
+	{
+		edges->nextIn[edges->inTails[infected]] = edge;
+	}
+	edges->inTails[infected] = edge;
+}
+
+void markRankDirty(RankOrder *order, size_t node)
+{
+	if (!(order->marks[node] & DIRTY_MARK))
+	{
+		order->marks[node] |= DIRTY_MARK;
+		order->dirty[order->numOfDirty++] = node;
+	}
+}
+
+void addRankEdge(RankOrder *order, size_t infector, size_t infected)
+{
+	markRankDirty(order, infected);
+	order->isInOrder = order->isInOrder && order->ranks[infector] < order->ranks[infected];
+}
+
+void removeRankEdge(RankOrder *order, size_t infected)
+{
+	markRankDirty(order, infected);
+	order->isInOrder = order->isInOrder && !order->hasCycles;
+}
+
+/**
+ * Adds a person to the heap of the batch (a min-heap by rank)
+ * @param order The order
+ * @param heapLen pointer to the number of people in the heap
+ * @param node The person
+ */
+static void pushByRank(RankOrder *order, size_t *heapLen, size_t node)
+{
+	size_t *heap = order->ready;
+	size_t place = (*heapLen)++;
+	while (place > 0 && order->ranks[heap[(place - 1) / 2]] > order->ranks[node])
+	{
+		heap[place] = heap[(place - 1) / 2];
+		place = (place - 1) / 2;
+	}
+	heap[place] = node;
+}
+
+/**
+ * Takes the person with the smallest rank out of the heap of the batch
+ * @param order The order
+ * @param heapLen pointer to the number of people in the heap (not 0)
+ * @return The person
+ */
+static size_t popByRank(RankOrder *order, size_t *heapLen)
+{
+	size_t *heap = order->ready;
+	size_t top = heap[0];
+	size_t last = heap[--(*heapLen)];
+	size_t place = 0;
+	while (2 * place + 1 < *heapLen)
+	{
+		size_t child = 2 * place + 1;
+		if (child + 1 < *heapLen && order->ranks[heap[child + 1]] < order->ranks[heap[child]])
+		{
+			child++;
+		}
+		if (order->ranks[heap[child]] >= order->ranks[last])
+		{
+			break;
+		}
+		heap[place] = heap[child];
+		place = child;
+	}
+	heap[place] = last;
+	return top;
+}
+
+/**
+ * Kahn's topological order over the affected people (their pending meetings are counted), into
+ * ready. If only cycles are left, the order either stops, or (when it breaks cycles, and everyone
+ * is affected) takes the person with the smallest key that is left, like the full propagation
+ * @param order The order
+ * @param edges The meetings
+ * @param numOfAffected The number of affected people (in order->affected)
+ * @param isBreakingCycles 1 to break the cycles, 0 to stop at them
+ * @return 1 if all the affected people are in the order, 0 if it stopped at a cycle
+ */
+static int sortAffected(RankOrder *order, const RankEdges *edges, size_t numOfAffected,
+                        int isBreakingCycles)
+{
+	unsigned char *marks = order->marks;
+	size_t *ready = order->ready;
+	size_t numOfReady = 0;
+	for (size_t i = 0; i < numOfAffected; ++i)
+	{
+		if (order->pending[order->affected[i]] == 0)
+		{
+			ready[numOfReady++] = order->affected[i];
+		}
+	}
+	size_t nextReady = 0;
+	size_t nextByKey = 0;
+	for (size_t numOfDone = 0; numOfDone < numOfAffected; ++numOfDone)
+	{
+		if (nextReady == numOfReady) // only cycles are left
+		{
+			if (!isBreakingCycles)
+			{
+				return 0;
+			}
+			if (!order->isByKeySorted) // the keys never change, so they are sorted only once
+			{
+				for (size_t node = 0; node < order->numOfNodes; ++node)
+				{
+					order->byKey[node] = node;
+				}
+				sortNodesByKey(order->byKey, order->numOfNodes, order->keys);
+				order->isByKeySorted = 1;
+			}
+			while (marks[order->byKey[nextByKey]] & DONE_MARK)
+			{
+				nextByKey++;
+			}
+			ready[numOfReady++] = order->byKey[nextByKey];
+			order->hasCycles = 1;
+		}
+		size_t node = ready[nextReady++];
+		marks[node] |= DONE_MARK;
+		for (size_t e = edges->outHeads[node]; e != NO_EDGE; e = edges->nextOut[e])
+		{
+			size_t target = edges->infecteds[e];
+			if (!(marks[target] & DONE_MARK) && --order->pending[target] == 0)
+			{
+				ready[numOfReady++] = target;
+			}
+		}
+	}
+	return 1;
+}
+
+/**
+ * Clears the scratch of the affected people, for the next batch
+ * @param order The order
+ * @param numOfAffected The number of affected people (in order->affected)
+ */
+static void clearAffected(RankOrder *order, size_t numOfAffected)
+{
+	for (size_t i = 0; i < numOfAffected; ++i)
+	{
+		order->marks[order->affected[i]] = 0;
+		order->pending[order->affected[i]] = 0;
+	}
+}
+
+/**
+ * Computes the probability of a person again: 1 for a seed (NOT_EXPOSED otherwise) combined with
+ * the exposure of every meeting that infects him from a smaller rank (all of them, unless he was
+ * taken on a cycle), in the order of his list. If it was changed it is counted (and kept, with the
+ * old probability, when the order keeps the changed people)
+ * @param order The order
+ * @param edges The meetings
+ * @param node The person
+ * @param combineRule The combine rule (a constant of the caller)
+ * @return 1 if it was changed, 0 otherwise
+ */
+static ALWAYS_INLINE int recomputeNode(RankOrder *order, const RankEdges *edges, size_t node,
+                                       int combineRule)
+{
+	float prob = order->isSeed[node] ? SURE_INFECTED : NOT_EXPOSED;
+	for (size_t e = edges->inHeads[node]; e != NO_EDGE; e = edges->nextIn[e])
+	{
+		if (order->ranks[edges->infectors[e]] < order->ranks[node])
+		{
+			prob = combineExposure(combineRule, prob,
+			                       order->probs[edges->infectors[e]] * edges->weights[e]);
+		}
+	}
+	if (prob == order->probs[node])
+	{
+		return 0;
+	}
+	if (order->changed != NULL)
+	{
+		order->changed[order->numOfChanged] = node;
+		order->oldProbs[order->numOfChanged] = order->probs[node];
+	}
+	order->numOfChanged++;
+	order->probs[node] = prob;
+	return 1;
+}
+
+/**
+ * Gives the affected people the next ranks in the order of sortAffected, and computes the dirty
+ * ones again (or all of them). A person whose probability was changed makes the people he infects
+ * dirty. The scratch of the affected people is cleared at the end
+ * @param order The order
+ * @param edges The meetings
+ * @param numOfAffected The number of affected people
+ * @param isComputingAll 1 to compute all of them again, 0 for only the dirty ones
+ * @param combineRule The combine rule (a constant of the caller)
+ */
+static ALWAYS_INLINE void rankAffected(RankOrder *order, const RankEdges *edges,
+                                       size_t numOfAffected, int isComputingAll, int combineRule)
+{
+	unsigned char *marks = order->marks;
+	for (size_t i = 0; i < numOfAffected; ++i)
+	{
+		order->ranks[order->affected[i]] = NO_RANK;
+	}
+	for (size_t i = 0; i < numOfAffected; ++i)
+	{
+		size_t node = order->ready[i];
+		order->ranks[node] = order->nextRank++;
+		if ((isComputingAll || (marks[node] & DIRTY_MARK)) &&
+		    recomputeNode(order, edges, node, combineRule))
+		{
+			for (size_t e = edges->outHeads[node]; e != NO_EDGE; e = edges->nextOut[e])
+			{
+				marks[edges->infecteds[e]] |= DIRTY_MARK;
+			}
+		}
+	}
+	clearAffected(order, numOfAffected);
+}
+
+/**
+ * Orders all the people again like the full propagation (breaking the cycles by the keys), and
+ * notes whether there are cycles. Everyone's scratch is clear, except the marks of the dirty people
+ * @param order The order
+ * @param edges The meetings
+ * @param isComputingAll 1 to compute everyone again, 0 for only the dirty people
+ * @param combineRule The combine rule (a constant of the caller)
+ * @return The number of people (all of them were visited)
+ */
+static ALWAYS_INLINE size_t orderAllNodes(RankOrder *order, const RankEdges *edges,
+                                          int isComputingAll, int combineRule)
+{
+	for (size_t node = 0; node < order->numOfNodes; ++node) // everyone is affected
+	{
+		order->affected[node] = node;
+		for (size_t e = edges->outHeads[node]; e != NO_EDGE; e = edges->nextOut[e])
+		{
+			order->pending[edges->infecteds[e]]++;
+		}
+	}
+	order->hasCycles = 0;
+	order->nextRank = 0;
+	sortAffected(order, edges, order->numOfNodes, 1);
+	rankAffected(order, edges, order->numOfNodes, isComputingAll, combineRule);
+	return order->numOfNodes;
+}
+
+/**
+ * Propagates a batch whose new meetings all go from a smaller rank to a larger one (the ranks are
+ * still a topological order). Only the dirty people are visited, by the order of their ranks (a
+ * heap): the marked people, and the people infected by someone who was changed. Every person is
+ * visited at most once, after all his infectors (with smaller ranks) that were visited
+ * @param order The order
+ * @param edges The meetings
+ * @param combineRule The combine rule (a constant of the caller)
+ * @return The number of people that were visited
+ */
+static ALWAYS_INLINE size_t propagateByRank(RankOrder *order, const RankEdges *edges,
+                                            int combineRule)
+{
+	unsigned char *marks = order->marks;
+	size_t heapLen = 0;
+	size_t numOfVisited = 0;
+	for (size_t i = 0; i < order->numOfDirty; ++i)
+	{
+		pushByRank(order, &heapLen, order->dirty[i]);
+	}
+	while (heapLen > 0)
+	{
+		size_t node = popByRank(order, &heapLen);
+		marks[node] = 0; // can not be pushed again: only larger ranks are pushed from now on
+		numOfVisited++;
+		if (!recomputeNode(order, edges, node, combineRule))
+		{
+			continue;
+		}
+		for (size_t e = edges->outHeads[node]; e != NO_EDGE; e = edges->nextOut[e])
+		{
+			size_t target = edges->infecteds[e];
+			// a meeting against the ranks closes a cycle, and is not followed (like in the full
+			// propagation, where the person it infects was already made final)
+			if (order->ranks[target] > order->ranks[node] && !(marks[target] & DIRTY_MARK))
+			{
+				marks[target] = DIRTY_MARK;
+				pushByRank(order, &heapLen, target);
+			}
+		}
+	}
+	return numOfVisited;
+}
+
+/**
+ * Propagates a batch with a new meeting against the ranks: everyone that can be reached from the
+ * dirty people is affected, and they are ordered again (and get new ranks, larger than all the
+ * others, so the ranks are a topological order again). If they have a cycle, all the people are
+ * ordered again instead
+ * @param order The order
+ * @param edges The meetings
+ * @param combineRule The combine rule (a constant of the caller)
+ * @return The number of affected people
+ */
+static ALWAYS_INLINE size_t propagateByKahn(RankOrder *order, const RankEdges *edges,
+                                            int combineRule)
+{
+	unsigned char *marks = order->marks;
+	size_t *affected = order->affected;
+	size_t numOfAffected = 0;
+	for (size_t i = 0; i < order->numOfDirty; ++i)
+	{
+		affected[numOfAffected++] = order->dirty[i];
+		marks[order->dirty[i]] |= AFFECTED_MARK;
+	}
+	// everyone they can reach is affected. Every affected person counts the meetings that infect
+	// him from affected people (he waits for them)
+	for (size_t i = 0; i < numOfAffected; ++i)
+	{
+		for (size_t e = edges->outHeads[affected[i]]; e != NO_EDGE; e = edges->nextOut[e])
+		{
+			size_t target = edges->infecteds[e];
+			order->pending[target]++;
+			if (!(marks[target] & AFFECTED_MARK))
+			{
+				marks[target] |= AFFECTED_MARK;
+				affected[numOfAffected++] = target;
+			}
+		}
+	}
+	if (!sortAffected(order, edges, numOfAffected, 0)) // the new meetings closed a cycle
+	{
+		clearAffected(order, numOfAffected);
+		return orderAllNodes(order, edges, 1, combineRule);
+	}
+	rankAffected(order, edges, numOfAffected, 0, combineRule);
+	return numOfAffected;
+}
+
+/**
+ * orderAllNodes with COMBINE_MAX
+ * @param order The order
+ * @param edges The meetings
+ * @param isComputingAll 1 to compute everyone again, 0 for only the dirty people
+ * @return The number of people
+ */
+static size_t orderAllNodesMax(RankOrder *order, const RankEdges *edges, int isComputingAll)
+{
+	return orderAllNodes(order, edges, isComputingAll, COMBINE_MAX);
+}
+
+/**
+ * propagateByRank with COMBINE_MAX
+ * @param order The order
+ * @param edges The meetings
+ * @return The number of people that were visited
+ */
+static size_t propagateByRankMax(RankOrder *order, const RankEdges *edges)
+{
+	return propagateByRank(order, edges, COMBINE_MAX);
+}
+
+/**
+ * propagateByKahn with COMBINE_MAX
+ * @param order The order
+ * @param edges The meetings
+ * @return The number of affected people
+ */
+static size_t propagateByKahnMax(RankOrder *order, const RankEdges *edges)
+{
+	return propagateByKahn(order, edges, COMBINE_MAX);
+}
+
+/**
+ * orderAllNodes with COMBINE_NOISY_OR
+ * @param order The order
+ * @param edges The meetings
+ * @param isComputingAll 1 to compute everyone again, 0 for only the dirty people
+ * @return The number of people
+ */
+static size_t orderAllNodesNoisyOr(RankOrder *order, const RankEdges *edges, int isComputingAll)
+{
+	return orderAllNodes(order, edges, isComputingAll, COMBINE_NOISY_OR);
+}
+
+/**
+ * propagateByRank with COMBINE_NOISY_OR
+ * @param order The order
+ * @param edges The meetings
+ * @return The number of people that were visited
+ */
+static size_t propagateByRankNoisyOr(RankOrder *order, const RankEdges *edges)
+{
+	return propagateByRank(order, edges, COMBINE_NOISY_OR);
+}
+
+/**
+ * propagateByKahn with COMBINE_NOISY_OR
+ * @param order The order
+ * @param edges The meetings
+ * @return The number of affected people
+ */
+static size_t propagateByKahnNoisyOr(RankOrder *order, const RankEdges *edges)
+{
+	return propagateByKahn(order, edges, COMBINE_NOISY_OR);
+}
+
+/**
+ * @struct RankRunners
+ * @brief The loops of the propagation over the ranks of one combine rule (its wrappers)
+ */
+typedef struct RankRunners
+{
+	size_t (*orderAllNodes)(RankOrder *order, const RankEdges *edges, int isComputingAll);
+	size_t (*propagateByRank)(RankOrder *order, const RankEdges *edges);
+	size_t (*propagateByKahn)(RankOrder *order, const RankEdges *edges);
+} RankRunners;
+
+/**
+ * The loops of the propagation over the ranks (by combine rule)
+ */
+static const RankRunners rankRunners[NUM_OF_COMBINE_RULES] = {
+		{orderAllNodesMax,     propagateByRankMax,     propagateByKahnMax},
+		{orderAllNodesNoisyOr, propagateByRankNoisyOr, propagateByKahnNoisyOr}};
+
+void rankAllNodes(RankOrder *order, const RankEdges *edges)
+{
+	// nobody is dirty, so nothing is computed (and the rule is not used)
+	rankRunners[order->combineRule].orderAllNodes(order, edges, 0);
+}
+
+size_t propagateRankOrder(RankOrder *order, const RankEdges *edges)
+{
+	const RankRunners *runners = &rankRunners[order->combineRule];
+	size_t numOfVisited = 0;
+	order->numOfChanged = 0;
+	if (order->numOfDirty > 0)
+	{
+		if (order->isInOrder)
+		{
+			numOfVisited = runners->propagateByRank(order, edges);
+		}
+		else
+		{
+			// with cycles, a change of the order may change where all of them are broken
+			numOfVisited = order->hasCycles ? runners->orderAllNodes(order, edges, 1) :
+			               runners->propagateByKahn(order, edges);
+		}
+	}
+	order->numOfDirty = 0;
+	order->isInOrder = 1;
+	return numOfVisited;
+}
+
+
+size_t strongestRankInfector(const RankOrder *order, const RankEdges *edges, size_t node)
+{
+	size_t infector = NO_RANK_INFECTOR;
+	float strongest = NOT_EXPOSED;
+	if (order->isSeed[node])
+	{
+		return NO_RANK_INFECTOR;
+	}
+	for (size_t e = edges->inHeads[node]; e != NO_EDGE; e = edges->nextIn[e])
+	{
+		float exposure = order->probs[edges->infectors[e]] * edges->weights[e];
+		if (exposure > strongest) // the first of equal exposures
+		{
+			strongest = exposure;
+			infector = edges->infectors[e];
+		}
+	}
+	return infector;
+}
+
+void freeRankOrder(RankOrder *order)
+{
+	size_t numOfNodes = order->numOfNodes;
+	trackedFree(order->isSeed, numOfNodes * sizeof(unsigned char));
+	trackedFree(order->marks, numOfNodes * sizeof(unsigned char));
+	trackedFree(order->dirty, numOfNodes * sizeof(size_t));
+	trackedFree(order->pending, numOfNodes * sizeof(size_t));
+	trackedFree(order->affected, numOfNodes * sizeof(size_t));
+	trackedFree(order->ready, numOfNodes * sizeof(size_t));
+	trackedFree(order->ranks, numOfNodes * sizeof(size_t));
+	trackedFree(order->byKey, numOfNodes * sizeof(size_t));
+	trackedFree(order->changed, numOfNodes * sizeof(size_t));
+	trackedFree(order->oldProbs, numOfNodes * sizeof(float));
+	RankOrder empty = {0};
+	*order = empty;
+}
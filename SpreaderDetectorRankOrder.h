@@ -0,0 +1,194 @@
+/**
+* @file SpreaderDetectorRankOrder.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The propagation of a batch of changes through a graph that keeps a topological order of
+* its people (their ranks), shared by the incremental graph and the graph of the window
+* @section DESCRIPTION
+* Both graphs keep their meetings in arrays (infectors, infecteds and a weight column) and link the
+* meetings of every person into lists inside these arrays: the meetings that infect him, in the
+* order they were read (inHeads to inTails through nextIn), and the meetings he is the infector in
+* (from outHeads through nextOut, and back through prevOut when meetings can leave from the middle
+* of the list). RankEdges points to these arrays, so the same propagation runs over both graphs
+* and over the weight column each of them uses (the crnas, or the crnas after the decay).
+* RankOrder holds the ranks of the people and the scratch of a batch. A change (a new meeting, a
+* meeting that left or was weighed again, a new seed) marks the person it infects as dirty, and
+* propagateRankOrder computes the dirty people again and everyone they change:
+* - while every new meeting goes from a smaller rank to a larger one (the ranks are still a
+*   topological order) only the dirty people are visited, by the order of their ranks (a heap);
+* - otherwise everyone that can be reached from the dirty people is affected, and they are visited
+*   in Kahn's topological order, which also gives them new ranks.
+* The ranks are the order in which the full propagation (SpreaderDetectorGraph.h) makes the people
+* final, and a person is computed from the meetings whose infectors have smaller ranks. When the
+* meetings have cycles (which should not happen) the full propagation makes final the person with
+* the smallest key (his ID) of the people that are left, so which people are taken depends on the
+* whole graph: from the first time a cycle is found (hasCycles) until there are no cycles again, a
+* change of the order (a meeting against the ranks, or a meeting that left) orders all the people
+* again the same way, and computes all of them. A new meeting that keeps the ranks, a new weight or
+* a new seed never changes which people are taken, so they still use the heap.
+*/
+
+#ifndef EXAM_SPREADERDETECTORRANKORDER_H
+#define EXAM_SPREADERDETECTORRANKORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @def RANK_SUCCESS 1
+ * @brief Returned by the functions of the rank order when they succeeded
+ */
+#define RANK_SUCCESS 1
+
+/**
+ * @def RANK_FAILED 0
+ * @brief Returned by the functions of the rank order when an allocation failed
+ */
+#define RANK_FAILED 0
+
+/**
+ * @def NO_EDGE SIZE_MAX
+ * @brief The end of a list of edges
+ */
+#define NO_EDGE SIZE_MAX
+
+/**
+ * @def NO_RANK_INFECTOR SIZE_MAX
+ * @brief Returned by strongestRankInfector for a person that nobody infected (a seed, or a person
+ * whose meetings all have no risk)
+ */
+#define NO_RANK_INFECTOR SIZE_MAX
+
+/**
+ * @struct RankEdges
+ * @brief The meetings of a graph and the lists that link them (see the description above). The
+ * arrays belong to the graph, and may be moved when it grows, so a graph fills this right before
+ * it is used. prevOut is NULL when meetings never leave the middle of a list
+ */
+typedef struct RankEdges
+{
+	size_t *infectors;
+	size_t *infecteds;
+	float *weights;
+	size_t *nextIn;
+	size_t *nextOut;
+	size_t *prevOut;
+	size_t *inHeads;
+	size_t *inTails;
+	size_t *outHeads;
+} RankEdges;
+
+/**
+ * @struct RankOrder
+ * @brief The people of a graph: their keys, their probabilities, which of them are seeds, their
+ * ranks (a topological order, nextRank is the next rank to give), whether the new meetings keep it
+ * and whether the meetings have cycles. byKey is all the people by their keys (sorted the first
+ * time a cycle is found). marks, dirty (the people marked since the last propagation), pending,
+ * affected and ready (also the heap by rank) are the scratch of a batch. numOfChanged is the number
+ * of people the last propagation changed; when changed is not NULL it holds them, and oldProbs
+ * their probabilities before it. An order initialized to {0} is empty
+ */
+typedef struct RankOrder
+{
+	size_t numOfNodes;
+	const size_t *keys;
+	size_t *byKey;
+	int isByKeySorted;
+	int combineRule;
+	float *probs;
+	unsigned char *isSeed;
+	unsigned char *marks;
+	size_t *dirty;
+	size_t numOfDirty;
+	size_t *pending;
+	size_t *affected;
+	size_t *ready;
+	size_t *ranks;
+	size_t nextRank;
+	int isInOrder;
+	int hasCycles;
+	size_t *changed;
+	float *oldProbs;
+	size_t numOfChanged;
+} RankOrder;
+
+/**
+ * Prepares the order of the people of a graph without meetings (any order is topological)
+ * @param order The order (empty)
+ * @param numOfNodes The number of people
+ * @param keys The key of every person (his ID), to break the cycles by like propagateRisk (kept
+ * as long as the order is used)
+ * @param combineRule COMBINE_MAX or COMBINE_NOISY_OR (see SpreaderDetectorGraph.h)
+ * @param probs The probabilities of the people. They are updated by every propagation (and must
+ * stay valid as long as the order is used)
+ * @param isKeepingChanged 1 to keep the people every propagation changed (changed and oldProbs), 0
+ * to only count them
+ * @return RANK_SUCCESS or RANK_FAILED (no memory; what was allocated is released by freeRankOrder)
+ */
+int initRankOrder(RankOrder *order, size_t numOfNodes, const size_t *keys, int combineRule,
+                  float *probs, int isKeepingChanged);
+
+/**
+ * Links a meeting to the end of the list of its infected and to the start of the list of its
+ * infector
+ * @param edges The meetings
+ * @param edge The meeting
+ */
+void linkRankEdge(const RankEdges *edges, size_t edge);
+
+/**
+ * Marks a person to be computed again by the next propagation (once)
+ * @param order The order
+ * @param node The person
+ */
+void markRankDirty(RankOrder *order, size_t node);
+
+/**
+ * Marks the infected of a new meeting, and notes whether the meeting keeps the ranks
+ * @param order The order
+ * @param infector The infector of the meeting
+ * @param infected The infected of the meeting
+ */
+void addRankEdge(RankOrder *order, size_t infector, size_t infected);
+
+/**
+ * Marks the infected of a meeting that left the graph (when the meetings have cycles, this may
+ * change which people the cycles are broken at)
+ * @param order The order
+ * @param infected The infected of the meeting
+ */
+void removeRankEdge(RankOrder *order, size_t infected);
+
+/**
+ * Gives all the people ranks in the order of the full propagation of the meetings, without
+ * computing any of them again (the probabilities already match the meetings)
+ * @param order The order (nobody is marked)
+ * @param edges The meetings
+ */
+void rankAllNodes(RankOrder *order, const RankEdges *edges);
+
+/**
+ * Computes again the people that were marked since the last propagation, and everyone they change
+ * @param order The order
+ * @param edges The meetings
+ * @return The number of people that were visited
+ */
+size_t propagateRankOrder(RankOrder *order, const RankEdges *edges);
+
+/**
+ * Finds the infector of the meeting that gave a person his largest exposure (with COMBINE_MAX the
+ * one his probability came from). The first of equal exposures, in the order of his list
+ * @param order The order (propagated)
+ * @param edges The meetings
+ * @param node The person
+ * @return The infector, or NO_RANK_INFECTOR
+ */
+size_t strongestRankInfector(const RankOrder *order, const RankEdges *edges, size_t node);
+
+/**
+ * Releases the order. And turns it into an empty order
+ * @param order The order
+ */
+void freeRankOrder(RankOrder *order);
+
+#endif //EXAM_SPREADERDETECTORRANKORDER_H
@@ -0,0 +1,208 @@
+/**
+* @file SpreaderDetectorScan.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the scan functions
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "SpreaderDetectorScan.h"
+
+int scanMeetingFromBytes(const char *line, const char *lineEnd, MeetingInfo *meeting)
+{
+	const char *cur = line;
+	// The fields of a line of the meeting file (like "%lu %lu %f %f" of sscanf):
+	// <infector ID> <infected ID> <distance> <time>
+	if (scanUnsigned(&cur, lineEnd, &meeting->infectorId) == SCAN_FAILED ||
+		scanUnsigned(&cur, lineEnd, &meeting->infectedId) == SCAN_FAILED ||
+		scanFloat(&cur, lineEnd, &meeting->distance) == SCAN_FAILED ||
+		scanFloat(&cur, lineEnd, &meeting->time) == SCAN_FAILED)
+	{
+		return SCAN_FAILED;
+	}
+	return SCAN_SUCCESS;
+}
+
+int scanPersonFromBytes(const char *line, const char *lineEnd, const char **name, size_t *nameLen,
+                        size_t *id, float *age)
+{
+	const char *cur = line;
+	// The fields of a line of the people file (like "%s %lu %f" of sscanf):
+	// <Person Name> <Person ID> <Person age>
+	if (scanToken(&cur, lineEnd, name, nameLen) == SCAN_FAILED ||
+		scanUnsigned(&cur, lineEnd, id) == SCAN_FAILED ||
+		scanFloat(&cur, lineEnd, age) == SCAN_FAILED)
+	{
+		return SCAN_FAILED;
+	}
+	return SCAN_SUCCESS;
+}
+
+int scanTimedMeetingFromBytes(const char *line, const char *lineEnd, MeetingInfo *meeting,
+                              size_t *timestamp)
+{
+	const char *cur = line;
+	if (scanUnsigned(&cur, lineEnd, &meeting->infectorId) == SCAN_FAILED ||
+		scanUnsigned(&cur, lineEnd, &meeting->infectedId) == SCAN_FAILED ||
+		scanFloat(&cur, lineEnd, &meeting->distance) == SCAN_FAILED ||
+		scanFloat(&cur, lineEnd, &meeting->time) == SCAN_FAILED ||
+		scanUnsigned(&cur, lineEnd, timestamp) == SCAN_FAILED)
+	{
+		return SCAN_FAILED;
+	}
+	return SCAN_SUCCESS;
+}
+
+const char *findLineEnd(const char *cur, const char *end)
+{
+	const char *lineEnd = (const char *) memchr(cur, '\n', (size_t) (end - cur));
+	return lineEnd != NULL ? lineEnd : end;
+}
+
+int isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+const char *skipBlanks(const char *cur, const char *lineEnd)
+{
+	while (cur < lineEnd && isBlank(*cur))
+	{
+		cur++;
+	}
+	return cur;
+}
+
+int scanToken(const char **cur, const char *lineEnd, const char **token, size_t *tokenLen)
+{
+	const char *begin = skipBlanks(*cur, lineEnd);
+	const char *tokenEnd = begin;
+	while (tokenEnd < lineEnd && !isBlank(*tokenEnd))
+	{
+		tokenEnd++;
+	}
+	if (tokenEnd == begin)
+	{
+		return SCAN_FAILED;
+	}
+	*token = begin;
+	*tokenLen = (size_t) (tokenEnd - begin);
+	*cur = tokenEnd;
+	return SCAN_SUCCESS;
+}
+
+int scanUnsigned(const char **cur, const char *lineEnd, size_t *value)
+{
+	const char *begin = skipBlanks(*cur, lineEnd);
+	const char *p = begin;
+	int negative = 0; // "%lu" accepts a sign (and negates the number as unsigned)
+	if (p < lineEnd && (*p == '+' || *p == '-'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+	const char *digits = p;
+	size_t result = 0;
+	while (p < lineEnd && *p >= '0' && *p <= '9')
+	{
+		result = result * DECIMAL_BASE + (size_t) (*p - '0');
+		p++;
+	}
+	if (p == digits)
+	{
+		return SCAN_FAILED;
+	}
+	if ((size_t) (p - digits) > MAX_FAST_ID_DIGITS) // may overflow, strtoul knows what to do
+	{
+		char buffer[MAX_LINE_SIZE];
+		copyField(begin, lineEnd, buffer);
+		char *numberEnd;
+		result = strtoul(buffer, &numberEnd, DECIMAL_BASE);
+		*value = result;
+		*cur = begin + (numberEnd - buffer);
+		return SCAN_SUCCESS;
+	}
+	*value = negative ? -result : result;
+	*cur = p;
+	return SCAN_SUCCESS;
+}
+
+int scanFloat(const char **cur, const char *lineEnd, float *value)
+{
+	const char *begin = skipBlanks(*cur, lineEnd);
+	const char *p = begin;
+	int negative = 0;
+	if (p < lineEnd && (*p == '+' || *p == '-'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+	size_t mantissa = 0;
+	size_t numOfDigits = 0;
+	size_t fractionDigits = 0;
+	while (p < lineEnd && *p >= '0' && *p <= '9')
+	{
+		mantissa = mantissa <= MAX_EXACT_FLOAT_MANTISSA ? mantissa * DECIMAL_BASE + (*p - '0') :
+		           mantissa;
+		numOfDigits++;
+		p++;
+	}
+	if (p < lineEnd && *p == '.')
+	{
+		p++;
+		while (p < lineEnd && *p >= '0' && *p <= '9')
+		{
+			mantissa = mantissa <= MAX_EXACT_FLOAT_MANTISSA ? mantissa * DECIMAL_BASE + (*p - '0') :
+			           mantissa;
+			numOfDigits++;
+			fractionDigits++;
+			p++;
+		}
+	}
+	if (numOfDigits == 0 || mantissa > MAX_EXACT_FLOAT_MANTISSA ||
+		fractionDigits > MAX_EXACT_FRACTION_DIGITS || (p < lineEnd && !isBlank(*p)))
+	{
+		// Not a simple decimal number (or not a number at all) - strtof will decide
+		char buffer[MAX_LINE_SIZE];
+		if (copyField(begin, lineEnd, buffer) == 0)
+		{
+			return SCAN_FAILED;
+		}
+		char *numberEnd;
+		float result = strtof(buffer, &numberEnd);
+		if (numberEnd == buffer)
+		{
+			return SCAN_FAILED;
+		}
+		*value = result;
+		*cur = begin + (numberEnd - buffer);
+		return SCAN_SUCCESS;
+	}
+	float result = (float) mantissa / powerOfTen(fractionDigits); // exact, see the @def
+	*value = negative ? -result : result;
+	*cur = p;
+	return SCAN_SUCCESS;
+}
+
+size_t copyField(const char *begin, const char *lineEnd, char *buffer)
+{
+	size_t len = 0;
+	while (begin + len < lineEnd && !isBlank(begin[len]) && len < MAX_LINE_SIZE - 1)
+	{
+		buffer[len] = begin[len];
+		len++;
+	}
+	buffer[len] = '\0';
+	return len;
+}
+
+float powerOfTen(size_t exponent)
+{
+	float result = 1.0f;
+	for (size_t i = 0; i < exponent; ++i)
+	{
+		result *= DECIMAL_BASE;
+	}
+	return result;
+}
@@ -0,0 +1,179 @@
+/**
+* @file SpreaderDetectorScan.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Reads the fields of the lines of the input files straight from their bytes
+* @section DESCRIPTION
+* The scan functions read the same fields sscanf reads with the formats of the input files, with
+* exactly the same values, without copying the line and without the locale of the standard library.
+* They do not exit on an error (they return SCAN_FAILED), so they are used by the command line
+* tool, by its parser threads and by the engine (see SpreaderDetectorEngine.h) alike.
+*/
+
+#ifndef EXAM_SPREADERDETECTORSCAN_H
+#define EXAM_SPREADERDETECTORSCAN_H
+
+#include <stddef.h>
+#include "SpreaderDetectorSnapshot.h"
+
+/**
+ * @def MAX_LINE_SIZE 1025
+ * @brief It can be assumed that the maximum line length (in the input file or in the output file)
+ * is 1024 but since we capture each line as a string we will need 1025 space in memory because '\0'
+ */
+#define MAX_LINE_SIZE 1025
+
+/**
+ * @def READING_MODE "r"
+ * @brief The input files that are read line by line (with fgets) are opened for reading only
+ */
+#define READING_MODE "r"
+
+/**
+ * @def SCAN_FAILED 0
+ * @brief Returned by the scan functions when the field they were asked to read is not there.
+ * (Like sscanf returning less fields than expected)
+ */
+#define SCAN_FAILED 0
+
+/**
+ * @def SCAN_SUCCESS 1
+ * @brief Returned by the scan functions when the field was read
+ */
+#define SCAN_SUCCESS 1
+
+/**
+ * @def DECIMAL_BASE 10
+ * @brief The base of the numbers in the input files
+ */
+#define DECIMAL_BASE 10
+
+/**
+ * @def MAX_EXACT_FLOAT_MANTISSA 16777216
+ * @brief 2^24. Every integer up to it is exactly a float. If the digits of a number (without the
+ * point) are at most this, and there are at most MAX_EXACT_FRACTION_DIGITS after the point, then
+ * the number is exactly mantissa / 10^fractionDigits, both operands are exact floats and one float
+ * division gives the correctly rounded result - exactly what strtof (and so sscanf) gives
+ */
+#define MAX_EXACT_FLOAT_MANTISSA 16777216
+
+/**
+ * @def MAX_EXACT_FRACTION_DIGITS 10
+ * @brief 10^10 is the largest power of ten which is exactly a float (5^10 < 2^24)
+ */
+#define MAX_EXACT_FRACTION_DIGITS 10
+
+/**
+ * @def MAX_FAST_ID_DIGITS 19
+ * @brief An ID with at most 19 digits can not overflow size_t, so we can read it digit by digit.
+ * Longer IDs are left to strtoul, so the overflow is handled exactly as sscanf handles it
+ */
+#define MAX_FAST_ID_DIGITS 19
+/**
+ * Reads the fields of one meeting from the bytes of one line (without exiting on an error, so it
+ * can be used by the parser threads)
+ * @param line The beginning of the line
+ * @param lineEnd The end of the line
+ * @param meeting Will contain the meeting
+ * @return SCAN_SUCCESS or SCAN_FAILED
+ */
+int scanMeetingFromBytes(const char *line, const char *lineEnd, MeetingInfo *meeting);
+
+/**
+ * Reads the fields of one person from the bytes of one line of the people file. The name is not
+ * copied, we only return where it is
+ * @param line The beginning of the line
+ * @param lineEnd The end of the line
+ * @param name Will point to the first char of the name
+ * @param nameLen Will contain the length of the name
+ * @param id Will contain the ID
+ * @param age Will contain the age
+ * @return SCAN_SUCCESS or SCAN_FAILED
+ */
+int scanPersonFromBytes(const char *line, const char *lineEnd, const char **name, size_t *nameLen,
+                        size_t *id, float *age);
+
+/**
+ * Reads the fields of one meeting of a continuous feed: the fields of a meeting and then its
+ * timestamp (an unsigned number)
+ * @param line The beginning of the line
+ * @param lineEnd The end of the line
+ * @param meeting Will contain the meeting
+ * @param timestamp Will contain the timestamp
+ * @return SCAN_SUCCESS or SCAN_FAILED
+ */
+int scanTimedMeetingFromBytes(const char *line, const char *lineEnd, MeetingInfo *meeting,
+                              size_t *timestamp);
+
+/**
+ * Returns the end of the line that starts at cur
+ * @param cur The beginning of the line
+ * @param end The end of the buffer
+ * @return pointer to the '\n' that ends the line, or end if it is the last line (without '\n')
+ */
+const char *findLineEnd(const char *cur, const char *end);
+
+/**
+ * Is this char a white space inside a line (the same white spaces sscanf skips, except '\n'
+ * which ends the line)
+ * @param c the char
+ * @return 1 if it is a white space, 0 otherwise
+ */
+int isBlank(char c);
+
+/**
+ * Skips the white spaces at the beginning of the field
+ * @param cur The current place in the line
+ * @param lineEnd The end of the line
+ * @return pointer to the first char which is not a white space (or lineEnd)
+ */
+const char *skipBlanks(const char *cur, const char *lineEnd);
+
+/**
+ * Reads one word (like "%s" of sscanf). The word is not copied, we only return where it is
+ * @param cur pointer to the current place in the line. Will be moved after the word
+ * @param lineEnd The end of the line
+ * @param token Will point to the first char of the word
+ * @param tokenLen Will contain the length of the word
+ * @return SCAN_SUCCESS or SCAN_FAILED (if there is no word)
+ */
+int scanToken(const char **cur, const char *lineEnd, const char **token, size_t *tokenLen);
+
+/**
+ * Reads one unsigned number (like "%lu" of sscanf)
+ * @param cur pointer to the current place in the line. Will be moved after the number
+ * @param lineEnd The end of the line
+ * @param value Will contain the number
+ * @return SCAN_SUCCESS or SCAN_FAILED (if there is no number)
+ */
+int scanUnsigned(const char **cur, const char *lineEnd, size_t *value);
+
+/**
+ * Reads one float (like "%f" of sscanf). Simple decimal numbers (which are all the numbers in our
+ * files) are computed directly from the digits, with exactly the result strtof would give. Any
+ * other number (exponent, many digits, etc.) is left to strtof
+ * @param cur pointer to the current place in the line. Will be moved after the number
+ * @param lineEnd The end of the line
+ * @param value Will contain the number
+ * @return SCAN_SUCCESS or SCAN_FAILED (if there is no number)
+ */
+int scanFloat(const char **cur, const char *lineEnd, float *value);
+
+/**
+ * Copies the field that starts at begin (until the next white space) into a '\0' terminated
+ * buffer, so it can be given to the functions of the standard library
+ * @param begin The beginning of the field
+ * @param lineEnd The end of the line
+ * @param buffer The buffer (of size MAX_LINE_SIZE)
+ * @return The length of the field that was copied
+ */
+size_t copyField(const char *begin, const char *lineEnd, char *buffer);
+
+/**
+ * Returns 10^exponent as a float
+ * @param exponent at most MAX_EXACT_FRACTION_DIGITS (so the result is exact)
+ * @return 10^exponent
+ */
+float powerOfTen(size_t exponent);
+
+#endif //EXAM_SPREADERDETECTORSCAN_H
@@ -0,0 +1,560 @@
+/**
+* @file SpreaderDetectorServer.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the query server
+* @section DESCRIPTION
+* Every connection has a buffer of the bytes that were read and not handled yet (a request that
+* was cut in the middle waits there for the rest of it), and a buffer of the replies that were not
+* written yet. The epoll of the connection waits for input while all its replies were written, and
+* only for output while they were not. The connections are kept in a list, so the ones that are
+* still open when the server stops can be closed. Before they are closed, the replies they still
+* have (the "OK" of "SHUTDOWN" among them) are written with blocking writes, each connection for
+* at most DRAIN_TIMEOUT_SECONDS.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "SpreaderDetectorServer.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorOrder.h"
+#include "SpreaderDetectorScan.h"
+
+/**
+ * @def READ_BUFFER_SIZE 65536
+ * @brief The size of the input buffer of a connection (the most one read takes)
+ */
+#define READ_BUFFER_SIZE 65536
+
+/**
+ * @def INIT_REPLIES_CAPACITY 4096
+ * @brief The capacity of the replies buffer of a connection when its first reply is added
+ */
+#define INIT_REPLIES_CAPACITY 4096
+
+/**
+ * @def REPLIES_GROWTH_FACTOR 2
+ * @brief A full replies buffer grows by this factor
+ */
+#define REPLIES_GROWTH_FACTOR 2
+
+/**
+ * @def MAX_EVENTS 64
+ * @brief The maximal number of events one epoll_wait returns
+ */
+#define MAX_EVENTS 64
+
+/**
+ * @def DRAIN_TIMEOUT_SECONDS 5
+ * @brief When the server stops, a client that does not read its last replies is waited for at
+ * most this long
+ */
+#define DRAIN_TIMEOUT_SECONDS 5
+
+/**
+ * The names of the classes in the replies (by class)
+ */
+static const char *const classNames[NUM_OF_CLASSES] = {"hospitalization", "quarantine", "clean"};
+
+/**
+ * @struct Connection
+ * @brief One client: its socket, the bytes it sent that were not handled yet, and the replies that
+ * were not written yet (from repliesWritten to repliesLen). The connections are a doubly linked
+ * list
+ */
+typedef struct Connection
+{
+	int fd;
+	char *requests;
+	size_t requestsLen;
+	char *replies;
+	size_t repliesLen;
+	size_t repliesWritten;
+	size_t repliesCapacity;
+	int isWaitingForOutput;
+	struct Connection *prev;
+	struct Connection *next;
+} Connection;
+
+/**
+ * @struct QueryServer
+ * @brief The state of the server: the engine, the sockets and the open connections
+ */
+typedef struct QueryServer
+{
+	SpreaderEngine *engine;
+	int listenFd;
+	int epollFd;
+	Connection *connections;
+	int isShuttingDown;
+	ServerStats *stats;
+} QueryServer;
+
+/**
+ * Makes a socket non blocking
+ * @param fd The socket
+ * @return SERVER_SUCCESS or SERVER_FAILED
+ */
+static int setNonBlocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 ? SERVER_SUCCESS :
+	       SERVER_FAILED;
+}
+
+/**
+ * Closes a connection, removes it from the list and releases it
+ * @param server The server
+ * @param connection The connection
+ */
+static void closeConnection(QueryServer *server, Connection *connection)
+{
+	close(connection->fd); // also removes it from the epoll
+	if (connection->prev != NULL)
+	{
+		connection->prev->next = connection->next;
+	}
+	else
+	{
+		server->connections = connection->next;
+	}
+	if (connection->next != NULL)
+	{
+		connection->next->prev = connection->prev;
+	}
+	trackedFree(connection->requests, READ_BUFFER_SIZE);
+	trackedFree(connection->replies, connection->repliesCapacity);
+	trackedFree(connection, sizeof(Connection));
+}
+
+/**
+ * Adds a reply (or a part of one) to the replies of a connection, like printf
+ * @param connection The connection
+ * @param format The format of the reply
+ * @param ... The values of the format
+ * @return SERVER_SUCCESS or SERVER_FAILED (no memory)
+ */
+static int addReply(Connection *connection, const char *format, ...)
+{
+	while (1)
+	{
+		size_t room = connection->repliesCapacity - connection->repliesLen;
+		va_list args;
+		va_start(args, format);
+		int len = room > 0 ? vsnprintf(connection->replies + connection->repliesLen, room, format,
+		                               args) : 0;
+		va_end(args);
+		if (len < 0)
+		{
+			return SERVER_FAILED;
+		}
+		if (room > 0 && (size_t) len < room)
+		{
+			connection->repliesLen += (size_t) len;
+			return SERVER_SUCCESS;
+		}
+		size_t capacity = connection->repliesCapacity;
+		size_t newCapacity = capacity ? capacity * REPLIES_GROWTH_FACTOR : INIT_REPLIES_CAPACITY;
+		char *replies = (char *) trackedRealloc(connection->replies, capacity, newCapacity);
+		if (replies == NULL)
+		{
+			return SERVER_FAILED;
+		}
+		connection->replies = replies;
+		connection->repliesCapacity = newCapacity;
+	}
+}
+
+/**
+ * Answers "RISK <ID>"
+ * @param server The server
+ * @param connection The connection
+ * @param id The ID
+ * @return SERVER_SUCCESS or SERVER_FAILED (no memory)
+ */
+static int answerRisk(QueryServer *server, Connection *connection, size_t id)
+{
+	EngineResult person;
+	int status = engineQueryRisk(server->engine, id, &person);
+	if (status != ENGINE_SUCCESS)
+	{
+		return addReply(connection, SERVER_ERROR_REPLY " %s\n", engineStatusMessage(status));
+	}
+	EngineResult infector;
+	status = engineQueryInfector(server->engine, id, &infector);
+	if (status != ENGINE_SUCCESS && status != ENGINE_END)
+	{
+		return addReply(connection, SERVER_ERROR_REPLY " %s\n", engineStatusMessage(status));
+	}
+	if (addReply(connection, SERVER_OK_REPLY " %zu %.*s " SERVER_PROBABILITY_FORMAT " %s ",
+	             person.id, (int) person.nameLen, person.name, person.probInfected,
+	             classNames[person.riskClass < NUM_OF_CLASSES ? person.riskClass : CLEAN_CLASS]) ==
+	    SERVER_FAILED)
+	{
+		return SERVER_FAILED;
+	}
+	return status == ENGINE_END ? addReply(connection, SERVER_NO_INFECTOR "\n") :
+	       addReply(connection, "%zu\n", infector.id);
+}
+
+/**
+ * Answers "PATH <ID>": the person and then every infector of the one before him
+ * @param server The server
+ * @param connection The connection
+ * @param id The ID
+ * @return SERVER_SUCCESS or SERVER_FAILED (no memory)
+ */
+static int answerPath(QueryServer *server, Connection *connection, size_t id)
+{
+	EngineResult infector;
+	int status = engineQueryInfector(server->engine, id, &infector);
+	if (status != ENGINE_SUCCESS && status != ENGINE_END)
+	{
+		return addReply(connection, SERVER_ERROR_REPLY " %s\n", engineStatusMessage(status));
+	}
+	if (addReply(connection, SERVER_OK_REPLY " %zu", id) == SERVER_FAILED)
+	{
+		return SERVER_FAILED;
+	}
+	for (size_t len = 1; status == ENGINE_SUCCESS && len < SERVER_MAX_PATH_LENGTH; ++len)
+	{
+		if (addReply(connection, " %zu", infector.id) == SERVER_FAILED)
+		{
+			return SERVER_FAILED;
+		}
+		status = engineQueryInfector(server->engine, infector.id, &infector);
+	}
+	return addReply(connection, "\n");
+}
+
+/**
+ * Answers "COUNTS"
+ * @param server The server
+ * @param connection The connection
+ * @return SERVER_SUCCESS or SERVER_FAILED (no memory)
+ */
+static int answerCounts(QueryServer *server, Connection *connection)
+{
+	size_t counts[NUM_OF_CLASSES];
+	int status = engineCountClasses(server->engine, counts);
+	if (status != ENGINE_SUCCESS)
+	{
+		return addReply(connection, SERVER_ERROR_REPLY " %s\n", engineStatusMessage(status));
+	}
+	return addReply(connection, SERVER_OK_REPLY " %zu %zu %zu\n", counts[HOSPITALIZATION_CLASS],
+	                counts[QUARANTINE_CLASS], counts[CLEAN_CLASS]);
+}
+
+/**
+ * Answers one request line
+ * @param server The server
+ * @param connection The connection
+ * @param line The beginning of the line
+ * @param lineEnd The end of the line (without the '\n')
+ * @return SERVER_SUCCESS or SERVER_FAILED (no memory)
+ */
+static int answerRequest(QueryServer *server, Connection *connection, const char *line,
+                         const char *lineEnd)
+{
+	const char *cur = line;
+	const char *word;
+	size_t wordLen;
+	size_t id;
+	server->stats->numOfRequests++;
+	if (scanToken(&cur, lineEnd, &word, &wordLen) == SCAN_FAILED)
+	{
+		return addReply(connection, SERVER_ERROR_REPLY " empty request\n");
+	}
+	if (wordLen == strlen(SERVER_RISK_REQUEST) && memcmp(word, SERVER_RISK_REQUEST, wordLen) == 0 &&
+	    scanUnsigned(&cur, lineEnd, &id) == SCAN_SUCCESS)
+	{
+		return answerRisk(server, connection, id);
+	}
+	if (wordLen == strlen(SERVER_PATH_REQUEST) && memcmp(word, SERVER_PATH_REQUEST, wordLen) == 0 &&
+	    scanUnsigned(&cur, lineEnd, &id) == SCAN_SUCCESS)
+	{
+		return answerPath(server, connection, id);
+	}
+	if (wordLen == strlen(SERVER_COUNTS_REQUEST) &&
+	    memcmp(word, SERVER_COUNTS_REQUEST, wordLen) == 0)
+	{
+		return answerCounts(server, connection);
+	}
+	if (wordLen == strlen(SERVER_SHUTDOWN_REQUEST) &&
+	    memcmp(word, SERVER_SHUTDOWN_REQUEST, wordLen) == 0)
+	{
+		server->isShuttingDown = 1;
+		return addReply(connection, SERVER_OK_REPLY "\n");
+	}
+	return addReply(connection, SERVER_ERROR_REPLY " unknown request\n");
+}
+
+/**
+ * Writes as much of the replies of a connection as the socket takes, and makes the epoll wait for
+ * output if some are left (and for input again once all were written)
+ * @param server The server
+ * @param connection The connection
+ * @return SERVER_SUCCESS or SERVER_FAILED (the connection should be closed)
+ */
+static int writeReplies(QueryServer *server, Connection *connection)
+{
+	while (connection->repliesWritten < connection->repliesLen)
+	{
+		ssize_t written = send(connection->fd, connection->replies + connection->repliesWritten,
+		                       connection->repliesLen - connection->repliesWritten, MSG_NOSIGNAL);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				return SERVER_FAILED;
+			}
+			break;
+		}
+		connection->repliesWritten += (size_t) written;
+	}
+	int isWaitingForOutput = connection->repliesWritten < connection->repliesLen;
+	if (!isWaitingForOutput)
+	{
+		connection->repliesLen = 0;
+		connection->repliesWritten = 0;
+	}
+	if (isWaitingForOutput != connection->isWaitingForOutput)
+	{
+		struct epoll_event event = {0};
+		event.events = isWaitingForOutput ? EPOLLOUT : EPOLLIN;
+		event.data.ptr = connection;
+		if (epoll_ctl(server->epollFd, EPOLL_CTL_MOD, connection->fd, &event) != 0)
+		{
+			return SERVER_FAILED;
+		}
+		connection->isWaitingForOutput = isWaitingForOutput;
+	}
+	return SERVER_SUCCESS;
+}
+
+/**
+ * Writes all the replies a connection still has before it is closed: the socket is made blocking,
+ * with a timeout of DRAIN_TIMEOUT_SECONDS for every write (a client that stopped reading does not
+ * stop the server)
+ * @param connection The connection
+ */
+static void drainReplies(Connection *connection)
+{
+	if (connection->repliesWritten == connection->repliesLen)
+	{
+		return;
+	}
+	struct timeval timeout = {DRAIN_TIMEOUT_SECONDS, 0};
+	int flags = fcntl(connection->fd, F_GETFL);
+	if (flags < 0 || fcntl(connection->fd, F_SETFL, flags & ~O_NONBLOCK) != 0 ||
+	    setsockopt(connection->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0)
+	{
+		return;
+	}
+	while (connection->repliesWritten < connection->repliesLen)
+	{
+		ssize_t written = send(connection->fd, connection->replies + connection->repliesWritten,
+		                       connection->repliesLen - connection->repliesWritten, MSG_NOSIGNAL);
+		if (written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (written <= 0) // an error, or the timeout passed
+		{
+			return;
+		}
+		connection->repliesWritten += (size_t) written;
+	}
+}
+
+/**
+ * Reads what a client sent, answers all the complete requests in it (one batch) and writes the
+ * replies
+ * @param server The server
+ * @param connection The connection
+ * @return SERVER_SUCCESS or SERVER_FAILED (the connection should be closed)
+ */
+static int serveConnection(QueryServer *server, Connection *connection)
+{
+	ssize_t numOfRead;
+	do
+	{
+		numOfRead = read(connection->fd, connection->requests + connection->requestsLen,
+		                 READ_BUFFER_SIZE - connection->requestsLen);
+	} while (numOfRead < 0 && errno == EINTR);
+	if (numOfRead < 0)
+	{
+		return errno == EAGAIN || errno == EWOULDBLOCK ? SERVER_SUCCESS : SERVER_FAILED;
+	}
+	if (numOfRead == 0) // the client closed the connection
+	{
+		return SERVER_FAILED;
+	}
+	connection->requestsLen += (size_t) numOfRead;
+	const char *cur = connection->requests;
+	const char *end = connection->requests + connection->requestsLen;
+	const char *lineEnd;
+	int hasRequests = 0;
+	while ((lineEnd = (const char *) memchr(cur, '\n', (size_t) (end - cur))) != NULL)
+	{
+		if (answerRequest(server, connection, cur, lineEnd) == SERVER_FAILED)
+		{
+			return SERVER_FAILED;
+		}
+		hasRequests = 1;
+		cur = lineEnd + 1;
+	}
+	size_t numOfLeft = (size_t) (end - cur);
+	if (numOfLeft >= SERVER_MAX_REQUEST_SIZE) // a line that is too long for a request
+	{
+		return SERVER_FAILED;
+	}
+	memmove(connection->requests, cur, numOfLeft);
+	connection->requestsLen = numOfLeft;
+	server->stats->numOfBatches += hasRequests;
+	return writeReplies(server, connection);
+}
+
+/**
+ * Accepts all the clients that are waiting to connect
+ * @param server The server
+ */
+static void acceptConnections(QueryServer *server)
+{
+	int fd;
+	while ((fd = accept(server->listenFd, NULL, NULL)) >= 0)
+	{
+		Connection *connection = (Connection *) trackedCalloc(1, sizeof(Connection));
+		char *requests = (char *) trackedMalloc(READ_BUFFER_SIZE);
+		struct epoll_event event = {0};
+		event.events = EPOLLIN;
+		event.data.ptr = connection;
+		if (connection == NULL || requests == NULL || setNonBlocking(fd) == SERVER_FAILED ||
+		    epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+		{
+			trackedFree(requests, READ_BUFFER_SIZE);
+			trackedFree(connection, sizeof(Connection));
+			close(fd);
+			continue;
+		}
+		connection->fd = fd;
+		connection->requests = requests;
+		connection->next = server->connections;
+		if (server->connections != NULL)
+		{
+			server->connections->prev = connection;
+		}
+		server->connections = connection;
+		server->stats->numOfConnections++;
+	}
+}
+
+/**
+ * Creates the listening socket at a path (a socket file that is already there is replaced)
+ * @param socketPath The path
+ * @return The socket, or -1
+ */
+static int listenAt(const char *socketPath)
+{
+	struct sockaddr_un address = {0};
+	address.sun_family = AF_UNIX;
+	if (strlen(socketPath) >= sizeof(address.sun_path))
+	{
+		return -1;
+	}
+	strcpy(address.sun_path, socketPath);
+	struct stat status;
+	if (lstat(socketPath, &status) == 0 && S_ISSOCK(status.st_mode)) // left by an older server
+	{
+		unlink(socketPath);
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	if (setNonBlocking(fd) == SERVER_FAILED ||
+	    bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+	    listen(fd, SOMAXCONN) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int runQueryServer(SpreaderEngine *engine, const char *socketPath, ServerStats *stats)
+{
+	ServerStats empty = {0};
+	*stats = empty;
+	QueryServer server = {engine, -1, -1, NULL, 0, stats};
+	server.listenFd = listenAt(socketPath);
+	if (server.listenFd < 0)
+	{
+		return SERVER_FAILED;
+	}
+	server.epollFd = epoll_create1(0);
+	struct epoll_event listenEvent = {0};
+	listenEvent.events = EPOLLIN;
+	listenEvent.data.ptr = NULL; // the listening socket is the only one without a connection
+	int status = server.epollFd >= 0 &&
+	             epoll_ctl(server.epollFd, EPOLL_CTL_ADD, server.listenFd, &listenEvent) == 0 ?
+	             SERVER_SUCCESS : SERVER_FAILED;
+	struct epoll_event events[MAX_EVENTS];
+	while (status == SERVER_SUCCESS && !server.isShuttingDown)
+	{
+		int numOfEvents = epoll_wait(server.epollFd, events, MAX_EVENTS, -1);
+		if (numOfEvents < 0)
+		{
+			status = errno == EINTR ? SERVER_SUCCESS : SERVER_FAILED;
+			continue;
+		}
+		for (int i = 0; i < numOfEvents; ++i)
+		{
+			Connection *connection = (Connection *) events[i].data.ptr;
+			if (connection == NULL)
+			{
+				acceptConnections(&server);
+				continue;
+			}
+			int isOpen = !(events[i].events & EPOLLERR);
+			if (isOpen && connection->isWaitingForOutput)
+			{
+				isOpen = writeReplies(&server, connection) == SERVER_SUCCESS;
+			}
+			else if (isOpen)
+			{
+				isOpen = serveConnection(&server, connection) == SERVER_SUCCESS;
+			}
+			if (!isOpen)
+			{
+				closeConnection(&server, connection);
+			}
+		}
+	}
+	while (server.connections != NULL)
+	{
+		drainReplies(server.connections);
+		closeConnection(&server, server.connections);
+	}
+	if (server.epollFd >= 0)
+	{
+		close(server.epollFd);
+	}
+	close(server.listenFd);
+	unlink(socketPath);
+	return status;
+}
@@ -0,0 +1,128 @@
+/**
+* @file SpreaderDetectorServer.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief A server that answers questions about the people of a loaded engine over a Unix domain
+* socket
+* @section DESCRIPTION
+* The engine (see SpreaderDetectorEngine.h) is loaded once and stays in memory, and the server
+* answers its clients from it. The protocol is lines of text: every request is one line, and every
+* request gets one line back, in the order of the requests of its connection, that starts with
+* SERVER_OK_REPLY or SERVER_ERROR_REPLY (and then the message of the error). The requests are:
+* - "RISK <ID>": "OK <ID> <name> <probability> <class> <ID of the infector>" (the infector is
+*   SERVER_NO_INFECTOR for a seed or a person that nobody exposed).
+* - "PATH <ID>": "OK <ID> <ID of the infector> <ID of his infector> .." back to a seed (or to a
+*   person that nobody exposed), at most SERVER_MAX_PATH_LENGTH people.
+* - "COUNTS": "OK <hospitalization> <quarantine> <clean>", the number of people of every class.
+* - "SHUTDOWN": "OK", and the server stops (the replies that were not written yet, this "OK" too,
+*   are written before the connections are closed).
+* All the connections are served by one thread with epoll. Every read takes as many requests as
+* the client already sent, and all their replies are written back with one write, so a client that
+* sends its requests in batches (without waiting for every reply) pays for one system call per
+* batch and not per request. A client that does not read its replies is not read from until they
+* were written.
+*/
+
+#ifndef EXAM_SPREADERDETECTORSERVER_H
+#define EXAM_SPREADERDETECTORSERVER_H
+
+#include <stddef.h>
+#include "SpreaderDetectorEngine.h"
+
+/**
+ * @def SERVER_SUCCESS 1
+ * @brief Returned by runQueryServer after a client shut the server down
+ */
+#define SERVER_SUCCESS 1
+
+/**
+ * @def SERVER_FAILED 0
+ * @brief Returned by runQueryServer when the socket could not be created or an allocation failed
+ */
+#define SERVER_FAILED 0
+
+/**
+ * @def SERVER_RISK_REQUEST "RISK"
+ * @brief The request for the risk of one person
+ */
+#define SERVER_RISK_REQUEST "RISK"
+
+/**
+ * @def SERVER_PATH_REQUEST "PATH"
+ * @brief The request for the path of the infection of one person
+ */
+#define SERVER_PATH_REQUEST "PATH"
+
+/**
+ * @def SERVER_COUNTS_REQUEST "COUNTS"
+ * @brief The request for the number of people of every class
+ */
+#define SERVER_COUNTS_REQUEST "COUNTS"
+
+/**
+ * @def SERVER_SHUTDOWN_REQUEST "SHUTDOWN"
+ * @brief The request that stops the server
+ */
+#define SERVER_SHUTDOWN_REQUEST "SHUTDOWN"
+
+/**
+ * @def SERVER_OK_REPLY "OK"
+ * @brief The first word of the reply to a request that succeeded
+ */
+#define SERVER_OK_REPLY "OK"
+
+/**
+ * @def SERVER_ERROR_REPLY "ERR"
+ * @brief The first word of the reply to a request that failed
+ */
+#define SERVER_ERROR_REPLY "ERR"
+
+/**
+ * @def SERVER_NO_INFECTOR "-"
+ * @brief The infector in the reply to "RISK" of a person that nobody infected
+ */
+#define SERVER_NO_INFECTOR "-"
+
+/**
+ * @def SERVER_PROBABILITY_FORMAT "%.6f"
+ * @brief How the probability is written in the reply to "RISK"
+ */
+#define SERVER_PROBABILITY_FORMAT "%.6f"
+
+/**
+ * @def SERVER_MAX_PATH_LENGTH 256
+ * @brief The maximal number of people in the reply to "PATH" (the infections of the meetings may
+ * have a cycle)
+ */
+#define SERVER_MAX_PATH_LENGTH 256
+
+/**
+ * @def SERVER_MAX_REQUEST_SIZE 256
+ * @brief The maximal length of a request line. A connection that sends a longer line is closed
+ */
+#define SERVER_MAX_REQUEST_SIZE 256
+
+/**
+ * @struct ServerStats
+ * @brief What the server did: the connections it accepted, the requests it answered and the
+ * batches they came in (the reads that had at least one request)
+ */
+typedef struct ServerStats
+{
+	size_t numOfConnections;
+	size_t numOfRequests;
+	size_t numOfBatches;
+} ServerStats;
+
+/**
+ * Listens on a Unix domain socket and answers the requests of its clients until one of them sends
+ * "SHUTDOWN". A socket file that is already at the path is replaced, and the socket file is removed
+ * at the end
+ * @param engine The engine (loaded)
+ * @param socketPath The path of the socket
+ * @param stats Will contain what the server did
+ * @return SERVER_SUCCESS or SERVER_FAILED
+ */
+int runQueryServer(SpreaderEngine *engine, const char *socketPath, ServerStats *stats);
+
+#endif //EXAM_SPREADERDETECTORSERVER_H
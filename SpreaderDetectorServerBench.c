@@ -0,0 +1,704 @@
+/**
+* @file SpreaderDetectorServerBench.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Generates load on the query server and measures its latency and throughput
+* @section DESCRIPTION
+* Usage: server_bench <Path to exam> <Path to People.in> <Path to Meetings.in>
+* [number of connections] [requests per connection] [requests per batch]
+* The tool is started in the server mode ("--serve=", on a socket in a temporary directory), and
+* the bench loads the same files into its own engine. First every reply of the server is checked:
+* "RISK" and "PATH" of every person (up to MAX_CHECKED_PEOPLE of them) and "COUNTS" must be
+* exactly what the engine of the bench answers. Then every connection (a thread of its own) sends
+* random requests (RISK_PERCENT of them "RISK", PATH_PERCENT "PATH" and the rest "COUNTS") in
+* batches, and waits for all the replies of a batch before it sends the next one. The latency of a
+* request is the time from sending its batch until its reply arrived. The queries per second of
+* all the connections together and the percentiles of the latency are reported, and at the end the
+* server is shut down.
+*/
+
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "SpreaderDetectorEngine.h"
+#include "SpreaderDetectorGraph.h"
+#include "SpreaderDetectorOrder.h"
+#include "SpreaderDetectorServer.h"
+#include "SpreaderDetectorStats.h"
+
+/**
+ * @def DEFAULT_NUM_OF_CONNECTIONS 4
+ * @brief The number of connections when it is not given
+ */
+#define DEFAULT_NUM_OF_CONNECTIONS 4
+
+/**
+ * @def DEFAULT_NUM_OF_REQUESTS 100000
+ * @brief The number of requests of every connection when it is not given
+ */
+#define DEFAULT_NUM_OF_REQUESTS 100000
+
+/**
+ * @def DEFAULT_BATCH_SIZE 32
+ * @brief The number of requests in a batch when it is not given
+ */
+#define DEFAULT_BATCH_SIZE 32
+
+/**
+ * @def MAX_BATCH_SIZE 4096
+ * @brief The maximal number of requests in a batch
+ */
+#define MAX_BATCH_SIZE 4096
+
+/**
+ * @def MAX_REQUEST_SIZE 32
+ * @brief The maximal length of a request line the bench sends
+ */
+#define MAX_REQUEST_SIZE 32
+
+/**
+ * @def RISK_PERCENT 80
+ * @brief The percent of "RISK" requests in the load
+ */
+#define RISK_PERCENT 80
+
+/**
+ * @def PATH_PERCENT 15
+ * @brief The percent of "PATH" requests in the load (the rest are "COUNTS")
+ */
+#define PATH_PERCENT 15
+
+/**
+ * @def MAX_CHECKED_PEOPLE 100000
+ * @brief The maximal number of people whose replies are checked before the load
+ */
+#define MAX_CHECKED_PEOPLE 100000
+
+/**
+ * @def REPLY_BUFFER_SIZE 65536
+ * @brief The size of the buffer the replies are read into
+ */
+#define REPLY_BUFFER_SIZE 65536
+
+/**
+ * @def EXPECTED_REPLY_SIZE 8192
+ * @brief The size of the buffer the expected reply is written into (a path of
+ * SERVER_MAX_PATH_LENGTH IDs fits)
+ */
+#define EXPECTED_REPLY_SIZE 8192
+
+/**
+ * @def CONNECT_ATTEMPTS 3000
+ * @brief How many times the bench tries to connect while the server loads its files
+ */
+#define CONNECT_ATTEMPTS 3000
+
+/**
+ * @def CONNECT_WAIT_NANOS 10000000
+ * @brief The wait between two attempts to connect (10ms)
+ */
+#define CONNECT_WAIT_NANOS 10000000
+
+/**
+ * @def RANDOM_SEED 12345
+ * @brief The seed of the random requests (the same requests in every run)
+ */
+#define RANDOM_SEED 12345
+
+/**
+ * @def WORK_DIR_TEMPLATE "/tmp/server_benchXXXXXX"
+ * @brief The temporary directory of the socket of the server
+ */
+#define WORK_DIR_TEMPLATE "/tmp/server_benchXXXXXX"
+
+/**
+ * @def SOCKET_NAME "server.sock"
+ * @brief The name of the socket of the server, in the temporary directory
+ */
+#define SOCKET_NAME "server.sock"
+
+/**
+ * @struct ReplyReader
+ * @brief Reads the replies of one connection line by line. The bytes from start to len were read
+ * and not returned yet
+ */
+typedef struct ReplyReader
+{
+	int fd;
+	char buffer[REPLY_BUFFER_SIZE];
+	size_t start;
+	size_t len;
+} ReplyReader;
+
+/**
+ * @struct LoadClient
+ * @brief One connection of the load, in a thread of its own: the people it asks about, how many
+ * requests it sends and in what batches, and the latencies of its requests
+ */
+typedef struct LoadClient
+{
+	const char *socketPath;
+	const size_t *ids;
+	size_t numOfPeople;
+	size_t numOfRequests;
+	size_t batchSize;
+	uint64_t random;
+	double *latencies;
+	size_t numOfErrors;
+	int isOk;
+	pthread_t thread;
+} LoadClient;
+
+/**
+ * The next number of a xorshift generator
+ * @param state The state of the generator (not 0)
+ * @return The number
+ */
+static uint64_t nextRandom(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+/**
+ * Connects to the server once
+ * @param socketPath The path of the socket of the server
+ * @return The socket, or -1
+ */
+static int connectToServer(const char *socketPath)
+{
+	struct sockaddr_un address = {0};
+	address.sun_family = AF_UNIX;
+	if (strlen(socketPath) >= sizeof(address.sun_path))
+	{
+		return -1;
+	}
+	strcpy(address.sun_path, socketPath);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd >= 0 && connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0)
+	{
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+/**
+ * Writes a whole buffer to a socket
+ * @param fd The socket
+ * @param data The buffer
+ * @param len The length of the buffer
+ * @return 1 if everything was written, 0 otherwise
+ */
+static int writeAll(int fd, const char *data, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t written = send(fd, data, len, MSG_NOSIGNAL);
+		if (written <= 0)
+		{
+			return 0;
+		}
+		data += written;
+		len -= (size_t) written;
+	}
+	return 1;
+}
+
+/**
+ * Returns the next reply line of a connection (reads from the socket if it is not there yet)
+ * @param reader The reader of the connection
+ * @param line Will point to the line (valid until the next call)
+ * @param lineLen Will contain the length of the line, without the '\n'
+ * @return 1, or 0 if the connection was closed or the line is too long
+ */
+static int readReplyLine(ReplyReader *reader, const char **line, size_t *lineLen)
+{
+	while (1)
+	{
+		char *begin = reader->buffer + reader->start;
+		char *lineEnd = (char *) memchr(begin, '\n', reader->len - reader->start);
+		if (lineEnd != NULL)
+		{
+			*line = begin;
+			*lineLen = (size_t) (lineEnd - begin);
+			reader->start += *lineLen + 1;
+			return 1;
+		}
+		reader->len -= reader->start;
+		memmove(reader->buffer, begin, reader->len);
+		reader->start = 0;
+		if (reader->len == sizeof(reader->buffer))
+		{
+			return 0;
+		}
+		ssize_t numOfRead = read(reader->fd, reader->buffer + reader->len,
+		                         sizeof(reader->buffer) - reader->len);
+		if (numOfRead <= 0)
+		{
+			return 0;
+		}
+		reader->len += (size_t) numOfRead;
+	}
+}
+
+/**
+ * The thread of one connection of the load
+ * @param arg The LoadClient of the connection
+ * @return NULL
+ */
+static void *runLoadClient(void *arg)
+{
+	LoadClient *client = (LoadClient *) arg;
+	ReplyReader *reader = (ReplyReader *) calloc(1, sizeof(ReplyReader));
+	char *requests = (char *) malloc(client->batchSize * MAX_REQUEST_SIZE);
+	if (reader != NULL)
+	{
+		reader->fd = connectToServer(client->socketPath);
+	}
+	client->isOk = reader != NULL && requests != NULL && reader->fd >= 0;
+	for (size_t done = 0; client->isOk && done < client->numOfRequests;)
+	{
+		size_t numOfSent = client->numOfRequests - done < client->batchSize ?
+		                   client->numOfRequests - done : client->batchSize;
+		size_t len = 0;
+		for (size_t i = 0; i < numOfSent; ++i)
+		{
+			uint64_t kind = nextRandom(&client->random) % 100;
+			size_t id = client->ids[nextRandom(&client->random) % client->numOfPeople];
+			len += (size_t) (kind < RISK_PERCENT ?
+			                 sprintf(requests + len, SERVER_RISK_REQUEST " %zu\n", id) :
+			                 kind < RISK_PERCENT + PATH_PERCENT ?
+			                 sprintf(requests + len, SERVER_PATH_REQUEST " %zu\n", id) :
+			                 sprintf(requests + len, SERVER_COUNTS_REQUEST "\n"));
+		}
+		double sent = currentSeconds();
+		client->isOk = writeAll(reader->fd, requests, len);
+		for (size_t i = 0; client->isOk && i < numOfSent; ++i)
+		{
+			const char *line = NULL;
+			size_t lineLen = 0;
+			client->isOk = readReplyLine(reader, &line, &lineLen);
+			client->latencies[done + i] = currentSeconds() - sent;
+			if (client->isOk &&
+			    strncmp(line, SERVER_ERROR_REPLY, strlen(SERVER_ERROR_REPLY)) == 0)
+			{
+				client->numOfErrors++;
+			}
+		}
+		done += numOfSent;
+	}
+	if (reader != NULL && reader->fd >= 0)
+	{
+		close(reader->fd);
+	}
+	free(reader);
+	free(requests);
+	return NULL;
+}
+
+/**
+ * Writes the reply the server should give to "RISK" of a person, without the class (the fields
+ * the engine of the bench knows exactly)
+ * @param engine The engine of the bench
+ * @param id The ID of the person
+ * @param expected Will contain the reply
+ * @return The length of the reply
+ */
+static int expectedRiskFields(SpreaderEngine *engine, size_t id, char *expected)
+{
+	EngineResult person, infector;
+	engineQueryRisk(engine, id, &person);
+	int len = sprintf(expected, SERVER_OK_REPLY " %zu %.*s " SERVER_PROBABILITY_FORMAT, person.id,
+	                  (int) person.nameLen, person.name, person.probInfected);
+	if (engineQueryInfector(engine, id, &infector) == ENGINE_SUCCESS)
+	{
+		return len + sprintf(expected + len, " %zu", infector.id);
+	}
+	return len + sprintf(expected + len, " " SERVER_NO_INFECTOR);
+}
+
+/**
+ * Writes the reply the server should give to "PATH" of a person
+ * @param engine The engine of the bench
+ * @param id The ID of the person
+ * @param expected Will contain the reply
+ * @return The length of the reply
+ */
+static int expectedPath(SpreaderEngine *engine, size_t id, char *expected)
+{
+	int len = sprintf(expected, SERVER_OK_REPLY " %zu", id);
+	EngineResult infector;
+	int status = engineQueryInfector(engine, id, &infector);
+	for (size_t pathLen = 1; status == ENGINE_SUCCESS && pathLen < SERVER_MAX_PATH_LENGTH;
+	     ++pathLen)
+	{
+		len += sprintf(expected + len, " %zu", infector.id);
+		status = engineQueryInfector(engine, infector.id, &infector);
+	}
+	return len;
+}
+
+/**
+ * Finds the last space of a line
+ * @param line The line
+ * @param len The length of the line
+ * @return pointer to the space, or NULL
+ */
+static const char *lastSpace(const char *line, size_t len)
+{
+	while (len > 0)
+	{
+		if (line[--len] == ' ')
+		{
+			return line + len;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Checks the replies of the server to "RISK" and "PATH" of the first people and to "COUNTS"
+ * @param engine The engine of the bench
+ * @param reader The reader of the connection to the server
+ * @param ids The IDs of the people
+ * @param numOfChecked The number of people to check
+ * @param batchSize The number of people in a batch
+ * @return The number of replies that were not the expected ones (or 1 if the connection failed)
+ */
+static size_t checkReplies(SpreaderEngine *engine, ReplyReader *reader, const size_t *ids,
+                           size_t numOfChecked, size_t batchSize)
+{
+	static char requests[MAX_BATCH_SIZE * 2 * MAX_REQUEST_SIZE];
+	static char expected[EXPECTED_REPLY_SIZE];
+	size_t numOfWrong = 0;
+	const char *line = NULL;
+	size_t lineLen = 0;
+	for (size_t first = 0; first < numOfChecked; first += batchSize)
+	{
+		size_t last = first + batchSize < numOfChecked ? first + batchSize : numOfChecked;
+		size_t len = 0;
+		for (size_t i = first; i < last; ++i)
+		{
+			len += (size_t) sprintf(requests + len, SERVER_RISK_REQUEST " %zu\n"
+			                        SERVER_PATH_REQUEST " %zu\n", ids[i], ids[i]);
+		}
+		if (!writeAll(reader->fd, requests, len))
+		{
+			return 1;
+		}
+		for (size_t i = first; i < last; ++i)
+		{
+			int expectedLen = expectedRiskFields(engine, ids[i], expected);
+			if (!readReplyLine(reader, &line, &lineLen))
+			{
+				return 1;
+			}
+			// the class is the word before the infector, the rest must be exactly the expected
+			const char *infector = lastSpace(line, lineLen);
+			const char *classBegin = infector != NULL ? lastSpace(line, infector - line) : NULL;
+			size_t headLen = classBegin != NULL ? (size_t) (classBegin - line) : 0;
+			size_t tailLen = infector != NULL ? lineLen - (size_t) (infector - line) : 0;
+			numOfWrong += classBegin == NULL || headLen + tailLen != (size_t) expectedLen ||
+			              memcmp(line, expected, headLen) != 0 ||
+			              memcmp(infector, expected + headLen, tailLen) != 0;
+			expectedLen = expectedPath(engine, ids[i], expected);
+			if (!readReplyLine(reader, &line, &lineLen))
+			{
+				return 1;
+			}
+			numOfWrong += lineLen != (size_t) expectedLen || memcmp(line, expected, lineLen) != 0;
+		}
+	}
+	size_t counts[NUM_OF_CLASSES];
+	engineCountClasses(engine, counts);
+	int expectedLen = sprintf(expected, SERVER_OK_REPLY " %zu %zu %zu",
+	                          counts[HOSPITALIZATION_CLASS], counts[QUARANTINE_CLASS],
+	                          counts[CLEAN_CLASS]);
+	if (!writeAll(reader->fd, SERVER_COUNTS_REQUEST "\n", strlen(SERVER_COUNTS_REQUEST "\n")) ||
+	    !readReplyLine(reader, &line, &lineLen))
+	{
+		return 1;
+	}
+	return numOfWrong + (lineLen != (size_t) expectedLen || memcmp(line, expected, lineLen) != 0);
+}
+
+/**
+ * A comparison function to q-sort that orders latencies from the smallest
+ * @param first
+ * @param sec
+ * @return -1 if the first is smaller. 1 if greater and 0 if equal
+ */
+static int cmpLatencies(const void *first, const void *sec)
+{
+	double firstLatency = *(const double *) first;
+	double secLatency = *(const double *) sec;
+	return (firstLatency > secLatency) - (firstLatency < secLatency);
+}
+
+/**
+ * Starts the tool in the server mode
+ * @param exam The path to the tool
+ * @param people The path to the people file
+ * @param meetings The path to the meeting file
+ * @param socketPath The path of the socket
+ * @return The process of the server, or -1
+ */
+static pid_t startServer(const char *exam, const char *people, const char *meetings,
+                         const char *socketPath)
+{
+	char serveOption[sizeof("--serve=") + PATH_MAX];
+	snprintf(serveOption, sizeof(serveOption), "--serve=%s", socketPath);
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		execl(exam, exam, serveOption, people, meetings, (char *) NULL);
+		_exit(EXIT_FAILURE);
+	}
+	return pid;
+}
+
+/**
+ * Connects to the server while it loads its files (until it answers, exits or the attempts are
+ * over)
+ * @param socketPath The path of the socket
+ * @param server The process of the server
+ * @return The socket, or -1
+ */
+static int waitForServer(const char *socketPath, pid_t server)
+{
+	struct timespec wait = {0, CONNECT_WAIT_NANOS};
+	for (int attempt = 0; attempt < CONNECT_ATTEMPTS; ++attempt)
+	{
+		int fd = connectToServer(socketPath);
+		if (fd >= 0)
+		{
+			return fd;
+		}
+		int status;
+		if (waitpid(server, &status, WNOHANG) != 0) // the server is gone
+		{
+			return -1;
+		}
+		nanosleep(&wait, NULL);
+	}
+	return -1;
+}
+
+/**
+ * Loads the two files into the engine of the bench and collects the IDs of the people
+ * @param people The path to the people file
+ * @param meetings The path to the meeting file
+ * @param ids Will point to the IDs (allocated with malloc)
+ * @return The engine, or NULL (the error was printed)
+ */
+static SpreaderEngine *loadEngine(const char *people, const char *meetings, size_t **ids)
+{
+	SpreaderEngine *engine;
+	long onlineCores = sysconf(_SC_NPROCESSORS_ONLN);
+	int status = createEngine(&engine, COMBINE_MAX, onlineCores > 0 ? (size_t) onlineCores : 1);
+	if (status != ENGINE_SUCCESS)
+	{
+		fprintf(stderr, "engine: %s\n", engineStatusMessage(status));
+		return NULL;
+	}
+	status = engineLoadPeople(engine, people);
+	if (status == ENGINE_SUCCESS)
+	{
+		status = engineLoadMeetings(engine, meetings);
+	}
+	size_t numOfPeople = engineNumOfPeople(engine);
+	*ids = (size_t *) malloc((numOfPeople ? numOfPeople : 1) * sizeof(size_t));
+	if (status == ENGINE_SUCCESS && *ids == NULL)
+	{
+		status = ENGINE_NO_MEMORY;
+	}
+	EngineResult result;
+	for (size_t rank = 0; status == ENGINE_SUCCESS && rank < numOfPeople; ++rank)
+	{
+		status = engineResultAt(engine, rank, &result);
+		(*ids)[rank] = result.id;
+	}
+	if (status == ENGINE_SUCCESS && numOfPeople == 0)
+	{
+		fprintf(stderr, "engine: no people to query\n");
+		status = ENGINE_END;
+	}
+	else if (status != ENGINE_SUCCESS)
+	{
+		fprintf(stderr, "engine: %s\n", engineStatusMessage(status));
+	}
+	if (status != ENGINE_SUCCESS)
+	{
+		free(*ids);
+		*ids = NULL;
+		destroyEngine(engine);
+		return NULL;
+	}
+	return engine;
+}
+
+/**
+ * Runs the load: one thread for every connection, all of them at once
+ * @param clients The connections (their settings are filled)
+ * @param numOfConnections The number of connections
+ * @return The wall time of the load in seconds, or a negative number if a connection failed
+ */
+static double runLoad(LoadClient *clients, size_t numOfConnections)
+{
+	double begin = currentSeconds();
+	size_t numOfStarted = 0;
+	while (numOfStarted < numOfConnections &&
+	       pthread_create(&clients[numOfStarted].thread, NULL, runLoadClient,
+	                      &clients[numOfStarted]) == 0)
+	{
+		numOfStarted++;
+	}
+	int isOk = numOfStarted == numOfConnections;
+	for (size_t i = 0; i < numOfStarted; ++i)
+	{
+		pthread_join(clients[i].thread, NULL);
+		isOk &= clients[i].isOk;
+	}
+	return isOk ? currentSeconds() - begin : -1;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "Usage: server_bench <Path to exam> <Path to People.in> "
+		                "<Path to Meetings.in> [number of connections] [requests per connection] "
+		                "[requests per batch]\n");
+		return EXIT_FAILURE;
+	}
+	size_t numOfConnections = argc > 4 ? strtoul(argv[4], NULL, 10) : DEFAULT_NUM_OF_CONNECTIONS;
+	size_t numOfRequests = argc > 5 ? strtoul(argv[5], NULL, 10) : DEFAULT_NUM_OF_REQUESTS;
+	size_t batchSize = argc > 6 ? strtoul(argv[6], NULL, 10) : DEFAULT_BATCH_SIZE;
+	if (numOfConnections == 0 || batchSize == 0 || batchSize > MAX_BATCH_SIZE)
+	{
+		fprintf(stderr, "server_bench: at least one connection, and 1 .. %d requests per batch\n",
+		        MAX_BATCH_SIZE);
+		return EXIT_FAILURE;
+	}
+	char *exam = realpath(argv[1], NULL);
+	char workDir[] = WORK_DIR_TEMPLATE;
+	char socketPath[sizeof(workDir) + sizeof(SOCKET_NAME) + 1];
+	if (exam == NULL || mkdtemp(workDir) == NULL)
+	{
+		fprintf(stderr, "server_bench: the paths can not be used\n");
+		free(exam);
+		return EXIT_FAILURE;
+	}
+	snprintf(socketPath, sizeof(socketPath), "%s/%s", workDir, SOCKET_NAME);
+	size_t *ids;
+	SpreaderEngine *engine = loadEngine(argv[2], argv[3], &ids);
+	if (engine == NULL)
+	{
+		rmdir(workDir);
+		free(exam);
+		return EXIT_FAILURE;
+	}
+	size_t numOfPeople = engineNumOfPeople(engine);
+	double begin = currentSeconds();
+	pid_t server = startServer(exam, argv[2], argv[3], socketPath);
+	ReplyReader *control = (ReplyReader *) calloc(1, sizeof(ReplyReader));
+	int exitStatus = EXIT_FAILURE;
+	if (server > 0 && control != NULL && (control->fd = waitForServer(socketPath, server)) >= 0)
+	{
+		double readySeconds = currentSeconds() - begin;
+		size_t numOfChecked = numOfPeople < MAX_CHECKED_PEOPLE ? numOfPeople : MAX_CHECKED_PEOPLE;
+		size_t numOfWrong = checkReplies(engine, control, ids, numOfChecked, batchSize);
+		LoadClient *clients = (LoadClient *) calloc(numOfConnections, sizeof(LoadClient));
+		double *latencies = (double *) malloc((numOfConnections * numOfRequests + 1) *
+		                                      sizeof(double));
+		double loadSeconds = -1;
+		size_t numOfErrors = 0;
+		if (clients != NULL && latencies != NULL)
+		{
+			for (size_t i = 0; i < numOfConnections; ++i)
+			{
+				clients[i].socketPath = socketPath; // the rest is 0 (calloc)
+				clients[i].ids = ids;
+				clients[i].numOfPeople = numOfPeople;
+				clients[i].numOfRequests = numOfRequests;
+				clients[i].batchSize = batchSize;
+				clients[i].random = RANDOM_SEED + i;
+				clients[i].latencies = latencies + i * numOfRequests;
+			}
+			loadSeconds = runLoad(clients, numOfConnections);
+			for (size_t i = 0; i < numOfConnections; ++i)
+			{
+				numOfErrors += clients[i].numOfErrors;
+			}
+		}
+		const char *line = NULL;
+		size_t lineLen = 0;
+		int isShutDown = writeAll(control->fd, SERVER_SHUTDOWN_REQUEST "\n",
+		                          strlen(SERVER_SHUTDOWN_REQUEST "\n")) &&
+		                 readReplyLine(control, &line, &lineLen);
+		if (loadSeconds >= 0)
+		{
+			size_t total = numOfConnections * numOfRequests;
+			qsort(latencies, total, sizeof(double), cmpLatencies);
+			printf("people: %zu, connections: %zu, requests: %zu (batches of %zu)\n", numOfPeople,
+			       numOfConnections, total, batchSize);
+			printf("server ready         %12.3f ms (load and propagation)\n", readySeconds * 1e3);
+			printf("queries per second   %12.0f\n", loadSeconds > 0 ? total / loadSeconds : 0);
+			if (total > 0)
+			{
+				printf("latency p50          %12.1f us\n", latencies[total / 2] * 1e6);
+				printf("latency p99          %12.1f us\n", latencies[total * 99 / 100] * 1e6);
+				printf("latency p99.9        %12.1f us\n", latencies[total * 999 / 1000] * 1e6);
+				printf("latency max          %12.1f us\n", latencies[total - 1] * 1e6);
+			}
+			printf("errors               %12zu\n", numOfErrors);
+			printf("replies of %zu people %s\n", numOfChecked, numOfWrong ? "MISMATCH" : "exact");
+			exitStatus = numOfWrong == 0 && numOfErrors == 0 && isShutDown ? EXIT_SUCCESS :
+			             EXIT_FAILURE;
+		}
+		else
+		{
+			fprintf(stderr, "server_bench: a connection failed\n");
+		}
+		free(clients);
+		free(latencies);
+		close(control->fd);
+	}
+	else
+	{
+		fprintf(stderr, "server_bench: the server did not start\n");
+	}
+	if (server > 0)
+	{
+		int status;
+		if (exitStatus != EXIT_SUCCESS)
+		{
+			kill(server, SIGTERM);
+		}
+		waitpid(server, &status, 0);
+		if (exitStatus == EXIT_SUCCESS && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+		{
+			fprintf(stderr, "server_bench: the server failed\n");
+			exitStatus = EXIT_FAILURE;
+		}
+	}
+	unlink(socketPath);
+	rmdir(workDir);
+	free(control);
+	free(ids);
+	destroyEngine(engine);
+	free(exam);
+	return exitStatus;
+}
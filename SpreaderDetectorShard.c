@@ -0,0 +1,736 @@
+/**
+* @file SpreaderDetectorShard.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the graph of a shard and of the rounds between the shards
+* @section DESCRIPTION
+* A message between two shards is a ShardMessage: the probability of a person who was made final
+* (for the remote vertex of the other shard), or the end of the round of the sender (with the
+* number of people it has left, and the smallest ID of them when it made no one final in the
+* round). A shard writes all its
+* messages of the round and then the end of the round to every other shard, and reads until it has
+* the end of the round of every other shard; the bytes that come after an end of a round already
+* belong to the next round and wait in the buffer of the link.
+* In a shard the edges are arranged like in SpreaderDetectorGraph.c: the meetings that infect every
+* person (in the order they were read, for his probability) and the meetings of every infector
+* (local or remote, to count down the in-degrees). Inside a round the people are made final with a
+* stack of the people whose in-degree dropped to 0. The rows of the shard are sorted by ID only the
+* first time a round of the shard makes no one final (a round of all the shards that makes no one
+* final means that only cycles are left, which should not happen). The probability of a person is
+* pulled with the wrapper of pullExposures of the combine rule (see SpreaderDetectorGraph.h).
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "SpreaderDetectorShard.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorGraph.h"
+#include "SpreaderDetectorTable.h"
+
+/**
+ * @def LINK_BUFFER_SIZE 65536
+ * @brief The size of the buffer every link reads into
+ */
+#define LINK_BUFFER_SIZE 65536
+
+/**
+ * @def NO_ONE_LEFT SIZE_MAX
+ * @brief The row of the person with the smallest ID that is left, when no one is left
+ */
+#define NO_ONE_LEFT SIZE_MAX
+
+/**
+ * @def FIBONACCI_MULTIPLIER 0x9E3779B97F4A7C15ull
+ * @brief 2^64 / golden ratio (Fibonacci hashing, see SpreaderDetectorIdIndex.c)
+ */
+#define FIBONACCI_MULTIPLIER 0x9E3779B97F4A7C15ull
+
+/**
+ * @def MESSAGE_EXPOSURE 0
+ * @brief A message with the probability of a person who was made final
+ */
+#define MESSAGE_EXPOSURE 0
+
+/**
+ * @def MESSAGE_END_OF_ROUND 1
+ * @brief The last message of a round
+ */
+#define MESSAGE_END_OF_ROUND 1
+
+/**
+ * @def MESSAGE_END_OF_ROUND_WITH_FIRST 2
+ * @brief The last message of a round in which the sender made no one final (with the smallest ID
+ * it has left)
+ */
+#define MESSAGE_END_OF_ROUND_WITH_FIRST 2
+
+/**
+ * @struct ShardMessage
+ * @brief One message between two shards. An exposure has the ID and the probability of the
+ * person, an end of a round has the number of people that are left and, when the round made no one
+ * final, the smallest ID of them (in id)
+ */
+typedef struct ShardMessage
+{
+	size_t id;
+	size_t numLeft;
+	float prob;
+	unsigned int kind;
+} ShardMessage;
+
+/**
+ * @struct ShardPropagation
+ * @brief The propagation of one shard: the probabilities of all the vertices (the people and then
+ * the remote infectors), which of them are final, the meetings that infect every person (inOffsets,
+ * sources and inWeights) and the meetings of every vertex (outOffsets and targets), and the stack
+ * of the people that can be made final. byId is the rows by the IDs of their people (NULL until a
+ * round makes no one final), and nextById the first of them that may still be left. pullExposures
+ * is the wrapper of pullExposures of the combine rule
+ */
+typedef struct ShardPropagation
+{
+	ShardGraph *graph;
+	float (*pullExposures)(const struct ShardPropagation *propagation, size_t row);
+	size_t numOfNodes;
+	size_t numOfRemote;
+	float *probs;
+	unsigned char *isFinal;
+	size_t *inOffsets;
+	size_t *sources;
+	float *inWeights;
+	size_t *outOffsets;
+	size_t *targets;
+	size_t *inDegrees;
+	size_t *ready;
+	size_t readyLen;
+	size_t numLeft;
+	size_t *byId;
+	size_t nextById;
+} ShardPropagation;
+
+/**
+ * @struct RoundTotals
+ * @brief What all the shards know at the end of a round
+ */
+typedef struct RoundTotals
+{
+	size_t numLeft;
+	int isFirstLeftKnown;
+	size_t firstLeft;
+	size_t firstLeftShard;
+} RoundTotals;
+
+size_t shardOfId(size_t id, size_t numOfShards)
+{
+	return (size_t) ((((uint64_t) id * FIBONACCI_MULTIPLIER) >> 32) % numOfShards);
+}
+
+int createShardMesh(ShardMesh *mesh, size_t numOfShards)
+{
+	mesh->numOfShards = numOfShards;
+	mesh->links = (int *) trackedMalloc(numOfShards * numOfShards * sizeof(int));
+	if (mesh->links == NULL)
+	{
+		return SHARD_FAILED;
+	}
+	for (size_t i = 0; i < numOfShards * numOfShards; ++i)
+	{
+		mesh->links[i] = -1;
+	}
+	for (size_t i = 0; i < numOfShards; ++i)
+	{
+		for (size_t j = i + 1; j < numOfShards; ++j)
+		{
+			int pair[2];
+			if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+			{
+				closeShardMesh(mesh);
+				return SHARD_FAILED;
+			}
+			mesh->links[i * numOfShards + j] = pair[0];
+			mesh->links[j * numOfShards + i] = pair[1];
+		}
+	}
+	return SHARD_SUCCESS;
+}
+
+void closeShardMesh(ShardMesh *mesh)
+{
+	if (mesh->links == NULL)
+	{
+		return;
+	}
+	for (size_t i = 0; i < mesh->numOfShards * mesh->numOfShards; ++i)
+	{
+		if (mesh->links[i] >= 0)
+		{
+			close(mesh->links[i]);
+		}
+	}
+	trackedFree(mesh->links, mesh->numOfShards * mesh->numOfShards * sizeof(int));
+	mesh->links = NULL;
+}
+
+int initShardGraph(ShardGraph *graph, ShardMesh *mesh, size_t shard, const size_t *ids,
+                   size_t numOfPeople)
+{
+	memset(graph, 0, sizeof(ShardGraph));
+	graph->shard = shard;
+	graph->numOfShards = mesh->numOfShards;
+	graph->ids = ids;
+	graph->numOfPeople = numOfPeople;
+	graph->links = (ShardLink *) trackedCalloc(mesh->numOfShards, sizeof(ShardLink));
+	graph->isSeed = (unsigned char *) trackedCalloc(numOfPeople + 1, sizeof(unsigned char));
+	graph->subscribers = (unsigned int *) trackedCalloc(numOfPeople + 1, sizeof(unsigned int));
+	if (graph->links == NULL)
+	{
+		closeShardMesh(mesh);
+		freeShardGraph(graph);
+		return SHARD_FAILED;
+	}
+	int status = graph->isSeed != NULL && graph->subscribers != NULL ? SHARD_SUCCESS :
+	             SHARD_FAILED;
+	for (size_t peer = 0; peer < graph->numOfShards; ++peer)
+	{
+		ShardLink *link = &graph->links[peer];
+		link->fd = mesh->links[shard * mesh->numOfShards + peer];
+		mesh->links[shard * mesh->numOfShards + peer] = -1; // taken, so it is not closed below
+		if (link->fd < 0)
+		{
+			continue;
+		}
+		link->in = (char *) trackedMalloc(LINK_BUFFER_SIZE);
+		int flags = fcntl(link->fd, F_GETFL);
+		if (link->in == NULL || flags < 0 || fcntl(link->fd, F_SETFL, flags | O_NONBLOCK) != 0)
+		{
+			status = SHARD_FAILED;
+		}
+	}
+	closeShardMesh(mesh); // the links of the other shards
+	if (status == SHARD_FAILED)
+	{
+		freeShardGraph(graph);
+	}
+	return status;
+}
+
+size_t remoteNodeOfId(ShardGraph *graph, size_t id)
+{
+	size_t node = nodeOfId(&graph->remoteNodes, id);
+	return node == NODE_FAILED ? NODE_FAILED : graph->numOfPeople + node;
+}
+
+void addShardSeed(ShardGraph *graph, size_t row)
+{
+	graph->isSeed[row] = 1;
+}
+
+int addShardContact(ShardGraph *graph, size_t infector, size_t infected, float crna)
+{
+	if (graph->numOfEdges == graph->edgesCapacity)
+	{
+		size_t capacity = graph->edgesCapacity;
+		size_t newCapacity = capacity ? capacity * GROWTH_FACTOR : INIT_CAPACITY;
+		if (resizeArray((void **) &graph->infectors, capacity, newCapacity, sizeof(size_t)) ==
+		    GROW_FAILED ||
+			resizeArray((void **) &graph->infecteds, capacity, newCapacity, sizeof(size_t)) ==
+			GROW_FAILED ||
+			resizeArray((void **) &graph->crnas, capacity, newCapacity, sizeof(float)) == GROW_FAILED)
+		{
+			return SHARD_FAILED; // the arrays that did grow are released with the graph
+		}
+		graph->edgesCapacity = newCapacity;
+	}
+	graph->infectors[graph->numOfEdges] = infector;
+	graph->infecteds[graph->numOfEdges] = infected;
+	graph->crnas[graph->numOfEdges] = crna;
+	graph->numOfEdges++;
+	return SHARD_SUCCESS;
+}
+
+void addShardSubscriber(ShardGraph *graph, size_t row, size_t shard)
+{
+	graph->subscribers[row] |= 1u << shard;
+}
+
+/**
+ * Adds a message to the messages of a link that wait to be written
+ * @param link The link
+ * @param message The message
+ * @return SHARD_SUCCESS or SHARD_FAILED
+ */
+static int queueMessage(ShardLink *link, const ShardMessage *message)
+{
+	if (link->outLen + sizeof(ShardMessage) > link->outCapacity)
+	{
+		size_t newCapacity = link->outCapacity ? link->outCapacity * GROWTH_FACTOR :
+		                     INIT_CAPACITY * sizeof(ShardMessage);
+		if (resizeArray((void **) &link->out, link->outCapacity, newCapacity, sizeof(char)) ==
+		    GROW_FAILED)
+		{
+			return SHARD_FAILED;
+		}
+		link->outCapacity = newCapacity;
+	}
+	memcpy(link->out + link->outLen, message, sizeof(ShardMessage));
+	link->outLen += sizeof(ShardMessage);
+	return SHARD_SUCCESS;
+}
+
+/**
+ * Counts down the in-degrees of the people infected by a vertex that was made final. The people
+ * whose in-degree dropped to 0 can be made final
+ * @param propagation The propagation
+ * @param node The vertex
+ */
+static void releaseTargets(ShardPropagation *propagation, size_t node)
+{
+	for (size_t e = propagation->outOffsets[node]; e < propagation->outOffsets[node + 1]; ++e)
+	{
+		size_t target = propagation->targets[e];
+		if (!propagation->isFinal[target] && --propagation->inDegrees[target] == 0)
+		{
+			propagation->ready[propagation->readyLen++] = target;
+		}
+	}
+}
+
+/**
+ * Returns the probability of a person: his own probability (1 for a seed, NOT_EXPOSED otherwise)
+ * combined with the exposure of every meeting that infects him and whose infector is final (all of
+ * them, unless he is on a cycle), in the order the meetings were read
+ * @param propagation The propagation
+ * @param row The row of the person
+ * @param combineRule The combine rule (a constant of the caller)
+ * @return The probability
+ */
+static ALWAYS_INLINE float pullExposures(const ShardPropagation *propagation, size_t row,
+                                         int combineRule)
+{
+	float prob = propagation->graph->isSeed[row] ? SURE_INFECTED : NOT_EXPOSED;
+	for (size_t e = propagation->inOffsets[row]; e < propagation->inOffsets[row + 1]; ++e)
+	{
+		size_t source = propagation->sources[e];
+		if (propagation->isFinal[source])
+		{
+			prob = combineExposure(combineRule, prob,
+			                       propagation->probs[source] * propagation->inWeights[e]);
+		}
+	}
+	return prob;
+}
+
+/**
+ * pullExposures with COMBINE_MAX
+ * @param propagation The propagation
+ * @param row The row of the person
+ * @return The probability
+ */
+static float pullExposuresMax(const ShardPropagation *propagation, size_t row)
+{
+	return pullExposures(propagation, row, COMBINE_MAX);
+}
+
+/**
+ * pullExposures with COMBINE_NOISY_OR
+ * @param propagation The propagation
+ * @param row The row of the person
+ * @return The probability
+ */
+static float pullExposuresNoisyOr(const ShardPropagation *propagation, size_t row)
+{
+	return pullExposures(propagation, row, COMBINE_NOISY_OR);
+}
+
+/**
+ * The wrappers of pullExposures (by combine rule)
+ */
+static float (*const exposurePulls[NUM_OF_COMBINE_RULES])(const ShardPropagation *propagation,
+                                                          size_t row) = {pullExposuresMax,
+                                                                         pullExposuresNoisyOr};
+
+/**
+ * Makes a person final with the probability of pullExposures. His probability is sent to every
+ * shard that subscribed to him
+ * @param propagation The propagation
+ * @param row The row of the person
+ * @return SHARD_SUCCESS or SHARD_FAILED
+ */
+static int makeFinal(ShardPropagation *propagation, size_t row)
+{
+	ShardGraph *graph = propagation->graph;
+	float prob = propagation->pullExposures(propagation, row);
+	propagation->probs[row] = prob;
+	propagation->isFinal[row] = 1;
+	propagation->numLeft--;
+	releaseTargets(propagation, row);
+	ShardMessage message = {graph->ids[row], 0, prob, MESSAGE_EXPOSURE};
+	for (size_t peer = 0; peer < graph->numOfShards; ++peer)
+	{
+		if ((graph->subscribers[row] >> peer & 1u) &&
+		    queueMessage(&graph->links[peer], &message) == SHARD_FAILED)
+		{
+			return SHARD_FAILED;
+		}
+	}
+	return SHARD_SUCCESS;
+}
+
+/**
+ * Handles the messages of a link that were read, until the end of the round of the other shard.
+ * The bytes that were not handled are moved to the beginning of the buffer
+ * @param propagation The propagation
+ * @param link The link
+ * @return SHARD_SUCCESS or SHARD_FAILED (a message about a person the shard does not know)
+ */
+static int handleMessages(ShardPropagation *propagation, ShardLink *link)
+{
+	size_t place = 0;
+	while (!link->gotEndOfRound && link->inLen - place >= sizeof(ShardMessage))
+	{
+		ShardMessage message;
+		memcpy(&message, link->in + place, sizeof(ShardMessage));
+		place += sizeof(ShardMessage);
+		if (message.kind != MESSAGE_EXPOSURE)
+		{
+			link->gotEndOfRound = 1;
+			link->isPeerFirstLeftKnown = message.kind == MESSAGE_END_OF_ROUND_WITH_FIRST;
+			link->peerFirstLeft = message.id;
+			link->peerLeft = message.numLeft;
+			continue;
+		}
+		size_t node = nodeOfId(&propagation->graph->remoteNodes, message.id);
+		if (node >= propagation->numOfRemote) // not a vertex of the shard (or no memory)
+		{
+			return SHARD_FAILED;
+		}
+		node += propagation->graph->numOfPeople;
+		if (propagation->isFinal[node])
+		{
+			return SHARD_FAILED;
+		}
+		propagation->probs[node] = message.prob;
+		propagation->isFinal[node] = 1;
+		releaseTargets(propagation, node);
+	}
+	memmove(link->in, link->in + place, link->inLen - place);
+	link->inLen -= place;
+	return SHARD_SUCCESS;
+}
+
+/**
+ * Finds the person of the shard with the smallest ID that is left. The first time the rows are
+ * sorted by ID (no one is left again after he was made final, so they are sorted only once)
+ * @param propagation The propagation
+ * @param row Will contain his row (or NO_ONE_LEFT)
+ * @return SHARD_SUCCESS or SHARD_FAILED (no memory)
+ */
+static int findFirstLeft(ShardPropagation *propagation, size_t *row)
+{
+	size_t numOfPeople = propagation->graph->numOfPeople;
+	if (propagation->byId == NULL)
+	{
+		propagation->byId = (size_t *) trackedMalloc((numOfPeople + 1) * sizeof(size_t));
+		if (propagation->byId == NULL)
+		{
+			return SHARD_FAILED;
+		}
+		for (size_t i = 0; i < numOfPeople; ++i)
+		{
+			propagation->byId[i] = i;
+		}
+		sortNodesByKey(propagation->byId, numOfPeople, propagation->graph->ids);
+	}
+	while (propagation->nextById < numOfPeople &&
+	       propagation->isFinal[propagation->byId[propagation->nextById]])
+	{
+		propagation->nextById++;
+	}
+	*row = propagation->nextById < numOfPeople ? propagation->byId[propagation->nextById] :
+	       NO_ONE_LEFT;
+	return SHARD_SUCCESS;
+}
+
+/**
+ * Ends a round: writes the messages of the round and the end of the round to every other shard,
+ * and handles their messages until the end of their round
+ * @param propagation The propagation
+ * @param firstLeft The row of the person of this shard with the smallest ID that is left, or
+ * NO_ONE_LEFT when no one is left or the round made someone final
+ * @param totals Will contain the numbers of all the shards (the smallest ID that is left is known
+ * only when no shard made anyone final)
+ * @return SHARD_SUCCESS or SHARD_FAILED
+ */
+static int exchangeRound(ShardPropagation *propagation, size_t firstLeft, RoundTotals *totals)
+{
+	ShardGraph *graph = propagation->graph;
+	size_t firstLeftId = firstLeft != NO_ONE_LEFT ? graph->ids[firstLeft] : 0;
+	ShardMessage endOfRound = {firstLeftId, propagation->numLeft, 0.0f,
+	                           firstLeft != NO_ONE_LEFT ? MESSAGE_END_OF_ROUND_WITH_FIRST :
+	                           MESSAGE_END_OF_ROUND};
+	struct pollfd fds[MAX_SHARDS];
+	size_t peers[MAX_SHARDS];
+	for (size_t peer = 0; peer < graph->numOfShards; ++peer)
+	{
+		ShardLink *link = &graph->links[peer];
+		if (link->fd >= 0 && (queueMessage(link, &endOfRound) == SHARD_FAILED ||
+		                      handleMessages(propagation, link) == SHARD_FAILED)) // the leftovers
+		{
+			return SHARD_FAILED;
+		}
+	}
+	while (1)
+	{
+		nfds_t numOfFds = 0;
+		for (size_t peer = 0; peer < graph->numOfShards; ++peer)
+		{
+			ShardLink *link = &graph->links[peer];
+			short events = (short) ((link->fd >= 0 && !link->gotEndOfRound ? POLLIN : 0) |
+			                        (link->outWritten < link->outLen ? POLLOUT : 0));
+			if (events != 0)
+			{
+				fds[numOfFds].fd = link->fd;
+				fds[numOfFds].events = events;
+				peers[numOfFds++] = peer;
+			}
+		}
+		if (numOfFds == 0)
+		{
+			break;
+		}
+		if (poll(fds, numOfFds, -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return SHARD_FAILED;
+		}
+		for (nfds_t i = 0; i < numOfFds; ++i)
+		{
+			ShardLink *link = &graph->links[peers[i]];
+			if (fds[i].revents & (POLLOUT | POLLERR))
+			{
+				ssize_t written = send(link->fd, link->out + link->outWritten,
+				                       link->outLen - link->outWritten, MSG_NOSIGNAL);
+				if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				{
+					return SHARD_FAILED; // the other shard is gone
+				}
+				link->outWritten += written > 0 ? (size_t) written : 0;
+			}
+			if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !link->gotEndOfRound)
+			{
+				ssize_t numOfRead = recv(link->fd, link->in + link->inLen,
+				                         LINK_BUFFER_SIZE - link->inLen, 0);
+				if (numOfRead == 0 ||
+				    (numOfRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+				{
+					return SHARD_FAILED; // the other shard is gone
+				}
+				link->inLen += numOfRead > 0 ? (size_t) numOfRead : 0;
+				if (handleMessages(propagation, link) == SHARD_FAILED)
+				{
+					return SHARD_FAILED;
+				}
+			}
+		}
+	}
+	totals->numLeft = propagation->numLeft;
+	totals->isFirstLeftKnown = firstLeft != NO_ONE_LEFT;
+	totals->firstLeft = firstLeftId;
+	totals->firstLeftShard = graph->shard;
+	for (size_t peer = 0; peer < graph->numOfShards; ++peer)
+	{
+		ShardLink *link = &graph->links[peer];
+		if (link->fd < 0)
+		{
+			continue;
+		}
+		totals->numLeft += link->peerLeft;
+		if (link->isPeerFirstLeftKnown &&
+		    (!totals->isFirstLeftKnown || link->peerFirstLeft < totals->firstLeft))
+		{
+			totals->isFirstLeftKnown = 1;
+			totals->firstLeft = link->peerFirstLeft;
+			totals->firstLeftShard = peer;
+		}
+		link->gotEndOfRound = 0;
+		link->outLen = 0;
+		link->outWritten = 0;
+	}
+	return SHARD_SUCCESS;
+}
+
+/**
+ * Arranges the edges of the shard: the meetings that infect every person, in the order they were
+ * read, and the meetings of every vertex. The in-degree of every person is his number of meetings
+ * @param propagation The propagation (its arrays are allocated, the offsets are zeros)
+ */
+static void buildShardCsr(ShardPropagation *propagation)
+{
+	const ShardGraph *graph = propagation->graph;
+	size_t *inOffsets = propagation->inOffsets;
+	size_t *outOffsets = propagation->outOffsets;
+	for (size_t e = 0; e < graph->numOfEdges; ++e)
+	{
+		inOffsets[graph->infecteds[e] + 1]++;
+		outOffsets[graph->infectors[e] + 1]++;
+	}
+	for (size_t row = 0; row < graph->numOfPeople; ++row)
+	{
+		propagation->inDegrees[row] = inOffsets[row + 1];
+		inOffsets[row + 1] += inOffsets[row];
+	}
+	for (size_t node = 0; node < propagation->numOfNodes; ++node)
+	{
+		outOffsets[node + 1] += outOffsets[node];
+	}
+	for (size_t e = 0; e < graph->numOfEdges; ++e)
+	{
+		size_t inPlace = inOffsets[graph->infecteds[e]]++; // moves to the next place
+		propagation->sources[inPlace] = graph->infectors[e];
+		propagation->inWeights[inPlace] = graph->crnas[e];
+		propagation->targets[outOffsets[graph->infectors[e]]++] = graph->infecteds[e];
+	}
+	for (size_t row = graph->numOfPeople; row > 0; --row) // back to the first place of every row
+	{
+		inOffsets[row] = inOffsets[row - 1];
+	}
+	inOffsets[0] = 0;
+	for (size_t node = propagation->numOfNodes; node > 0; --node)
+	{
+		outOffsets[node] = outOffsets[node - 1];
+	}
+	outOffsets[0] = 0;
+}
+
+/**
+ * Releases the arrays of a propagation
+ * @param propagation The propagation
+ * @param numOfEdges The number of edges of the graph
+ */
+static void freePropagation(ShardPropagation *propagation, size_t numOfEdges)
+{
+	size_t numOfPeople = propagation->graph->numOfPeople;
+	trackedFree(propagation->probs, (propagation->numOfNodes + 1) * sizeof(float));
+	trackedFree(propagation->isFinal, (propagation->numOfNodes + 1) * sizeof(unsigned char));
+	trackedFree(propagation->inOffsets, (numOfPeople + 1) * sizeof(size_t));
+	trackedFree(propagation->sources, (numOfEdges + 1) * sizeof(size_t));
+	trackedFree(propagation->inWeights, (numOfEdges + 1) * sizeof(float));
+	trackedFree(propagation->outOffsets, (propagation->numOfNodes + 1) * sizeof(size_t));
+	trackedFree(propagation->targets, (numOfEdges + 1) * sizeof(size_t));
+	trackedFree(propagation->inDegrees, (numOfPeople + 1) * sizeof(size_t));
+	trackedFree(propagation->ready, (numOfPeople + 1) * sizeof(size_t));
+	trackedFree(propagation->byId, propagation->byId != NULL ? (numOfPeople + 1) * sizeof(size_t) :
+	                               0);
+}
+
+int propagateShard(ShardGraph *graph, int combineRule, float *probs, size_t *numOfRounds)
+{
+	ShardPropagation propagation = {0};
+	size_t numOfPeople = graph->numOfPeople;
+	size_t numOfEdges = graph->numOfEdges;
+	propagation.graph = graph;
+	propagation.pullExposures = exposurePulls[combineRule];
+	propagation.numOfRemote = graph->remoteNodes.len;
+	propagation.numOfNodes = numOfPeople + propagation.numOfRemote;
+	propagation.numLeft = numOfPeople;
+	// Every array has one more element, so none of them is empty
+	propagation.probs = (float *) trackedMalloc((propagation.numOfNodes + 1) * sizeof(float));
+	propagation.isFinal = (unsigned char *) trackedCalloc(propagation.numOfNodes + 1,
+	                                                      sizeof(unsigned char));
+	propagation.inOffsets = (size_t *) trackedCalloc(numOfPeople + 1, sizeof(size_t));
+	propagation.sources = (size_t *) trackedMalloc((numOfEdges + 1) * sizeof(size_t));
+	propagation.inWeights = (float *) trackedMalloc((numOfEdges + 1) * sizeof(float));
+	propagation.outOffsets = (size_t *) trackedCalloc(propagation.numOfNodes + 1, sizeof(size_t));
+	propagation.targets = (size_t *) trackedMalloc((numOfEdges + 1) * sizeof(size_t));
+	propagation.inDegrees = (size_t *) trackedMalloc((numOfPeople + 1) * sizeof(size_t));
+	propagation.ready = (size_t *) trackedMalloc((numOfPeople + 1) * sizeof(size_t));
+	if (propagation.probs == NULL || propagation.isFinal == NULL ||
+	    propagation.inOffsets == NULL || propagation.sources == NULL ||
+	    propagation.inWeights == NULL || propagation.outOffsets == NULL ||
+	    propagation.targets == NULL || propagation.inDegrees == NULL || propagation.ready == NULL)
+	{
+		freePropagation(&propagation, numOfEdges);
+		return SHARD_FAILED;
+	}
+	buildShardCsr(&propagation);
+	for (size_t row = 0; row < numOfPeople; ++row)
+	{
+		if (propagation.inDegrees[row] == 0) // no meeting infects him
+		{
+			propagation.ready[propagation.readyLen++] = row;
+		}
+	}
+	int status = SHARD_SUCCESS;
+	size_t lastNumLeft = SIZE_MAX;
+	*numOfRounds = 0;
+	while (status == SHARD_SUCCESS)
+	{
+		size_t roundNumLeft = propagation.numLeft;
+		while (propagation.readyLen > 0 && status == SHARD_SUCCESS)
+		{
+			status = makeFinal(&propagation, propagation.ready[--propagation.readyLen]);
+		}
+		// the smallest ID that is left is needed only if no shard made anyone final in the round
+		size_t firstLeft = NO_ONE_LEFT;
+		if (status == SHARD_SUCCESS && propagation.numLeft == roundNumLeft)
+		{
+			status = findFirstLeft(&propagation, &firstLeft);
+		}
+		RoundTotals totals;
+		if (status == SHARD_FAILED ||
+		    exchangeRound(&propagation, firstLeft, &totals) == SHARD_FAILED)
+		{
+			status = SHARD_FAILED;
+			break;
+		}
+		(*numOfRounds)++;
+		if (totals.numLeft == 0)
+		{
+			break;
+		}
+		// No one was made final in any shard, so only cycles are left: the person with the
+		// smallest ID that is left (in all the shards) is final with what he has now
+		if (totals.numLeft == lastNumLeft && totals.isFirstLeftKnown &&
+		    totals.firstLeftShard == graph->shard)
+		{
+			status = makeFinal(&propagation, firstLeft);
+		}
+		lastNumLeft = totals.numLeft;
+	}
+	if (status == SHARD_SUCCESS && numOfPeople > 0) // an empty shard has no arrays to copy
+	{
+		memcpy(probs, propagation.probs, numOfPeople * sizeof(float));
+	}
+	freePropagation(&propagation, numOfEdges);
+	return status;
+}
+
+void freeShardGraph(ShardGraph *graph)
+{
+	freeProbMap(&graph->remoteNodes);
+	trackedFree(graph->isSeed, (graph->numOfPeople + 1) * sizeof(unsigned char));
+	trackedFree(graph->subscribers, (graph->numOfPeople + 1) * sizeof(unsigned int));
+	trackedFree(graph->infectors, graph->edgesCapacity * sizeof(size_t));
+	trackedFree(graph->infecteds, graph->edgesCapacity * sizeof(size_t));
+	trackedFree(graph->crnas, graph->edgesCapacity * sizeof(float));
+	for (size_t peer = 0; graph->links != NULL && peer < graph->numOfShards; ++peer)
+	{
+		ShardLink *link = &graph->links[peer];
+		if (link->fd >= 0)
+		{
+			close(link->fd);
+		}
+		trackedFree(link->out, link->outCapacity);
+		trackedFree(link->in, link->in != NULL ? LINK_BUFFER_SIZE : 0);
+	}
+	trackedFree(graph->links, graph->numOfShards * sizeof(ShardLink));
+	memset(graph, 0, sizeof(ShardGraph));
+}
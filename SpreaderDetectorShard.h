@@ -0,0 +1,191 @@
+/**
+* @file SpreaderDetectorShard.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The parts of the sharded mode of the detector: the people are split between processes
+* @section DESCRIPTION
+* In the sharded mode the people are split by a hash of their ID between N worker processes
+* (shards), and no process holds more than its own part of the table:
+* - Every meeting belongs to the shard of its infected. The infector may be in another shard: then
+*   he is a remote vertex of the graph of the shard, and the shard of the infector knows that it
+*   has to send his probability there (a subscriber).
+* - The shards propagate in rounds. In a round every shard makes final everyone it can (like the
+*   levels of SpreaderDetectorGraph.h, from all his infectors in the order the meetings were
+*   read), and then all the shards exchange the probabilities of the people who were made final
+*   (one message for every person and subscribed shard) and the number of people they have left.
+*   Every shard gets the same numbers, so they all decide together whether to stop.
+* - A round in which no one was made final in any shard means that only cycles are left (which
+*   should not happen): the person with the smallest ID that is left in all the shards is made
+*   final with the infectors that are already final, like in the regular mode.
+* The shards are connected by a full mesh of Unix domain sockets (one socket pair for every two
+* shards), which are written and read together with poll, so two shards that send a lot to each
+* other never wait for each other. The number of rounds is the length of the longest chain of
+* meetings that pass between shards.
+*/
+
+#ifndef EXAM_SPREADERDETECTORSHARD_H
+#define EXAM_SPREADERDETECTORSHARD_H
+
+#include <stddef.h>
+#include "SpreaderDetectorStreaming.h"
+
+/**
+ * @def SHARD_SUCCESS 1
+ * @brief Returned by the functions of the shards when they succeeded
+ */
+#define SHARD_SUCCESS 1
+
+/**
+ * @def SHARD_FAILED 0
+ * @brief Returned by the functions of the shards when an allocation, a socket or another shard
+ * failed
+ */
+#define SHARD_FAILED 0
+
+/**
+ * @def MAX_SHARDS 16
+ * @brief The maximal number of shards (the mesh has N * (N - 1) sockets, and the subscribers of a
+ * person are the bits of an unsigned int)
+ */
+#define MAX_SHARDS 16
+
+/**
+ * @struct ShardMesh
+ * @brief The sockets between the shards: links[i * numOfShards + j] is the end of the link
+ * between shard i and shard j that belongs to shard i (-1 when i == j or when it was closed)
+ */
+typedef struct ShardMesh
+{
+	int *links;
+	size_t numOfShards;
+} ShardMesh;
+
+/**
+ * @struct ShardLink
+ * @brief The link of a shard to one other shard: the messages of the current round that are
+ * waiting to be written, and the bytes that were read and not handled yet
+ */
+typedef struct ShardLink
+{
+	int fd;
+	char *out;
+	size_t outLen;
+	size_t outWritten;
+	size_t outCapacity;
+	char *in;
+	size_t inLen;
+	int gotEndOfRound;
+	size_t peerLeft;
+	int isPeerFirstLeftKnown;
+	size_t peerFirstLeft;
+} ShardLink;
+
+/**
+ * @struct ShardGraph
+ * @brief The graph of one shard. The vertices are the people of the shard (by their rows) and
+ * then the remote infectors (numOfPeople + their node in remoteNodes). The edges are kept as they
+ * were read until the propagation, and subscribers has a bit for every shard that has to get the
+ * probability of the person of the row
+ */
+typedef struct ShardGraph
+{
+	size_t shard;
+	size_t numOfPeople;
+	const size_t *ids;
+	ProbMap remoteNodes;
+	unsigned char *isSeed;
+	size_t *infectors;
+	size_t *infecteds;
+	float *crnas;
+	size_t numOfEdges;
+	size_t edgesCapacity;
+	unsigned int *subscribers;
+	ShardLink *links;
+	size_t numOfShards;
+} ShardGraph;
+
+/**
+ * Returns the shard of a person
+ * @param id The ID of the person
+ * @param numOfShards The number of shards
+ * @return The shard (0 .. numOfShards - 1)
+ */
+size_t shardOfId(size_t id, size_t numOfShards);
+
+/**
+ * Creates the sockets between every two shards (before the workers are forked)
+ * @param mesh The mesh
+ * @param numOfShards The number of shards (at most MAX_SHARDS)
+ * @return SHARD_SUCCESS or SHARD_FAILED (nothing is left open)
+ */
+int createShardMesh(ShardMesh *mesh, size_t numOfShards);
+
+/**
+ * Closes all the sockets of the mesh
+ * @param mesh The mesh
+ */
+void closeShardMesh(ShardMesh *mesh);
+
+/**
+ * Prepares the graph of one shard (in its worker, after the fork). The sockets of the shard are
+ * taken from the mesh, and all the other sockets of the mesh are closed
+ * @param graph The graph (empty)
+ * @param mesh The mesh
+ * @param shard The shard of this worker
+ * @param ids The IDs of the people of the shard (by row, kept until the graph is freed)
+ * @param numOfPeople The number of people of the shard
+ * @return SHARD_SUCCESS or SHARD_FAILED
+ */
+int initShardGraph(ShardGraph *graph, ShardMesh *mesh, size_t shard, const size_t *ids,
+                   size_t numOfPeople);
+
+/**
+ * Returns the vertex of an infector from another shard (a new vertex the first time)
+ * @param graph The graph
+ * @param id The ID of the infector
+ * @return The vertex, or NODE_FAILED (no memory)
+ */
+size_t remoteNodeOfId(ShardGraph *graph, size_t id);
+
+/**
+ * Marks a person of the shard as a seed
+ * @param graph The graph
+ * @param row The row of the person
+ */
+void addShardSeed(ShardGraph *graph, size_t row);
+
+/**
+ * Adds a meeting whose infected is in the shard
+ * @param graph The graph
+ * @param infector The vertex of the infector (his row, or the result of remoteNodeOfId)
+ * @param infected The row of the infected
+ * @param crna The crna of the meeting
+ * @return SHARD_SUCCESS or SHARD_FAILED
+ */
+int addShardContact(ShardGraph *graph, size_t infector, size_t infected, float crna);
+
+/**
+ * Adds a meeting whose infector is in the shard and whose infected is in another shard
+ * @param graph The graph
+ * @param row The row of the infector
+ * @param shard The shard of the infected
+ */
+void addShardSubscriber(ShardGraph *graph, size_t row, size_t shard);
+
+/**
+ * Propagates the risk together with all the other shards (each one calls it in its own worker)
+ * @param graph The graph
+ * @param combineRule COMBINE_MAX or COMBINE_NOISY_OR (see SpreaderDetectorGraph.h)
+ * @param probs Will contain the probability of every person of the shard (by row)
+ * @param numOfRounds Will contain the number of rounds
+ * @return SHARD_SUCCESS or SHARD_FAILED
+ */
+int propagateShard(ShardGraph *graph, int combineRule, float *probs, size_t *numOfRounds);
+
+/**
+ * Releases the graph and closes the sockets of the shard. And turns it into an empty graph
+ * @param graph The graph
+ */
+void freeShardGraph(ShardGraph *graph);
+
+#endif //EXAM_SPREADERDETECTORSHARD_H
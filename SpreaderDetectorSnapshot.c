@@ -0,0 +1,362 @@
+/**
+* @file SpreaderDetectorSnapshot.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the binary snapshots
+* @section DESCRIPTION
+* A new snapshot is created in its final size (its blocks are allocated up front, so filling the
+* mapping can not fail for lack of space) and the caller fills the columns directly in the shared
+* mapping. The checksum is computed over everything after the header, 8 bytes at a time in four
+* independent lanes, so checking it on every load costs about as much as reading the file once.
+*/
+
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SpreaderDetectorSnapshot.h"
+#include "SpreaderDetectorStats.h"
+
+/**
+ * @def SNAPSHOT_MAGIC "\x89SDSNAP\n"
+ * @brief The first bytes of every snapshot. (The first byte is not text, so a text file never
+ * starts with them)
+ */
+#define SNAPSHOT_MAGIC "\x89SDSNAP\n"
+
+/**
+ * @def SNAPSHOT_MAGIC_LEN 8
+ * @brief The number of bytes of the magic (without the '\0')
+ */
+#define SNAPSHOT_MAGIC_LEN 8
+
+/**
+ * @def SNAPSHOT_VERSION 1
+ * @brief The version of the format. A snapshot of another version is rejected
+ */
+#define SNAPSHOT_VERSION 1
+
+/**
+ * @def BYTE_ORDER_MARK 0x01020304
+ * @brief Written as a number into the header, so a snapshot of a machine with another byte order
+ * is recognized
+ */
+#define BYTE_ORDER_MARK 0x01020304
+
+/**
+ * @def SNAPSHOT_ALIGNMENT 8
+ * @brief Every column starts at a multiple of this (the alignment of size_t)
+ */
+#define SNAPSHOT_ALIGNMENT 8
+
+/**
+ * @def MAX_COLUMNS 5
+ * @brief The maximal number of columns of a snapshot (the people have 5)
+ */
+#define MAX_COLUMNS 5
+
+/**
+ * @def SNAPSHOT_FILE_MODE 0644
+ * @brief The permissions of a new snapshot file (before the umask)
+ */
+#define SNAPSHOT_FILE_MODE 0644
+
+/**
+ * @def CHECKSUM_LANES 4
+ * @brief The number of independent lanes of the checksum
+ */
+#define CHECKSUM_LANES 4
+
+/**
+ * @def CHECKSUM_PRIME_1 0x9E3779B185EBCA87
+ * @brief The first multiplier of the checksum (a large odd number with mixed bits)
+ */
+#define CHECKSUM_PRIME_1 0x9E3779B185EBCA87ull
+
+/**
+ * @def CHECKSUM_PRIME_2 0xC2B2AE3D27D4EB4F
+ * @brief The second multiplier of the checksum
+ */
+#define CHECKSUM_PRIME_2 0xC2B2AE3D27D4EB4Full
+
+/**
+ * @def BITS_IN_WORD 64
+ * @brief The number of bits of one word of the checksum
+ */
+#define BITS_IN_WORD 64
+
+/**
+ * @struct SnapshotHeader
+ * @brief The first 64 bytes of a snapshot. fileSize is the size of the whole file and checksum is
+ * the checksum of everything after the header
+ */
+typedef struct SnapshotHeader
+{
+	char magic[SNAPSHOT_MAGIC_LEN];
+	uint32_t version;
+	uint32_t kind;
+	uint32_t byteOrder;
+	uint32_t sizeOfId;
+	uint64_t count;
+	uint64_t extraCount;
+	uint64_t fileSize;
+	uint64_t checksum;
+	uint64_t reserved;
+} SnapshotHeader;
+
+/**
+ * Rounds a size up to a multiple of SNAPSHOT_ALIGNMENT
+ * @param size The size
+ * @return The rounded size
+ */
+static size_t alignColumn(size_t size)
+{
+	return (size + SNAPSHOT_ALIGNMENT - 1) & ~((size_t) SNAPSHOT_ALIGNMENT - 1);
+}
+
+/**
+ * Computes where every column of a snapshot starts
+ * @param kind SNAPSHOT_PEOPLE or SNAPSHOT_MEETINGS
+ * @param count The number of people (or of meetings)
+ * @param extraCount The number of bytes of the names (or the number of seeds)
+ * @param offsets Will contain the offset of every column (in the order of the Snapshot struct)
+ * @return The size of the whole snapshot
+ */
+static size_t layoutSnapshot(unsigned int kind, size_t count, size_t extraCount,
+                             size_t offsets[MAX_COLUMNS])
+{
+	size_t offset = alignColumn(sizeof(SnapshotHeader));
+	if (kind == SNAPSHOT_PEOPLE)
+	{
+		size_t columnSizes[MAX_COLUMNS] = {count * sizeof(size_t), count * sizeof(float),
+		                                   count * sizeof(float), count * sizeof(unsigned int),
+		                                   extraCount};
+		for (size_t i = 0; i < MAX_COLUMNS; ++i)
+		{
+			offsets[i] = offset;
+			offset += alignColumn(columnSizes[i]);
+		}
+		return offset;
+	}
+	offsets[0] = offset; // the seeds
+	offset += alignColumn(extraCount * sizeof(size_t));
+	offsets[1] = offset; // the meetings
+	return offset + count * sizeof(MeetingInfo);
+}
+
+/**
+ * Points the columns of a snapshot into its mapping
+ * @param snapshot The snapshot (with its data, kind and counts)
+ */
+static void placeColumns(Snapshot *snapshot)
+{
+	size_t offsets[MAX_COLUMNS];
+	layoutSnapshot(snapshot->kind, snapshot->count, snapshot->extraCount, offsets);
+	char *data = snapshot->data;
+	if (snapshot->kind == SNAPSHOT_PEOPLE)
+	{
+		snapshot->ids = (size_t *) (data + offsets[0]);
+		snapshot->ages = (float *) (data + offsets[1]);
+		snapshot->probs = (float *) (data + offsets[2]);
+		snapshot->nameLengths = (unsigned int *) (data + offsets[3]);
+		snapshot->names = data + offsets[4];
+	}
+	else
+	{
+		snapshot->seeds = (size_t *) (data + offsets[0]);
+		snapshot->meetings = (MeetingInfo *) (data + offsets[1]);
+	}
+}
+
+/**
+ * Rotates the bits of a word to the left
+ * @param word The word
+ * @param bits The number of bits (1 .. 63)
+ * @return The rotated word
+ */
+static uint64_t rotateLeft(uint64_t word, unsigned int bits)
+{
+	return (word << bits) | (word >> (BITS_IN_WORD - bits));
+}
+
+/**
+ * Computes the checksum of a range of bytes. Every lane mixes every fourth word (multiply, rotate,
+ * multiply), so the lanes do not wait for each other, and the lanes and the last bytes are mixed
+ * together at the end
+ * @param data The bytes
+ * @param len The number of bytes
+ * @return The checksum
+ */
+static uint64_t checksumOf(const char *data, size_t len)
+{
+	uint64_t lanes[CHECKSUM_LANES] = {CHECKSUM_PRIME_1, CHECKSUM_PRIME_2, 0, (uint64_t) len};
+	const size_t blockSize = CHECKSUM_LANES * sizeof(uint64_t);
+	size_t i = 0;
+	for (; i + blockSize <= len; i += blockSize)
+	{
+		for (size_t lane = 0; lane < CHECKSUM_LANES; ++lane)
+		{
+			uint64_t word;
+			memcpy(&word, data + i + lane * sizeof(uint64_t), sizeof(uint64_t));
+			lanes[lane] = rotateLeft(lanes[lane] + word * CHECKSUM_PRIME_2, 31) * CHECKSUM_PRIME_1;
+		}
+	}
+	uint64_t checksum = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) +
+	                    rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+	for (; i < len; ++i)
+	{
+		checksum = (checksum ^ (unsigned char) data[i]) * CHECKSUM_PRIME_1;
+	}
+	checksum ^= checksum >> 33;
+	checksum *= CHECKSUM_PRIME_2;
+	checksum ^= checksum >> 29;
+	return checksum;
+}
+
+/**
+ * Checks the header of a mapped snapshot against its kind, the machine, its size and its checksum
+ * @param data The mapped file
+ * @param len The size of the file
+ * @param kind The expected kind
+ * @return SNAPSHOT_SUCCESS or SNAPSHOT_INVALID
+ */
+static int checkSnapshot(const char *data, size_t len, unsigned int kind)
+{
+	SnapshotHeader header;
+	memcpy(&header, data, sizeof(SnapshotHeader));
+	// every person (or meeting, or seed, or byte of a name) takes at least one byte, so the counts
+	// can not make the layout overflow
+	if (header.version != SNAPSHOT_VERSION || header.kind != kind ||
+		header.byteOrder != BYTE_ORDER_MARK || header.sizeOfId != sizeof(size_t) ||
+		header.count > len || header.extraCount > len || header.fileSize != len)
+	{
+		return SNAPSHOT_INVALID;
+	}
+	size_t offsets[MAX_COLUMNS];
+	if (layoutSnapshot(kind, (size_t) header.count, (size_t) header.extraCount, offsets) != len ||
+		checksumOf(data + sizeof(SnapshotHeader), len - sizeof(SnapshotHeader)) != header.checksum)
+	{
+		return SNAPSHOT_INVALID;
+	}
+	return SNAPSHOT_SUCCESS;
+}
+
+int openSnapshot(const char *path, unsigned int kind, Snapshot *snapshot)
+{
+	struct stat fileStat;
+	if (stat(path, &fileStat) != 0)
+	{
+		return SNAPSHOT_OPEN_FAILED;
+	}
+	// a pipe is never a snapshot (and it is not opened here, so nothing is read from it)
+	if (!S_ISREG(fileStat.st_mode) || (size_t) fileStat.st_size < SNAPSHOT_MAGIC_LEN)
+	{
+		return SNAPSHOT_NOT_SNAPSHOT;
+	}
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return SNAPSHOT_OPEN_FAILED;
+	}
+	char magic[SNAPSHOT_MAGIC_LEN];
+	if (pread(fd, magic, SNAPSHOT_MAGIC_LEN, 0) != SNAPSHOT_MAGIC_LEN ||
+		memcmp(magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) != 0)
+	{
+		close(fd);
+		return SNAPSHOT_NOT_SNAPSHOT;
+	}
+	size_t len = (size_t) fileStat.st_size;
+	if (len < sizeof(SnapshotHeader))
+	{
+		close(fd);
+		return SNAPSHOT_INVALID;
+	}
+	void *data = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping stays valid after closing the file
+	if (data == MAP_FAILED)
+	{
+		return SNAPSHOT_FAILED;
+	}
+	madvise(data, len, MADV_WILLNEED); // the checksum reads all of it, start reading ahead
+	if (checkSnapshot((const char *) data, len, kind) != SNAPSHOT_SUCCESS)
+	{
+		munmap(data, len);
+		return SNAPSHOT_INVALID;
+	}
+	SnapshotHeader header;
+	memcpy(&header, data, sizeof(SnapshotHeader));
+	Snapshot opened = {0};
+	opened.data = (char *) data;
+	opened.len = len;
+	opened.kind = kind;
+	opened.count = (size_t) header.count;
+	opened.extraCount = (size_t) header.extraCount;
+	placeColumns(&opened);
+	*snapshot = opened;
+	COUNT_BYTES_READ(len);
+	return SNAPSHOT_SUCCESS;
+}
+
+int createSnapshot(const char *path, unsigned int kind, size_t count, size_t extraCount,
+                   Snapshot *snapshot)
+{
+	size_t offsets[MAX_COLUMNS];
+	size_t len = layoutSnapshot(kind, count, extraCount, offsets);
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, SNAPSHOT_FILE_MODE);
+	if (fd < 0)
+	{
+		return SNAPSHOT_OPEN_FAILED;
+	}
+	if (posix_fallocate(fd, 0, (off_t) len) != 0)
+	{
+		close(fd);
+		return SNAPSHOT_FAILED;
+	}
+	void *data = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		return SNAPSHOT_FAILED;
+	}
+	Snapshot created = {0};
+	created.data = (char *) data;
+	created.len = len;
+	created.kind = kind;
+	created.count = count;
+	created.extraCount = extraCount;
+	placeColumns(&created);
+	*snapshot = created;
+	return SNAPSHOT_SUCCESS;
+}
+
+int finishSnapshot(Snapshot *snapshot)
+{
+	SnapshotHeader header = {0};
+	memcpy(header.magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN);
+	header.version = SNAPSHOT_VERSION;
+	header.kind = snapshot->kind;
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.sizeOfId = sizeof(size_t);
+	header.count = snapshot->count;
+	header.extraCount = snapshot->extraCount;
+	header.fileSize = snapshot->len;
+	header.checksum = checksumOf(snapshot->data + sizeof(SnapshotHeader),
+	                             snapshot->len - sizeof(SnapshotHeader));
+	memcpy(snapshot->data, &header, sizeof(SnapshotHeader));
+	int status = msync(snapshot->data, snapshot->len, MS_SYNC) == 0 ? SNAPSHOT_SUCCESS :
+	             SNAPSHOT_FAILED;
+	COUNT_BYTES_WRITTEN(snapshot->len);
+	closeSnapshot(snapshot);
+	return status;
+}
+
+void closeSnapshot(Snapshot *snapshot)
+{
+	if (snapshot->data != NULL)
+	{
+		munmap(snapshot->data, snapshot->len);
+	}
+	Snapshot empty = {0};
+	*snapshot = empty;
+}
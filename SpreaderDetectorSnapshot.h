@@ -0,0 +1,143 @@
+/**
+* @file SpreaderDetectorSnapshot.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief A binary snapshot of the people file or of the meeting file, that is loaded without
+* parsing
+* @section DESCRIPTION
+* A snapshot is a header (magic, version, kind, counts, size and checksum) and then the columns,
+* every one of them starting at a multiple of 8 bytes:
+* - people: the IDs, the ages, the probabilities and the lengths of the names (one of each for every
+*   person), and then all the names one after the other (not '\0' terminated).
+* - meetings: the IDs of the seeds (the first line of the meeting file), and then the meetings as
+*   MeetingInfo records.
+* The numbers are kept exactly as they are in memory (the byte order and the size of size_t of the
+* machine are in the header, and a snapshot of another machine is rejected). So loading a snapshot
+* is mapping it into memory and checking its checksum: the columns are used in place. The mapping
+* is private, so the columns can be changed (the probabilities, or the order of the rows) without
+* changing the file.
+*/
+
+#ifndef EXAM_SPREADERDETECTORSNAPSHOT_H
+#define EXAM_SPREADERDETECTORSNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @def SNAPSHOT_SUCCESS 0
+ * @brief Returned by the functions of the snapshots when they succeeded
+ */
+#define SNAPSHOT_SUCCESS 0
+
+/**
+ * @def SNAPSHOT_OPEN_FAILED 1
+ * @brief The file could not be opened (or created) at all
+ */
+#define SNAPSHOT_OPEN_FAILED 1
+
+/**
+ * @def SNAPSHOT_NOT_SNAPSHOT 2
+ * @brief The file is not a snapshot (it does not start with the magic, or it is not a regular
+ * file). It should be read as a text file
+ */
+#define SNAPSHOT_NOT_SNAPSHOT 2
+
+/**
+ * @def SNAPSHOT_INVALID 3
+ * @brief The file starts with the magic but it can not be used: another version or kind, another
+ * machine, a wrong size or a wrong checksum
+ */
+#define SNAPSHOT_INVALID 3
+
+/**
+ * @def SNAPSHOT_FAILED 4
+ * @brief Mapping or writing the snapshot failed (a standard library error)
+ */
+#define SNAPSHOT_FAILED 4
+
+/**
+ * @def SNAPSHOT_PEOPLE 1
+ * @brief The kind of a snapshot of the people file
+ */
+#define SNAPSHOT_PEOPLE 1
+
+/**
+ * @def SNAPSHOT_MEETINGS 2
+ * @brief The kind of a snapshot of the meeting file
+ */
+#define SNAPSHOT_MEETINGS 2
+
+/**
+ * @struct MeetingInfo
+ * @brief Represents a meeting between two people received in the second input file. A snapshot
+ * of the meetings keeps exactly these records
+ */
+typedef struct MeetingInfo
+{
+	size_t infectorId;
+	size_t infectedId;
+	float distance;
+	float time;
+} MeetingInfo;
+
+/**
+ * @struct Snapshot
+ * @brief A snapshot mapped into memory. count is the number of people (or of meetings) and
+ * extraCount the number of bytes of all the names (or the number of seeds). Only the columns of
+ * its kind point into the mapping, the others are NULL. A snapshot initialized to {0} is empty
+ */
+typedef struct Snapshot
+{
+	char *data;
+	size_t len;
+	unsigned int kind;
+	size_t count;
+	size_t extraCount;
+	size_t *ids;
+	float *ages;
+	float *probs;
+	unsigned int *nameLengths;
+	char *names;
+	size_t *seeds;
+	MeetingInfo *meetings;
+} Snapshot;
+
+/**
+ * Maps a snapshot (privately: changing the columns does not change the file) and checks it
+ * @param path The path of the file
+ * @param kind SNAPSHOT_PEOPLE or SNAPSHOT_MEETINGS
+ * @param snapshot The snapshot (empty). Stays empty unless SNAPSHOT_SUCCESS is returned
+ * @return SNAPSHOT_SUCCESS, SNAPSHOT_OPEN_FAILED, SNAPSHOT_NOT_SNAPSHOT (a text file, or a pipe)
+ * or SNAPSHOT_INVALID
+ */
+int openSnapshot(const char *path, unsigned int kind, Snapshot *snapshot);
+
+/**
+ * Creates a new snapshot file in its final size and maps it, so the caller can fill its columns.
+ * The snapshot is valid only after finishSnapshot
+ * @param path The path of the file (an existing file is replaced)
+ * @param kind SNAPSHOT_PEOPLE or SNAPSHOT_MEETINGS
+ * @param count The number of people (or of meetings)
+ * @param extraCount The number of bytes of all the names (or the number of seeds)
+ * @param snapshot The snapshot (empty)
+ * @return SNAPSHOT_SUCCESS, SNAPSHOT_OPEN_FAILED or SNAPSHOT_FAILED
+ */
+int createSnapshot(const char *path, unsigned int kind, size_t count, size_t extraCount,
+                   Snapshot *snapshot);
+
+/**
+ * Computes the checksum of a snapshot that was filled after createSnapshot, writes its header and
+ * closes it
+ * @param snapshot The snapshot
+ * @return SNAPSHOT_SUCCESS or SNAPSHOT_FAILED
+ */
+int finishSnapshot(Snapshot *snapshot);
+
+/**
+ * Unmaps a snapshot. And turns it into an empty snapshot
+ * @param snapshot The snapshot
+ */
+void closeSnapshot(Snapshot *snapshot);
+
+#endif //EXAM_SPREADERDETECTORSNAPSHOT_H
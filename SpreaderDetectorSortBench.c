@@ -0,0 +1,209 @@
+/**
+* @file SpreaderDetectorSortBench.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief A benchmark of the sort of the output: q-sort, and sortByProbability with 1..N threads
+* @section DESCRIPTION
+* Usage: sort_bench [number of people] [maximal number of threads] [number of rounds]
+* Random keys (unique IDs, and probabilities like the ones of a propagation: most people are not
+* exposed at all, some are a little and a few a lot) are sorted by q-sort with cmpFuncProb, and by
+* sortByProbability (the radix sort, unless built with SPREADER_QSORT_PROB_ORDER) with 1, 2, 4 ..
+* threads (and the maximal number, by default the number of cores). For every one of them the best
+* round is printed, with the speedup over q-sort, and the order is compared to the one of q-sort
+* (it must be exactly the same, including the ties).
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "SpreaderDetectorOrder.h"
+#include "SpreaderDetectorParams.h"
+#include "SpreaderDetectorPolicy.h"
+#include "SpreaderDetectorStats.h"
+
+/**
+ * @def DEFAULT_NUM_OF_PEOPLE 10000000
+ * @brief The number of people when it is not given
+ */
+#define DEFAULT_NUM_OF_PEOPLE 10000000
+
+/**
+ * @def DEFAULT_NUM_OF_ROUNDS 3
+ * @brief The number of rounds when it is not given (the best one is printed)
+ */
+#define DEFAULT_NUM_OF_ROUNDS 3
+
+/**
+ * @def RANDOM_SEED 12345
+ * @brief The seed of the random probabilities (the same keys in every run)
+ */
+#define RANDOM_SEED 12345
+
+/**
+ * @def NOT_EXPOSED_PERCENT 70
+ * @brief The percent of the people whose probability is 0
+ */
+#define NOT_EXPOSED_PERCENT 70
+
+/**
+ * @def LOW_EXPOSURE_PERCENT 20
+ * @brief The percent of the people whose probability is below LOW_EXPOSURE (the rest are above)
+ */
+#define LOW_EXPOSURE_PERCENT 20
+
+/**
+ * @def LOW_EXPOSURE 0.3f
+ * @brief The highest probability of a little exposed person
+ */
+#define LOW_EXPOSURE 0.3f
+
+/**
+ * @def PERCENT 100
+ * @brief The whole of a percent
+ */
+#define PERCENT 100
+
+/**
+ * Returns a random float in [low, high]
+ * @param low The lowest value
+ * @param high The highest value
+ * @return The float
+ */
+static float randomIn(float low, float high)
+{
+	return low + (high - low) * ((float) rand() / (float) RAND_MAX);
+}
+
+/**
+ * Mixes the bits of a number (the finalizer of splitmix64). Different numbers give different
+ * results, so the IDs are unique and look random
+ * @param x The number
+ * @return The mixed number
+ */
+static uint64_t mixBits(uint64_t x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/**
+ * Is the order of the sorted keys the expected one
+ * @param keys The sorted keys
+ * @param expected The keys sorted by q-sort
+ * @param len The number of keys
+ * @return 1 if it is, 0 otherwise
+ */
+static int isSameOrder(const ProbSortKey *keys, const ProbSortKey *expected, size_t len)
+{
+	for (size_t i = 0; i < len; ++i)
+	{
+		if (keys[i].id != expected[i].id || keys[i].row != expected[i].row)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Prints a line of the benchmark
+ * @param name The name of the sort
+ * @param seconds The seconds of the best round
+ * @param qsortSeconds The seconds of q-sort
+ * @param isExact Whether the order is the expected one
+ */
+static void printResult(const char *name, double seconds, double qsortSeconds, int isExact)
+{
+	printf("%-12s %8.3f s %6.2fx %s\n", name, seconds, qsortSeconds / seconds,
+	       isExact ? "exact" : "MISMATCH");
+}
+
+int main(int argc, char *argv[])
+{
+	long onlineCores = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t numOfPeople = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_NUM_OF_PEOPLE;
+	size_t maxThreads = argc > 2 ? strtoul(argv[2], NULL, 10) :
+	                    (onlineCores > 0 ? (size_t) onlineCores : 1);
+	size_t numOfRounds = argc > 3 ? strtoul(argv[3], NULL, 10) : DEFAULT_NUM_OF_ROUNDS;
+	if (numOfPeople == 0 || maxThreads == 0 || numOfRounds == 0)
+	{
+		fprintf(stderr, "Usage: sort_bench [number of people] [maximal number of threads] "
+		                "[number of rounds]\n");
+		return EXIT_FAILURE;
+	}
+	ProbSortKey *unsorted = (ProbSortKey *) malloc(numOfPeople * sizeof(ProbSortKey));
+	ProbSortKey *expected = (ProbSortKey *) malloc(numOfPeople * sizeof(ProbSortKey));
+	ProbSortKey *keys = (ProbSortKey *) malloc(numOfPeople * sizeof(ProbSortKey));
+	if (unsorted == NULL || expected == NULL || keys == NULL)
+	{
+		fprintf(stderr, STANDARD_LIB_ERR_MSG);
+		free(unsorted);
+		free(expected);
+		free(keys);
+		return EXIT_FAILURE;
+	}
+	RiskPolicy policy; // the default one: the class does not depend on the age
+	initDefaultPolicy(&policy);
+	srand(RANDOM_SEED);
+	for (size_t row = 0; row < numOfPeople; ++row)
+	{
+		int percent = rand() % PERCENT;
+		unsorted[row].id = (size_t) mixBits(row + 1);
+		unsorted[row].row = row;
+		unsorted[row].probInfected = percent < NOT_EXPOSED_PERCENT ? 0.0f :
+		                             percent < NOT_EXPOSED_PERCENT + LOW_EXPOSURE_PERCENT ?
+		                             randomIn(0.0f, LOW_EXPOSURE) : randomIn(LOW_EXPOSURE, 1.0f);
+		unsorted[row].riskClass = classOfPerson(&policy, 0.0f, unsorted[row].probInfected);
+	}
+	printf("people: %zu, rounds: %zu, maximal threads: %zu\n", numOfPeople, numOfRounds,
+	       maxThreads);
+	double qsortSeconds = 0;
+	for (size_t round = 0; round < numOfRounds; ++round)
+	{
+		memcpy(expected, unsorted, numOfPeople * sizeof(ProbSortKey));
+		double begin = currentSeconds();
+		qsort(expected, numOfPeople, sizeof(ProbSortKey), cmpFuncProb);
+		double seconds = currentSeconds() - begin;
+		qsortSeconds = round == 0 || seconds < qsortSeconds ? seconds : qsortSeconds;
+	}
+	printResult("qsort", qsortSeconds, qsortSeconds, 1);
+	int status = EXIT_SUCCESS;
+	for (size_t numOfThreads = 1; numOfThreads <= maxThreads && status == EXIT_SUCCESS;
+	     numOfThreads = numOfThreads < maxThreads && numOfThreads * 2 > maxThreads ?
+	                    maxThreads : numOfThreads * 2)
+	{
+		double best = 0;
+		for (size_t round = 0; round < numOfRounds; ++round)
+		{
+			memcpy(keys, unsorted, numOfPeople * sizeof(ProbSortKey));
+			double begin = currentSeconds();
+			if (sortByProbability(keys, numOfPeople, numOfThreads) == ORDER_FAILED)
+			{
+				fprintf(stderr, STANDARD_LIB_ERR_MSG);
+				status = EXIT_FAILURE;
+				break;
+			}
+			double seconds = currentSeconds() - begin;
+			best = round == 0 || seconds < best ? seconds : best;
+		}
+		if (status == EXIT_SUCCESS)
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "%zu threads", numOfThreads);
+			int isExact = isSameOrder(keys, expected, numOfPeople);
+			printResult(name, best, qsortSeconds, isExact);
+			status = isExact ? status : EXIT_FAILURE;
+		}
+		if (numOfThreads == maxThreads)
+		{
+			break;
+		}
+	}
+	free(unsorted);
+	free(expected);
+	free(keys);
+	return status;
+}
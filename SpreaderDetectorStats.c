@@ -0,0 +1,225 @@
+/**
+* @file SpreaderDetectorStats.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the measurements of the phases
+* @section DESCRIPTION
+* Every hardware counter is opened on its own (so a counter the CPU or the kernel does not have
+* does not take the others with it), counts only user space (which is allowed with the default
+* perf_event_paranoid), and is inherited by the threads created after it was opened. The counts of
+* a thread are added to its counter when the thread ends, and every phase joins its threads before
+* it ends, so the counts of a phase include all its threads. Phases are begun and ended only by the
+* main thread, the bytes may be counted by any thread.
+*/
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+#include "SpreaderDetectorStats.h"
+#include "SpreaderDetectorArena.h"
+
+double currentSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) now.tv_sec + (double) now.tv_nsec / NANOS_IN_SECOND;
+}
+
+#ifndef NO_PHASE_STATS
+
+/**
+ * @def NUM_OF_COUNTERS 4
+ * @brief Cycles, instructions, cache misses and branch misses
+ */
+#define NUM_OF_COUNTERS 4
+
+/**
+ * @def NO_COUNTER -1
+ * @brief The file descriptor of a counter that could not be opened
+ */
+#define NO_COUNTER -1
+
+/**
+ * @struct PhaseStats
+ * @brief What was measured in one phase: the number of times it ran, its seconds, its counters and
+ * the peak RSS of the process at its end, and the values at the beginning of the current run of
+ * the phase
+ */
+typedef struct PhaseStats
+{
+	size_t numOfRuns;
+	double seconds;
+	long peakRssKb;
+	uint64_t counters[NUM_OF_COUNTERS];
+	double beginSeconds;
+	uint64_t beginCounters[NUM_OF_COUNTERS];
+} PhaseStats;
+
+/**
+ * The names of the phases in the report (by the PHASE_ constants)
+ */
+static const char *const phaseNames[NUM_OF_PHASES] = {"load_people", "id_index", "read_meetings",
+                                                      "propagate", "sort_by_probability",
+                                                      "output", "incremental", "write_snapshots",
+                                                      "validate"};
+
+/**
+ * The names of the counters in the report
+ */
+static const char *const counterNames[NUM_OF_COUNTERS] = {"cycles", "instructions",
+                                                          "cache_misses", "branch_misses"};
+
+/**
+ * The state of the measurements
+ */
+static int isEnabled;
+static double runBeginSeconds;
+static int counterFds[NUM_OF_COUNTERS] = {NO_COUNTER, NO_COUNTER, NO_COUNTER, NO_COUNTER};
+static PhaseStats phases[NUM_OF_PHASES];
+static atomic_size_t bytesRead;
+static atomic_size_t bytesWritten;
+
+/**
+ * Opens one hardware counter of the process (user space only, inherited by new threads)
+ * @param config The PERF_COUNT_HW_ constant
+ * @return The file descriptor, or NO_COUNTER
+ */
+static int openCounter(uint64_t config)
+{
+#ifdef __linux__
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.inherit = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	return fd < 0 ? NO_COUNTER : (int) fd;
+#else
+	(void) config;
+	return NO_COUNTER;
+#endif
+}
+
+/**
+ * Reads the current values of the counters (0 for a counter that is not open or failed to read)
+ * @param values Will contain NUM_OF_COUNTERS values
+ */
+static void readCounters(uint64_t *values)
+{
+	for (size_t i = 0; i < NUM_OF_COUNTERS; ++i)
+	{
+		values[i] = 0;
+		if (counterFds[i] != NO_COUNTER &&
+		    read(counterFds[i], &values[i], sizeof(values[i])) != (ssize_t) sizeof(values[i]))
+		{
+			values[i] = 0;
+		}
+	}
+}
+
+void enablePhaseStats(void)
+{
+#ifdef __linux__
+	const uint64_t configs[NUM_OF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES,
+	                                           PERF_COUNT_HW_INSTRUCTIONS,
+	                                           PERF_COUNT_HW_CACHE_MISSES,
+	                                           PERF_COUNT_HW_BRANCH_MISSES};
+	for (size_t i = 0; i < NUM_OF_COUNTERS; ++i)
+	{
+		counterFds[i] = openCounter(configs[i]);
+	}
+#endif
+	runBeginSeconds = currentSeconds();
+	isEnabled = 1;
+}
+
+void beginPhase(int phase)
+{
+	if (!isEnabled)
+	{
+		return;
+	}
+	readCounters(phases[phase].beginCounters);
+	phases[phase].beginSeconds = currentSeconds();
+}
+
+void endPhase(int phase)
+{
+	if (!isEnabled)
+	{
+		return;
+	}
+	PhaseStats *stats = &phases[phase];
+	stats->seconds += currentSeconds() - stats->beginSeconds;
+	uint64_t endCounters[NUM_OF_COUNTERS];
+	readCounters(endCounters);
+	for (size_t i = 0; i < NUM_OF_COUNTERS; ++i)
+	{
+		stats->counters[i] += endCounters[i] - stats->beginCounters[i];
+	}
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0 && usage.ru_maxrss > stats->peakRssKb)
+	{
+		stats->peakRssKb = usage.ru_maxrss; // in KB on Linux
+	}
+	stats->numOfRuns++;
+}
+
+void countBytesRead(size_t numOfBytes)
+{
+	if (isEnabled)
+	{
+		atomic_fetch_add_explicit(&bytesRead, numOfBytes, memory_order_relaxed);
+	}
+}
+
+void countBytesWritten(size_t numOfBytes)
+{
+	if (isEnabled)
+	{
+		atomic_fetch_add_explicit(&bytesWritten, numOfBytes, memory_order_relaxed);
+	}
+}
+
+void writeStatsReport(FILE *out)
+{
+	AllocationStats allocations;
+	getAllocationStats(&allocations);
+	fprintf(out, "{\"seconds\": %.6f, \"phases\": [", currentSeconds() - runBeginSeconds);
+	for (size_t phase = 0; phase < NUM_OF_PHASES; ++phase)
+	{
+		const PhaseStats *stats = &phases[phase];
+		fprintf(out, "%s{\"name\": \"%s\", \"runs\": %zu, \"seconds\": %.6f, \"peak_rss_kb\": %ld",
+		        phase ? ", " : "", phaseNames[phase], stats->numOfRuns, stats->seconds,
+		        stats->peakRssKb);
+		for (size_t i = 0; i < NUM_OF_COUNTERS; ++i)
+		{
+			if (counterFds[i] == NO_COUNTER)
+			{
+				fprintf(out, ", \"%s\": null", counterNames[i]);
+			}
+			else
+			{
+				fprintf(out, ", \"%s\": %llu", counterNames[i],
+				        (unsigned long long) stats->counters[i]);
+			}
+		}
+		fprintf(out, "}");
+	}
+	fprintf(out, "], \"allocations\": %zu, \"frees\": %zu, \"peak_heap_bytes\": %zu, "
+	             "\"bytes_read\": %zu, \"bytes_written\": %zu}\n", allocations.numOfAllocations,
+	        allocations.numOfFrees, allocations.peakBytesInUse, atomic_load(&bytesRead),
+	        atomic_load(&bytesWritten));
+}
+
+#endif //NO_PHASE_STATS
@@ -0,0 +1,155 @@
+/**
+* @file SpreaderDetectorStats.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Measures the phases of a run (time and hardware counters) and reports them as JSON
+* @section DESCRIPTION
+* Every phase of the run (loading the people, the ID index, reading the meetings, the propagation,
+* the sort by probability and the output) is wrapped with PHASE_BEGIN and PHASE_END. When the
+* report was asked for ("--stats") every phase adds its time on a monotonic clock and, where the
+* kernel allows perf_event_open, the cycles, instructions, cache misses and branch misses of the
+* process (the threads of the phase included). The bytes of the input files that were read and of
+* the files that were written are counted as well, and the allocations come from
+* SpreaderDetectorArena.h.
+* Building with the CMake option SPREADER_NO_PHASE_STATS (NO_PHASE_STATS) turns every macro into
+* nothing, so the layer costs nothing at all (and "--stats" is not an option). The monotonic clock
+* (currentSeconds) is there in every build, for the timings of the modes and of the benches.
+*/
+
+#ifndef EXAM_SPREADERDETECTORSTATS_H
+#define EXAM_SPREADERDETECTORSTATS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @def PHASE_LOAD_PEOPLE 0
+ * @brief Reading the people file into the table (or the spilled runs in the streaming mode)
+ */
+#define PHASE_LOAD_PEOPLE 0
+
+/**
+ * @def PHASE_ID_INDEX 1
+ * @brief Building the index from ID to row (with the sort by ID when it is a sorted index)
+ */
+#define PHASE_ID_INDEX 1
+
+/**
+ * @def PHASE_READ_MEETINGS 2
+ * @brief Reading the meeting file into the graph
+ */
+#define PHASE_READ_MEETINGS 2
+
+/**
+ * @def PHASE_PROPAGATE 3
+ * @brief Propagating the risk over the graph
+ */
+#define PHASE_PROPAGATE 3
+
+/**
+ * @def PHASE_SORT_BY_PROB 4
+ * @brief Sorting the people by the probability of infection
+ */
+#define PHASE_SORT_BY_PROB 4
+
+/**
+ * @def PHASE_OUTPUT 5
+ * @brief Writing the output file (the merge of the runs in the streaming mode)
+ */
+#define PHASE_OUTPUT 5
+
+/**
+ * @def PHASE_INCREMENTAL 6
+ * @brief Applying the batches of new meetings ("--deltas=")
+ */
+#define PHASE_INCREMENTAL 6
+
+/**
+ * @def PHASE_WRITE_SNAPSHOTS 7
+ * @brief Converting the input files into snapshots ("--write-snapshot=")
+ */
+#define PHASE_WRITE_SNAPSHOTS 7
+
+/**
+ * @def PHASE_VALIDATE 8
+ * @brief Checking the input files ("--validate")
+ */
+#define PHASE_VALIDATE 8
+
+/**
+ * @def NUM_OF_PHASES 9
+ * @brief The number of phases
+ */
+#define NUM_OF_PHASES 9
+
+/**
+ * @def NANOS_IN_SECOND 1e9
+ * @brief Nanoseconds in a second
+ */
+#define NANOS_IN_SECOND 1e9
+
+/**
+ * Returns the time of a monotonic clock
+ * @return The time in seconds
+ */
+double currentSeconds(void);
+
+#ifndef NO_PHASE_STATS
+
+/**
+ * Starts measuring (the clock of the whole run starts here, and the hardware counters are opened
+ * if the kernel allows it). Until it is called the other functions do nothing
+ */
+void enablePhaseStats(void);
+
+/**
+ * Starts a phase
+ * @param phase One of the PHASE_ constants
+ */
+void beginPhase(int phase);
+
+/**
+ * Ends a phase: adds its time and its counters to the phase
+ * @param phase The phase given to beginPhase
+ */
+void endPhase(int phase);
+
+/**
+ * Counts bytes that were read from a file
+ * @param numOfBytes The number of bytes
+ */
+void countBytesRead(size_t numOfBytes);
+
+/**
+ * Counts bytes that were written to a file
+ * @param numOfBytes The number of bytes
+ */
+void countBytesWritten(size_t numOfBytes);
+
+/**
+ * Writes the report as one JSON object: the seconds of the run, every phase (the number of times
+ * it ran, its seconds, the peak RSS of the process at its end and its counters, null where a
+ * counter could not be opened), the allocations and the bytes read and written
+ * @param out The stream
+ */
+void writeStatsReport(FILE *out);
+
+#define STATS_ENABLE() enablePhaseStats()
+#define PHASE_BEGIN(phase) beginPhase(phase)
+#define PHASE_END(phase) endPhase(phase)
+#define COUNT_BYTES_READ(numOfBytes) countBytesRead(numOfBytes)
+#define COUNT_BYTES_WRITTEN(numOfBytes) countBytesWritten(numOfBytes)
+#define WRITE_STATS_REPORT(out) writeStatsReport(out)
+
+#else
+
+#define STATS_ENABLE() ((void) 0)
+#define PHASE_BEGIN(phase) ((void) 0)
+#define PHASE_END(phase) ((void) 0)
+#define COUNT_BYTES_READ(numOfBytes) ((void) 0)
+#define COUNT_BYTES_WRITTEN(numOfBytes) ((void) 0)
+#define WRITE_STATS_REPORT(out) ((void) 0)
+
+#endif //NO_PHASE_STATS
+
+#endif //EXAM_SPREADERDETECTORSTATS_H
@@ -0,0 +1,593 @@
+/**
+* @file SpreaderDetectorStreaming.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the map of probabilities, the sorted runs and their k-way merge
+* @section DESCRIPTION
+* A sorted run is a temporary file (tmpfile, deleted automatically) of records, one after the
+* other: probability (float), ID (size_t), length of the name (unsigned int) and the name.
+* If there are more runs than MAX_MERGE_FAN_IN, groups of runs are first merged into longer runs,
+* so we never keep more than MAX_MERGE_FAN_IN files open in one merge.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SpreaderDetectorStreaming.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorStats.h"
+
+/**
+ * @def NOT_INFECTED_PROB 0.0f
+ * @brief The probability of a person who does not appear in the meeting file (INIT_PROB)
+ */
+#define NOT_INFECTED_PROB 0.0f
+
+/**
+ * @def EMPTY_SLOT SIZE_MAX
+ * @brief The vertex of an empty slot of the map
+ */
+#define EMPTY_SLOT SIZE_MAX
+
+/**
+ * @def MIN_PROB_SLOTS 1024
+ * @brief The number of slots of the map of probabilities when the first person is added
+ */
+#define MIN_PROB_SLOTS 1024
+
+/**
+ * @def PROB_MAP_GROWTH_FACTOR 2
+ * @brief When the map is half full the number of slots is doubled
+ */
+#define PROB_MAP_GROWTH_FACTOR 2
+
+/**
+ * @def FIBONACCI_MULTIPLIER 0x9E3779B97F4A7C15ull
+ * @brief 2^64 / golden ratio (Fibonacci hashing, see SpreaderDetectorIdIndex.c)
+ */
+#define FIBONACCI_MULTIPLIER 0x9E3779B97F4A7C15ull
+
+/**
+ * @def MAX_MERGE_FAN_IN 256
+ * @brief The maximal number of runs that are merged at once
+ */
+#define MAX_MERGE_FAN_IN 256
+
+/**
+ * @def INIT_RUNS_CAPACITY 16
+ * @brief The number of runs the list of runs can hold before the first growth (doubles from there)
+ */
+#define INIT_RUNS_CAPACITY 16
+
+/**
+ * @def LEFT_BEFOR_RIGHT -1
+ * @brief In the comparison functions -1 will indicate that the left record comes first
+ */
+#define LEFT_BEFOR_RIGHT -1
+
+/**
+ * @def READ_RECORD 1
+ * @brief readRecord read a record
+ */
+#define READ_RECORD 1
+
+/**
+ * @def END_OF_RUN 0
+ * @brief readRecord got to the end of the run
+ */
+#define END_OF_RUN 0
+
+/**
+ * @def READ_ERROR -1
+ * @brief readRecord failed (the run is broken)
+ */
+#define READ_ERROR -1
+
+/**
+ * @struct RunReader
+ * @brief One run in the middle of a merge: the file, and the record at its head
+ */
+typedef struct RunReader
+{
+	FILE *file;
+	PersonRecord head;
+	char *nameBuffer;
+} RunReader;
+
+/**
+ * Returns the first slot to look at for an ID
+ * @param id The ID
+ * @param numOfSlots The number of slots (a power of two)
+ * @return The slot
+ */
+static size_t probSlotOfId(size_t id, size_t numOfSlots)
+{
+	return (size_t) (((uint64_t) id * FIBONACCI_MULTIPLIER) >> 32) & (numOfSlots - 1);
+}
+
+/**
+ * Compares two records: by class (the more risky first), then by probability from the largest to
+ * the smallest, then by ID from the smallest to the largest (exactly the order of cmpFuncProb)
+ * @return -1 if the left record comes first, 1 if the right one and 0 if equal
+ */
+static int compareRecords(unsigned int leftClass, float leftProb, size_t leftId,
+                          unsigned int rightClass, float rightProb, size_t rightId)
+{
+	if (leftClass != rightClass)
+	{
+		return leftClass < rightClass ? LEFT_BEFOR_RIGHT : 1;
+	}
+	if (leftProb > rightProb)
+	{
+		return LEFT_BEFOR_RIGHT;
+	}
+	if (leftProb < rightProb)
+	{
+		return 1;
+	}
+	if (leftId < rightId)
+	{
+		return LEFT_BEFOR_RIGHT;
+	}
+	return leftId > rightId;
+}
+
+/**
+ * A comparison function to q-sort of the keys in the buffer of the spiller
+ */
+static int cmpFuncRecordKey(const void *first, const void *sec)
+{
+	const RecordKey *left = (const RecordKey *) first;
+	const RecordKey *right = (const RecordKey *) sec;
+	return compareRecords(left->riskClass, left->probInfected, left->id, right->riskClass,
+	                      right->probInfected, right->id);
+}
+
+/**
+ * Moves the map into a new array of slots (twice as many)
+ * @param map The map
+ * @return STREAM_SUCCESS or STREAM_FAILED
+ */
+static int growProbMap(ProbMap *map)
+{
+	size_t numOfSlots = map->numOfSlots ? map->numOfSlots * PROB_MAP_GROWTH_FACTOR :
+	                    MIN_PROB_SLOTS;
+	ProbSlot *slots = (ProbSlot *) trackedMalloc(numOfSlots * sizeof(ProbSlot));
+	if (slots == NULL)
+	{
+		return STREAM_FAILED;
+	}
+	for (size_t i = 0; i < numOfSlots; ++i)
+	{
+		slots[i].node = EMPTY_SLOT;
+	}
+	for (size_t i = 0; i < map->numOfSlots; ++i)
+	{
+		if (map->slots[i].node != EMPTY_SLOT)
+		{
+			size_t slot = probSlotOfId(map->slots[i].id, numOfSlots);
+			while (slots[slot].node != EMPTY_SLOT)
+			{
+				slot = (slot + 1) & (numOfSlots - 1);
+			}
+			slots[slot] = map->slots[i];
+		}
+	}
+	trackedFree(map->slots, map->numOfSlots * sizeof(ProbSlot));
+	map->slots = slots;
+	map->numOfSlots = numOfSlots;
+	return STREAM_SUCCESS;
+}
+
+size_t nodeOfId(ProbMap *map, size_t id)
+{
+	if ((map->len + 1) * PROB_MAP_GROWTH_FACTOR > map->numOfSlots && growProbMap(map) ==
+	                                                                  STREAM_FAILED)
+	{
+		return NODE_FAILED;
+	}
+	size_t slot = probSlotOfId(id, map->numOfSlots);
+	while (map->slots[slot].node != EMPTY_SLOT)
+	{
+		if (map->slots[slot].id == id)
+		{
+			return map->slots[slot].node;
+		}
+		slot = (slot + 1) & (map->numOfSlots - 1);
+	}
+	map->slots[slot].id = id;
+	map->slots[slot].node = map->len;
+	return map->len++;
+}
+
+float *allocateNodeProbs(ProbMap *map)
+{
+	map->ids = (size_t *) trackedMalloc(map->len * sizeof(size_t));
+	map->probs = (float *) trackedMalloc(map->len * sizeof(float));
+	map->isMatched = (unsigned char *) trackedCalloc(map->len, sizeof(unsigned char));
+	if (map->ids == NULL || map->probs == NULL || map->isMatched == NULL)
+	{
+		return NULL; // all are released with the map
+	}
+	for (size_t i = 0; i < map->numOfSlots; ++i)
+	{
+		if (map->slots[i].node != EMPTY_SLOT)
+		{
+			map->ids[map->slots[i].node] = map->slots[i].id;
+		}
+	}
+	map->numOfMatched = 0;
+	return map->probs;
+}
+
+float matchProb(ProbMap *map, size_t id)
+{
+	if (map->numOfSlots == 0)
+	{
+		return NOT_INFECTED_PROB;
+	}
+	size_t slot = probSlotOfId(id, map->numOfSlots);
+	while (map->slots[slot].node != EMPTY_SLOT)
+	{
+		if (map->slots[slot].id == id)
+		{
+			size_t node = map->slots[slot].node;
+			if (map->isMatched[node]) // a repeated ID
+			{
+				return NOT_INFECTED_PROB;
+			}
+			map->isMatched[node] = 1;
+			map->numOfMatched++;
+			return map->probs[node];
+		}
+		slot = (slot + 1) & (map->numOfSlots - 1);
+	}
+	return NOT_INFECTED_PROB;
+}
+
+int isEveryNodeMatched(const ProbMap *map)
+{
+	return map->numOfMatched == map->len;
+}
+
+void freeProbMap(ProbMap *map)
+{
+	trackedFree(map->slots, map->numOfSlots * sizeof(ProbSlot));
+	trackedFree(map->ids, map->len * sizeof(size_t));
+	trackedFree(map->probs, map->len * sizeof(float));
+	trackedFree(map->isMatched, map->len * sizeof(unsigned char));
+	map->slots = NULL;
+	map->ids = NULL;
+	map->probs = NULL;
+	map->isMatched = NULL;
+	map->numOfMatched = 0;
+	map->numOfSlots = 0;
+	map->len = 0;
+}
+
+int initSpiller(RunSpiller *spiller, size_t budget)
+{
+	budget = budget < MIN_RECORDS_BUFFER_SIZE ? MIN_RECORDS_BUFFER_SIZE : budget;
+	spiller->buffer = (char *) trackedMalloc(budget);
+	if (spiller->buffer == NULL)
+	{
+		return STREAM_FAILED;
+	}
+	spiller->budget = budget;
+	spiller->numOfKeys = 0;
+	spiller->namesBegin = budget;
+	spiller->maxNameLen = 0;
+	return STREAM_SUCCESS;
+}
+
+int writeRecordToRun(const PersonRecord *record, void *context)
+{
+	FILE *run = (FILE *) context;
+	if (fwrite(&record->probInfected, sizeof(float), 1, run) != 1 ||
+		fwrite(&record->id, sizeof(size_t), 1, run) != 1 ||
+		fwrite(&record->nameLen, sizeof(unsigned int), 1, run) != 1 ||
+		fwrite(&record->riskClass, sizeof(unsigned int), 1, run) != 1 ||
+		fwrite(record->name, 1, record->nameLen, run) != record->nameLen)
+	{
+		return STREAM_FAILED;
+	}
+	COUNT_BYTES_WRITTEN(sizeof(float) + sizeof(size_t) + 2 * sizeof(unsigned int) +
+	                    record->nameLen);
+	return STREAM_SUCCESS;
+}
+
+/**
+ * Reads the next record of a run
+ * @param reader The run
+ * @return READ_RECORD, END_OF_RUN or READ_ERROR
+ */
+static int readRecord(RunReader *reader)
+{
+	PersonRecord *record = &reader->head;
+	if (fread(&record->probInfected, sizeof(float), 1, reader->file) != 1)
+	{
+		return feof(reader->file) ? END_OF_RUN : READ_ERROR;
+	}
+	if (fread(&record->id, sizeof(size_t), 1, reader->file) != 1 ||
+		fread(&record->nameLen, sizeof(unsigned int), 1, reader->file) != 1 ||
+		fread(&record->riskClass, sizeof(unsigned int), 1, reader->file) != 1 ||
+		fread(reader->nameBuffer, 1, record->nameLen, reader->file) != record->nameLen)
+	{
+		return READ_ERROR;
+	}
+	record->name = reader->nameBuffer;
+	COUNT_BYTES_READ(sizeof(float) + sizeof(size_t) + 2 * sizeof(unsigned int) + record->nameLen);
+	return READ_RECORD;
+}
+
+/**
+ * Adds a run to the list of runs of the spiller
+ * @param spiller The spiller
+ * @param run The run (rewound, ready to be read)
+ * @return STREAM_SUCCESS or STREAM_FAILED
+ */
+static int pushRun(RunSpiller *spiller, FILE *run)
+{
+	if (spiller->numOfRuns == spiller->runsCapacity)
+	{
+		size_t newCapacity = spiller->runsCapacity ? spiller->runsCapacity * 2 : INIT_RUNS_CAPACITY;
+		FILE **runs = (FILE **) trackedRealloc(spiller->runs, spiller->runsCapacity * sizeof(FILE *),
+		                                       newCapacity * sizeof(FILE *));
+		if (runs == NULL)
+		{
+			fclose(run);
+			return STREAM_FAILED;
+		}
+		spiller->runs = runs;
+		spiller->runsCapacity = newCapacity;
+	}
+	spiller->runs[spiller->numOfRuns++] = run;
+	return STREAM_SUCCESS;
+}
+
+/**
+ * Sorts the buffer and gives its records (in order) to the consumer. The buffer is empty after
+ * @param spiller The spiller
+ * @param consumer The consumer
+ * @param context Given to the consumer
+ * @return STREAM_SUCCESS or STREAM_FAILED
+ */
+static int drainBuffer(RunSpiller *spiller, RecordConsumer consumer, void *context)
+{
+	RecordKey *keys = (RecordKey *) spiller->buffer;
+	qsort(keys, spiller->numOfKeys, sizeof(RecordKey), cmpFuncRecordKey);
+	for (size_t i = 0; i < spiller->numOfKeys; ++i)
+	{
+		PersonRecord record = {keys[i].probInfected, keys[i].id,
+		                       spiller->buffer + keys[i].nameOffset, keys[i].nameLen,
+		                       keys[i].riskClass};
+		if (consumer(&record, context) == STREAM_FAILED)
+		{
+			return STREAM_FAILED;
+		}
+	}
+	spiller->numOfKeys = 0;
+	spiller->namesBegin = spiller->budget;
+	return STREAM_SUCCESS;
+}
+
+/**
+ * Writes the buffer as a new sorted run
+ * @param spiller The spiller
+ * @return STREAM_SUCCESS or STREAM_FAILED
+ */
+static int spillBuffer(RunSpiller *spiller)
+{
+	FILE *run = tmpfile();
+	if (run == NULL)
+	{
+		return STREAM_FAILED;
+	}
+	if (drainBuffer(spiller, writeRecordToRun, run) == STREAM_FAILED || fflush(run) != 0)
+	{
+		fclose(run);
+		return STREAM_FAILED;
+	}
+	rewind(run);
+	return pushRun(spiller, run);
+}
+
+int addRecord(RunSpiller *spiller, const PersonRecord *record)
+{
+	size_t keysEnd = (spiller->numOfKeys + 1) * sizeof(RecordKey);
+	if (keysEnd + record->nameLen > spiller->namesBegin)
+	{
+		if (spiller->numOfKeys == 0)
+		{
+			return STREAM_FAILED; // one record does not fit in the whole buffer
+		}
+		if (spillBuffer(spiller) == STREAM_FAILED)
+		{
+			return STREAM_FAILED;
+		}
+	}
+	spiller->namesBegin -= record->nameLen;
+	memcpy(spiller->buffer + spiller->namesBegin, record->name, record->nameLen);
+	RecordKey *key = (RecordKey *) spiller->buffer + spiller->numOfKeys;
+	key->id = record->id;
+	key->probInfected = record->probInfected;
+	key->nameOffset = spiller->namesBegin;
+	key->nameLen = record->nameLen;
+	key->riskClass = record->riskClass;
+	spiller->numOfKeys++;
+	spiller->maxNameLen = record->nameLen > spiller->maxNameLen ? record->nameLen :
+	                      spiller->maxNameLen;
+	return STREAM_SUCCESS;
+}
+
+/**
+ * Restores the heap property from one place down (the heap is of readers, the smallest record,
+ * by compareRecords, at the top)
+ * @param heap The readers
+ * @param heapLen The number of readers in the heap
+ * @param place The place to sift down from
+ */
+static void siftDown(RunReader **heap, size_t heapLen, size_t place)
+{
+	while (1)
+	{
+		size_t smallest = place;
+		size_t left = 2 * place + 1;
+		size_t right = left + 1;
+		const PersonRecord *top = &heap[smallest]->head;
+		if (left < heapLen &&
+		    compareRecords(heap[left]->head.riskClass, heap[left]->head.probInfected,
+		                   heap[left]->head.id, top->riskClass, top->probInfected, top->id) < 0)
+		{
+			smallest = left;
+			top = &heap[smallest]->head;
+		}
+		if (right < heapLen &&
+		    compareRecords(heap[right]->head.riskClass, heap[right]->head.probInfected,
+		                   heap[right]->head.id, top->riskClass, top->probInfected, top->id) < 0)
+		{
+			smallest = right;
+		}
+		if (smallest == place)
+		{
+			return;
+		}
+		RunReader *tmp = heap[place];
+		heap[place] = heap[smallest];
+		heap[smallest] = tmp;
+		place = smallest;
+	}
+}
+
+/**
+ * Merges k runs (k-way merge with a heap) and gives the records in order to the consumer
+ * @param runs The runs (rewound)
+ * @param numOfRuns k (at most MAX_MERGE_FAN_IN)
+ * @param maxNameLen The longest name in the runs
+ * @param consumer The consumer
+ * @param context Given to the consumer
+ * @return STREAM_SUCCESS or STREAM_FAILED
+ */
+static int mergeGroup(FILE **runs, size_t numOfRuns, unsigned int maxNameLen,
+                      RecordConsumer consumer, void *context)
+{
+	RunReader *readers = (RunReader *) trackedCalloc(numOfRuns, sizeof(RunReader));
+	RunReader **heap = (RunReader **) trackedCalloc(numOfRuns, sizeof(RunReader *));
+	char *names = (char *) trackedMalloc(numOfRuns * ((size_t) maxNameLen + 1));
+	int status = readers != NULL && heap != NULL && names != NULL ? STREAM_SUCCESS : STREAM_FAILED;
+	size_t heapLen = 0;
+	for (size_t i = 0; i < numOfRuns && status == STREAM_SUCCESS; ++i)
+	{
+		readers[i].file = runs[i];
+		readers[i].nameBuffer = names + i * ((size_t) maxNameLen + 1);
+		int readStatus = readRecord(&readers[i]);
+		if (readStatus == READ_ERROR)
+		{
+			status = STREAM_FAILED;
+		}
+		else if (readStatus == READ_RECORD)
+		{
+			heap[heapLen++] = &readers[i];
+		}
+	}
+	for (size_t i = heapLen / 2; i-- > 0 && status == STREAM_SUCCESS;)
+	{
+		siftDown(heap, heapLen, i);
+	}
+	while (heapLen > 0 && status == STREAM_SUCCESS)
+	{
+		if (consumer(&heap[0]->head, context) == STREAM_FAILED)
+		{
+			status = STREAM_FAILED;
+			break;
+		}
+		int readStatus = readRecord(heap[0]);
+		if (readStatus == READ_ERROR)
+		{
+			status = STREAM_FAILED;
+			break;
+		}
+		if (readStatus == END_OF_RUN)
+		{
+			heap[0] = heap[--heapLen];
+		}
+		siftDown(heap, heapLen, 0);
+	}
+	trackedFree(readers, numOfRuns * sizeof(RunReader));
+	trackedFree(heap, numOfRuns * sizeof(RunReader *));
+	trackedFree(names, numOfRuns * ((size_t) maxNameLen + 1));
+	return status;
+}
+
+int mergeRuns(RunSpiller *spiller, RecordConsumer consumer, void *context)
+{
+	if (spiller->numOfRuns == 0) // everything fits in the budget, no need for the disk
+	{
+		return drainBuffer(spiller, consumer, context);
+	}
+	if (spiller->numOfKeys > 0 && spillBuffer(spiller) == STREAM_FAILED)
+	{
+		return STREAM_FAILED;
+	}
+	trackedFree(spiller->buffer, spiller->budget); // the merge needs only the heads of the runs
+	spiller->buffer = NULL;
+	// While there are too many runs to merge at once, merge the first runs into a longer one
+	size_t first = 0;
+	while (spiller->numOfRuns - first > MAX_MERGE_FAN_IN)
+	{
+		FILE *run = tmpfile();
+		if (run == NULL)
+		{
+			return STREAM_FAILED;
+		}
+		if (mergeGroup(spiller->runs + first, MAX_MERGE_FAN_IN, spiller->maxNameLen, writeRecordToRun,
+		               run) == STREAM_FAILED || fflush(run) != 0)
+		{
+			fclose(run);
+			return STREAM_FAILED;
+		}
+		for (size_t i = first; i < first + MAX_MERGE_FAN_IN; ++i)
+		{
+			fclose(spiller->runs[i]);
+			spiller->runs[i] = NULL;
+		}
+		first += MAX_MERGE_FAN_IN;
+		rewind(run);
+		if (pushRun(spiller, run) == STREAM_FAILED)
+		{
+			return STREAM_FAILED;
+		}
+	}
+	return mergeGroup(spiller->runs + first, spiller->numOfRuns - first, spiller->maxNameLen,
+	                  consumer, context);
+}
+
+int addSortedRun(RunSpiller *spiller, FILE *run, unsigned int maxNameLen)
+{
+	spiller->maxNameLen = maxNameLen > spiller->maxNameLen ? maxNameLen : spiller->maxNameLen;
+	return pushRun(spiller, run);
+}
+
+size_t getNumOfRuns(const RunSpiller *spiller)
+{
+	return spiller->numOfRuns;
+}
+
+void freeSpiller(RunSpiller *spiller)
+{
+	trackedFree(spiller->buffer, spiller->budget);
+	spiller->buffer = NULL;
+	for (size_t i = 0; i < spiller->numOfRuns; ++i)
+	{
+		if (spiller->runs[i] != NULL)
+		{
+			fclose(spiller->runs[i]); // tmpfile is deleted when closed
+		}
+	}
+	trackedFree(spiller->runs, spiller->runsCapacity * sizeof(FILE *));
+	spiller->runs = NULL;
+	spiller->numOfRuns = 0;
+	spiller->runsCapacity = 0;
+	spiller->numOfKeys = 0;
+	spiller->budget = 0;
+}
@@ -0,0 +1,251 @@
+/**
+* @file SpreaderDetectorStreaming.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The parts of the streaming (bounded memory) mode of the detector
+* @section DESCRIPTION
+* In the streaming mode the table of people is never kept in memory as a whole, and the whole
+* tracked heap of the mode (see SpreaderDetectorArena.h) is kept under the memory budget:
+* - The probabilities are computed from the meeting file alone (see SpreaderDetectorGraph.h). The
+*   people who appear in meetings are numbered by a map from their ID, so they can be the vertices
+*   of the graph (their IDs are the keys the cycles are broken by, like in every other mode), and
+*   the map then gives their probabilities (everyone else has INIT_PROB). Like in
+*   the in-memory mode, a repeated ID gets the probability only in its first line, and an ID of the
+*   meeting file that no line of the people file has is an error. The meetings, the map and the
+*   propagation are in memory at once, so they must fit in the budget: when they do not, the mode
+*   fails (MODE_OVER_BUDGET) instead of going over it.
+* - Then the people file is read line by line, and every person becomes a record (probability, ID,
+*   name). The records are collected into a buffer of the room that is left in the budget after
+*   the map (except for the buffer of the output file, which is sized from that room too). When the buffer is full it is sorted (by class,
+*   then by probability from the largest to the smallest, then by ID) and written to a temporary
+*   file as one sorted run.
+* - At the end the runs are merged (k-way merge with a heap) in the same order, so the output is
+*   exactly the output of the in-memory mode.
+* The budget does not cover the stacks of the threads and the buffers of the temporary files.
+*/
+
+#ifndef EXAM_SPREADERDETECTORSTREAMING_H
+#define EXAM_SPREADERDETECTORSTREAMING_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @def STREAM_SUCCESS 1
+ * @brief Returned by the functions of the streaming mode when they succeeded
+ */
+#define STREAM_SUCCESS 1
+
+/**
+ * @def STREAM_FAILED 0
+ * @brief Returned by the functions of the streaming mode when an allocation or a temporary file
+ * failed (a standard library error)
+ */
+#define STREAM_FAILED 0
+
+/**
+ * @def MIN_MEMORY_BUDGET (1 << 16)
+ * @brief The smallest value of "--memory-budget=" (64KB): the buffers of the records and of the
+ * output file fit in it when there are only a few meetings. The sharded mode gives its spiller
+ * this budget too (it only merges the runs of its workers)
+ */
+#define MIN_MEMORY_BUDGET (1 << 16)
+
+/**
+ * @def MIN_RECORDS_BUFFER_SIZE (1 << 12)
+ * @brief The buffer of the records is at least 4KB (a budget with less room than that for them is
+ * too small)
+ */
+#define MIN_RECORDS_BUFFER_SIZE (1 << 12)
+
+/**
+ * @def NODE_FAILED SIZE_MAX
+ * @brief Returned by nodeOfId when the map could not grow
+ */
+#define NODE_FAILED SIZE_MAX
+
+/**
+ * @struct ProbSlot
+ * @brief One slot of the map of probabilities: an ID and its vertex
+ */
+typedef struct ProbSlot
+{
+	size_t id;
+	size_t node;
+} ProbSlot;
+
+/**
+ * @struct ProbMap
+ * @brief A growing open-addressing hash map from ID to a vertex (0 .. len - 1, in the order the
+ * IDs were added), and from the vertex to its ID (ids) and to the probability of infection (probs)
+ * once they were allocated. Holds only the people who appear in the meeting file. isMatched marks the vertices
+ * that were given to a person of the people file (numOfMatched of them). A map initialized to {0}
+ * is empty
+ */
+typedef struct ProbMap
+{
+	ProbSlot *slots;
+	size_t numOfSlots;
+	size_t len;
+	size_t *ids;
+	float *probs;
+	unsigned char *isMatched;
+	size_t numOfMatched;
+} ProbMap;
+
+/**
+ * @struct PersonRecord
+ * @brief One person as it is written to the output: the probability, the ID, the name (the name
+ * is not '\0' terminated) and the class (computed from the age when the record was made, so the
+ * age does not have to be kept)
+ */
+typedef struct PersonRecord
+{
+	float probInfected;
+	size_t id;
+	const char *name;
+	unsigned int nameLen;
+	unsigned int riskClass;
+} PersonRecord;
+
+/**
+ * @struct RecordKey
+ * @brief A record inside the buffer of the spiller. The name is at nameOffset in the buffer
+ */
+typedef struct RecordKey
+{
+	size_t id;
+	size_t nameOffset;
+	float probInfected;
+	unsigned int nameLen;
+	unsigned int riskClass;
+} RecordKey;
+
+/**
+ * @struct RunSpiller
+ * @brief Collects records into one buffer of exactly budget bytes, and spills the buffer to a
+ * temporary file (a sorted run) every time it is full. The keys grow from the beginning of the
+ * buffer and the names grow from its end (namesBegin) towards them. A spiller initialized to {0}
+ * is empty
+ */
+typedef struct RunSpiller
+{
+	char *buffer;
+	size_t budget;
+	size_t numOfKeys;
+	size_t namesBegin;
+	unsigned int maxNameLen;
+	FILE **runs;
+	size_t numOfRuns;
+	size_t runsCapacity;
+} RunSpiller;
+
+/**
+ * A function that gets the records in their final order (one by one)
+ * @param record The record
+ * @param context The context given to mergeRuns
+ * @return STREAM_SUCCESS, or STREAM_FAILED to stop the merge
+ */
+typedef int (*RecordConsumer)(const PersonRecord *record, void *context);
+
+/**
+ * Returns the vertex of a person. A person who is not in the map yet is added (with the next
+ * vertex). The map grows if needed
+ * @param map The map
+ * @param id The ID of the person
+ * @return The vertex, or NODE_FAILED (no memory)
+ */
+size_t nodeOfId(ProbMap *map, size_t id);
+
+/**
+ * Allocates the probabilities of the vertices (one for every person in the map), to be filled by
+ * the caller, their IDs (ids, to break the cycles by) and their marks (none is matched). No person
+ * can be added after that
+ * @param map The map (not empty)
+ * @return The probabilities, or NULL (no memory)
+ */
+float *allocateNodeProbs(ProbMap *map);
+
+/**
+ * Returns the probability of a person of the people file, and marks his vertex as matched. A
+ * vertex is given only to the first person with its ID: a later person with the same ID gets
+ * INIT_PROB, like in the in-memory mode, where the meetings of an ID go to its first person
+ * @param map The map (with its probabilities)
+ * @param id The ID of the person
+ * @return The probability (INIT_PROB if he is not in the map or his ID was already matched)
+ */
+float matchProb(ProbMap *map, size_t id);
+
+/**
+ * Was every person of the map (a seed or a person of a meeting) matched by a person of the people
+ * file. If not, the meeting file has an ID that is not in the people file
+ * @param map The map (after all the people were matched)
+ * @return 1 if he was, 0 otherwise
+ */
+int isEveryNodeMatched(const ProbMap *map);
+
+/**
+ * Releases the map. And turns it into an empty map
+ * @param map The map
+ */
+void freeProbMap(ProbMap *map);
+
+/**
+ * Prepares the spiller
+ * @param spiller The spiller (empty)
+ * @param budget The maximal number of bytes of the buffer of the records
+ * @return STREAM_SUCCESS or STREAM_FAILED (no memory)
+ */
+int initSpiller(RunSpiller *spiller, size_t budget);
+
+/**
+ * Adds one record. If the buffer is full it is first spilled to a new sorted run
+ * @param spiller The spiller
+ * @param record The record (the name is copied)
+ * @return STREAM_SUCCESS or STREAM_FAILED (no memory or the temporary file failed)
+ */
+int addRecord(RunSpiller *spiller, const PersonRecord *record);
+
+/**
+ * Gives all the records (by class, then by probability from the largest to the smallest, then by
+ * ID) to the consumer. If nothing was spilled the buffer is only sorted in memory, otherwise the
+ * buffer is spilled too and all the runs are merged
+ * @param spiller The spiller
+ * @param consumer The consumer
+ * @param context Given to the consumer
+ * @return STREAM_SUCCESS or STREAM_FAILED
+ */
+int mergeRuns(RunSpiller *spiller, RecordConsumer consumer, void *context);
+
+/**
+ * Writes one record to the end of a run (a RecordConsumer)
+ * @param record The record
+ * @param context The run (FILE *)
+ * @return STREAM_SUCCESS or STREAM_FAILED
+ */
+int writeRecordToRun(const PersonRecord *record, void *context);
+
+/**
+ * Adds a run that was sorted somewhere else (the records of a shard, through a pipe for example).
+ * It is merged with the other runs and closed with the spiller; it does not have to be seekable
+ * @param spiller The spiller
+ * @param run The run, at its first record
+ * @param maxNameLen The longest name in the run
+ * @return STREAM_SUCCESS or STREAM_FAILED (the run is closed)
+ */
+int addSortedRun(RunSpiller *spiller, FILE *run, unsigned int maxNameLen);
+
+/**
+ * Returns the number of sorted runs that were written to temporary files so far
+ * @param spiller The spiller
+ * @return The number of runs
+ */
+size_t getNumOfRuns(const RunSpiller *spiller);
+
+/**
+ * Releases the spiller (the temporary files are deleted). And turns it into an empty spiller
+ * @param spiller The spiller
+ */
+void freeSpiller(RunSpiller *spiller);
+
+#endif //EXAM_SPREADERDETECTORSTREAMING_H
@@ -0,0 +1,1199 @@
+/**
+* @file SpreaderDetectorTable.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the table of people
+* @section DESCRIPTION
+* A mapped people file is split into chunks of whole lines. Every chunk is counted by a thread of
+* its own, the columns are allocated once in their exact size, and then every thread parses its
+* chunk directly into its rows. The meetings of every way of reading the meeting file go through
+* the same batch (addTableMeeting), so their crnas are computed a batch at a time (see
+* SpreaderDetectorCrna.h).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SpreaderDetectorTable.h"
+#include "SpreaderDetectorModel.h"
+#include "SpreaderDetectorScan.h"
+#include "SpreaderDetectorStats.h"
+
+/**
+ * @def INIT_PROB 0.0f
+ * @brief For each person absorbed from the people file we will initialize the probability that he
+ * is sick to be 0, then if he is also in the meeting file (he will not necessarily be there)
+ * we will change the probability accordingly)
+ */
+#define INIT_PROB 0.0f
+
+
+/**
+ * @def MIN_BYTES_PER_THREAD (1 << 20)
+ * @brief We don't split the people file into chunks smaller than 1MB. (For a small file it is
+ * cheaper to parse it on one thread than to start threads)
+ */
+#define MIN_BYTES_PER_THREAD (1 << 20)
+
+/**
+ * @def LEFT_BEFOR_RIGHT -1
+ * @brief In the comparison functions to be passed to q-sort -1 will indicate that the left value
+ * should be according to the right value
+ */
+#define LEFT_BEFOR_RIGHT -1
+
+/**
+ * @struct PeopleChunk
+ * @brief A range of whole lines of the mapped people file, which is loaded by one thread. The
+ * lines of the chunk are rows firstRow .. firstRow + numOfLines - 1 of the table, so every
+ * thread writes directly into its own rows of the (already allocated) columns
+ */
+typedef struct PeopleChunk
+{
+	const char *begin;
+	const char *end;
+	size_t firstRow;
+	size_t numOfLines;
+	PeopleTable *people;
+	int status;
+} PeopleChunk;
+
+/**
+ * @struct IdSortKey
+ * @brief The key we sort when we sort the table by ID: the ID itself and the row it came from.
+ * Sorting the keys (16 bytes each, contiguous) is much cheaper than moving whole people around
+ */
+typedef struct IdSortKey
+{
+	size_t id;
+	size_t row;
+} IdSortKey;
+
+/**
+ * @struct TableApplier
+ * @brief The context of the applier of the pipeline (and of the seeds of the first line): the table,
+ * and the status of the first meeting (or seed) that could not be added
+ */
+typedef struct TableApplier
+{
+	PeopleTable *people;
+	int status;
+} TableApplier;
+
+/**
+ * Runs a task on every chunk: each chunk on a thread of its own (the first one on the calling
+ * thread). If a thread can not be created, the calling thread does its chunk
+ * @param task The task
+ * @param chunks The chunks
+ * @param numOfChunks The number of chunks (at least 1)
+ */
+static void runOnChunks(void *(*task)(void *), PeopleChunk *chunks, size_t numOfChunks)
+{
+	pthread_t *threads = (pthread_t *) trackedCalloc(numOfChunks, sizeof(pthread_t));
+	int *started = (int *) trackedCalloc(numOfChunks, sizeof(int));
+	for (size_t i = 1; i < numOfChunks && threads != NULL && started != NULL; ++i)
+	{
+		started[i] = pthread_create(&threads[i], NULL, task, &chunks[i]) == 0;
+	}
+	task(&chunks[0]);
+	for (size_t i = 1; i < numOfChunks; ++i)
+	{
+		if (started != NULL && started[i])
+		{
+			pthread_join(threads[i], NULL);
+		}
+		else // no thread, so this thread does the work
+		{
+			task(&chunks[i]);
+		}
+	}
+	trackedFree(threads, numOfChunks * sizeof(pthread_t));
+	trackedFree(started, numOfChunks * sizeof(int));
+}
+
+/**
+ * Counts the lines of a chunk (a task of runOnChunks)
+ * @param arg The chunk
+ * @return NULL
+ */
+static void *countChunkLines(void *arg)
+{
+	PeopleChunk *chunk = (PeopleChunk *) arg;
+	size_t numOfLines = 0;
+	const char *cur = chunk->begin;
+	while (cur < chunk->end)
+	{
+		const char *lineEnd = findLineEnd(cur, chunk->end);
+		numOfLines++;
+		cur = lineEnd < chunk->end ? lineEnd + 1 : chunk->end;
+	}
+	chunk->numOfLines = numOfLines;
+	return NULL;
+}
+
+/**
+ * Parses the lines of a chunk into its rows (a task of runOnChunks). At an invalid line the
+ * status of the chunk is SCAN_FAILED, and numOfLines is the number of lines before it
+ * @param arg The chunk
+ * @return NULL
+ */
+static void *loadPeopleChunk(void *arg)
+{
+	PeopleChunk *chunk = (PeopleChunk *) arg;
+	const char *cur = chunk->begin;
+	size_t row = chunk->firstRow;
+	chunk->status = SCAN_SUCCESS;
+	while (cur < chunk->end)
+	{
+		const char *lineEnd = findLineEnd(cur, chunk->end);
+		if (parsePersonFromBytes(cur, lineEnd, chunk->people, row) == SCAN_FAILED)
+		{
+			chunk->status = SCAN_FAILED;
+			chunk->numOfLines = row - chunk->firstRow;
+			break;
+		}
+		row++;
+		cur = lineEnd < chunk->end ? lineEnd + 1 : chunk->end;
+	}
+	return NULL;
+}
+
+/**
+ * Loads the people of the mapped people file (peopleFile) by several threads
+ * @param people The table (empty)
+ * @param numOfThreads The maximal number of threads
+ * @return TABLE_SUCCESS, TABLE_INVALID_INPUT (the rows before the invalid line are in the table)
+ * or TABLE_NO_MEMORY
+ */
+static int loadMappedPeople(PeopleTable *people, size_t numOfThreads)
+{
+	const char *begin = people->peopleFile.data;
+	size_t fileLen = people->peopleFile.len;
+	size_t numOfChunks = fileLen / MIN_BYTES_PER_THREAD + 1;
+	numOfChunks = numOfChunks < numOfThreads ? numOfChunks : numOfThreads;
+	numOfChunks = numOfChunks > 0 ? numOfChunks : 1;
+	PeopleChunk *chunks = (PeopleChunk *) trackedCalloc(numOfChunks, sizeof(PeopleChunk));
+	if (chunks == NULL)
+	{
+		return TABLE_NO_MEMORY;
+	}
+	// Each chunk starts right after the '\n' that ends the previous chunk, so every line belongs
+	// to exactly one chunk
+	const char *end = begin + fileLen;
+	const char *chunkBegin = begin;
+	for (size_t i = 0; i < numOfChunks; ++i)
+	{
+		const char *chunkEnd = end;
+		if (i + 1 < numOfChunks)
+		{
+			const char *target = begin + fileLen / numOfChunks * (i + 1);
+			chunkEnd = findLineEnd(target < chunkBegin ? chunkBegin : target, end);
+			chunkEnd = chunkEnd < end ? chunkEnd + 1 : end;
+		}
+		chunks[i].begin = chunkBegin;
+		chunks[i].end = chunkEnd;
+		chunks[i].people = people;
+		chunkBegin = chunkEnd;
+	}
+	runOnChunks(countChunkLines, chunks, numOfChunks);
+	size_t numOfPeople = 0;
+	for (size_t i = 0; i < numOfChunks; ++i)
+	{
+		chunks[i].firstRow = numOfPeople;
+		numOfPeople += chunks[i].numOfLines;
+	}
+	if (reservePeopleCapacity(people, numOfPeople) == GROW_FAILED)
+	{
+		trackedFree(chunks, numOfChunks * sizeof(PeopleChunk));
+		return TABLE_NO_MEMORY;
+	}
+	runOnChunks(loadPeopleChunk, chunks, numOfChunks);
+	// The table keeps the rows up to the first invalid line, as if the file was read line by line
+	int status = TABLE_SUCCESS;
+	people->len = 0;
+	for (size_t i = 0; i < numOfChunks && status == TABLE_SUCCESS; ++i)
+	{
+		people->len += chunks[i].numOfLines;
+		status = chunks[i].status == SCAN_SUCCESS ? TABLE_SUCCESS : TABLE_INVALID_INPUT;
+	}
+	trackedFree(chunks, numOfChunks * sizeof(PeopleChunk));
+	return status;
+}
+
+/**
+ * Makes the rows of the people snapshot (peopleSnapshot): only the pointers to the names are
+ * allocated, the other columns are the columns of the snapshot
+ * @param people The table (empty)
+ * @return TABLE_SUCCESS, TABLE_INVALID_INPUT or TABLE_NO_MEMORY
+ */
+static int loadSnapshotPeople(PeopleTable *people)
+{
+	const Snapshot *snapshot = &people->peopleSnapshot;
+	size_t numOfPeople = snapshot->count;
+	people->names = (const char **) trackedMalloc(numOfPeople * sizeof(const char *));
+	if (people->names == NULL && numOfPeople > 0)
+	{
+		return TABLE_NO_MEMORY;
+	}
+	people->capacity = numOfPeople; // only of the names, the other columns are not allocated
+	people->ids = snapshot->ids;
+	people->ages = snapshot->ages;
+	people->probsInfected = snapshot->probs;
+	people->nameLengths = snapshot->nameLengths;
+	size_t nameOffset = 0;
+	for (size_t row = 0; row < numOfPeople; ++row)
+	{
+		people->names[row] = snapshot->names + nameOffset;
+		nameOffset += snapshot->nameLengths[row];
+		if (nameOffset > snapshot->extraCount) // the lengths do not match the names
+		{
+			return TABLE_INVALID_INPUT;
+		}
+	}
+	people->len = numOfPeople;
+	return TABLE_SUCCESS;
+}
+
+/**
+ * Adds the people of a people file read line by line (a pipe, or a file added to a table that
+ * already has people). The names are copied into the names arena
+ * @param people The table
+ * @param path The path of the file
+ * @return TABLE_SUCCESS, TABLE_OPEN_FAILED, TABLE_INVALID_INPUT or TABLE_NO_MEMORY
+ */
+static int loadPeopleStream(PeopleTable *people, const char *path)
+{
+	FILE *inputFile = fopen(path, READING_MODE);
+	if (inputFile == NULL)
+	{
+		return TABLE_OPEN_FAILED;
+	}
+	char currentRow[MAX_LINE_SIZE];
+	int status = TABLE_SUCCESS;
+	while (status == TABLE_SUCCESS && fgets(currentRow, sizeof(currentRow), inputFile))
+	{
+		size_t rowLen = strlen(currentRow);
+		COUNT_BYTES_READ(rowLen);
+		const char *name;
+		size_t nameLen;
+		size_t id;
+		float age;
+		if (scanPersonFromBytes(currentRow, findLineEnd(currentRow, currentRow + rowLen), &name,
+		                        &nameLen, &id, &age) == SCAN_FAILED)
+		{
+			status = TABLE_INVALID_INPUT;
+		}
+		else
+		{
+			status = addTablePerson(people, name, nameLen, id, age);
+		}
+	}
+	fclose(inputFile);
+	return status;
+}
+
+int loadPeopleTable(PeopleTable *people, const char *path, size_t numOfThreads)
+{
+	if (people->len > 0 || people->peopleFile.data != NULL || people->peopleSnapshot.data != NULL)
+	{
+		return loadPeopleStream(people, path); // the table already has a file of its own
+	}
+	int snapshotStatus = openSnapshot(path, SNAPSHOT_PEOPLE, &people->peopleSnapshot);
+	if (snapshotStatus == SNAPSHOT_SUCCESS)
+	{
+		return loadSnapshotPeople(people);
+	}
+	else if (snapshotStatus == SNAPSHOT_OPEN_FAILED)
+	{
+		return TABLE_OPEN_FAILED;
+	}
+	else if (snapshotStatus != SNAPSHOT_NOT_SNAPSHOT) // an invalid snapshot is an invalid file
+	{
+		return TABLE_INVALID_INPUT;
+	}
+	int mapStatus = mapInputFile(path, &people->peopleFile);
+	if (mapStatus == MAP_OPEN_FAILED)
+	{
+		return TABLE_OPEN_FAILED;
+	}
+	else if (mapStatus == MAP_SUCCESS)
+	{
+		return loadMappedPeople(people, numOfThreads);
+	}
+	// The file can not be mapped (a pipe for example) so we read it line by line
+	return loadPeopleStream(people, path);
+}
+
+int addTablePerson(PeopleTable *people, const char *name, size_t nameLen, size_t id, float age)
+{
+	if (ensurePeopleCapacity(people) == GROW_FAILED)
+	{
+		return TABLE_NO_MEMORY;
+	}
+	char *copy = (char *) arenaAlloc(&people->namesArena, nameLen);
+	if (copy == NULL && nameLen > 0)
+	{
+		return TABLE_NO_MEMORY;
+	}
+	memcpy(copy, name, nameLen);
+	size_t row = people->len;
+	people->names[row] = copy;
+	people->nameLengths[row] = (unsigned int) nameLen;
+	people->ids[row] = id;
+	people->ages[row] = age;
+	people->probsInfected[row] = INIT_PROB; // We initialize the probability to 0
+	// ("The person is innocent until proven otherwise")
+	people->len++;
+	return TABLE_SUCCESS;
+}
+
+int parsePersonFromBytes(const char *line, const char *lineEnd, PeopleTable *people, size_t row)
+{
+	const char *name;
+	size_t nameLen;
+	size_t id;
+	float age;
+	if (scanPersonFromBytes(line, lineEnd, &name, &nameLen, &id, &age) == SCAN_FAILED)
+	{
+		return SCAN_FAILED;
+	}
+	people->names[row] = name; // in place!
+	people->nameLengths[row] = (unsigned int) nameLen;
+	people->ids[row] = id;
+	people->ages[row] = age;
+	people->probsInfected[row] = INIT_PROB;
+	return SCAN_SUCCESS;
+}
+
+int ensurePeopleCapacity(PeopleTable *people)
+{
+	if (people->len < people->capacity)
+	{
+		return GROW_SUCCESS;
+	}
+	return reservePeopleCapacity(people, people->capacity ? people->capacity * GROWTH_FACTOR :
+	                                     INIT_CAPACITY);
+}
+
+/**
+ * Returns whether the columns of the table (except the pointers to the names) are the columns of
+ * its people snapshot
+ * @param people The table
+ * @return 1 if they are, 0 if they were allocated
+ */
+static int areColumnsInSnapshot(const PeopleTable *people)
+{
+	return people->peopleSnapshot.data != NULL && people->ids == people->peopleSnapshot.ids;
+}
+
+/**
+ * Copies the columns of the snapshot into allocated columns of a larger capacity, so people can be
+ * added after the people of the snapshot
+ * @param people The table (its columns are in the snapshot)
+ * @param newCapacity The capacity
+ * @return GROW_SUCCESS or GROW_FAILED (the table is not changed)
+ */
+static int copySnapshotColumns(PeopleTable *people, size_t newCapacity)
+{
+	size_t *ids = (size_t *) trackedMalloc(newCapacity * sizeof(size_t));
+	float *ages = (float *) trackedMalloc(newCapacity * sizeof(float));
+	float *probs = (float *) trackedMalloc(newCapacity * sizeof(float));
+	unsigned int *lengths = (unsigned int *) trackedMalloc(newCapacity * sizeof(unsigned int));
+	const char **names = NULL;
+	if (ids != NULL && ages != NULL && probs != NULL && lengths != NULL)
+	{
+		names = (const char **) trackedRealloc((void *) people->names,
+		                                       people->capacity * sizeof(const char *),
+		                                       newCapacity * sizeof(const char *));
+	}
+	if (names == NULL)
+	{
+		trackedFree(ids, ids != NULL ? newCapacity * sizeof(size_t) : 0);
+		trackedFree(ages, ages != NULL ? newCapacity * sizeof(float) : 0);
+		trackedFree(probs, probs != NULL ? newCapacity * sizeof(float) : 0);
+		trackedFree(lengths, lengths != NULL ? newCapacity * sizeof(unsigned int) : 0);
+		return GROW_FAILED;
+	}
+	memcpy(ids, people->ids, people->len * sizeof(size_t));
+	memcpy(ages, people->ages, people->len * sizeof(float));
+	memcpy(probs, people->probsInfected, people->len * sizeof(float));
+	memcpy(lengths, people->nameLengths, people->len * sizeof(unsigned int));
+	people->ids = ids;
+	people->ages = ages;
+	people->probsInfected = probs;
+	people->nameLengths = lengths;
+	people->names = names;
+	people->capacity = newCapacity;
+	return GROW_SUCCESS;
+}
+
+int reservePeopleCapacity(PeopleTable *people, size_t newCapacity)
+{
+	size_t oldCapacity = people->capacity;
+	if (newCapacity <= oldCapacity)
+	{
+		return GROW_SUCCESS;
+	}
+	if (areColumnsInSnapshot(people))
+	{
+		return copySnapshotColumns(people, newCapacity);
+	}
+	// Every column is replaced as soon as it was reallocated, and the capacity is updated only at
+	// the end. So in case of an error the table stays valid and can be freed (the columns that
+	// already grew are freed by their old size, which is fine for the counters: see trackedFree)
+	size_t *ids = (size_t *) trackedRealloc(people->ids, oldCapacity * sizeof(size_t),
+	                                        newCapacity * sizeof(size_t));
+	if (ids == NULL)
+	{
+		return GROW_FAILED;
+	}
+	people->ids = ids;
+	float *ages = (float *) trackedRealloc(people->ages, oldCapacity * sizeof(float),
+	                                       newCapacity * sizeof(float));
+	if (ages == NULL)
+	{
+		return GROW_FAILED;
+	}
+	people->ages = ages;
+	float *probs = (float *) trackedRealloc(people->probsInfected, oldCapacity * sizeof(float),
+	                                        newCapacity * sizeof(float));
+	if (probs == NULL)
+	{
+		return GROW_FAILED;
+	}
+	people->probsInfected = probs;
+	const char **names = (const char **) trackedRealloc((void *) people->names,
+	                                                    oldCapacity * sizeof(const char *),
+	                                                    newCapacity * sizeof(const char *));
+	if (names == NULL)
+	{
+		return GROW_FAILED;
+	}
+	people->names = names;
+	unsigned int *lengths = (unsigned int *) trackedRealloc(people->nameLengths,
+	                                                        oldCapacity * sizeof(unsigned int),
+	                                                        newCapacity * sizeof(unsigned int));
+	if (lengths == NULL)
+	{
+		return GROW_FAILED;
+	}
+	people->nameLengths = lengths;
+	people->capacity = newCapacity;
+	return GROW_SUCCESS;
+}
+
+int resizeArray(void **array, size_t capacity, size_t newCapacity, size_t elementSize)
+{
+	void *grown = trackedRealloc(*array, capacity * elementSize, newCapacity * elementSize);
+	if (grown == NULL)
+	{
+		return GROW_FAILED;
+	}
+	*array = grown;
+	return GROW_SUCCESS;
+}
+
+int ensureArrayCapacity(void **array, size_t *capacity, size_t len, size_t elementSize)
+{
+	if (len < *capacity)
+	{
+		return GROW_SUCCESS;
+	}
+	size_t newCapacity = *capacity ? *capacity * GROWTH_FACTOR : INIT_CAPACITY;
+	if (resizeArray(array, *capacity, newCapacity, elementSize) == GROW_FAILED)
+	{
+		return GROW_FAILED;
+	}
+	*capacity = newCapacity;
+	return GROW_SUCCESS;
+}
+
+#ifdef SORTED_ID_INDEX
+/**
+ *  A comparison function to q-sort that orders the keys by ID, and the keys of the same ID by row
+ * @param first
+ * @param sec
+ * @return -1 if the first key is smaller. 1 if greater and 0 if equal
+ */
+static int cmpFuncId(const void *first, const void *sec)
+{
+	size_t left = ((const IdSortKey *) first)->id;
+	size_t right = ((const IdSortKey *) sec)->id;
+	if (left < right)
+	{
+		return LEFT_BEFOR_RIGHT;
+	}
+	if (left > right)
+	{
+		return 1;
+	}
+	// Same ID: by row, so two people with the same ID stay in the order of the file
+	size_t leftRow = ((const IdSortKey *) first)->row;
+	size_t rightRow = ((const IdSortKey *) sec)->row;
+	return (leftRow > rightRow) - (leftRow < rightRow);
+}
+
+/**
+ * Moves the rows of the people (except the ids, which are already sorted) into the order of the
+ * sorted keys, in place: every cycle of the permutation is followed once
+ * @param people The table
+ * @param keys The sorted keys (keys[i].row is the row that should move to row i). They are
+ * changed
+ */
+static void permutePeopleById(PeopleTable *people, IdSortKey *keys)
+{
+	for (size_t start = 0; start < people->len; ++start)
+	{
+		if (keys[start].row == start) // already in its place
+		{
+			continue;
+		}
+		// Row start is saved aside, and then each row of the cycle takes the row it should
+		// take, until we get back to start
+		float savedAge = people->ages[start];
+		const char *savedName = people->names[start];
+		unsigned int savedNameLen = people->nameLengths[start];
+		size_t dest = start;
+		while (keys[dest].row != start)
+		{
+			size_t source = keys[dest].row;
+			people->ages[dest] = people->ages[source];
+			people->names[dest] = people->names[source];
+			people->nameLengths[dest] = people->nameLengths[source];
+			keys[dest].row = dest;
+			dest = source;
+		}
+		people->ages[dest] = savedAge;
+		people->names[dest] = savedName;
+		people->nameLengths[dest] = savedNameLen;
+		keys[dest].row = dest;
+	}
+}
+
+/**
+ * Sorts the rows of the table by ID (with q-sort over the keys, and then one permutation of the
+ * rows)
+ * @param people The table
+ * @return TABLE_SUCCESS or TABLE_NO_MEMORY (the table is not changed)
+ */
+static int sortPeopleTableById(PeopleTable *people)
+{
+	IdSortKey *keys = (IdSortKey *) trackedMalloc(people->len * sizeof(IdSortKey));
+	if (keys == NULL)
+	{
+		return TABLE_NO_MEMORY;
+	}
+	for (size_t i = 0; i < people->len; ++i)
+	{
+		keys[i].id = people->ids[i];
+		keys[i].row = i;
+	}
+	qsort(keys, people->len, sizeof(IdSortKey), cmpFuncId); //Sort the keys by ID
+	for (size_t i = 0; i < people->len; ++i) // the ids are already in the keys
+	{
+		people->ids[i] = keys[i].id;
+	}
+	permutePeopleById(people, keys);
+	// All the probabilities are still INIT_PROB, so there is nothing to rearrange in this column
+	trackedFree(keys, people->len * sizeof(IdSortKey));
+	return TABLE_SUCCESS;
+}
+#endif
+
+int indexPeopleTable(PeopleTable *people)
+{
+	if (people->len == NO_PEOPLE_IN_FIRST_FILE) // no index at all
+	{
+		return TABLE_SUCCESS;
+	}
+#ifdef SORTED_ID_INDEX
+	if (sortPeopleTableById(people) != TABLE_SUCCESS)
+	{
+		return TABLE_NO_MEMORY;
+	}
+#endif
+	return buildIdIndex(&people->idIndex, people->ids, people->len) == INDEX_BUILD_SUCCESS ?
+	       TABLE_SUCCESS : TABLE_NO_MEMORY;
+}
+
+int findTableRow(const PeopleTable *people, size_t id, size_t *row)
+{
+	if (people->len == NO_PEOPLE_IN_FIRST_FILE) // no index at all
+	{
+		return TABLE_UNKNOWN_PERSON;
+	}
+	size_t found = findRowById(&people->idIndex, id);
+	if (found == (size_t) ELEMENT_NOT_FOUND)
+	{
+		return TABLE_UNKNOWN_PERSON;
+	}
+	*row = found;
+	return TABLE_SUCCESS;
+}
+
+int addTableSeed(PeopleTable *people, size_t id)
+{
+	size_t row;
+	if (findTableRow(people, id, &row) != TABLE_SUCCESS)
+	{
+		return TABLE_UNKNOWN_PERSON;
+	}
+	return addSeed(&people->contacts, row) == GRAPH_SUCCESS ? TABLE_SUCCESS : TABLE_NO_MEMORY;
+}
+
+int addTableMeeting(PeopleTable *people, const MeetingInfo *meeting)
+{
+	size_t infectorRow, infectedRow;
+	if (findTableRow(people, meeting->infectorId, &infectorRow) != TABLE_SUCCESS ||
+	    findTableRow(people, meeting->infectedId, &infectedRow) != TABLE_SUCCESS)
+	{
+		return TABLE_UNKNOWN_PERSON;
+	}
+	MeetingBatch *batch = &people->meetingBatch;
+	if (batch->len == CRNA_BATCH_SIZE && flushTableBatch(people) != TABLE_SUCCESS)
+	{
+		return TABLE_NO_MEMORY;
+	}
+	batch->infectors[batch->len] = infectorRow;
+	batch->infecteds[batch->len] = infectedRow;
+	batch->distances[batch->len] = meeting->distance;
+	batch->times[batch->len] = meeting->time;
+	batch->len++;
+	return TABLE_SUCCESS;
+}
+
+int flushTableBatch(PeopleTable *people)
+{
+	MeetingBatch *batch = &people->meetingBatch;
+	if (batch->len == 0)
+	{
+		return TABLE_SUCCESS;
+	}
+	if (!people->isIncremental)
+	{
+		return addContactBatch(&people->contacts, batch) == GRAPH_SUCCESS ? TABLE_SUCCESS :
+		       TABLE_NO_MEMORY;
+	}
+	float risks[CRNA_BATCH_SIZE];
+	computeRisks(people->contacts.riskModel, batch->distances, batch->times, risks, batch->len);
+	size_t numOfAdded = 0;
+	while (numOfAdded < batch->len &&
+	       addBatchContact(&people->incremental, batch->infectors[numOfAdded],
+	                       batch->infecteds[numOfAdded], risks[numOfAdded]) == INCREMENTAL_SUCCESS)
+	{
+		numOfAdded++;
+	}
+	if (numOfAdded < batch->len) // keep the meetings that were not added for the next flush
+	{
+		size_t numOfLeft = batch->len - numOfAdded;
+		memmove(batch->infectors, batch->infectors + numOfAdded, numOfLeft * sizeof(size_t));
+		memmove(batch->infecteds, batch->infecteds + numOfAdded, numOfLeft * sizeof(size_t));
+		memmove(batch->distances, batch->distances + numOfAdded, numOfLeft * sizeof(float));
+		memmove(batch->times, batch->times + numOfAdded, numOfLeft * sizeof(float));
+		batch->len = numOfLeft;
+		return TABLE_NO_MEMORY;
+	}
+	batch->len = 0;
+	return TABLE_SUCCESS;
+}
+
+int parseSeedsFromBytes(const char *line, const char *lineEnd, SeedConsumer consumer,
+                        void *context)
+{
+	const char *cur = line;
+	size_t idOfInfector;
+	if (scanUnsigned(&cur, lineEnd, &idOfInfector) == SCAN_FAILED) // at least one
+	{
+		return SCAN_FAILED;
+	}
+	do
+	{
+		if (consumer(idOfInfector, context) == SCAN_FAILED)
+		{
+			return SCAN_FAILED;
+		}
+	} while (scanUnsigned(&cur, lineEnd, &idOfInfector) == SCAN_SUCCESS);
+	return SCAN_SUCCESS;
+}
+
+/**
+ * A SeedConsumer that adds the seed to the table
+ * @param id The ID of the seed
+ * @param context The TableApplier
+ * @return SCAN_SUCCESS or SCAN_FAILED (the status is in the TableApplier)
+ */
+static int applySeed(size_t id, void *context)
+{
+	TableApplier *applier = (TableApplier *) context;
+	applier->status = addTableSeed(applier->people, id);
+	return applier->status == TABLE_SUCCESS ? SCAN_SUCCESS : SCAN_FAILED;
+}
+
+/**
+ * Reads the first line of a meeting file: the IDs of the seeds (one or more)
+ * @param people The table
+ * @param line The beginning of the line
+ * @param lineEnd The end of the line
+ * @return TABLE_SUCCESS, TABLE_INVALID_INPUT, TABLE_UNKNOWN_PERSON or TABLE_NO_MEMORY
+ */
+static int addSeedsFromLine(PeopleTable *people, const char *line, const char *lineEnd)
+{
+	TableApplier applier = {people, TABLE_SUCCESS};
+	if (parseSeedsFromBytes(line, lineEnd, applySeed, &applier) == SCAN_FAILED)
+	{
+		return applier.status != TABLE_SUCCESS ? applier.status : TABLE_INVALID_INPUT;
+	}
+	return TABLE_SUCCESS;
+}
+
+/**
+ * Reads the first line of the meeting file byte by byte from its descriptor (the pipeline reads
+ * the rest of the file from the same descriptor) and adds its seeds
+ * @param fd The descriptor of the meeting file
+ * @param people The table
+ * @param hasLine Will contain 1 if there was a line, 0 if the file is empty
+ * @return TABLE_SUCCESS, TABLE_OPEN_FAILED (reading failed), TABLE_INVALID_INPUT,
+ * TABLE_UNKNOWN_PERSON or TABLE_NO_MEMORY
+ */
+static int readSeedsFromFd(int fd, PeopleTable *people, int *hasLine)
+{
+	char *line = NULL;
+	size_t capacity = 0;
+	size_t len = 0;
+	char c;
+	ssize_t numOfBytes;
+	while ((numOfBytes = read(fd, &c, 1)) == 1 && c != '\n')
+	{
+		if (ensureArrayCapacity((void **) &line, &capacity, len, sizeof(char)) == GROW_FAILED)
+		{
+			trackedFree(line, capacity);
+			return TABLE_NO_MEMORY;
+		}
+		line[len++] = c;
+	}
+	if (numOfBytes < 0)
+	{
+		trackedFree(line, capacity);
+		return TABLE_OPEN_FAILED;
+	}
+	*hasLine = len > 0 || numOfBytes == 1;
+	COUNT_BYTES_READ(len + (size_t) (numOfBytes == 1));
+	int status = *hasLine ? addSeedsFromLine(people, line, line + len) : TABLE_SUCCESS;
+	trackedFree(line, capacity);
+	return status;
+}
+
+/**
+ * Parses the lines of a block of the meeting file (the parser of the pipeline)
+ * @param begin The beginning of the block
+ * @param end The end of the block
+ * @param meetings Will contain the meetings
+ * @param capacity The room in meetings
+ * @param numOfMeetings Will contain the number of meetings
+ * @return PIPELINE_SUCCESS or PIPELINE_FAILED (an invalid line)
+ */
+static int parseMeetingBlock(const char *begin, const char *end, MeetingInfo *meetings,
+                             size_t capacity, size_t *numOfMeetings)
+{
+	size_t len = 0;
+	const char *cur = begin;
+	while (cur < end)
+	{
+		const char *lineEnd = findLineEnd(cur, end);
+		if (len == capacity || scanMeetingFromBytes(cur, lineEnd, &meetings[len]) == SCAN_FAILED)
+		{
+			return PIPELINE_FAILED;
+		}
+		len++;
+		cur = lineEnd < end ? lineEnd + 1 : end;
+	}
+	*numOfMeetings = len;
+	return PIPELINE_SUCCESS;
+}
+
+/**
+ * Adds the parsed meetings of a block to the table, in the order of the file (the applier of the
+ * pipeline)
+ * @param meetings The meetings
+ * @param numOfMeetings The number of meetings
+ * @param context The TableApplier
+ * @return PIPELINE_SUCCESS or PIPELINE_FAILED (the status is in the TableApplier)
+ */
+static int applyMeetingBatch(const MeetingInfo *meetings, size_t numOfMeetings, void *context)
+{
+	TableApplier *applier = (TableApplier *) context;
+	for (size_t i = 0; i < numOfMeetings; ++i)
+	{
+		applier->status = addTableMeeting(applier->people, &meetings[i]);
+		if (applier->status != TABLE_SUCCESS)
+		{
+			return PIPELINE_FAILED;
+		}
+	}
+	return PIPELINE_SUCCESS;
+}
+
+/**
+ * Reads the meeting file through the pipeline: one thread reads blocks, several threads parse
+ * them and the calling thread adds them to the table (see SpreaderDetectorPipeline.h)
+ * @param path The path of the file
+ * @param people The table
+ * @param numOfParsers The number of parser threads
+ * @param stats Will contain the measurements of the pipeline
+ * @return TABLE_SUCCESS, TABLE_OPEN_FAILED, TABLE_INVALID_INPUT, TABLE_UNKNOWN_PERSON or
+ * TABLE_NO_MEMORY
+ */
+static int readPipelinedMeetings(const char *path, PeopleTable *people, size_t numOfParsers,
+                                 PipelineStats *stats)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return TABLE_OPEN_FAILED;
+	}
+	int hasLine = 0;
+	int status = people->len == NO_PEOPLE_IN_FIRST_FILE ? TABLE_SUCCESS : // the file is empty
+	             readSeedsFromFd(fd, people, &hasLine);
+	if (status != TABLE_SUCCESS || !hasLine)
+	{
+		close(fd);
+		return status;
+	}
+	TableApplier applier = {people, TABLE_SUCCESS};
+	int pipelineStatus = runMeetingPipeline(fd, numOfParsers, parseMeetingBlock,
+	                                        applyMeetingBatch, &applier, stats);
+	close(fd);
+	if (pipelineStatus == PIPELINE_FAILED) // all the threads of the pipeline were already joined
+	{
+		return applier.status != TABLE_SUCCESS ? applier.status : TABLE_INVALID_INPUT;
+	}
+	return TABLE_SUCCESS;
+}
+
+/**
+ * Reads the meeting file line by line (a pipe for example)
+ * @param path The path of the file
+ * @param people The table
+ * @return TABLE_SUCCESS, TABLE_OPEN_FAILED, TABLE_INVALID_INPUT, TABLE_UNKNOWN_PERSON or
+ * TABLE_NO_MEMORY
+ */
+static int readMeetingsStream(const char *path, PeopleTable *people)
+{
+	FILE *inputFile = fopen(path, READING_MODE);
+	if (inputFile == NULL)
+	{
+		return TABLE_OPEN_FAILED;
+	}
+	char currentRow[MAX_LINE_SIZE];
+	int status = TABLE_SUCCESS;
+	//first line. get the ids of the first infectors. (The first line is different from the rest!)
+	if (people->len != NO_PEOPLE_IN_FIRST_FILE && // The first file may be empty
+	    fgets(currentRow, sizeof(currentRow), inputFile))
+	{
+		size_t rowLen = strlen(currentRow);
+		COUNT_BYTES_READ(rowLen);
+		status = addSeedsFromLine(people, currentRow, findLineEnd(currentRow, currentRow + rowLen));
+		// we get the rest of lines. Each line represents a meeting We will look for the people in
+		// the id index (O(1) expected!!) and add the meeting to the graph. The probabilities are
+		// computed only after all the meetings were read, so the meetings can come in any order
+		while (status == TABLE_SUCCESS && fgets(currentRow, sizeof(currentRow), inputFile))
+		{
+			rowLen = strlen(currentRow);
+			COUNT_BYTES_READ(rowLen);
+			MeetingInfo curMeeting;
+			status = scanMeetingFromBytes(currentRow, findLineEnd(currentRow, currentRow + rowLen),
+			                              &curMeeting) == SCAN_FAILED ? TABLE_INVALID_INPUT :
+			         addTableMeeting(people, &curMeeting);
+		}
+	}
+	fclose(inputFile);
+	return status;
+}
+
+/**
+ * Reads the meeting file from its mapping
+ * @param meetingsFile The mapped file
+ * @param people The table
+ * @return TABLE_SUCCESS, TABLE_INVALID_INPUT, TABLE_UNKNOWN_PERSON or TABLE_NO_MEMORY
+ */
+static int readMappedMeetings(const MappedFile *meetingsFile, PeopleTable *people)
+{
+	const char *cur = meetingsFile->data;
+	const char *end = cur + meetingsFile->len;
+	if (cur == end) // empty file
+	{
+		return TABLE_SUCCESS;
+	}
+	madvise((void *) meetingsFile->data, meetingsFile->len, MADV_SEQUENTIAL); // only a hint
+	//first line. get the ids of the first infectors. (The first line is different from the rest!)
+	const char *lineEnd = findLineEnd(cur, end);
+	int status = addSeedsFromLine(people, cur, lineEnd);
+	cur = lineEnd < end ? lineEnd + 1 : end;
+	while (status == TABLE_SUCCESS && cur < end)
+	{
+		lineEnd = findLineEnd(cur, end);
+		MeetingInfo curMeeting;
+		status = scanMeetingFromBytes(cur, lineEnd, &curMeeting) == SCAN_FAILED ?
+		         TABLE_INVALID_INPUT : addTableMeeting(people, &curMeeting);
+		cur = lineEnd < end ? lineEnd + 1 : end;
+	}
+	return status;
+}
+
+/**
+ * Adds the seeds and the meetings of a meetings snapshot (already parsed)
+ * @param meetingsSnapshot The snapshot
+ * @param people The table
+ * @return TABLE_SUCCESS, TABLE_UNKNOWN_PERSON or TABLE_NO_MEMORY
+ */
+static int readSnapshotMeetings(const Snapshot *meetingsSnapshot, PeopleTable *people)
+{
+	int status = TABLE_SUCCESS;
+	for (size_t i = 0; i < meetingsSnapshot->extraCount && status == TABLE_SUCCESS; ++i)
+	{
+		status = addTableSeed(people, meetingsSnapshot->seeds[i]);
+	}
+	for (size_t i = 0; i < meetingsSnapshot->count && status == TABLE_SUCCESS; ++i)
+	{
+		status = addTableMeeting(people, &meetingsSnapshot->meetings[i]);
+	}
+	return status;
+}
+
+int loadTableMeetings(PeopleTable *people, const char *path, size_t numOfParsers,
+                      PipelineStats *stats)
+{
+	stats->numOfParsers = 0;
+	Snapshot meetingsSnapshot = {0};
+	int snapshotStatus = openSnapshot(path, SNAPSHOT_MEETINGS, &meetingsSnapshot);
+	int status = TABLE_SUCCESS;
+	if (snapshotStatus == SNAPSHOT_OPEN_FAILED)
+	{
+		return TABLE_OPEN_FAILED;
+	}
+	else if (snapshotStatus == SNAPSHOT_SUCCESS)
+	{
+		if (people->len != NO_PEOPLE_IN_FIRST_FILE) // The first file may be empty
+		{
+			status = readSnapshotMeetings(&meetingsSnapshot, people);
+		}
+		closeSnapshot(&meetingsSnapshot);
+	}
+	else if (snapshotStatus != SNAPSHOT_NOT_SNAPSHOT) // an invalid snapshot is an invalid file
+	{
+		return TABLE_INVALID_INPUT;
+	}
+	else if (numOfParsers != NO_PIPELINE)
+	{
+		status = readPipelinedMeetings(path, people, numOfParsers, stats);
+	}
+	else
+	{
+		MappedFile meetingsFile = {0};
+		int mapStatus = mapInputFile(path, &meetingsFile);
+		if (mapStatus == MAP_OPEN_FAILED)
+		{
+			return TABLE_OPEN_FAILED;
+		}
+		else if (mapStatus == MAP_NOT_MAPPABLE) // a pipe for example
+		{
+			status = readMeetingsStream(path, people);
+		}
+		else
+		{
+			if (people->len != NO_PEOPLE_IN_FIRST_FILE) // The first file may be empty
+			{
+				status = readMappedMeetings(&meetingsFile, people);
+			}
+			unmapInputFile(&meetingsFile);
+		}
+	}
+	return status == TABLE_SUCCESS ? flushTableBatch(people) : status; // the last batch
+}
+
+int propagatePeopleTable(PeopleTable *people, int combineRule, size_t numOfThreads)
+{
+	if (people->len != NO_PEOPLE_IN_FIRST_FILE && // no graph at all without people
+		propagateRisk(&people->contacts, people->len, people->ids, combineRule, numOfThreads,
+		              people->probsInfected) == GRAPH_FAILED)
+	{
+		return TABLE_NO_MEMORY;
+	}
+	return TABLE_SUCCESS;
+}
+
+int beginTableUpdates(PeopleTable *people, int combineRule)
+{
+	if (people->len != NO_PEOPLE_IN_FIRST_FILE && // no graph at all without people
+		initIncrementalGraph(&people->incremental, &people->contacts, people->len, people->ids,
+		                     combineRule, people->probsInfected) == INCREMENTAL_FAILED)
+	{
+		return TABLE_NO_MEMORY;
+	}
+	people->isIncremental = 1;
+	return TABLE_SUCCESS;
+}
+
+int orderPeopleTable(const PeopleTable *people, const RiskPolicy *policy, size_t top, float minProb,
+                     unsigned int maxClass, size_t numOfThreads, ProbSortKey **order,
+                     size_t *numOfKeys)
+{
+	*order = NULL;
+	*numOfKeys = 0;
+	// The classes of everyone in one pass over the columns: the keys are sorted by them first
+	unsigned char *classes = (unsigned char *) trackedMalloc(people->len ? people->len : 1);
+	if (classes == NULL)
+	{
+		return TABLE_NO_MEMORY;
+	}
+	classifyPeople(policy, people->ages, people->probsInfected, people->len, classes);
+	int isSelection = top != NO_TOP || minProb != NO_MIN_PROB || maxClass != NO_MAX_CLASS;
+	size_t len = !isSelection ? people->len :
+	             countAtLeastProbability(people->probsInfected, classes, people->len, minProb,
+	                                     maxClass);
+	if (top != NO_TOP && top < len)
+	{
+		len = top;
+	}
+	ProbSortKey *keys = (ProbSortKey *) trackedMalloc(len * sizeof(ProbSortKey));
+	int status = keys != NULL || len == 0 ? TABLE_SUCCESS : TABLE_NO_MEMORY;
+	if (status == TABLE_SUCCESS && top != NO_TOP && len > 0) // only k keys at a time, sorted
+	{
+		selectTopByProbability(people->ids, people->probsInfected, classes, people->len, minProb,
+		                       maxClass, len, keys);
+	}
+	else if (status == TABLE_SUCCESS)
+	{
+		if (isSelection)
+		{
+			selectAtLeastProbability(people->ids, people->probsInfected, classes, people->len,
+			                         minProb, maxClass, keys);
+		}
+		else
+		{
+			for (size_t i = 0; i < len; ++i)
+			{
+				keys[i].id = people->ids[i];
+				keys[i].row = i;
+				keys[i].probInfected = people->probsInfected[i];
+				keys[i].riskClass = classes[i];
+			}
+		}
+		//Sort the rows according to the class and the probability of infection
+		if (sortByProbability(keys, len, numOfThreads) == ORDER_FAILED)
+		{
+			status = TABLE_NO_MEMORY;
+		}
+	}
+	trackedFree(classes, people->len ? people->len : 1);
+	if (status != TABLE_SUCCESS)
+	{
+		trackedFree(keys, keys != NULL ? len * sizeof(ProbSortKey) : 0);
+		return status;
+	}
+	*order = keys;
+	*numOfKeys = len;
+	return TABLE_SUCCESS;
+}
+
+int writePeopleTable(const PeopleTable *people, const ProbSortKey *order, size_t numOfKeys,
+                     const char *path)
+{
+	OutputWriter writer = {0};
+	int openStatus = openOutputWriter(&writer, path);
+	if (openStatus != WRITER_SUCCESS)
+	{
+		return openStatus == WRITER_OPEN_FAILED ? TABLE_OPEN_FAILED : TABLE_NO_MEMORY;
+	}
+	for (size_t i = 0; i < numOfKeys; ++i) // the keys already have the classes of the policy
+	{
+		manageToOutputFile(&writer, people, order[i].row, order[i].riskClass);
+	}
+	return closeOutputWriter(&writer) == WRITER_SUCCESS ? TABLE_SUCCESS : TABLE_WRITE_FAILED;
+}
+
+void manageToOutputFile(OutputWriter *writer, const PeopleTable *people, size_t row,
+                        unsigned int riskClass)
+{
+	writePersonLine(writer, people->names[row], people->nameLengths[row], people->ids[row],
+	                riskClass);
+}
+
+int mapInputFile(const char *path, MappedFile *file)
+{
+	file->data = NULL;
+	file->len = 0;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return MAP_OPEN_FAILED;
+	}
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+	{
+		close(fd);
+		return MAP_NOT_MAPPABLE;
+	}
+	if (fileStat.st_size == 0) // nothing to map (mmap does not accept an empty mapping)
+	{
+		close(fd);
+		return MAP_SUCCESS;
+	}
+	void *data = mmap(NULL, (size_t) fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping stays valid after closing the file
+	if (data == MAP_FAILED)
+	{
+		return MAP_NOT_MAPPABLE;
+	}
+	file->data = (const char *) data;
+	file->len = (size_t) fileStat.st_size;
+	COUNT_BYTES_READ(file->len);
+	return MAP_SUCCESS;
+}
+
+void unmapInputFile(MappedFile *file)
+{
+	if (file->data != NULL)
+	{
+		munmap((void *) file->data, file->len);
+	}
+	file->data = NULL;
+	file->len = 0;
+}
+
+void freePeopleTable(PeopleTable *people)
+{
+	if (people == NULL)
+	{
+		return;
+	}
+	size_t capacity = people->capacity;
+	if (!areColumnsInSnapshot(people))
+	{
+		trackedFree(people->ids, capacity * sizeof(size_t));
+		trackedFree(people->ages, capacity * sizeof(float));
+		trackedFree(people->probsInfected, capacity * sizeof(float));
+		trackedFree(people->nameLengths, capacity * sizeof(unsigned int));
+	}
+	people->ids = NULL;
+	people->ages = NULL;
+	people->probsInfected = NULL;
+	people->nameLengths = NULL;
+	trackedFree((void *) people->names, capacity * sizeof(const char *));
+	people->names = NULL;
+	arenaDestroy(&people->namesArena); // all the names at once
+	freeIdIndex(&people->idIndex);
+	freeContactGraph(&people->contacts);
+	freeIncrementalGraph(&people->incremental);
+	unmapInputFile(&people->peopleFile);
+	closeSnapshot(&people->peopleSnapshot);
+	people->len = 0;
+	people->capacity = 0;
+	people->meetingBatch.len = 0;
+	people->isIncremental = 0;
+}
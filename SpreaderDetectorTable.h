@@ -0,0 +1,427 @@
+/**
+* @file SpreaderDetectorTable.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The table of people in memory: loading the input files, the propagation and the output
+* @section DESCRIPTION
+* The in-memory mode of the command line tool and the engine (SpreaderDetectorEngine.h) keep the
+* same table, and they load it, propagate the risk over it and write it by the functions of this
+* file:
+* - loadPeopleTable reads a people file (a snapshot, a mapped file parsed by several threads or a
+*   file read line by line) and indexPeopleTable builds the index of the IDs.
+* - loadTableMeetings reads a meeting file (a snapshot, a pipeline of parser threads, a mapped file
+*   or a file read line by line) into the contact graph, a batch of meetings at a time.
+* - propagatePeopleTable computes the probabilities. After beginTableUpdates the table takes new
+*   meetings into an incremental graph (see SpreaderDetectorIncremental.h) instead.
+* - orderPeopleTable sorts the people (or only the selected ones) into the order of the output
+*   file, and writePeopleTable writes them.
+* No function of the table exits or prints: every error is returned as one of the TABLE_ codes, and
+* the table stays valid (and can be freed) after any error.
+*/
+
+#ifndef EXAM_SPREADERDETECTORTABLE_H
+#define EXAM_SPREADERDETECTORTABLE_H
+
+#include <stddef.h>
+#include <math.h>
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorGraph.h"
+#include "SpreaderDetectorIdIndex.h"
+#include "SpreaderDetectorIncremental.h"
+#include "SpreaderDetectorOrder.h"
+#include "SpreaderDetectorPipeline.h"
+#include "SpreaderDetectorPolicy.h"
+#include "SpreaderDetectorSnapshot.h"
+#include "SpreaderDetectorWriter.h"
+
+/**
+ * @def TABLE_SUCCESS 0
+ * @brief Returned by the functions of the table when they succeeded
+ */
+#define TABLE_SUCCESS 0
+
+/**
+ * @def TABLE_OPEN_FAILED 1
+ * @brief An input file (or the output file) could not be opened
+ */
+#define TABLE_OPEN_FAILED 1
+
+/**
+ * @def TABLE_INVALID_INPUT 2
+ * @brief A line of an input file is not in the format of its file, or a snapshot is invalid
+ */
+#define TABLE_INVALID_INPUT 2
+
+/**
+ * @def TABLE_UNKNOWN_PERSON 3
+ * @brief There is no person with this ID (a seed or a meeting)
+ */
+#define TABLE_UNKNOWN_PERSON 3
+
+/**
+ * @def TABLE_NO_MEMORY 4
+ * @brief An allocation failed
+ */
+#define TABLE_NO_MEMORY 4
+
+/**
+ * @def TABLE_WRITE_FAILED 5
+ * @brief Writing the output file failed
+ */
+#define TABLE_WRITE_FAILED 5
+
+/**
+ * @def NO_PEOPLE_IN_FIRST_FILE 0
+ * @brief Indicates that the people file is empty
+ */
+#define NO_PEOPLE_IN_FIRST_FILE 0
+
+/**
+ * @def NO_TOP 0
+ * @brief orderPeopleTable keeps everyone who passes the threshold, not only the first k
+ */
+#define NO_TOP 0
+
+/**
+ * @def NO_MIN_PROB (-INFINITY)
+ * @brief orderPeopleTable keeps everyone, whatever his probability is
+ */
+#define NO_MIN_PROB (-INFINITY)
+
+/**
+ * @def NO_MAX_CLASS CLEAN_CLASS
+ * @brief The class given to orderPeopleTable when the people are not selected by their class
+ * (every class is at most CLEAN_CLASS)
+ */
+#define NO_MAX_CLASS CLEAN_CLASS
+
+/**
+ * @def NO_PIPELINE 0
+ * @brief loadTableMeetings reads the meeting file on the calling thread, without the pipeline
+ */
+#define NO_PIPELINE 0
+
+/**
+ * @def MAP_SUCCESS 0
+ * @brief The input file was mapped into memory (or it is empty, and there is nothing to map)
+ */
+#define MAP_SUCCESS 0
+
+/**
+ * @def MAP_OPEN_FAILED 1
+ * @brief The input file could not be opened at all. This is an error in the input files
+ */
+#define MAP_OPEN_FAILED 1
+
+/**
+ * @def MAP_NOT_MAPPABLE 2
+ * @brief The input file was opened but it can not be mapped (for example a pipe). In this case we
+ * read it line by line with fgets as before
+ */
+#define MAP_NOT_MAPPABLE 2
+
+/**
+ * @def INIT_CAPACITY 64
+ * @brief The number of elements a growing array (a column of the people table, the edges of a
+ * graph) can hold before the first growth. From there every growth multiplies the capacity by
+ * GROWTH_FACTOR, so adding n elements costs O(n) copies in total. (A mapped people file is counted
+ * first, and its columns are allocated once in their exact size)
+ */
+#define INIT_CAPACITY 64
+
+/**
+ * @def GROWTH_FACTOR 2
+ * @brief Every time a growing array (or the names arena) is full we multiply its capacity by this
+ * factor
+ */
+#define GROWTH_FACTOR 2
+
+/**
+ * @def GROW_FAILED 0
+ * @brief Returned by the functions that grow the table when the allocation failed. (They don't
+ * exit by themselves, because they are also called from the loading threads)
+ */
+#define GROW_FAILED 0
+
+/**
+ * @def GROW_SUCCESS 1
+ * @brief Returned by the functions that grow the table when there is room for the new person
+ */
+#define GROW_SUCCESS 1
+
+/**
+ * A function that gets the IDs of the seeds of a meeting file one by one (see parseSeedsFromBytes)
+ * @param id The ID of the seed
+ * @param context The context given to parseSeedsFromBytes
+ * @return SCAN_SUCCESS, or SCAN_FAILED to stop (the context keeps why)
+ */
+typedef int (*SeedConsumer)(size_t id, void *context);
+
+/**
+ * @struct MappedFile
+ * @brief An input file mapped into memory (read only). We parse the bytes directly from the
+ * mapping, without copying them into line buffers
+ */
+typedef struct MappedFile
+{
+	const char *data;
+	size_t len;
+} MappedFile;
+
+/**
+ * @struct PeopleTable
+ * @brief Represents all the people received in the first input file as a structure of arrays.
+ * Row i of the table is the person whose details are in ids[i], ages[i], probsInfected[i] and so
+ * on. Every column is contiguous, so the sort by ID and the lookups only touch the ids, and the
+ * sort by probability only touches the probabilities. The row of a person is found by his ID
+ * through idIndex (see SpreaderDetectorIdIndex.h). Each person references his name by a
+ * pointer and a length. When the people file is mapped into memory (peopleFile) the names are not
+ * copied at all: they point into the mapped file itself. Otherwise they are copied one after the
+ * other into the slabs of one shared arena (namesArena), which is released in O(number of slabs).
+ * When the people file is a snapshot (peopleSnapshot) all the columns except the pointers to the
+ * names are the columns of the snapshot itself, and they are not allocated at all. The meetings
+ * that were read are collected into meetingBatch, and added to the graph (contacts) a batch at a
+ * time, or to the incremental graph once isIncremental is set (see beginTableUpdates)
+ */
+typedef struct PeopleTable
+{
+	size_t *ids;
+	float *ages;
+	float *probsInfected;
+	const char **names;
+	unsigned int *nameLengths;
+	size_t len;
+	size_t capacity;
+	Arena namesArena;
+	MappedFile peopleFile;
+	Snapshot peopleSnapshot;
+	IdIndex idIndex;
+	ContactGraph contacts;
+	MeetingBatch meetingBatch;
+	IncrementalGraph incremental;
+	int isIncremental;
+} PeopleTable;
+
+/**
+ * Adds all the people of a people file. The first file of an empty table is read in the fastest
+ * way it can: a snapshot is used as it is, and a regular file is mapped and parsed by several
+ * threads. Any other file (a pipe, or a file added to a table that already has people) is read
+ * line by line
+ * @param people The table
+ * @param path The path of the file
+ * @param numOfThreads The maximal number of threads that parse a mapped file
+ * @return TABLE_SUCCESS, TABLE_OPEN_FAILED, TABLE_INVALID_INPUT (the lines before the invalid one
+ * were added) or TABLE_NO_MEMORY
+ */
+int loadPeopleTable(PeopleTable *people, const char *path, size_t numOfThreads);
+
+/**
+ * Adds one person
+ * @param people The table
+ * @param name The name (not '\0' terminated, it is copied into the names arena)
+ * @param nameLen The length of the name
+ * @param id The ID
+ * @param age The age
+ * @return TABLE_SUCCESS or TABLE_NO_MEMORY
+ */
+int addTablePerson(PeopleTable *people, const char *name, size_t nameLen, size_t id, float age);
+
+/**
+ * Parses one line of the people file into a row of the table (the name is not copied: it points
+ * into the line)
+ * @param line The beginning of the line
+ * @param lineEnd The end of the line (its '\n' or the end of the file)
+ * @param people The table (with room for the row)
+ * @param row The row
+ * @return SCAN_SUCCESS or SCAN_FAILED
+ */
+int parsePersonFromBytes(const char *line, const char *lineEnd, PeopleTable *people, size_t row);
+
+/**
+ * Parses the first line of a meeting file: the IDs of the seeds (one or more), and gives them to a
+ * consumer in the order of the line
+ * @param line The beginning of the line
+ * @param lineEnd The end of the line
+ * @param consumer The consumer of the IDs
+ * @param context Given to the consumer
+ * @return SCAN_SUCCESS, or SCAN_FAILED (the line has no ID, or the consumer stopped)
+ */
+int parseSeedsFromBytes(const char *line, const char *lineEnd, SeedConsumer consumer,
+                        void *context);
+
+/**
+ * Makes sure the columns have room for one more person, by multiplying their capacity by
+ * GROWTH_FACTOR if they are full
+ * @param people The table
+ * @return GROW_SUCCESS or GROW_FAILED
+ */
+int ensurePeopleCapacity(PeopleTable *people);
+
+/**
+ * Grows the columns to a given capacity (the columns of a snapshot are copied into allocated
+ * columns first)
+ * @param people The table
+ * @param newCapacity The capacity (nothing is done if it is not larger than the current one)
+ * @return GROW_SUCCESS or GROW_FAILED (the table stays valid)
+ */
+int reservePeopleCapacity(PeopleTable *people, size_t newCapacity);
+
+/**
+ * Makes sure an array has room for one more element, by multiplying its capacity by GROWTH_FACTOR
+ * (INIT_CAPACITY the first time)
+ * @param array The array (may point to NULL)
+ * @param capacity The capacity of the array (updated)
+ * @param len The number of elements in the array
+ * @param elementSize The size of an element
+ * @return GROW_SUCCESS or GROW_FAILED (the array is not changed)
+ */
+int ensureArrayCapacity(void **array, size_t *capacity, size_t len, size_t elementSize);
+
+/**
+ * Grows an array to a new capacity (for the arrays that share one capacity, like the edges of a
+ * graph)
+ * @param array The array (may point to NULL)
+ * @param capacity The number of elements the array holds now
+ * @param newCapacity The number of elements the array will hold
+ * @param elementSize The size of an element
+ * @return GROW_SUCCESS or GROW_FAILED (the array is not changed)
+ */
+int resizeArray(void **array, size_t capacity, size_t newCapacity, size_t elementSize);
+
+/**
+ * Builds the index of the IDs. With SORTED_ID_INDEX the rows are sorted by ID first (the rows are
+ * moved, and a repeated ID keeps the order of its people)
+ * @param people The table (the probabilities are still INIT_PROB)
+ * @return TABLE_SUCCESS or TABLE_NO_MEMORY
+ */
+int indexPeopleTable(PeopleTable *people);
+
+/**
+ * Finds the row of a person
+ * @param people The table (indexed)
+ * @param id The ID of the person
+ * @param row Will contain the row (the first person with this ID)
+ * @return TABLE_SUCCESS or TABLE_UNKNOWN_PERSON
+ */
+int findTableRow(const PeopleTable *people, size_t id, size_t *row);
+
+/**
+ * Adds a seed (a person who is sick for sure) to the contact graph
+ * @param people The table (indexed)
+ * @param id The ID of the person
+ * @return TABLE_SUCCESS, TABLE_UNKNOWN_PERSON or TABLE_NO_MEMORY
+ */
+int addTableSeed(PeopleTable *people, size_t id);
+
+/**
+ * Adds a meeting to the batch (a full batch is flushed first)
+ * @param people The table (indexed)
+ * @param meeting The meeting
+ * @return TABLE_SUCCESS, TABLE_UNKNOWN_PERSON or TABLE_NO_MEMORY
+ */
+int addTableMeeting(PeopleTable *people, const MeetingInfo *meeting);
+
+/**
+ * Adds the meetings of the batch to the contact graph (or to the incremental graph after
+ * beginTableUpdates), and empties the batch
+ * @param people The table
+ * @return TABLE_SUCCESS or TABLE_NO_MEMORY (the meetings that were not added stay in the batch)
+ */
+int flushTableBatch(PeopleTable *people);
+
+/**
+ * Adds the seeds (the first line) and all the meetings of a meeting file, and flushes the last
+ * batch. A table without people only opens the file (by the format its meeting file is empty)
+ * @param people The table (indexed)
+ * @param path The path of the file (a meetings snapshot or a text file)
+ * @param numOfParsers The number of parser threads of the pipeline (see
+ * SpreaderDetectorPipeline.h), or NO_PIPELINE
+ * @param stats Will contain the measurements of the pipeline, if it ran (its numOfParsers is left
+ * 0 otherwise)
+ * @return TABLE_SUCCESS, TABLE_OPEN_FAILED, TABLE_INVALID_INPUT, TABLE_UNKNOWN_PERSON or
+ * TABLE_NO_MEMORY
+ */
+int loadTableMeetings(PeopleTable *people, const char *path, size_t numOfParsers,
+                      PipelineStats *stats);
+
+/**
+ * Propagates the risk over all the meetings that were added into the probabilities column
+ * @param people The table
+ * @param combineRule COMBINE_MAX or COMBINE_NOISY_OR (see SpreaderDetectorGraph.h)
+ * @param numOfThreads The maximal number of threads
+ * @return TABLE_SUCCESS or TABLE_NO_MEMORY
+ */
+int propagatePeopleTable(PeopleTable *people, int combineRule, size_t numOfThreads);
+
+/**
+ * Moves the contact graph into the incremental graph (after propagatePeopleTable). From then on
+ * the meetings are added to the incremental graph, and propagateBatch brings the probabilities up
+ * to date with them
+ * @param people The table
+ * @param combineRule The rule the table was propagated by
+ * @return TABLE_SUCCESS or TABLE_NO_MEMORY
+ */
+int beginTableUpdates(PeopleTable *people, int combineRule);
+
+/**
+ * Sorts the people into the order of the output file (by the classes of a policy first, see
+ * SpreaderDetectorOrder.h). When only the people whose probability is at least a threshold, or
+ * whose class is at least as risky as a given class, or only the first k, are asked for, they are
+ * selected first and only they are sorted
+ * @param people The table
+ * @param policy The policy of the classes
+ * @param top The number of people to keep, or NO_TOP
+ * @param minProb The threshold, or NO_MIN_PROB
+ * @param maxClass The last class that is kept, or NO_MAX_CLASS
+ * @param numOfThreads The maximal number of threads of the sort
+ * @param order Will point to the keys (allocated, numOfKeys of them, with the class of every
+ * person)
+ * @param numOfKeys Will contain the number of keys
+ * @return TABLE_SUCCESS or TABLE_NO_MEMORY
+ */
+int orderPeopleTable(const PeopleTable *people, const RiskPolicy *policy, size_t top, float minProb,
+                     unsigned int maxClass, size_t numOfThreads, ProbSortKey **order,
+                     size_t *numOfKeys);
+
+/**
+ * Writes the people of an order to an output file (one line for each, by the class in his key)
+ * @param people The table
+ * @param order The keys of the people (see orderPeopleTable)
+ * @param numOfKeys The number of keys
+ * @param path The path of the output file
+ * @return TABLE_SUCCESS, TABLE_OPEN_FAILED, TABLE_WRITE_FAILED or TABLE_NO_MEMORY
+ */
+int writePeopleTable(const PeopleTable *people, const ProbSortKey *order, size_t numOfKeys,
+                     const char *path);
+
+/**
+ * Writes the line of one person to the output
+ * @param writer The output
+ * @param people The table
+ * @param row The row of the person
+ * @param riskClass The class of the person
+ */
+void manageToOutputFile(OutputWriter *writer, const PeopleTable *people, size_t row,
+                        unsigned int riskClass);
+
+/**
+ * Maps an input file into memory
+ * @param path The path of the file
+ * @param file Will contain the mapping
+ * @return MAP_SUCCESS, MAP_OPEN_FAILED or MAP_NOT_MAPPABLE
+ */
+int mapInputFile(const char *path, MappedFile *file);
+
+/**
+ * Unmaps a file that was mapped by mapInputFile (an empty mapping is ignored)
+ * @param file The mapping
+ */
+void unmapInputFile(MappedFile *file);
+
+/**
+ * Releases everything in the table, and turns it into an empty table
+ * @param people The table (NULL is ignored)
+ */
+void freePeopleTable(PeopleTable *people);
+
+#endif //EXAM_SPREADERDETECTORTABLE_H
@@ -0,0 +1,638 @@
+/**
+* @file SpreaderDetectorValidate.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the validation of the input files (see the header)
+* @section DESCRIPTION
+* A chunk keeps the line numbers of its problems and of its people from its own first line, since
+* the first line of a chunk is known only after all the chunks before it were counted. The ID
+* table keeps the line (from the beginning of the file) of the first person of every ID, and line
+* 0 marks an empty slot.
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SpreaderDetectorValidate.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorScan.h"
+#include "SpreaderDetectorTable.h"
+
+/**
+ * @def MIN_BYTES_PER_CHUNK (1 << 20)
+ * @brief A file is split into chunks of at least 1MB (a smaller file is checked by one thread)
+ */
+#define MIN_BYTES_PER_CHUNK (1 << 20)
+
+/**
+ * @def FIRST_LINE 1
+ * @brief The number of the first line of a file
+ */
+#define FIRST_LINE 1
+
+/**
+ * @def EMPTY_ID_SLOT 0
+ * @brief The line of an empty slot of the ID table (there is no line 0)
+ */
+#define EMPTY_ID_SLOT 0
+
+/**
+ * @def ID_SLOTS_PER_PERSON 2
+ * @brief The ID table has at least 2 slots per person
+ */
+#define ID_SLOTS_PER_PERSON 2
+
+/**
+ * @def MIN_ID_SLOTS_BITS 4
+ * @brief The ID table has at least 2^4 slots
+ */
+#define MIN_ID_SLOTS_BITS 4
+
+/**
+ * @def ID_HASH_MULTIPLIER 0x9E3779B97F4A7C15ull
+ * @brief The multiplier of the Fibonacci hashing of the IDs
+ */
+#define ID_HASH_MULTIPLIER 0x9E3779B97F4A7C15ull
+
+/**
+ * @def BITS_IN_HASH 64
+ * @brief The number of bits of the product of the hash
+ */
+#define BITS_IN_HASH 64
+
+/**
+ * @struct ValidationIssue
+ * @brief One problem: its line (from the first line of its chunk), its kind, and what the report
+ * says about it (the ID, the line of the first person with the ID, the role of the person in the
+ * meeting, the distance)
+ */
+typedef struct ValidationIssue
+{
+	size_t line;
+	int kind;
+	size_t id;
+	size_t firstLine;
+	const char *role;
+	float distance;
+} ValidationIssue;
+
+/**
+ * @struct IdLine
+ * @brief An ID and its line: a person of a chunk (the line from the first line of the chunk), or
+ * a slot of the ID table (the line from the beginning of the file)
+ */
+typedef struct IdLine
+{
+	size_t id;
+	size_t line;
+} IdLine;
+
+/**
+ * @struct IdTable
+ * @brief The open addressing table of the IDs of the people file
+ */
+typedef struct IdTable
+{
+	IdLine *slots;
+	size_t numOfSlots;
+	unsigned int shift;
+} IdTable;
+
+/**
+ * @struct ValidationChunk
+ * @brief Whole lines of a file that are checked by one thread, and what was found in them
+ */
+typedef struct ValidationChunk
+{
+	const char *begin;
+	const char *end;
+	size_t firstLine;
+	size_t numOfLines;
+	ValidationIssue *issues;
+	size_t numOfListed;
+	size_t issuesCapacity;
+	size_t numOfIssues[NUM_OF_ISSUE_KINDS];
+	IdLine *people;
+	size_t numOfPeople;
+	size_t peopleCapacity;
+	const IdTable *table;
+	int status;
+} ValidationChunk;
+
+/**
+ * Counts a problem of a chunk, and lists it if the chunk did not list VALIDATION_MAX_LISTED yet
+ * @param chunk The chunk
+ * @param kind The kind of the problem
+ * @param line The line (from the first line of the chunk)
+ * @return The listed problem (the caller fills what the report says about it), or NULL
+ */
+static ValidationIssue *addIssue(ValidationChunk *chunk, int kind, size_t line)
+{
+	chunk->numOfIssues[kind]++;
+	if (chunk->numOfListed == VALIDATION_MAX_LISTED)
+	{
+		return NULL;
+	}
+	if (ensureArrayCapacity((void **) &chunk->issues, &chunk->issuesCapacity, chunk->numOfListed,
+	                        sizeof(ValidationIssue)) == GROW_FAILED)
+	{
+		chunk->status = VALIDATION_FAILED;
+		return NULL;
+	}
+	ValidationIssue *issue = &chunk->issues[chunk->numOfListed++];
+	memset(issue, 0, sizeof(ValidationIssue));
+	issue->line = line;
+	issue->kind = kind;
+	return issue;
+}
+
+/**
+ * Returns the first slot to look at for an ID
+ * @param table The table
+ * @param id The ID
+ * @return The slot
+ */
+static size_t slotOfId(const IdTable *table, size_t id)
+{
+	return (size_t) (((uint64_t) id * ID_HASH_MULTIPLIER) >> table->shift);
+}
+
+/**
+ * Returns the slot of an ID, or the empty slot where it would be inserted
+ * @param table The table
+ * @param id The ID
+ * @return The slot
+ */
+static IdLine *findIdSlot(const IdTable *table, size_t id)
+{
+	size_t mask = table->numOfSlots - 1;
+	size_t slot = slotOfId(table, id);
+	while (table->slots[slot].line != EMPTY_ID_SLOT && table->slots[slot].id != id)
+	{
+		slot = (slot + 1) & mask;
+	}
+	return &table->slots[slot];
+}
+
+/**
+ * Is there a person with this ID
+ * @param table The table
+ * @param id The ID
+ * @return 1 if there is, 0 otherwise
+ */
+static int isKnownId(const IdTable *table, size_t id)
+{
+	return findIdSlot(table, id)->line != EMPTY_ID_SLOT;
+}
+
+/**
+ * Counts (and lists) a problem of a chunk if there is no person with this ID
+ * @param chunk The chunk (its table is the ID table)
+ * @param id The ID
+ * @param role The role of the person in the line ("seed", "infector" or "infected")
+ * @param line The line (from the first line of the chunk)
+ */
+static void checkId(ValidationChunk *chunk, size_t id, const char *role, size_t line)
+{
+	if (isKnownId(chunk->table, id))
+	{
+		return;
+	}
+	ValidationIssue *issue = addIssue(chunk, ISSUE_UNKNOWN_PERSON, line);
+	if (issue != NULL)
+	{
+		issue->id = id;
+		issue->role = role;
+	}
+}
+
+/**
+ * Splits bytes into chunks of whole lines. Each chunk starts right after the '\n' that ends the
+ * previous chunk, so every line belongs to exactly one chunk
+ * @param data The bytes
+ * @param len The number of bytes
+ * @param chunks The chunks (zeroed)
+ * @param numOfChunks The number of chunks
+ */
+static void splitIntoChunks(const char *data, size_t len, ValidationChunk *chunks,
+                            size_t numOfChunks)
+{
+	const char *end = data + len;
+	const char *chunkBegin = data;
+	for (size_t i = 0; i < numOfChunks; ++i)
+	{
+		const char *chunkEnd = end;
+		if (i + 1 < numOfChunks)
+		{
+			const char *target = data + len / numOfChunks * (i + 1);
+			chunkEnd = findLineEnd(target < chunkBegin ? chunkBegin : target, end);
+			chunkEnd = chunkEnd < end ? chunkEnd + 1 : end;
+		}
+		chunks[i].begin = chunkBegin;
+		chunks[i].end = chunkEnd;
+		chunks[i].status = VALIDATION_SUCCESS;
+		chunkBegin = chunkEnd;
+	}
+}
+
+/**
+ * Runs a task on every chunk, each one on its own thread (the calling thread takes the first
+ * chunk, and the chunks whose thread could not be created)
+ * @param task The task
+ * @param chunks The chunks
+ * @param numOfChunks The number of chunks
+ */
+static void runOnChunks(void *(*task)(void *), ValidationChunk *chunks, size_t numOfChunks)
+{
+	pthread_t *threads = (pthread_t *) trackedCalloc(numOfChunks, sizeof(pthread_t));
+	int *started = (int *) trackedCalloc(numOfChunks, sizeof(int));
+	for (size_t i = 1; i < numOfChunks && threads != NULL && started != NULL; ++i)
+	{
+		started[i] = pthread_create(&threads[i], NULL, task, &chunks[i]) == 0;
+	}
+	task(&chunks[0]);
+	for (size_t i = 1; i < numOfChunks; ++i)
+	{
+		if (started != NULL && started[i])
+		{
+			pthread_join(threads[i], NULL);
+		}
+		else // no thread, so this thread does the work
+		{
+			task(&chunks[i]);
+		}
+	}
+	trackedFree(threads, numOfChunks * sizeof(pthread_t));
+	trackedFree(started, numOfChunks * sizeof(int));
+}
+
+/**
+ * Checks the lines of a chunk of the people file, and keeps the ID of every valid line
+ * @param arg pointer to "ValidationChunk"
+ * @return NULL
+ */
+static void *checkPeopleChunk(void *arg)
+{
+	ValidationChunk *chunk = (ValidationChunk *) arg;
+	const char *cur = chunk->begin;
+	size_t line = 0;
+	while (cur < chunk->end && chunk->status == VALIDATION_SUCCESS)
+	{
+		const char *lineEnd = findLineEnd(cur, chunk->end);
+		const char *name;
+		size_t nameLen;
+		size_t id;
+		float age;
+		// The same scan as the loaders
+		if (scanPersonFromBytes(cur, lineEnd, &name, &nameLen, &id, &age) == SCAN_FAILED)
+		{
+			addIssue(chunk, ISSUE_MALFORMED_PERSON, line);
+		}
+		else if (ensureArrayCapacity((void **) &chunk->people, &chunk->peopleCapacity,
+		                             chunk->numOfPeople, sizeof(IdLine)) == GROW_FAILED)
+		{
+			chunk->status = VALIDATION_FAILED;
+		}
+		else
+		{
+			chunk->people[chunk->numOfPeople].id = id;
+			chunk->people[chunk->numOfPeople].line = line;
+			chunk->numOfPeople++;
+		}
+		line++;
+		cur = lineEnd < chunk->end ? lineEnd + 1 : chunk->end;
+	}
+	chunk->numOfLines = line;
+	return NULL;
+}
+
+/**
+ * Checks the lines of a chunk of the meeting file (after its first line)
+ * @param arg pointer to "ValidationChunk"
+ * @return NULL
+ */
+static void *checkMeetingsChunk(void *arg)
+{
+	ValidationChunk *chunk = (ValidationChunk *) arg;
+	const char *cur = chunk->begin;
+	size_t line = 0;
+	while (cur < chunk->end && chunk->status == VALIDATION_SUCCESS)
+	{
+		const char *lineEnd = findLineEnd(cur, chunk->end);
+		MeetingInfo meeting;
+		if (scanMeetingFromBytes(cur, lineEnd, &meeting) == SCAN_FAILED)
+		{
+			addIssue(chunk, ISSUE_MALFORMED_MEETING, line);
+		}
+		else
+		{
+			checkId(chunk, meeting.infectorId, "infector", line);
+			checkId(chunk, meeting.infectedId, "infected", line);
+			if (!(meeting.distance > 0.0f)) // also not a number
+			{
+				ValidationIssue *issue = addIssue(chunk, ISSUE_NON_POSITIVE_DISTANCE, line);
+				if (issue != NULL)
+				{
+					issue->distance = meeting.distance;
+				}
+			}
+		}
+		line++;
+		cur = lineEnd < chunk->end ? lineEnd + 1 : chunk->end;
+	}
+	chunk->numOfLines = line;
+	return NULL;
+}
+
+/**
+ * A SeedConsumer that checks the ID of a seed
+ * @param id The ID of the seed
+ * @param context The chunk of the first line
+ * @return SCAN_SUCCESS (every seed is checked)
+ */
+static int checkSeed(size_t id, void *context)
+{
+	checkId((ValidationChunk *) context, id, "seed", 0);
+	return SCAN_SUCCESS;
+}
+
+/**
+ * Checks the first line of the meeting file: one or more IDs of people
+ * @param chunk The chunk of the line (begin and end are the line)
+ */
+static void checkSeedsLine(ValidationChunk *chunk)
+{
+	chunk->numOfLines = 1;
+	if (parseSeedsFromBytes(chunk->begin, chunk->end, checkSeed, chunk) == SCAN_FAILED)
+	{
+		addIssue(chunk, ISSUE_MALFORMED_SEEDS, 0);
+	}
+}
+
+/**
+ * Gives every chunk the number of its first line, after the lines of the chunks before it
+ * @param chunks The chunks
+ * @param numOfChunks The number of chunks
+ * @param firstLine The number of the first line of the first chunk
+ * @return The number of lines of all the chunks
+ */
+static size_t numberChunks(ValidationChunk *chunks, size_t numOfChunks, size_t firstLine)
+{
+	size_t numOfLines = 0;
+	for (size_t i = 0; i < numOfChunks; ++i)
+	{
+		chunks[i].firstLine = firstLine + numOfLines;
+		numOfLines += chunks[i].numOfLines;
+	}
+	return numOfLines;
+}
+
+/**
+ * Puts the people of the chunks in the ID table, in the order of the file. A person whose ID is
+ * already there is a problem of his chunk
+ * @param table The table
+ * @param chunks The chunks of the people file
+ * @param numOfChunks The number of chunks
+ * @param numOfPeople The number of people of all the chunks
+ * @return VALIDATION_SUCCESS or VALIDATION_FAILED
+ */
+static int buildIdTable(IdTable *table, ValidationChunk *chunks, size_t numOfChunks,
+                        size_t numOfPeople)
+{
+	unsigned int bits = MIN_ID_SLOTS_BITS;
+	size_t numOfSlots = (size_t) 1 << bits;
+	while (numOfSlots < numOfPeople * ID_SLOTS_PER_PERSON)
+	{
+		numOfSlots *= 2;
+		bits++;
+	}
+	table->slots = (IdLine *) trackedCalloc(numOfSlots, sizeof(IdLine)); // all EMPTY_ID_SLOT
+	if (table->slots == NULL)
+	{
+		return VALIDATION_FAILED;
+	}
+	table->numOfSlots = numOfSlots;
+	table->shift = BITS_IN_HASH - bits;
+	for (size_t i = 0; i < numOfChunks; ++i)
+	{
+		ValidationChunk *chunk = &chunks[i];
+		for (size_t p = 0; p < chunk->numOfPeople; ++p)
+		{
+			IdLine *slot = findIdSlot(table, chunk->people[p].id);
+			if (slot->line == EMPTY_ID_SLOT)
+			{
+				slot->id = chunk->people[p].id;
+				slot->line = chunk->firstLine + chunk->people[p].line;
+				continue;
+			}
+			ValidationIssue *issue = addIssue(chunk, ISSUE_DUPLICATE_ID, chunk->people[p].line);
+			if (issue != NULL)
+			{
+				issue->id = chunk->people[p].id;
+				issue->firstLine = slot->line;
+			}
+		}
+		if (chunk->status == VALIDATION_FAILED)
+		{
+			return VALIDATION_FAILED;
+		}
+	}
+	return VALIDATION_SUCCESS;
+}
+
+/**
+ * A comparison function to q-sort that orders the problems of a chunk by their lines (a line of
+ * the people file has at most one problem)
+ * @param first
+ * @param sec
+ * @return -1 if the first line is earlier, 1 if it is later and 0 if it is the same line
+ */
+static int cmpFuncIssueLine(const void *first, const void *sec)
+{
+	size_t left = ((const ValidationIssue *) first)->line;
+	size_t right = ((const ValidationIssue *) sec)->line;
+	return (left > right) - (left < right);
+}
+
+/**
+ * Writes the line of a problem to the report
+ * @param report The stream of the report
+ * @param path The path of the file
+ * @param line The line (from the beginning of the file)
+ * @param issue The problem
+ */
+static void writeIssue(FILE *report, const char *path, size_t line, const ValidationIssue *issue)
+{
+	fprintf(report, "%s:%zu: ", path, line);
+	switch (issue->kind)
+	{
+		case ISSUE_MALFORMED_PERSON:
+			fprintf(report, "not a person (<name> <ID> <age>)\n");
+			break;
+		case ISSUE_DUPLICATE_ID:
+			fprintf(report, "ID %zu already appeared on line %zu\n", issue->id, issue->firstLine);
+			break;
+		case ISSUE_MALFORMED_SEEDS:
+			fprintf(report, "not a line of seeds (one or more IDs)\n");
+			break;
+		case ISSUE_MALFORMED_MEETING:
+			fprintf(report, "not a meeting (<infector ID> <infected ID> <distance> <time>)\n");
+			break;
+		case ISSUE_UNKNOWN_PERSON:
+			fprintf(report, "the %s ID %zu is not in the people file\n", issue->role, issue->id);
+			break;
+		default: // ISSUE_NON_POSITIVE_DISTANCE
+			fprintf(report, "the distance %g is not positive\n", (double) issue->distance);
+			break;
+	}
+}
+
+/**
+ * Writes the listed problems of the chunks to the report, and adds their counts to the stats
+ * @param report The stream of the report
+ * @param path The path of the file
+ * @param chunks The chunks
+ * @param numOfChunks The number of chunks
+ * @param stats The stats
+ */
+static void writeChunkIssues(FILE *report, const char *path, ValidationChunk *chunks,
+                             size_t numOfChunks, ValidationStats *stats)
+{
+	for (size_t i = 0; i < numOfChunks; ++i)
+	{
+		ValidationChunk *chunk = &chunks[i];
+		if (chunk->numOfListed > 0) // a clean chunk has no array of issues to sort
+		{
+			qsort(chunk->issues, chunk->numOfListed, sizeof(ValidationIssue), cmpFuncIssueLine);
+		}
+		for (size_t j = 0; j < chunk->numOfListed; ++j)
+		{
+			writeIssue(report, path, chunk->firstLine + chunk->issues[j].line, &chunk->issues[j]);
+		}
+		stats->numOfListed += chunk->numOfListed;
+		for (int kind = 0; kind < NUM_OF_ISSUE_KINDS; ++kind)
+		{
+			stats->numOfIssues[kind] += chunk->numOfIssues[kind];
+		}
+	}
+}
+
+/**
+ * Releases the arrays of the chunks, and the chunks
+ * @param chunks The chunks (can be NULL)
+ * @param numOfChunks The number of chunks
+ */
+static void freeChunks(ValidationChunk *chunks, size_t numOfChunks)
+{
+	for (size_t i = 0; chunks != NULL && i < numOfChunks; ++i)
+	{
+		trackedFree(chunks[i].issues, chunks[i].issuesCapacity * sizeof(ValidationIssue));
+		trackedFree(chunks[i].people, chunks[i].peopleCapacity * sizeof(IdLine));
+	}
+	trackedFree(chunks, numOfChunks * sizeof(ValidationChunk));
+}
+
+/**
+ * Returns the number of chunks of a file
+ * @param len The number of bytes of the file
+ * @param numOfThreads The maximal number of threads
+ * @return The number of chunks (at least 1)
+ */
+static size_t numOfChunksOf(size_t len, size_t numOfThreads)
+{
+	size_t numOfChunks = len / MIN_BYTES_PER_CHUNK + 1;
+	numOfThreads = numOfThreads > 0 ? numOfThreads : 1;
+	return numOfChunks < numOfThreads ? numOfChunks : numOfThreads;
+}
+
+int validateInputFiles(const char *peoplePath, const char *peopleData, size_t peopleLen,
+                       const char *meetingsPath, const char *meetingsData, size_t meetingsLen,
+                       size_t numOfThreads, FILE *report, ValidationStats *stats)
+{
+	memset(stats, 0, sizeof(ValidationStats));
+	// The people file
+	size_t numOfPeopleChunks = numOfChunksOf(peopleLen, numOfThreads);
+	ValidationChunk *peopleChunks = (ValidationChunk *) trackedCalloc(numOfPeopleChunks,
+	                                                                 sizeof(ValidationChunk));
+	if (peopleChunks == NULL)
+	{
+		return VALIDATION_FAILED;
+	}
+	splitIntoChunks(peopleData, peopleLen, peopleChunks, numOfPeopleChunks);
+	runOnChunks(checkPeopleChunk, peopleChunks, numOfPeopleChunks);
+	stats->numOfPeopleLines = numberChunks(peopleChunks, numOfPeopleChunks, FIRST_LINE);
+	size_t numOfPeople = 0;
+	int status = VALIDATION_SUCCESS;
+	for (size_t i = 0; i < numOfPeopleChunks; ++i)
+	{
+		numOfPeople += peopleChunks[i].numOfPeople;
+		status = peopleChunks[i].status == VALIDATION_SUCCESS ? status : VALIDATION_FAILED;
+	}
+	IdTable table = {0};
+	if (status == VALIDATION_SUCCESS)
+	{
+		status = buildIdTable(&table, peopleChunks, numOfPeopleChunks, numOfPeople);
+	}
+	// The meeting file: the first line here, the rest by the chunks
+	const char *meetingsEnd = meetingsData + meetingsLen;
+	const char *seedsEnd = meetingsLen > 0 ? findLineEnd(meetingsData, meetingsEnd) : meetingsEnd;
+	const char *restBegin = seedsEnd < meetingsEnd ? seedsEnd + 1 : meetingsEnd;
+	int isMeetingsChecked = stats->numOfPeopleLines > 0 && meetingsLen > 0;
+	ValidationChunk seedsChunk = {0};
+	size_t numOfMeetingChunks = numOfChunksOf((size_t) (meetingsEnd - restBegin), numOfThreads);
+	ValidationChunk *meetingChunks = NULL;
+	if (status == VALIDATION_SUCCESS && isMeetingsChecked)
+	{
+		seedsChunk.begin = meetingsData;
+		seedsChunk.end = seedsEnd;
+		seedsChunk.table = &table;
+		seedsChunk.status = VALIDATION_SUCCESS;
+		checkSeedsLine(&seedsChunk);
+		meetingChunks = (ValidationChunk *) trackedCalloc(numOfMeetingChunks,
+		                                                  sizeof(ValidationChunk));
+		status = meetingChunks == NULL ? VALIDATION_FAILED : seedsChunk.status;
+	}
+	if (status == VALIDATION_SUCCESS && isMeetingsChecked)
+	{
+		splitIntoChunks(restBegin, (size_t) (meetingsEnd - restBegin), meetingChunks,
+		                numOfMeetingChunks);
+		for (size_t i = 0; i < numOfMeetingChunks; ++i)
+		{
+			meetingChunks[i].table = &table;
+		}
+		runOnChunks(checkMeetingsChunk, meetingChunks, numOfMeetingChunks);
+		numberChunks(&seedsChunk, 1, FIRST_LINE);
+		stats->numOfMeetingLines = FIRST_LINE + numberChunks(meetingChunks, numOfMeetingChunks,
+		                                                     FIRST_LINE + FIRST_LINE);
+		for (size_t i = 0; i < numOfMeetingChunks; ++i)
+		{
+			status = meetingChunks[i].status == VALIDATION_SUCCESS ? status : VALIDATION_FAILED;
+		}
+	}
+	if (status == VALIDATION_SUCCESS)
+	{
+		writeChunkIssues(report, peoplePath, peopleChunks, numOfPeopleChunks, stats);
+		if (isMeetingsChecked)
+		{
+			writeChunkIssues(report, meetingsPath, &seedsChunk, 1, stats);
+			writeChunkIssues(report, meetingsPath, meetingChunks, numOfMeetingChunks, stats);
+		}
+		stats->numOfChunks = numOfPeopleChunks + (isMeetingsChecked ? numOfMeetingChunks : 0);
+	}
+	trackedFree(table.slots, table.numOfSlots * sizeof(IdLine));
+	trackedFree(seedsChunk.issues, seedsChunk.issuesCapacity * sizeof(ValidationIssue));
+	freeChunks(peopleChunks, numOfPeopleChunks);
+	freeChunks(meetingChunks, numOfMeetingChunks);
+	return status;
+}
+
+size_t totalIssues(const ValidationStats *stats)
+{
+	size_t total = 0;
+	for (int kind = 0; kind < NUM_OF_ISSUE_KINDS; ++kind)
+	{
+		total += stats->numOfIssues[kind];
+	}
+	return total;
+}
@@ -0,0 +1,129 @@
+/**
+* @file SpreaderDetectorValidate.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Checks the two input files and reports every problem in them, without computing anything
+* @section DESCRIPTION
+* The loaders stop at the first invalid line. The validation reads both files to the end and
+* reports every problem with its line number:
+* - a line of the people file that is not "<name> <ID> <age>", and an ID that already appeared.
+* - a first line of the meeting file that is not one or more IDs, a line that is not
+*   "<infector ID> <infected ID> <distance> <time>", an ID that is not in the people file, and a
+*   distance that is not positive (the crna divides by it).
+* The lines are read with the same scan functions as the loaders (SpreaderDetectorScan.h), so a
+* line is reported as malformed exactly when the loaders would stop at it. A repeated ID and a
+* distance that is not positive are accepted by the loaders, but their results are wrong: the
+* meetings of an ID go only to its first person, and the crna of a zero distance is infinite.
+* Every file is split into chunks of whole lines, and every chunk is checked by its own thread.
+* Between the two files the people are put in an ID table in the order of the file, and the chunks
+* of the meeting file look their IDs up in it. Every problem is counted, and the first
+* VALIDATION_MAX_LISTED problems of every chunk are reported (in the order of the lines).
+*/
+
+#ifndef EXAM_SPREADERDETECTORVALIDATE_H
+#define EXAM_SPREADERDETECTORVALIDATE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @def VALIDATION_FAILED 0
+ * @brief Returned by validateInputFiles when an allocation failed
+ */
+#define VALIDATION_FAILED 0
+
+/**
+ * @def VALIDATION_SUCCESS 1
+ * @brief Returned by validateInputFiles when the files were checked (with or without problems)
+ */
+#define VALIDATION_SUCCESS 1
+
+/**
+ * @def VALIDATION_MAX_LISTED 10000
+ * @brief The number of problems of a chunk that are reported line by line (the rest are only
+ * counted), so a file with a problem in every line does not take its size again in memory
+ */
+#define VALIDATION_MAX_LISTED 10000
+
+/**
+ * @def ISSUE_MALFORMED_PERSON 0
+ * @brief A line of the people file that is not "<name> <ID> <age>"
+ */
+#define ISSUE_MALFORMED_PERSON 0
+
+/**
+ * @def ISSUE_DUPLICATE_ID 1
+ * @brief A person whose ID is the ID of a person in an earlier line
+ */
+#define ISSUE_DUPLICATE_ID 1
+
+/**
+ * @def ISSUE_MALFORMED_SEEDS 2
+ * @brief A first line of the meeting file that is not one or more IDs
+ */
+#define ISSUE_MALFORMED_SEEDS 2
+
+/**
+ * @def ISSUE_MALFORMED_MEETING 3
+ * @brief A line of the meeting file that is not "<infector ID> <infected ID> <distance> <time>"
+ */
+#define ISSUE_MALFORMED_MEETING 3
+
+/**
+ * @def ISSUE_UNKNOWN_PERSON 4
+ * @brief A seed, an infector or an infected that is not in the people file
+ */
+#define ISSUE_UNKNOWN_PERSON 4
+
+/**
+ * @def ISSUE_NON_POSITIVE_DISTANCE 5
+ * @brief A meeting whose distance is not positive (or not a number)
+ */
+#define ISSUE_NON_POSITIVE_DISTANCE 5
+
+/**
+ * @def NUM_OF_ISSUE_KINDS 6
+ * @brief The number of kinds of problems
+ */
+#define NUM_OF_ISSUE_KINDS 6
+
+/**
+ * @struct ValidationStats
+ * @brief What the validation found
+ */
+typedef struct ValidationStats
+{
+	size_t numOfPeopleLines;
+	size_t numOfMeetingLines;
+	size_t numOfIssues[NUM_OF_ISSUE_KINDS];
+	size_t numOfListed;
+	size_t numOfChunks;
+} ValidationStats;
+
+/**
+ * Checks the two files and writes a line for every problem that is listed:
+ * "<path>:<line>: <problem>", in the order of the lines, the people file first. When the people
+ * file has no lines, the meeting file is not checked (the loaders do not read it either)
+ * @param peoplePath The path of the people file (only for the report)
+ * @param peopleData The bytes of the people file
+ * @param peopleLen The number of bytes
+ * @param meetingsPath The path of the meeting file (only for the report)
+ * @param meetingsData The bytes of the meeting file
+ * @param meetingsLen The number of bytes
+ * @param numOfThreads The maximal number of threads that check every file
+ * @param report The stream of the report
+ * @param stats Will contain what was found
+ * @return VALIDATION_SUCCESS or VALIDATION_FAILED (no memory, nothing is written)
+ */
+int validateInputFiles(const char *peoplePath, const char *peopleData, size_t peopleLen,
+                       const char *meetingsPath, const char *meetingsData, size_t meetingsLen,
+                       size_t numOfThreads, FILE *report, ValidationStats *stats);
+
+/**
+ * The number of problems of all kinds
+ * @param stats What the validation found
+ * @return The number of problems
+ */
+size_t totalIssues(const ValidationStats *stats);
+
+#endif //EXAM_SPREADERDETECTORVALIDATE_H
@@ -0,0 +1,388 @@
+/**
+* @file SpreaderDetectorWindow.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the graph of the sliding window
+* @section DESCRIPTION
+* A slide of the window touches only what it changes: the meetings that left it (from the start of
+* the ring), and for every multiple of the half-life inside the window the meetings whose age passed
+* it (a range of the ring, found by binary search over the timestamps, which are sorted). If the
+* window moved by a whole half-life or more every meeting passed one, and all of them are weighed
+* again. The refresh is the propagation of SpreaderDetectorRankOrder.c (the one of the batches of
+* SpreaderDetectorIncremental.c), starting from the marked people, with the weights after the
+* decay.
+* When the ring is full it is copied into a ring twice as large (the oldest meeting in the first
+* slot) and all the lists are linked again, so the slots of the meetings are never moved between two
+* refreshes.
+*/
+
+#include <stdint.h>
+#include "SpreaderDetectorWindow.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorGraph.h"
+
+/**
+ * @def GROWTH_FACTOR 2
+ * @brief The ring grows by this factor when it is full (so its capacity stays a power of 2)
+ */
+#define GROWTH_FACTOR 2
+
+/**
+ * @def INIT_CAPACITY 64
+ * @brief The capacity of the ring when the first meeting is added (a power of 2)
+ */
+#define INIT_CAPACITY 64
+
+/**
+ * @def NO_DECAY_FACTOR 1.0f
+ * @brief The decay factor of a meeting younger than one half-life
+ */
+#define NO_DECAY_FACTOR 1.0f
+
+/**
+ * @def HALF 0.5f
+ * @brief The weight of a meeting is multiplied by it for every full half-life of its age
+ */
+#define HALF 0.5f
+
+/**
+ * @def NO_WEIGHT 0.0f
+ * @brief The decay factor of a meeting that is so old that its weight is 0
+ */
+#define NO_WEIGHT 0.0f
+
+/**
+ * @def MAX_HALVINGS 149
+ * @brief 2^-149 is the smallest float above 0, so after more halvings the weight is 0
+ */
+#define MAX_HALVINGS 149
+
+/**
+ * Returns the slot of a meeting in the ring
+ * @param graph The graph
+ * @param place The place of the meeting in the window (0 is the oldest)
+ * @return The slot
+ */
+static size_t slotOf(const WindowGraph *graph, size_t place)
+{
+	return (graph->firstEdge + place) & (graph->edgesCapacity - 1);
+}
+
+/**
+ * Returns the decay factor of a meeting: 1/2 for every full half-life of its age. The factor is a
+ * power of 2, so it is exact (and the weight is the same however the window got to this age)
+ * @param age The age of the meeting
+ * @param halfLife The half-life, or NO_DECAY
+ * @return The factor
+ */
+static float decayOfAge(size_t age, size_t halfLife)
+{
+	if (halfLife == NO_DECAY)
+	{
+		return NO_DECAY_FACTOR;
+	}
+	size_t halvings = age / halfLife;
+	if (halvings > MAX_HALVINGS)
+	{
+		return NO_WEIGHT;
+	}
+	float factor = NO_DECAY_FACTOR;
+	for (size_t i = 0; i < halvings; ++i)
+	{
+		factor *= HALF;
+	}
+	return factor;
+}
+
+/**
+ * Returns the meetings of the ring and their lists, with the weights after the decay
+ * @param graph The graph
+ * @return The meetings (valid until the ring grows)
+ */
+static RankEdges edgesOf(const WindowGraph *graph)
+{
+	RankEdges edges = {graph->infectors, graph->infecteds, graph->weights, graph->nextIn,
+	                   graph->nextOut, graph->prevOut, graph->inHeads, graph->inTails,
+	                   graph->outHeads};
+	return edges;
+}
+
+/**
+ * Takes the oldest meeting out of the window. It is the first in the list of its infected (the
+ * lists are in the order of the timestamps too), and its infected is marked
+ * @param graph The graph (with at least one meeting)
+ */
+static void expireOldest(WindowGraph *graph)
+{
+	size_t edge = graph->firstEdge;
+	size_t infector = graph->infectors[edge];
+	size_t infected = graph->infecteds[edge];
+	graph->inHeads[infected] = graph->nextIn[edge];
+	if (graph->inTails[infected] == edge)
+	{
+		graph->inTails[infected] = NO_EDGE;
+	}
+	if (graph->prevOut[edge] == NO_EDGE)
+	{
+		graph->outHeads[infector] = graph->nextOut[edge];
+	}
+	else
+	{
+		graph->nextOut[graph->prevOut[edge]] = graph->nextOut[edge];
+	}
+	if (graph->nextOut[edge] != NO_EDGE)
+	{
+		graph->prevOut[graph->nextOut[edge]] = graph->prevOut[edge];
+	}
+	removeRankEdge(&graph->order, infected);
+	graph->firstEdge = slotOf(graph, 1);
+	graph->numOfEdges--;
+	graph->numOfExpired++;
+}
+
+/**
+ * Releases the arrays of the edges
+ * @param graph The graph
+ * @param capacity The number of slots of the arrays
+ */
+static void freeEdgeArrays(WindowGraph *graph, size_t capacity)
+{
+	trackedFree(graph->infectors, capacity * sizeof(size_t));
+	trackedFree(graph->infecteds, capacity * sizeof(size_t));
+	trackedFree(graph->timestamps, capacity * sizeof(size_t));
+	trackedFree(graph->crnas, capacity * sizeof(float));
+	trackedFree(graph->weights, capacity * sizeof(float));
+	trackedFree(graph->nextIn, capacity * sizeof(size_t));
+	trackedFree(graph->nextOut, capacity * sizeof(size_t));
+	trackedFree(graph->prevOut, capacity * sizeof(size_t));
+}
+
+/**
+ * Copies the ring into a ring of GROWTH_FACTOR times its capacity (the oldest meeting in the first
+ * slot), and links all the lists again
+ * @param graph The graph
+ * @return WINDOW_SUCCESS or WINDOW_FAILED (the graph is not changed)
+ */
+static int growRing(WindowGraph *graph)
+{
+	size_t capacity = graph->edgesCapacity;
+	size_t newCapacity = capacity ? capacity * GROWTH_FACTOR : INIT_CAPACITY;
+	WindowGraph grown = *graph;
+	grown.infectors = (size_t *) trackedMalloc(newCapacity * sizeof(size_t));
+	grown.infecteds = (size_t *) trackedMalloc(newCapacity * sizeof(size_t));
+	grown.timestamps = (size_t *) trackedMalloc(newCapacity * sizeof(size_t));
+	grown.crnas = (float *) trackedMalloc(newCapacity * sizeof(float));
+	grown.weights = (float *) trackedMalloc(newCapacity * sizeof(float));
+	grown.nextIn = (size_t *) trackedMalloc(newCapacity * sizeof(size_t));
+	grown.nextOut = (size_t *) trackedMalloc(newCapacity * sizeof(size_t));
+	grown.prevOut = (size_t *) trackedMalloc(newCapacity * sizeof(size_t));
+	if (grown.infectors == NULL || grown.infecteds == NULL || grown.timestamps == NULL ||
+		grown.crnas == NULL || grown.weights == NULL || grown.nextIn == NULL ||
+		grown.nextOut == NULL || grown.prevOut == NULL)
+	{
+		freeEdgeArrays(&grown, newCapacity);
+		return WINDOW_FAILED;
+	}
+	for (size_t place = 0; place < graph->numOfEdges; ++place)
+	{
+		size_t slot = slotOf(graph, place);
+		grown.infectors[place] = graph->infectors[slot];
+		grown.infecteds[place] = graph->infecteds[slot];
+		grown.timestamps[place] = graph->timestamps[slot];
+		grown.crnas[place] = graph->crnas[slot];
+		grown.weights[place] = graph->weights[slot];
+	}
+	freeEdgeArrays(graph, capacity);
+	grown.firstEdge = 0;
+	grown.edgesCapacity = newCapacity;
+	*graph = grown;
+	for (size_t node = 0; node < graph->order.numOfNodes; ++node)
+	{
+		graph->outHeads[node] = NO_EDGE;
+		graph->inHeads[node] = NO_EDGE;
+		graph->inTails[node] = NO_EDGE;
+	}
+	RankEdges edges = edgesOf(graph);
+	for (size_t edge = 0; edge < graph->numOfEdges; ++edge)
+	{
+		linkRankEdge(&edges, edge);
+	}
+	return WINDOW_SUCCESS;
+}
+
+/**
+ * Computes the weight of a meeting at the current end of the window, and marks its infected if it
+ * was changed
+ * @param graph The graph
+ * @param edge The slot of the meeting
+ */
+static void weighEdge(WindowGraph *graph, size_t edge)
+{
+	float weight = graph->crnas[edge] * decayOfAge(graph->now - graph->timestamps[edge],
+	                                                graph->halfLife);
+	if (weight != graph->weights[edge])
+	{
+		graph->weights[edge] = weight;
+		markRankDirty(&graph->order, graph->infecteds[edge]);
+	}
+}
+
+/**
+ * Returns the place of the oldest meeting that is newer than a given time (binary search: the
+ * timestamps of the ring are sorted)
+ * @param graph The graph
+ * @param time The time
+ * @return The place (numOfEdges if there is no such meeting)
+ */
+static size_t firstNewerThan(const WindowGraph *graph, size_t time)
+{
+	size_t low = 0;
+	size_t high = graph->numOfEdges;
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		if (graph->timestamps[slotOf(graph, middle)] > time)
+		{
+			high = middle;
+		}
+		else
+		{
+			low = middle + 1;
+		}
+	}
+	return low;
+}
+
+/**
+ * Weighs again the meetings whose age passed a multiple of the half-life since the previous end of
+ * the window
+ * @param graph The graph (with a half-life)
+ * @param before The previous end of the window
+ */
+static void decayPassedMeetings(WindowGraph *graph, size_t before)
+{
+	size_t halfLife = graph->halfLife;
+	if (graph->now - before >= halfLife) // every meeting passed at least one
+	{
+		for (size_t place = 0; place < graph->numOfEdges; ++place)
+		{
+			weighEdge(graph, slotOf(graph, place));
+		}
+		return;
+	}
+	for (size_t passed = halfLife; passed < graph->windowLength && passed <= graph->now;
+	     passed += halfLife)
+	{
+		// the meetings whose age reached it in this slide: before - t < passed <= now - t
+		size_t place = before >= passed ? firstNewerThan(graph, before - passed) : 0;
+		for (; place < graph->numOfEdges &&
+		       graph->timestamps[slotOf(graph, place)] <= graph->now - passed; ++place)
+		{
+			weighEdge(graph, slotOf(graph, place));
+		}
+	}
+}
+
+int initWindowGraph(WindowGraph *graph, size_t numOfNodes, const size_t *keys, int combineRule,
+                    size_t windowLength, size_t halfLife, float *probs)
+{
+	graph->windowLength = windowLength;
+	graph->halfLife = halfLife;
+	int status = initRankOrder(&graph->order, numOfNodes, keys, combineRule, probs, 0);
+	graph->outHeads = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	graph->inHeads = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	graph->inTails = (size_t *) trackedMalloc(numOfNodes * sizeof(size_t));
+	if (status == RANK_FAILED ||
+		(numOfNodes > 0 &&
+		 (graph->outHeads == NULL || graph->inHeads == NULL || graph->inTails == NULL)))
+	{
+		return WINDOW_FAILED; // everything that was allocated is released with the graph
+	}
+	for (size_t node = 0; node < numOfNodes; ++node)
+	{
+		graph->outHeads[node] = NO_EDGE;
+		graph->inHeads[node] = NO_EDGE;
+		graph->inTails[node] = NO_EDGE;
+	}
+	return WINDOW_SUCCESS;
+}
+
+void addWindowSeed(WindowGraph *graph, size_t node)
+{
+	if (!graph->order.isSeed[node])
+	{
+		graph->order.isSeed[node] = 1;
+		markRankDirty(&graph->order, node);
+	}
+}
+
+int addWindowContact(WindowGraph *graph, size_t infector, size_t infected, float crna,
+                     size_t timestamp)
+{
+	if (advanceWindow(graph, timestamp) == WINDOW_OUT_OF_ORDER)
+	{
+		return WINDOW_OUT_OF_ORDER;
+	}
+	if (graph->numOfEdges == graph->edgesCapacity && growRing(graph) == WINDOW_FAILED)
+	{
+		return WINDOW_FAILED;
+	}
+	size_t edge = slotOf(graph, graph->numOfEdges);
+	graph->infectors[edge] = infector;
+	graph->infecteds[edge] = infected;
+	graph->timestamps[edge] = timestamp;
+	graph->crnas[edge] = crna;
+	graph->weights[edge] = crna * decayOfAge(graph->now - timestamp, graph->halfLife);
+	RankEdges edges = edgesOf(graph);
+	linkRankEdge(&edges, edge);
+	addRankEdge(&graph->order, infector, infected);
+	graph->numOfEdges++;
+	graph->numOfAdded++;
+	return WINDOW_SUCCESS;
+}
+
+int advanceWindow(WindowGraph *graph, size_t now)
+{
+	if (now < graph->now)
+	{
+		return WINDOW_OUT_OF_ORDER;
+	}
+	size_t before = graph->now;
+	graph->now = now;
+	while (graph->numOfEdges > 0 &&
+	       now - graph->timestamps[graph->firstEdge] >= graph->windowLength)
+	{
+		expireOldest(graph);
+	}
+	if (graph->halfLife != NO_DECAY && now > before)
+	{
+		decayPassedMeetings(graph, before);
+	}
+	return WINDOW_SUCCESS;
+}
+
+size_t refreshWindow(WindowGraph *graph)
+{
+	RankEdges edges = edgesOf(graph);
+	graph->numOfVisited += propagateRankOrder(&graph->order, &edges);
+	graph->numOfChanged += graph->order.numOfChanged;
+	return graph->order.numOfChanged;
+}
+
+size_t strongestWindowInfector(const WindowGraph *graph, size_t node)
+{
+	RankEdges edges = edgesOf(graph);
+	return strongestRankInfector(&graph->order, &edges, node);
+}
+
+void freeWindowGraph(WindowGraph *graph)
+{
+	size_t numOfNodes = graph->order.numOfNodes;
+	freeRankOrder(&graph->order);
+	freeEdgeArrays(graph, graph->edgesCapacity);
+	trackedFree(graph->outHeads, numOfNodes * sizeof(size_t));
+	trackedFree(graph->inHeads, numOfNodes * sizeof(size_t));
+	trackedFree(graph->inTails, numOfNodes * sizeof(size_t));
+	WindowGraph empty = {0};
+	*graph = empty;
+}
@@ -0,0 +1,167 @@
+/**
+* @file SpreaderDetectorWindow.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief The graph of the meetings of a continuous feed: only the meetings of a sliding time window
+* count, and their exposures decay with their age
+* @section DESCRIPTION
+* Every meeting has an absolute timestamp (in any unit, seconds for example), and the meetings come
+* in the order of their timestamps. The window ends at the newest timestamp (or at a later time the
+* clock was moved to), and a meeting counts while its age (the end of the window minus its
+* timestamp) is smaller than the length of the window. The meetings are kept in a ring, the oldest
+* first, so the meetings that leave the window are always at its start, and every one of them is
+* also the first in the list of the meetings that infect its infected.
+* The exposure of a meeting is the crna times a decay factor: the weight of a meeting is halved for
+* every full half-life of its age (a step and not a curve, so the weight of a meeting changes only
+* when its age passes a multiple of the half-life, and a slide of the window finds these meetings
+* with a binary search in the ring instead of touching all of them).
+* Nothing is computed when the window slides: the infecteds of the new meetings, of the meetings
+* that left and of the meetings whose weight was changed are only marked, and refreshWindow
+* computes them and everyone they change by SpreaderDetectorRankOrder.h, like a batch of
+* SpreaderDetectorIncremental.h (a heap by rank while the meetings keep the topological order,
+* Kahn's order over the affected people otherwise; removing a meeting never breaks the order). The
+* probabilities are exactly the ones a full propagation over the meetings of the window (with their
+* weights) would compute.
+*/
+
+#ifndef EXAM_SPREADERDETECTORWINDOW_H
+#define EXAM_SPREADERDETECTORWINDOW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SpreaderDetectorRankOrder.h"
+
+/**
+ * @def WINDOW_SUCCESS 1
+ * @brief Returned by the functions of the window when they succeeded
+ */
+#define WINDOW_SUCCESS 1
+
+/**
+ * @def WINDOW_FAILED 0
+ * @brief Returned by the functions of the window when an allocation failed
+ */
+#define WINDOW_FAILED 0
+
+/**
+ * @def WINDOW_OUT_OF_ORDER 2
+ * @brief Returned when a meeting (or a new end of the window) is older than the end of the window
+ */
+#define WINDOW_OUT_OF_ORDER 2
+
+/**
+ * @def NO_DECAY 0
+ * @brief The half-life of a window whose meetings do not decay
+ */
+#define NO_DECAY 0
+
+/**
+ * @def NO_WINDOW_INFECTOR NO_RANK_INFECTOR
+ * @brief Returned by strongestWindowInfector for a person that nobody in the window infected
+ */
+#define NO_WINDOW_INFECTOR NO_RANK_INFECTOR
+
+/**
+ * @struct WindowGraph
+ * @brief The graph of the window. The edges are a ring of edgesCapacity slots (a power of 2), the
+ * oldest in firstEdge; crnas are the crnas of the meetings and weights the crnas after the decay.
+ * nextIn links the edges that infect every vertex (inHeads to inTails, oldest first), and nextOut
+ * and prevOut the edges of every infector (from outHeads). order holds the probabilities, the
+ * seeds, the ranks and the marked people of the vertices (see SpreaderDetectorRankOrder.h). The
+ * counters are for the whole life of the graph. A graph initialized to {0} is empty
+ */
+typedef struct WindowGraph
+{
+	RankOrder order;
+	size_t windowLength;
+	size_t halfLife;
+	size_t now;
+	size_t *infectors;
+	size_t *infecteds;
+	size_t *timestamps;
+	float *crnas;
+	float *weights;
+	size_t *nextIn;
+	size_t *nextOut;
+	size_t *prevOut;
+	size_t firstEdge;
+	size_t numOfEdges;
+	size_t edgesCapacity;
+	size_t *outHeads;
+	size_t *inHeads;
+	size_t *inTails;
+	size_t numOfAdded;
+	size_t numOfExpired;
+	size_t numOfVisited;
+	size_t numOfChanged;
+} WindowGraph;
+
+/**
+ * Prepares an empty window
+ * @param graph The graph (empty)
+ * @param numOfNodes The number of vertices
+ * @param keys The key of every vertex (the ID of the person), to break the cycles by like
+ * propagateRisk (kept as long as the graph is used)
+ * @param combineRule COMBINE_MAX or COMBINE_NOISY_OR (see SpreaderDetectorGraph.h)
+ * @param windowLength The length of the window (positive, in the unit of the timestamps)
+ * @param halfLife The half-life of the exposures (in the unit of the timestamps), or NO_DECAY
+ * @param probs The probabilities of the vertices (all 0). They are updated by every refresh (and
+ * must stay valid as long as the graph is used)
+ * @return WINDOW_SUCCESS or WINDOW_FAILED (no memory)
+ */
+int initWindowGraph(WindowGraph *graph, size_t numOfNodes, const size_t *keys, int combineRule,
+                    size_t windowLength, size_t halfLife, float *probs);
+
+/**
+ * Marks a person as a seed (a person who is sick for sure, whatever the window holds)
+ * @param graph The graph
+ * @param node The vertex of the person
+ */
+void addWindowSeed(WindowGraph *graph, size_t node);
+
+/**
+ * Adds a meeting at the end of the window (the window first slides to its timestamp)
+ * @param graph The graph
+ * @param infector The vertex of the infector
+ * @param infected The vertex of the infected
+ * @param crna The crna of the meeting
+ * @param timestamp The timestamp of the meeting
+ * @return WINDOW_SUCCESS, WINDOW_OUT_OF_ORDER (older than the end of the window, nothing is
+ * changed) or WINDOW_FAILED (no memory)
+ */
+int addWindowContact(WindowGraph *graph, size_t infector, size_t infected, float crna,
+                     size_t timestamp);
+
+/**
+ * Slides the end of the window to a later time: the meetings that are too old leave it, and the
+ * weights of the meetings that passed another half-life are halved
+ * @param graph The graph
+ * @param now The new end of the window
+ * @return WINDOW_SUCCESS or WINDOW_OUT_OF_ORDER (earlier than the end of the window, nothing is
+ * changed)
+ */
+int advanceWindow(WindowGraph *graph, size_t now);
+
+/**
+ * Computes again the people that were marked since the last refresh, and everyone they change
+ * @param graph The graph
+ * @return The number of people whose probability was changed
+ */
+size_t refreshWindow(WindowGraph *graph);
+
+/**
+ * Finds the infector of the meeting in the window that gave a person his largest exposure (after
+ * the decay). The oldest of equal exposures
+ * @param graph The graph (refreshed)
+ * @param node The vertex of the person
+ * @return The vertex of the infector, or NO_WINDOW_INFECTOR (a seed, or no exposure)
+ */
+size_t strongestWindowInfector(const WindowGraph *graph, size_t node);
+
+/**
+ * Releases the graph. And turns it into an empty graph
+ * @param graph The graph
+ */
+void freeWindowGraph(WindowGraph *graph);
+
+#endif //EXAM_SPREADERDETECTORWINDOW_H
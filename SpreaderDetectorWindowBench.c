@@ -0,0 +1,392 @@
+/**
+* @file SpreaderDetectorWindowBench.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Streams a continuous feed of meetings through a windowed engine and measures it at steady
+* state
+* @section DESCRIPTION
+* Usage: window_bench [number of people] [meetings per second] [window length] [half-life]
+* [hours of feed] [meetings against the order in a thousand]
+* (the window and the half-life in seconds, a half-life of 0 for no decay)
+* The feed is generated here (always the same feed for the same arguments): every second of it has
+* the given number of meetings between random people, from an earlier person to a later one (so
+* there are no cycles, unless the last argument turns some of them around), and one person in a
+* thousand is a seed. Every minute of the feed is added
+* to the engine and then one person is queried, so the window is refreshed once a minute. After
+* the first window (when meetings start to leave it) the engine is at steady state, and from then
+* on the updates (meetings that were added or left the window) per second of wall time, the time
+* of a refresh, the people it visited and the memory of the engine are reported. At the end a new
+* engine gets only the meetings that are still in the window, and its probabilities must be
+* exactly the ones of the engine that slid all the way.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorEngine.h"
+#include "SpreaderDetectorGraph.h"
+#include "SpreaderDetectorParams.h"
+#include "SpreaderDetectorStats.h"
+
+/**
+ * @def DEFAULT_NUM_OF_PEOPLE 100000
+ * @brief The number of people when it is not given
+ */
+#define DEFAULT_NUM_OF_PEOPLE 100000
+
+/**
+ * @def DEFAULT_MEETINGS_PER_SECOND 2
+ * @brief The meetings in every second of the feed when it is not given
+ */
+#define DEFAULT_MEETINGS_PER_SECOND 2
+
+/**
+ * @def DEFAULT_WINDOW_LENGTH 86400
+ * @brief The window when it is not given: one day
+ */
+#define DEFAULT_WINDOW_LENGTH 86400
+
+/**
+ * @def DEFAULT_HALF_LIFE 21600
+ * @brief The half-life when it is not given: six hours
+ */
+#define DEFAULT_HALF_LIFE 21600
+
+/**
+ * @def DEFAULT_HOURS 72
+ * @brief The length of the feed when it is not given: three days
+ */
+#define DEFAULT_HOURS 72
+
+/**
+ * @def SECONDS_IN_HOUR 3600
+ * @brief Seconds in an hour
+ */
+#define SECONDS_IN_HOUR 3600
+
+/**
+ * @def SECONDS_PER_TICK 60
+ * @brief The window is refreshed after every minute of the feed
+ */
+#define SECONDS_PER_TICK 60
+
+/**
+ * @def FEED_START 1700000000
+ * @brief The timestamp of the first second of the feed
+ */
+#define FEED_START 1700000000
+
+/**
+ * @def PEOPLE_PER_SEED 1000
+ * @brief One person in PEOPLE_PER_SEED is a seed
+ */
+#define PEOPLE_PER_SEED 1000
+
+/**
+ * @def ID_STRIDE 7919
+ * @brief The IDs of the people are row * ID_STRIDE + 1 (so they are not their rows)
+ */
+#define ID_STRIDE 7919
+
+/**
+ * @def MAX_FEED_DISTANCE 10.0f
+ * @brief The distances of the meetings are between MIN_DISTANCE and this
+ */
+#define MAX_FEED_DISTANCE 10.0f
+
+/**
+ * @def FEED_SEED 2463534242u
+ * @brief The first state of the generator of the feed
+ */
+#define FEED_SEED 2463534242u
+
+/**
+ * @def PER_THOUSAND 1000
+ * @brief The meetings against the order are given in a thousand
+ */
+#define PER_THOUSAND 1000
+
+/**
+ * @def NAME_SIZE 32
+ * @brief The size of the buffer of a name
+ */
+#define NAME_SIZE 32
+
+/**
+ * @struct FeedMeeting
+ * @brief One meeting of the feed
+ */
+typedef struct FeedMeeting
+{
+	size_t infectorId;
+	size_t infectedId;
+	float distance;
+	float time;
+	size_t timestamp;
+} FeedMeeting;
+
+/**
+ * @struct Feed
+ * @brief The generator of the feed: the meetings of every second, one after the other
+ */
+typedef struct Feed
+{
+	uint64_t state;
+	size_t numOfPeople;
+	size_t meetingsPerSecond;
+	size_t backwardPerThousand;
+	size_t second;
+	size_t inSecond;
+} Feed;
+
+/**
+ * The next number of the generator (xorshift64*)
+ * @param feed The feed
+ * @return The number
+ */
+static uint64_t nextRandom(Feed *feed)
+{
+	feed->state ^= feed->state >> 12;
+	feed->state ^= feed->state << 25;
+	feed->state ^= feed->state >> 27;
+	return feed->state * 2685821657736338717ull;
+}
+
+/**
+ * Returns a random float in [low, high)
+ * @param feed The feed
+ * @param low The lowest value
+ * @param high The end of the range
+ * @return The float
+ */
+static float randomFloat(Feed *feed, float low, float high)
+{
+	return low + (high - low) * (float) (nextRandom(feed) >> 40) / (float) (1u << 24);
+}
+
+/**
+ * Returns the ID of the person of a row
+ * @param row The row
+ * @return The ID
+ */
+static size_t idOfRow(size_t row)
+{
+	return row * ID_STRIDE + 1;
+}
+
+/**
+ * Starts the feed from its beginning
+ * @param feed The feed
+ * @param numOfPeople The number of people (at least 2)
+ * @param meetingsPerSecond The meetings in every second
+ * @param backwardPerThousand The meetings (in a thousand) from a later person to an earlier one
+ */
+static void startFeed(Feed *feed, size_t numOfPeople, size_t meetingsPerSecond,
+                      size_t backwardPerThousand)
+{
+	feed->state = FEED_SEED;
+	feed->numOfPeople = numOfPeople;
+	feed->meetingsPerSecond = meetingsPerSecond;
+	feed->backwardPerThousand = backwardPerThousand;
+	feed->second = FEED_START;
+	feed->inSecond = 0;
+}
+
+/**
+ * Generates the next meeting of the feed
+ * @param feed The feed
+ * @param meeting Will contain the meeting
+ */
+static void nextMeeting(Feed *feed, FeedMeeting *meeting)
+{
+	if (feed->inSecond == feed->meetingsPerSecond)
+	{
+		feed->second++;
+		feed->inSecond = 0;
+	}
+	feed->inSecond++;
+	size_t first = (size_t) (nextRandom(feed) % feed->numOfPeople);
+	size_t sec = (size_t) (nextRandom(feed) % (feed->numOfPeople - 1));
+	sec += sec >= first; // another person
+	// no number is drawn without meetings against the order, so the feed stays the same
+	int isBackward = feed->backwardPerThousand > 0 &&
+	                 nextRandom(feed) % PER_THOUSAND < feed->backwardPerThousand;
+	meeting->infectorId = idOfRow((first < sec) != isBackward ? first : sec);
+	meeting->infectedId = idOfRow((first < sec) != isBackward ? sec : first);
+	meeting->distance = randomFloat(feed, MIN_DISTANCE, MAX_FEED_DISTANCE);
+	meeting->time = randomFloat(feed, 1.0f, MAX_TIME);
+	meeting->timestamp = feed->second;
+}
+
+/**
+ * Creates a windowed engine with the people and the seeds of the feed
+ * @param numOfPeople The number of people
+ * @param windowLength The length of the window
+ * @param halfLife The half-life
+ * @return The engine, or NULL (the error was printed)
+ */
+static SpreaderEngine *createFeedEngine(size_t numOfPeople, size_t windowLength, size_t halfLife)
+{
+	SpreaderEngine *engine;
+	int status = createWindowedEngine(&engine, COMBINE_MAX, windowLength, halfLife);
+	char name[NAME_SIZE];
+	for (size_t row = 0; status == ENGINE_SUCCESS && row < numOfPeople; ++row)
+	{
+		snprintf(name, sizeof(name), "P%zu", row);
+		status = engineAddPerson(engine, name, idOfRow(row), (float) (row % 90 + 1));
+	}
+	for (size_t row = 0; status == ENGINE_SUCCESS && row < numOfPeople; row += PEOPLE_PER_SEED)
+	{
+		status = engineAddSeed(engine, idOfRow(row));
+	}
+	if (status != ENGINE_SUCCESS)
+	{
+		fprintf(stderr, "engine: %s\n", engineStatusMessage(status));
+		destroyEngine(engine);
+		return NULL;
+	}
+	return engine;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t numOfPeople = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_NUM_OF_PEOPLE;
+	size_t meetingsPerSecond = argc > 2 ? strtoul(argv[2], NULL, 10) :
+	                           DEFAULT_MEETINGS_PER_SECOND;
+	size_t windowLength = argc > 3 ? strtoul(argv[3], NULL, 10) : DEFAULT_WINDOW_LENGTH;
+	size_t halfLife = argc > 4 ? strtoul(argv[4], NULL, 10) : DEFAULT_HALF_LIFE;
+	size_t hours = argc > 5 ? strtoul(argv[5], NULL, 10) : DEFAULT_HOURS;
+	size_t backwardPerThousand = argc > 6 ? strtoul(argv[6], NULL, 10) : 0;
+	size_t feedLength = hours * SECONDS_IN_HOUR;
+	if (numOfPeople < 2 || meetingsPerSecond == 0 || windowLength == 0 ||
+		feedLength <= windowLength || backwardPerThousand > PER_THOUSAND)
+	{
+		fprintf(stderr, "Usage: window_bench [number of people (at least 2)] "
+		                "[meetings per second] [window length] [half-life] "
+		                "[hours of feed (longer than the window)] "
+		                "[meetings against the order in a thousand (0 .. 1000)]\n");
+		return EXIT_FAILURE;
+	}
+	SpreaderEngine *engine = createFeedEngine(numOfPeople, windowLength, halfLife);
+	if (engine == NULL)
+	{
+		return EXIT_FAILURE;
+	}
+	Feed feed;
+	startFeed(&feed, numOfPeople, meetingsPerSecond, backwardPerThousand);
+	size_t numOfMeetings = feedLength * meetingsPerSecond;
+	size_t feedEnd = FEED_START + feedLength;
+	EngineResult result;
+	EngineWindowStats atSteadyState = {0};
+	int status = ENGINE_SUCCESS;
+	double steadyBegin = 0;
+	int isSteady = 0;
+	size_t steadyTicks = 0;
+	size_t peakLiveMeetings = 0;
+	FeedMeeting meeting;
+	nextMeeting(&feed, &meeting);
+	size_t numOfAdded = 0;
+	for (size_t tickEnd = FEED_START + SECONDS_PER_TICK; status == ENGINE_SUCCESS &&
+	                                                     tickEnd <= feedEnd;
+	     tickEnd += SECONDS_PER_TICK)
+	{
+		if (!isSteady && tickEnd > FEED_START + windowLength) // meetings start to leave now
+		{
+			isSteady = 1;
+			engineWindowStats(engine, &atSteadyState);
+			steadyBegin = currentSeconds();
+		}
+		while (status == ENGINE_SUCCESS && numOfAdded < numOfMeetings &&
+		       meeting.timestamp < tickEnd)
+		{
+			status = engineAddTimedMeeting(engine, meeting.infectorId, meeting.infectedId,
+			                               meeting.distance, meeting.time, meeting.timestamp);
+			if (++numOfAdded < numOfMeetings)
+			{
+				nextMeeting(&feed, &meeting);
+			}
+		}
+		if (status == ENGINE_SUCCESS)
+		{
+			status = engineAdvanceWindow(engine, tickEnd);
+		}
+		if (status == ENGINE_SUCCESS)
+		{
+			status = engineQueryRisk(engine, meeting.infectedId, &result); // the refresh
+			steadyTicks += isSteady;
+		}
+		EngineWindowStats now;
+		engineWindowStats(engine, &now);
+		peakLiveMeetings = now.numOfLiveMeetings > peakLiveMeetings ? now.numOfLiveMeetings :
+		                   peakLiveMeetings;
+	}
+	double steadySeconds = currentSeconds() - steadyBegin;
+	if (status != ENGINE_SUCCESS)
+	{
+		fprintf(stderr, "engine: %s\n", engineStatusMessage(status));
+		destroyEngine(engine);
+		return EXIT_FAILURE;
+	}
+	EngineWindowStats atEnd;
+	engineWindowStats(engine, &atEnd);
+	AllocationStats memory;
+	getAllocationStats(&memory);
+	size_t numOfUpdates = atEnd.numOfAdded - atSteadyState.numOfAdded + atEnd.numOfExpired -
+	                      atSteadyState.numOfExpired;
+	size_t numOfRefreshes = atEnd.numOfRefreshes - atSteadyState.numOfRefreshes;
+	printf("people: %zu, meetings: %zu (%zu per second), window: %zu s, half-life: %zu s\n",
+	       numOfPeople, numOfMeetings, meetingsPerSecond, windowLength, halfLife);
+	printf("steady state         %12.3f s of wall time for %zu minutes of feed\n", steadySeconds,
+	       steadyTicks);
+	printf("updates              %12zu (added %zu, left the window %zu)\n", numOfUpdates,
+	       atEnd.numOfAdded - atSteadyState.numOfAdded,
+	       atEnd.numOfExpired - atSteadyState.numOfExpired);
+	printf("updates per second   %12.0f\n", steadySeconds > 0 ? (double) numOfUpdates /
+	                                           steadySeconds : 0);
+	printf("refresh              %12.3f ms (visited %.1f people, changed %.1f)\n",
+	       numOfRefreshes ? steadySeconds * 1e3 / (double) numOfRefreshes : 0,
+	       numOfRefreshes ? (double) (atEnd.numOfVisited - atSteadyState.numOfVisited) /
+	                        (double) numOfRefreshes : 0,
+	       numOfRefreshes ? (double) (atEnd.numOfChanged - atSteadyState.numOfChanged) /
+	                        (double) numOfRefreshes : 0);
+	printf("meetings in window   %12zu (at most %zu)\n", atEnd.numOfLiveMeetings,
+	       peakLiveMeetings);
+	printf("heap in use          %12.1f MB (%.1f bytes per meeting in the window), peak %.1f MB\n",
+	       (double) memory.bytesInUse / 1e6, peakLiveMeetings ?
+	                                         (double) memory.bytesInUse / (double) peakLiveMeetings :
+	                                         0, (double) memory.peakBytesInUse / 1e6);
+	// A new engine with only the meetings that are still in the window
+	SpreaderEngine *fresh = createFeedEngine(numOfPeople, windowLength, halfLife);
+	startFeed(&feed, numOfPeople, meetingsPerSecond, backwardPerThousand);
+	for (size_t i = 0; fresh != NULL && status == ENGINE_SUCCESS && i < numOfMeetings; ++i)
+	{
+		FeedMeeting meeting;
+		nextMeeting(&feed, &meeting);
+		if (feedEnd - meeting.timestamp < windowLength)
+		{
+			status = engineAddTimedMeeting(fresh, meeting.infectorId, meeting.infectedId,
+			                               meeting.distance, meeting.time, meeting.timestamp);
+		}
+	}
+	if (fresh != NULL && status == ENGINE_SUCCESS)
+	{
+		status = engineAdvanceWindow(fresh, feedEnd);
+	}
+	size_t numOfMismatches = 0;
+	for (size_t row = 0; fresh != NULL && status == ENGINE_SUCCESS && row < numOfPeople; ++row)
+	{
+		EngineResult fromFresh;
+		status = engineQueryRisk(engine, idOfRow(row), &result);
+		if (status == ENGINE_SUCCESS)
+		{
+			status = engineQueryRisk(fresh, idOfRow(row), &fromFresh);
+		}
+		numOfMismatches += result.probInfected != fromFresh.probInfected;
+	}
+	int isExact = fresh != NULL && status == ENGINE_SUCCESS && numOfMismatches == 0;
+	printf("probabilities %s\n", isExact ? "exact" : "MISMATCH");
+	destroyEngine(fresh);
+	destroyEngine(engine);
+	return isExact ? EXIT_SUCCESS : EXIT_FAILURE;
+}
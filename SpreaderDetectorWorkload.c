@@ -0,0 +1,509 @@
+/**
+* @file SpreaderDetectorWorkload.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Generates people and meeting files of any size, for the benchmarks
+* @section DESCRIPTION
+* Usage: workload_gen <people path> <meetings path> [--people=N] [--topology=T] [--ids=I]
+*        [--seeds=K] [--name-len=L] [--seed=S]
+* Person i (0 .. N - 1) gets an ID that is computed from i alone, so nothing is kept in memory and
+* files of 10^9 people can be generated as well. People 0 .. K - 1 are the seeds, and every other
+* person is met exactly once, by an infector with a smaller index (so the meetings are written in
+* the order of the infection chain):
+* - chain: by person i - 1 (one long path)
+* - star: by one of the seeds (i % K)
+* - tree: by a random person before him
+* - cyclic: like tree, and one person in 4 also meets his infector back right after, so the
+*   meetings have cycles (the detector breaks them at the smallest IDs)
+* - multi-seed: like tree, with 16 seeds unless --seeds is given
+* The IDs (--ids) are sequential (i + 1), random (a bijective multiplicative hash of i + 1),
+* strided (multiples of 2^24) or clustered (64 dense ranges that are far apart). The names are
+* L random letters (8 by default). The same arguments always give the same files.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SpreaderDetectorParams.h"
+
+/**
+ * @def DEFAULT_NUM_OF_PEOPLE 1000
+ * @brief The number of people when --people is not given
+ */
+#define DEFAULT_NUM_OF_PEOPLE 1000
+
+/**
+ * @def DEFAULT_NAME_LEN 8
+ * @brief The length of the names when --name-len is not given
+ */
+#define DEFAULT_NAME_LEN 8
+
+/**
+ * @def MAX_NAME_LEN 900
+ * @brief A line of the people file has at most 1024 chars (with the ID and the age)
+ */
+#define MAX_NAME_LEN 900
+
+/**
+ * @def MULTI_SEED_DEFAULT_SEEDS 16
+ * @brief The number of seeds of the multi-seed topology when --seeds is not given
+ */
+#define MULTI_SEED_DEFAULT_SEEDS 16
+
+/**
+ * @def DEFAULT_RANDOM_SEED 12345
+ * @brief The seed of the random numbers when --seed is not given
+ */
+#define DEFAULT_RANDOM_SEED 12345
+
+/**
+ * @def ID_MULTIPLIER 0x9E3779B97F4A7C15
+ * @brief An odd multiplier, so multiplying by it modulo 2^64 is a bijection (the random IDs)
+ */
+#define ID_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+/**
+ * @def STRIDE_SHIFT 24
+ * @brief The strided IDs are (i + 1) << 24: all their low bits are 0
+ */
+#define STRIDE_SHIFT 24
+
+/**
+ * @def CLUSTER_BITS 6
+ * @brief The clustered IDs are in 2^6 ranges
+ */
+#define CLUSTER_BITS 6
+
+/**
+ * @def CLUSTER_SHIFT 52
+ * @brief The beginning of range c of the clustered IDs is c << 52
+ */
+#define CLUSTER_SHIFT 52
+
+/**
+ * @def FILE_BUFFER_SIZE (1 << 20)
+ * @brief The buffer of every output file
+ */
+#define FILE_BUFFER_SIZE (1 << 20)
+
+/**
+ * @def MAX_TENTHS_OF_AGE 1000
+ * @brief The ages are 0.0 .. 100.0
+ */
+#define MAX_TENTHS_OF_AGE 1000
+
+/**
+ * @def MAX_TENTHS_OF_DISTANCE 200
+ * @brief The distances are MIN_DISTANCE .. 20.0
+ */
+#define MAX_TENTHS_OF_DISTANCE 200
+
+/**
+ * @def MIN_TENTHS_OF_TIME 1
+ * @brief The times are 0.1 .. MAX_TIME
+ */
+#define MIN_TENTHS_OF_TIME 1
+
+/**
+ * @def ALPHABET_SIZE 26
+ * @brief The names are made of letters
+ */
+#define ALPHABET_SIZE 26
+
+/**
+ * @def MAX_DIGITS 20
+ * @brief The number of digits of the largest size_t
+ */
+#define MAX_DIGITS 20
+
+/**
+ * @def DECIMAL_BASE 10
+ * @brief The base of the numbers in the files
+ */
+#define DECIMAL_BASE 10
+
+/**
+ * @def TOPOLOGY_CHAIN 0
+ * @brief Every person is met by the person before him
+ */
+#define TOPOLOGY_CHAIN 0
+
+/**
+ * @def TOPOLOGY_STAR 1
+ * @brief Every person is met by a seed
+ */
+#define TOPOLOGY_STAR 1
+
+/**
+ * @def TOPOLOGY_TREE 2
+ * @brief Every person is met by a random person before him
+ */
+#define TOPOLOGY_TREE 2
+
+/**
+ * @def TOPOLOGY_CYCLIC 3
+ * @brief Like TOPOLOGY_TREE, and some people meet their infector back
+ */
+#define TOPOLOGY_CYCLIC 3
+
+/**
+ * @def MEETINGS_PER_BACK_MEETING 4
+ * @brief With TOPOLOGY_CYCLIC one person in 4 meets his infector back
+ */
+#define MEETINGS_PER_BACK_MEETING 4
+
+/**
+ * @def IDS_SEQUENTIAL 0
+ * @brief ID i + 1
+ */
+#define IDS_SEQUENTIAL 0
+
+/**
+ * @def IDS_RANDOM 1
+ * @brief ID (i + 1) * ID_MULTIPLIER
+ */
+#define IDS_RANDOM 1
+
+/**
+ * @def IDS_STRIDED 2
+ * @brief ID (i + 1) << STRIDE_SHIFT
+ */
+#define IDS_STRIDED 2
+
+/**
+ * @def IDS_CLUSTERED 3
+ * @brief ID in range i % 64, at place i / 64 + 1
+ */
+#define IDS_CLUSTERED 3
+
+/**
+ * @struct WorkloadOptions
+ * @brief The arguments of the generator
+ */
+typedef struct WorkloadOptions
+{
+	const char *peoplePath;
+	const char *meetingsPath;
+	size_t numOfPeople;
+	int topology;
+	int ids;
+	size_t numOfSeeds;
+	size_t nameLen;
+	uint64_t randomSeed;
+} WorkloadOptions;
+
+/**
+ * The state of the random numbers (xorshift64*, the same numbers on every platform)
+ */
+static uint64_t randomState;
+
+/**
+ * Returns the next random number
+ * @return 64 random bits
+ */
+static uint64_t nextRandom(void)
+{
+	randomState ^= randomState >> 12;
+	randomState ^= randomState << 25;
+	randomState ^= randomState >> 27;
+	return randomState * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Returns a random number in [0, bound)
+ * @param bound The bound (positive)
+ * @return The number
+ */
+static uint64_t randomBelow(uint64_t bound)
+{
+	return nextRandom() % bound;
+}
+
+/**
+ * Returns the ID of person i
+ * @param options The options (the kind of IDs)
+ * @param i The index of the person
+ * @return The ID
+ */
+static size_t idOfPerson(const WorkloadOptions *options, size_t i)
+{
+	uint64_t place = (uint64_t) i + 1;
+	switch (options->ids)
+	{
+		case IDS_RANDOM:
+			return (size_t) (place * ID_MULTIPLIER);
+		case IDS_STRIDED:
+			return (size_t) (place << STRIDE_SHIFT);
+		case IDS_CLUSTERED:
+			return (size_t) ((((uint64_t) i & ((1u << CLUSTER_BITS) - 1)) << CLUSTER_SHIFT) |
+			                 (((uint64_t) i >> CLUSTER_BITS) + 1));
+		default:
+			return (size_t) place;
+	}
+}
+
+/**
+ * Returns the index of the infector of person i (i >= the number of seeds)
+ * @param options The options (the topology)
+ * @param i The index of the person
+ * @return The index of the infector
+ */
+static size_t infectorOf(const WorkloadOptions *options, size_t i)
+{
+	switch (options->topology)
+	{
+		case TOPOLOGY_CHAIN:
+			return i - 1;
+		case TOPOLOGY_STAR:
+			return i % options->numOfSeeds;
+		default:
+			return (size_t) randomBelow(i);
+	}
+}
+
+/**
+ * Writes a number in decimal
+ * @param value The number
+ * @param file The file
+ */
+static void writeUnsigned(uint64_t value, FILE *file)
+{
+	char digits[MAX_DIGITS];
+	size_t len = 0;
+	do
+	{
+		digits[len++] = (char) ('0' + value % DECIMAL_BASE);
+		value /= DECIMAL_BASE;
+	} while (value != 0);
+	while (len > 0)
+	{
+		putc_unlocked(digits[--len], file);
+	}
+}
+
+/**
+ * Writes a number of tenths with one digit after the point ("12.3")
+ * @param tenths The number of tenths
+ * @param file The file
+ */
+static void writeTenths(uint64_t tenths, FILE *file)
+{
+	writeUnsigned(tenths / DECIMAL_BASE, file);
+	putc_unlocked('.', file);
+	putc_unlocked((char) ('0' + tenths % DECIMAL_BASE), file);
+}
+
+/**
+ * Writes one meeting with a random distance and time
+ * @param infectorId The ID of the infector
+ * @param infectedId The ID of the infected
+ * @param file The file
+ */
+static void writeMeeting(size_t infectorId, size_t infectedId, FILE *file)
+{
+	const uint64_t minDistance = (uint64_t) (MIN_DISTANCE * DECIMAL_BASE);
+	const uint64_t maxTime = (uint64_t) (MAX_TIME * DECIMAL_BASE);
+	writeUnsigned(infectorId, file);
+	putc_unlocked(' ', file);
+	writeUnsigned(infectedId, file);
+	putc_unlocked(' ', file);
+	writeTenths(minDistance + randomBelow(MAX_TENTHS_OF_DISTANCE - minDistance + 1), file);
+	putc_unlocked(' ', file);
+	writeTenths(MIN_TENTHS_OF_TIME + randomBelow(maxTime - MIN_TENTHS_OF_TIME + 1), file);
+	putc_unlocked('\n', file);
+}
+
+/**
+ * Writes the people file
+ * @param options The options
+ * @param file The file
+ */
+static void writePeople(const WorkloadOptions *options, FILE *file)
+{
+	for (size_t i = 0; i < options->numOfPeople; ++i)
+	{
+		putc_unlocked((char) ('A' + randomBelow(ALPHABET_SIZE)), file);
+		for (size_t c = 1; c < options->nameLen; ++c)
+		{
+			putc_unlocked((char) ('a' + randomBelow(ALPHABET_SIZE)), file);
+		}
+		putc_unlocked(' ', file);
+		writeUnsigned(idOfPerson(options, i), file);
+		putc_unlocked(' ', file);
+		writeTenths(randomBelow(MAX_TENTHS_OF_AGE + 1), file);
+		putc_unlocked('\n', file);
+	}
+}
+
+/**
+ * Writes the meeting file: the seeds, and then one meeting for every other person (and the
+ * meetings back of the cyclic topology)
+ * @param options The options
+ * @param file The file
+ */
+static void writeMeetings(const WorkloadOptions *options, FILE *file)
+{
+	for (size_t i = 0; i < options->numOfSeeds; ++i)
+	{
+		if (i > 0)
+		{
+			putc_unlocked(' ', file);
+		}
+		writeUnsigned(idOfPerson(options, i), file);
+	}
+	putc_unlocked('\n', file);
+	for (size_t i = options->numOfSeeds; i < options->numOfPeople; ++i)
+	{
+		size_t infector = infectorOf(options, i);
+		writeMeeting(idOfPerson(options, infector), idOfPerson(options, i), file);
+		if (options->topology == TOPOLOGY_CYCLIC && randomBelow(MEETINGS_PER_BACK_MEETING) == 0)
+		{
+			writeMeeting(idOfPerson(options, i), idOfPerson(options, infector), file);
+		}
+	}
+}
+
+/**
+ * Reads a positive number after the '=' of an option
+ * @param value The text after the '='
+ * @param number Will contain the number
+ * @return 1 if it is a positive number, 0 otherwise
+ */
+static int parsePositive(const char *value, size_t *number)
+{
+	char *numberEnd;
+	unsigned long long parsed = strtoull(value, &numberEnd, DECIMAL_BASE);
+	*number = (size_t) parsed;
+	return numberEnd != value && *numberEnd == '\0' && parsed > 0 && value[0] != '-';
+}
+
+/**
+ * Returns the value of an option
+ * @param arg The argument
+ * @param name The name of the option with its '='
+ * @return The text after the '=', or NULL if arg is not this option
+ */
+static const char *optionValue(const char *arg, const char *name)
+{
+	return strncmp(arg, name, strlen(name)) == 0 ? arg + strlen(name) : NULL;
+}
+
+/**
+ * Reads the arguments
+ * @param argc argc of main
+ * @param argv argv of main
+ * @param options Will contain the options
+ * @return 1 if they are valid, 0 otherwise
+ */
+static int parseWorkloadOptions(int argc, char *argv[], WorkloadOptions *options)
+{
+	const char *topologies[] = {"chain", "star", "tree", "cyclic", "multi-seed"};
+	const char *idKinds[] = {"sequential", "random", "strided", "clustered"};
+	int isMultiSeed = 0;
+	size_t randomSeed = DEFAULT_RANDOM_SEED;
+	options->numOfPeople = DEFAULT_NUM_OF_PEOPLE;
+	options->topology = TOPOLOGY_TREE;
+	options->ids = IDS_SEQUENTIAL;
+	options->numOfSeeds = 0;
+	options->nameLen = DEFAULT_NAME_LEN;
+	if (argc < 3)
+	{
+		return 0;
+	}
+	options->peoplePath = argv[1];
+	options->meetingsPath = argv[2];
+	for (int i = 3; i < argc; ++i)
+	{
+		const char *value;
+		int isValid = 0;
+		if ((value = optionValue(argv[i], "--people=")) != NULL)
+		{
+			isValid = parsePositive(value, &options->numOfPeople);
+		}
+		else if ((value = optionValue(argv[i], "--seeds=")) != NULL)
+		{
+			isValid = parsePositive(value, &options->numOfSeeds);
+		}
+		else if ((value = optionValue(argv[i], "--name-len=")) != NULL)
+		{
+			isValid = parsePositive(value, &options->nameLen) && options->nameLen <= MAX_NAME_LEN;
+		}
+		else if ((value = optionValue(argv[i], "--seed=")) != NULL)
+		{
+			isValid = parsePositive(value, &randomSeed);
+		}
+		else if ((value = optionValue(argv[i], "--topology=")) != NULL)
+		{
+			for (int t = 0; t < (int) (sizeof(topologies) / sizeof(topologies[0])); ++t)
+			{
+				if (strcmp(value, topologies[t]) == 0)
+				{
+					isMultiSeed = t > TOPOLOGY_CYCLIC;
+					options->topology = isMultiSeed ? TOPOLOGY_TREE : t;
+					isValid = 1;
+				}
+			}
+		}
+		else if ((value = optionValue(argv[i], "--ids=")) != NULL)
+		{
+			for (int k = 0; k < (int) (sizeof(idKinds) / sizeof(idKinds[0])); ++k)
+			{
+				if (strcmp(value, idKinds[k]) == 0)
+				{
+					options->ids = k;
+					isValid = 1;
+				}
+			}
+		}
+		if (!isValid)
+		{
+			return 0;
+		}
+	}
+	if (options->numOfSeeds == 0)
+	{
+		options->numOfSeeds = isMultiSeed ? MULTI_SEED_DEFAULT_SEEDS : 1;
+	}
+	options->randomSeed = (uint64_t) randomSeed;
+	return options->numOfSeeds <= options->numOfPeople;
+}
+
+int main(int argc, char *argv[])
+{
+	WorkloadOptions options;
+	if (!parseWorkloadOptions(argc, argv, &options))
+	{
+		fprintf(stderr, "Usage: workload_gen <people path> <meetings path> [--people=N] "
+		                "[--topology=chain|star|tree|cyclic|multi-seed] "
+		                "[--ids=sequential|random|strided|clustered] [--seeds=K] [--name-len=L] "
+		                "[--seed=S]\n");
+		return EXIT_FAILURE;
+	}
+	randomState = options.randomSeed;
+	FILE *people = fopen(options.peoplePath, "w");
+	FILE *meetings = fopen(options.meetingsPath, "w");
+	int status = people != NULL && meetings != NULL &&
+	             setvbuf(people, NULL, _IOFBF, FILE_BUFFER_SIZE) == 0 &&
+	             setvbuf(meetings, NULL, _IOFBF, FILE_BUFFER_SIZE) == 0;
+	if (status)
+	{
+		writePeople(&options, people);
+		writeMeetings(&options, meetings);
+		status = !ferror(people) && !ferror(meetings);
+	}
+	if (people != NULL)
+	{
+		status = fclose(people) == 0 && status;
+	}
+	if (meetings != NULL)
+	{
+		status = fclose(meetings) == 0 && status;
+	}
+	if (!status)
+	{
+		fprintf(stderr, STANDARD_LIB_ERR_MSG);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
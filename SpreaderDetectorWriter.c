@@ -0,0 +1,238 @@
+/**
+* @file SpreaderDetectorWriter.c
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Implementation of the buffered writer of the output file
+* @section DESCRIPTION
+* The ID is formatted two digits at a time (from a table of "00" .. "99"), from the last digit to
+* the first, like "%lu" does.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "SpreaderDetectorWriter.h"
+#include "SpreaderDetectorArena.h"
+#include "SpreaderDetectorOrder.h"
+#include "SpreaderDetectorParams.h"
+#include "SpreaderDetectorStats.h"
+
+/**
+ * @def OUTPUT_FILE_MODE 0666
+ * @brief The permissions of a new output file (before the umask), like fopen
+ */
+#define OUTPUT_FILE_MODE 0666
+
+/**
+ * @def NAME_FORMAT "%s"
+ * @brief The place of the name in the messages of SpreaderDetectorParams.h
+ */
+#define NAME_FORMAT "%s"
+
+/**
+ * @def ID_FORMAT "%lu"
+ * @brief The place of the ID in the messages of SpreaderDetectorParams.h
+ */
+#define ID_FORMAT "%lu"
+
+/**
+ * @def MAX_ID_DIGITS 20
+ * @brief The number of digits of the largest size_t (2^64 - 1)
+ */
+#define MAX_ID_DIGITS 20
+
+/**
+ * @def MAX_NAME_LEN 1024
+ * @brief The longest name we write (MAX_LINE_SIZE - 1 in the backend)
+ */
+#define MAX_NAME_LEN 1024
+
+/**
+ * @def HOSPITALIZATION_MESSAGE 0
+ * @brief The place of MEDICAL_SUPERVISION_THRESHOLD_MSG in the messages of the writer (the
+ * messages are in the order of the classes, so the class is the place of its message)
+ */
+#define HOSPITALIZATION_MESSAGE 0
+
+/**
+ * @def QUARANTINE_MESSAGE 1
+ * @brief The place of REGULAR_QUARANTINE_MSG in the messages of the writer
+ */
+#define QUARANTINE_MESSAGE 1
+
+/**
+ * @def CLEAN_MESSAGE 2
+ * @brief The place of CLEAN_MSG in the messages of the writer
+ */
+#define CLEAN_MESSAGE 2
+
+/**
+ * The pairs of digits "00" .. "99"
+ */
+static const char digitPairs[] =
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+
+/**
+ * Splits a message around its "%s" and its "%lu"
+ * @param message The message (a string literal from SpreaderDetectorParams.h)
+ * @param messageTemplate Will contain the parts
+ * @return WRITER_SUCCESS, or WRITER_FAILED if the message is not "...%s...%lu..."
+ */
+static int splitMessage(const char *message, MessageTemplate *messageTemplate)
+{
+	const char *name = strstr(message, NAME_FORMAT);
+	const char *id = name != NULL ? strstr(name + strlen(NAME_FORMAT), ID_FORMAT) : NULL;
+	if (id == NULL)
+	{
+		return WRITER_FAILED;
+	}
+	messageTemplate->beforeName = message;
+	messageTemplate->beforeNameLen = (size_t) (name - message);
+	messageTemplate->beforeId = name + strlen(NAME_FORMAT);
+	messageTemplate->beforeIdLen = (size_t) (id - messageTemplate->beforeId);
+	messageTemplate->afterId = id + strlen(ID_FORMAT);
+	messageTemplate->afterIdLen = strlen(messageTemplate->afterId);
+	return WRITER_SUCCESS;
+}
+
+/**
+ * Writes the whole buffer to the file (write may write only a part of it)
+ * @param writer The writer
+ */
+static void flushBuffer(OutputWriter *writer)
+{
+	size_t written = 0;
+	while (written < writer->len && writer->status == WRITER_SUCCESS)
+	{
+		ssize_t result = write(writer->fd, writer->buffer + written, writer->len - written);
+		if (result < 0 && errno != EINTR)
+		{
+			writer->status = WRITER_FAILED;
+		}
+		else if (result > 0)
+		{
+			written += (size_t) result;
+		}
+	}
+	COUNT_BYTES_WRITTEN(written);
+	writer->len = 0;
+}
+
+/**
+ * Formats a number in decimal (exactly like "%lu")
+ * @param value The number
+ * @param out Room for MAX_ID_DIGITS chars
+ * @return The number of chars
+ */
+static size_t formatUnsigned(size_t value, char *out)
+{
+	char digits[MAX_ID_DIGITS];
+	char *cur = digits + MAX_ID_DIGITS;
+	while (value >= 100)
+	{
+		size_t pair = (value % 100) * 2;
+		value /= 100;
+		*--cur = digitPairs[pair + 1];
+		*--cur = digitPairs[pair];
+	}
+	if (value >= 10)
+	{
+		*--cur = digitPairs[value * 2 + 1];
+		*--cur = digitPairs[value * 2];
+	}
+	else
+	{
+		*--cur = (char) ('0' + value);
+	}
+	size_t len = (size_t) (digits + MAX_ID_DIGITS - cur);
+	memcpy(out, cur, len);
+	return len;
+}
+
+int openOutputWriter(OutputWriter *writer, const char *path)
+{
+	return openSizedOutputWriter(writer, path, OUTPUT_BUFFER_SIZE);
+}
+
+int openSizedOutputWriter(OutputWriter *writer, const char *path, size_t bufferSize)
+{
+	writer->len = 0;
+	writer->status = WRITER_SUCCESS;
+	if (splitMessage(MEDICAL_SUPERVISION_THRESHOLD_MSG,
+	                 &writer->messages[HOSPITALIZATION_MESSAGE]) == WRITER_FAILED ||
+		splitMessage(REGULAR_QUARANTINE_MSG, &writer->messages[QUARANTINE_MESSAGE]) ==
+		WRITER_FAILED || splitMessage(CLEAN_MSG, &writer->messages[CLEAN_MESSAGE]) == WRITER_FAILED)
+	{
+		return WRITER_FAILED;
+	}
+	writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, OUTPUT_FILE_MODE);
+	if (writer->fd < 0)
+	{
+		return WRITER_OPEN_FAILED;
+	}
+	writer->bufferSize = bufferSize < MIN_OUTPUT_BUFFER_SIZE ? MIN_OUTPUT_BUFFER_SIZE : bufferSize;
+	writer->buffer = (char *) trackedMalloc(writer->bufferSize);
+	if (writer->buffer == NULL)
+	{
+		close(writer->fd);
+		return WRITER_FAILED;
+	}
+	return WRITER_SUCCESS;
+}
+
+void writePersonLine(OutputWriter *writer, const char *name, size_t nameLen, size_t id,
+                     unsigned int riskClass)
+{
+	const MessageTemplate *message = &writer->messages[riskClass < NUM_OF_CLASSES ? riskClass :
+	                                                   CLEAN_CLASS];
+	nameLen = nameLen < MAX_NAME_LEN ? nameLen : MAX_NAME_LEN;
+	const char *nameEnd = (const char *) memchr(name, '\0', nameLen); // "%s" stops at a '\0'
+	nameLen = nameEnd != NULL ? (size_t) (nameEnd - name) : nameLen;
+	size_t lineLen = message->beforeNameLen + nameLen + message->beforeIdLen + MAX_ID_DIGITS +
+	                 message->afterIdLen;
+	if (writer->bufferSize - writer->len < lineLen)
+	{
+		flushBuffer(writer);
+	}
+	char *cur = writer->buffer + writer->len;
+	memcpy(cur, message->beforeName, message->beforeNameLen);
+	cur += message->beforeNameLen;
+	memcpy(cur, name, nameLen);
+	cur += nameLen;
+	memcpy(cur, message->beforeId, message->beforeIdLen);
+	cur += message->beforeIdLen;
+	cur += formatUnsigned(id, cur);
+	memcpy(cur, message->afterId, message->afterIdLen);
+	cur += message->afterIdLen;
+	writer->len = (size_t) (cur - writer->buffer);
+}
+
+int endOutputBatch(OutputWriter *writer)
+{
+	if (writer->len == writer->bufferSize)
+	{
+		flushBuffer(writer);
+	}
+	writer->buffer[writer->len++] = '\n';
+	flushBuffer(writer);
+	return writer->status;
+}
+
+int closeOutputWriter(OutputWriter *writer)
+{
+	if (writer->buffer == NULL) // closed
+	{
+		return writer->status;
+	}
+	flushBuffer(writer);
+	if (close(writer->fd) != 0)
+	{
+		writer->status = WRITER_FAILED;
+	}
+	trackedFree(writer->buffer, writer->bufferSize);
+	writer->buffer = NULL;
+	return writer->status;
+}
@@ -0,0 +1,133 @@
+/**
+* @file SpreaderDetectorWriter.h
+* @author Aviel Shtern <aviel.shtern@mail.huji.ac.il>
+* @version 1.0
+* @brief Writes the lines of the output file through one large buffer
+* @section DESCRIPTION
+* Instead of one fprintf per person (parsing the format and locking the stream every time), the
+* three messages of SpreaderDetectorParams.h are split once into their constant parts (before the
+* name, between the name and the ID, after the ID). Every line is built by copying the parts and
+* formatting the ID by hand into a buffer of OUTPUT_BUFFER_SIZE bytes (or of the size a mode under
+* a memory budget gives), and the full buffer is given to the operating system with one write call.
+* The bytes are exactly the bytes fprintf would write.
+*/
+
+#ifndef EXAM_SPREADERDETECTORWRITER_H
+#define EXAM_SPREADERDETECTORWRITER_H
+
+#include <stddef.h>
+
+/**
+ * @def WRITER_SUCCESS 0
+ * @brief The writer is fine
+ */
+#define WRITER_SUCCESS 0
+
+/**
+ * @def WRITER_OPEN_FAILED 1
+ * @brief The output file could not be opened
+ */
+#define WRITER_OPEN_FAILED 1
+
+/**
+ * @def WRITER_FAILED 2
+ * @brief An allocation or a write failed (a standard library error)
+ */
+#define WRITER_FAILED 2
+
+/**
+ * @def OUTPUT_BUFFER_SIZE (1 << 20)
+ * @brief The size of the buffer of the writer (1MB), so a write call writes thousands of lines
+ */
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+/**
+ * @def MIN_OUTPUT_BUFFER_SIZE (1 << 12)
+ * @brief The smallest buffer of a writer (4KB): the longest line (a name of MAX_NAME_LEN chars and
+ * an ID of MAX_ID_DIGITS digits, see SpreaderDetectorWriter.c) always fits in it
+ */
+#define MIN_OUTPUT_BUFFER_SIZE (1 << 12)
+
+/**
+ * @def NUM_OF_MESSAGES 3
+ * @brief The messages of the output: hospitalization, quarantine and clean
+ */
+#define NUM_OF_MESSAGES 3
+
+/**
+ * @struct MessageTemplate
+ * @brief One message of SpreaderDetectorParams.h split around its "%s" (the name) and its "%lu"
+ * (the ID). The parts point into the string literal of the message
+ */
+typedef struct MessageTemplate
+{
+	const char *beforeName;
+	size_t beforeNameLen;
+	const char *beforeId;
+	size_t beforeIdLen;
+	const char *afterId;
+	size_t afterIdLen;
+} MessageTemplate;
+
+/**
+ * @struct OutputWriter
+ * @brief The output file and its buffer. A writer initialized to {0} is closed (and can be closed
+ * again)
+ */
+typedef struct OutputWriter
+{
+	int fd;
+	char *buffer;
+	size_t bufferSize;
+	size_t len;
+	int status;
+	MessageTemplate messages[NUM_OF_MESSAGES];
+} OutputWriter;
+
+/**
+ * Opens (creates or truncates) the output file
+ * @param writer The writer (closed)
+ * @param path The path of the output file
+ * @return WRITER_SUCCESS, WRITER_OPEN_FAILED or WRITER_FAILED
+ */
+int openOutputWriter(OutputWriter *writer, const char *path);
+
+/**
+ * Opens (creates or truncates) the output file with a buffer of bufferSize bytes (at least
+ * MIN_OUTPUT_BUFFER_SIZE), for a mode that keeps its heap under a budget
+ * @param writer The writer (closed)
+ * @param path The path of the output file
+ * @param bufferSize The size of the buffer
+ * @return WRITER_SUCCESS, WRITER_OPEN_FAILED or WRITER_FAILED
+ */
+int openSizedOutputWriter(OutputWriter *writer, const char *path, size_t bufferSize);
+
+/**
+ * Adds the line of one person (Is hospitalization, isolation needed or is it clean). The line is
+ * written to the file when the buffer is full, or when the writer is closed
+ * @param writer The writer
+ * @param name The name of the person (not '\0' terminated)
+ * @param nameLen The length of the name
+ * @param id The ID of the person
+ * @param riskClass The class of the person (HOSPITALIZATION_CLASS, QUARANTINE_CLASS or CLEAN_CLASS,
+ * see SpreaderDetectorPolicy.h)
+ */
+void writePersonLine(OutputWriter *writer, const char *name, size_t nameLen, size_t id,
+                     unsigned int riskClass);
+
+/**
+ * Ends a batch of lines (the incremental mode): adds an empty line and writes the buffer to the
+ * file, so a reader of the file sees the whole batch at once
+ * @param writer The writer
+ * @return WRITER_SUCCESS, or WRITER_FAILED if any write failed (since the writer was opened)
+ */
+int endOutputBatch(OutputWriter *writer);
+
+/**
+ * Writes the rest of the buffer, closes the file and releases the buffer
+ * @param writer The writer
+ * @return WRITER_SUCCESS, or WRITER_FAILED if any write failed (since the writer was opened)
+ */
+int closeOutputWriter(OutputWriter *writer);
+
+#endif //EXAM_SPREADERDETECTORWRITER_H